@@ -55,6 +55,18 @@ void md5_vector(size_t num_elem, const u8 *addr[], const size_t *len, u8 *mac);
 void sha1_vector(size_t num_elem, const u8 *addr[], const size_t *len,
      u8 *mac);
 
+/**
+ * sha1_transform - Perform one SHA-1 compression function iteration
+ * @state: SHA-1 chaining state (five 32-bit words in host byte order)
+ * @data: 64-octet message block
+ * Returns: 0 on success, -1 if the crypto library does not expose the
+ * compression function
+ *
+ * This is used to speed up HMAC-SHA1 based constructions (e.g., PBKDF2) by
+ * hashing the HMAC key pads only once and reusing the resulting states.
+ */
+int sha1_transform(u32 state[5], const u8 data[64]);
+
 /**
  * fips186_2-prf - NIST FIPS Publication 186-2 change notice 1 PRF
  * @seed: Seed/key for the PRF
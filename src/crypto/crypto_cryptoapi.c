@@ -236,6 +236,13 @@ void sha1_vector(size_t num_elem, const u8 *addr[], const size_t *len, u8 *mac)
 }
 
 
+int sha1_transform(u32 state[5], const u8 data[64])
+{
+        /* SHA-1 compression function is not exposed by the library */
+        return -1;
+}
+
+
 struct aes_context {
         HCRYPTPROV prov;
         HCRYPTKEY ckey;
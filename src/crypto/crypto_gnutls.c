@@ -91,6 +91,13 @@ void sha1_vector(size_t num_elem, const u8 *addr[], const size_t *len, u8 *mac)
 }
 
 
+int sha1_transform(u32 state[5], const u8 data[64])
+{
+        /* SHA-1 compression function is not exposed by the library */
+        return -1;
+}
+
+
 #ifndef CONFIG_NO_FIPS186_2_PRF
 int fips186_2_prf(const u8 *seed, size_t seed_len, u8 *x, size_t xlen)
 {
@@ -87,6 +87,13 @@ void sha1_vector(size_t num_elem, const u8 *addr[], const size_t *len, u8 *mac)
 }
 
 
+int sha1_transform(u32 state[5], const u8 data[64])
+{
+        /* SHA-1 compression function is not exposed by the library */
+        return -1;
+}
+
+
 void * aes_encrypt_init(const u8 *key, size_t len)
 {
         symmetric_key *skey;
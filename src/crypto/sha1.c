@@ -356,42 +356,161 @@ int tls_prf(const u8 *secret, size_t secret_len, const char *label,
 
 #ifndef CONFIG_NO_PBKDF2
 
-static void pbkdf2_sha1_f(const char *passphrase, const char *ssid,
-                          size_t ssid_len, int iterations, unsigned int count,
-                          u8 *digest)
+/* HMAC-SHA1 key with the ipad/opad blocks already run through SHA-1 */
+struct pbkdf2_sha1_key {
+        u32 inner[5];
+        u32 outer[5];
+};
+
+
+static int pbkdf2_sha1_key_init(struct pbkdf2_sha1_key *hkey,
+                                const u8 *key, size_t key_len)
 {
-        unsigned char tmp[SHA1_MAC_LEN], tmp2[SHA1_MAC_LEN];
+        static const u32 sha1_iv[5] = {
+                0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0
+        };
+        u8 k_pad[64], tk[SHA1_MAC_LEN];
+        size_t i;
+        int ret;
+
+        if (key_len > 64) {
+                sha1_vector(1, &key, &key_len, tk);
+                key = tk;
+                key_len = SHA1_MAC_LEN;
+        }
+
+        os_memset(k_pad, 0, sizeof(k_pad));
+        os_memcpy(k_pad, key, key_len);
+        for (i = 0; i < 64; i++)
+                k_pad[i] ^= 0x36;
+        os_memcpy(hkey->inner, sha1_iv, sizeof(sha1_iv));
+        ret = sha1_transform(hkey->inner, k_pad);
+
+        os_memset(k_pad, 0, sizeof(k_pad));
+        os_memcpy(k_pad, key, key_len);
+        for (i = 0; i < 64; i++)
+                k_pad[i] ^= 0x5c;
+        os_memcpy(hkey->outer, sha1_iv, sizeof(sha1_iv));
+        if (ret == 0)
+                ret = sha1_transform(hkey->outer, k_pad);
+
+        os_memset(k_pad, 0, sizeof(k_pad));
+        os_memset(tk, 0, sizeof(tk));
+        return ret;
+}
+
+
+/*
+ * Run count iterations of the PBKDF2 F() function on top of the previous U
+ * (u) and the XOR of all previous U values (digest); both are updated. Each
+ * U is HMAC-SHA1 of the 20-octet previous U, so both the inner and the outer
+ * hash fit into a single padded block on top of the precomputed key pad
+ * states.
+ */
+static void pbkdf2_sha1_iterate(const struct pbkdf2_sha1_key *hkey,
+                                u8 *u_buf, u8 *digest, int count)
+{
+        u8 block[64];
+        u32 state[5], u[5], acc[5];
+        int i, j;
+
+        /* Message padding for 64 + 20 octets of data (672 bits) */
+        os_memset(block, 0, sizeof(block));
+        block[SHA1_MAC_LEN] = 0x80;
+        block[62] = 0x02;
+        block[63] = 0xa0;
+
+        for (j = 0; j < 5; j++) {
+                u[j] = WPA_GET_BE32(u_buf + 4 * j);
+                acc[j] = WPA_GET_BE32(digest + 4 * j);
+        }
+
+        for (i = 0; i < count; i++) {
+                for (j = 0; j < 5; j++)
+                        WPA_PUT_BE32(block + 4 * j, u[j]);
+                os_memcpy(state, hkey->inner, sizeof(state));
+                sha1_transform(state, block);
+
+                for (j = 0; j < 5; j++)
+                        WPA_PUT_BE32(block + 4 * j, state[j]);
+                os_memcpy(u, hkey->outer, sizeof(u));
+                sha1_transform(u, block);
+
+                for (j = 0; j < 5; j++)
+                        acc[j] ^= u[j];
+        }
+
+        for (j = 0; j < 5; j++) {
+                WPA_PUT_BE32(u_buf + 4 * j, u[j]);
+                WPA_PUT_BE32(digest + 4 * j, acc[j]);
+        }
+        os_memset(block, 0, sizeof(block));
+        os_memset(state, 0, sizeof(state));
+        os_memset(u, 0, sizeof(u));
+        os_memset(acc, 0, sizeof(acc));
+}
+
+
+/* Same as pbkdf2_sha1_iterate() for crypto libraries that do not expose the
+ * SHA-1 compression function */
+static void pbkdf2_sha1_iterate_hmac(const char *passphrase, u8 *u,
+                                     u8 *digest, int count)
+{
+        size_t passphrase_len = os_strlen(passphrase);
+        u8 tmp[SHA1_MAC_LEN];
         int i, j;
+
+        for (i = 0; i < count; i++) {
+                hmac_sha1((const u8 *) passphrase, passphrase_len, u,
+                          SHA1_MAC_LEN, tmp);
+                os_memcpy(u, tmp, SHA1_MAC_LEN);
+                for (j = 0; j < SHA1_MAC_LEN; j++)
+                        digest[j] ^= tmp[j];
+        }
+        os_memset(tmp, 0, sizeof(tmp));
+}
+
+
+/* U1 = PRF(P, S || i) */
+static void pbkdf2_sha1_u1(const char *passphrase, const char *ssid,
+                           size_t ssid_len, unsigned int count, u8 *u1)
+{
         unsigned char count_buf[4];
         const u8 *addr[2];
         size_t len[2];
-        size_t passphrase_len = os_strlen(passphrase);
 
-        addr[0] = (u8 *) ssid;
+        addr[0] = (const u8 *) ssid;
         len[0] = ssid_len;
         addr[1] = count_buf;
         len[1] = 4;
 
+        WPA_PUT_BE32(count_buf, count);
+        hmac_sha1_vector((const u8 *) passphrase, os_strlen(passphrase), 2,
+                         addr, len, u1);
+}
+
+
+static void pbkdf2_sha1_f(const char *passphrase, const char *ssid,
+                          size_t ssid_len, int iterations, unsigned int count,
+                          const struct pbkdf2_sha1_key *hkey, u8 *digest)
+{
+        unsigned char tmp[SHA1_MAC_LEN];
+
         /* F(P, S, c, i) = U1 xor U2 xor ... Uc
          * U1 = PRF(P, S || i)
          * U2 = PRF(P, U1)
          * Uc = PRF(P, Uc-1)
          */
 
-        count_buf[0] = (count >> 24) & 0xff;
-        count_buf[1] = (count >> 16) & 0xff;
-        count_buf[2] = (count >> 8) & 0xff;
-        count_buf[3] = count & 0xff;
-        hmac_sha1_vector((u8 *) passphrase, passphrase_len, 2, addr, len, tmp);
+        pbkdf2_sha1_u1(passphrase, ssid, ssid_len, count, tmp);
         os_memcpy(digest, tmp, SHA1_MAC_LEN);
 
-        for (i = 1; i < iterations; i++) {
-                hmac_sha1((u8 *) passphrase, passphrase_len, tmp, SHA1_MAC_LEN,
-                          tmp2);
-                os_memcpy(tmp, tmp2, SHA1_MAC_LEN);
-                for (j = 0; j < SHA1_MAC_LEN; j++)
-                        digest[j] ^= tmp2[j];
-        }
+        if (hkey)
+                pbkdf2_sha1_iterate(hkey, tmp, digest, iterations - 1);
+        else
+                pbkdf2_sha1_iterate_hmac(passphrase, tmp, digest,
+                                         iterations - 1);
+        os_memset(tmp, 0, sizeof(tmp));
 }
 
 
@@ -415,16 +534,405 @@ void pbkdf2_sha1(const char *passphrase, const char *ssid, size_t ssid_len,
         unsigned char *pos = buf;
         size_t left = buflen, plen;
         unsigned char digest[SHA1_MAC_LEN];
+        struct pbkdf2_sha1_key hkey;
+        int fast;
+
+        fast = pbkdf2_sha1_key_init(&hkey, (const u8 *) passphrase,
+                                    os_strlen(passphrase)) == 0;
 
         while (left > 0) {
                 count++;
                 pbkdf2_sha1_f(passphrase, ssid, ssid_len, iterations, count,
-                              digest);
+                              fast ? &hkey : NULL, digest);
                 plen = left > SHA1_MAC_LEN ? SHA1_MAC_LEN : left;
                 os_memcpy(pos, digest, plen);
                 pos += plen;
                 left -= plen;
         }
+        os_memset(&hkey, 0, sizeof(hkey));
+}
+
+
+/*
+ * Multi-buffer PBKDF2: the U2..Uc loops of independent F() blocks are run
+ * side by side, one F() block per 32-bit lane of a SIMD register. Without
+ * SSE2/AVX2, pbkdf2_sha1_batch() falls back to serial pbkdf2_sha1() calls.
+ */
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define PBKDF2_LANES 8
+typedef __m256i sha1_lanes;
+#define L_SET1(x) _mm256_set1_epi32((int) (x))
+#define L_ADD(a, b) _mm256_add_epi32((a), (b))
+#define L_XOR(a, b) _mm256_xor_si256((a), (b))
+#define L_AND(a, b) _mm256_and_si256((a), (b))
+#define L_OR(a, b) _mm256_or_si256((a), (b))
+#define L_ROL(a, n) \
+        L_OR(_mm256_slli_epi32((a), (n)), _mm256_srli_epi32((a), 32 - (n)))
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define PBKDF2_LANES 4
+typedef __m128i sha1_lanes;
+#define L_SET1(x) _mm_set1_epi32((int) (x))
+#define L_ADD(a, b) _mm_add_epi32((a), (b))
+#define L_XOR(a, b) _mm_xor_si128((a), (b))
+#define L_AND(a, b) _mm_and_si128((a), (b))
+#define L_OR(a, b) _mm_or_si128((a), (b))
+#define L_ROL(a, n) \
+        L_OR(_mm_slli_epi32((a), (n)), _mm_srli_epi32((a), 32 - (n)))
+#endif
+
+
+#ifdef PBKDF2_LANES
+
+#define SHA1_LANES_W(w, i) \
+        (w[(i) & 15] = L_ROL(L_XOR(L_XOR(w[((i) + 13) & 15], \
+                                         w[((i) + 8) & 15]), \
+                                   L_XOR(w[((i) + 2) & 15], w[(i) & 15])), 1))
+
+#define SHA1_LANES_ROUND(f, k, wi) \
+do { \
+        t = L_ADD(L_ADD(L_ROL(a, 5), (f)), \
+                  L_ADD(L_ADD(e, L_SET1(k)), (wi))); \
+        e = d; \
+        d = c; \
+        c = L_ROL(b, 30); \
+        b = a; \
+        a = t; \
+} while (0)
+
+#define SHA1_F1 L_XOR(L_AND(b, L_XOR(c, d)), d)
+#define SHA1_F2 L_XOR(L_XOR(b, c), d)
+#define SHA1_F3 L_OR(L_AND(L_OR(b, c), d), L_AND(b, c))
+
+
+/* SHA-1 compression function on PBKDF2_LANES independent blocks */
+static void sha1_transform_lanes(sha1_lanes state[5], sha1_lanes w[16])
+{
+        sha1_lanes a, b, c, d, e, t;
+        int i;
+
+        a = state[0];
+        b = state[1];
+        c = state[2];
+        d = state[3];
+        e = state[4];
+
+        for (i = 0; i < 16; i++)
+                SHA1_LANES_ROUND(SHA1_F1, 0x5A827999, w[i]);
+        for (; i < 20; i++)
+                SHA1_LANES_ROUND(SHA1_F1, 0x5A827999, SHA1_LANES_W(w, i));
+        for (; i < 40; i++)
+                SHA1_LANES_ROUND(SHA1_F2, 0x6ED9EBA1, SHA1_LANES_W(w, i));
+        for (; i < 60; i++)
+                SHA1_LANES_ROUND(SHA1_F3, 0x8F1BBCDC, SHA1_LANES_W(w, i));
+        for (; i < 80; i++)
+                SHA1_LANES_ROUND(SHA1_F2, 0xCA62C1D6, SHA1_LANES_W(w, i));
+
+        state[0] = L_ADD(state[0], a);
+        state[1] = L_ADD(state[1], b);
+        state[2] = L_ADD(state[2], c);
+        state[3] = L_ADD(state[3], d);
+        state[4] = L_ADD(state[4], e);
+}
+
+
+/* One F() block of a batch PBKDF2 operation */
+struct pbkdf2_sha1_lane {
+        struct pbkdf2_sha1_key hkey;
+        u8 u1[SHA1_MAC_LEN];
+        u8 *out;
+        size_t out_len;
+};
+
+/* Per-lane words; sha1_lanes v[j] holds word j of every lane */
+union pbkdf2_sha1_words {
+        sha1_lanes v[5];
+        u32 w[5][PBKDF2_LANES];
+};
+
+
+static void pbkdf2_sha1_pad_lanes(sha1_lanes w[16])
+{
+        int j;
+
+        /* Message padding for 64 + 20 octets of data (672 bits) */
+        w[5] = L_SET1(0x80000000);
+        for (j = 6; j < 15; j++)
+                w[j] = L_SET1(0);
+        w[15] = L_SET1(0x2a0);
+}
+
+
+static void pbkdf2_sha1_iterate_lanes(struct pbkdf2_sha1_lane *lane,
+                                      size_t num, int iterations)
+{
+        union pbkdf2_sha1_words inner, outer, words;
+        sha1_lanes u[5], acc[5], state[5], w[16];
+        u8 digest[SHA1_MAC_LEN];
+        size_t k;
+        int i, j;
+
+        /* Unused lanes duplicate the first one and are ignored */
+        for (k = 0; k < PBKDF2_LANES; k++) {
+                const struct pbkdf2_sha1_lane *l = &lane[k < num ? k : 0];
+                for (j = 0; j < 5; j++) {
+                        inner.w[j][k] = l->hkey.inner[j];
+                        outer.w[j][k] = l->hkey.outer[j];
+                        words.w[j][k] = WPA_GET_BE32(l->u1 + 4 * j);
+                }
+        }
+
+        for (j = 0; j < 5; j++)
+                acc[j] = u[j] = words.v[j];
+
+        for (i = 1; i < iterations; i++) {
+                for (j = 0; j < 5; j++) {
+                        w[j] = u[j];
+                        state[j] = inner.v[j];
+                }
+                pbkdf2_sha1_pad_lanes(w);
+                sha1_transform_lanes(state, w);
+
+                for (j = 0; j < 5; j++) {
+                        w[j] = state[j];
+                        u[j] = outer.v[j];
+                }
+                pbkdf2_sha1_pad_lanes(w);
+                sha1_transform_lanes(u, w);
+
+                for (j = 0; j < 5; j++)
+                        acc[j] = L_XOR(acc[j], u[j]);
+        }
+
+        for (j = 0; j < 5; j++)
+                words.v[j] = acc[j];
+        for (k = 0; k < num && k < PBKDF2_LANES; k++) {
+                for (j = 0; j < 5; j++)
+                        WPA_PUT_BE32(digest + 4 * j, words.w[j][k]);
+                os_memcpy(lane[k].out, digest, lane[k].out_len);
+        }
+
+        os_memset(&inner, 0, sizeof(inner));
+        os_memset(&outer, 0, sizeof(outer));
+        os_memset(&words, 0, sizeof(words));
+        os_memset(digest, 0, sizeof(digest));
+}
+
+
+static int pbkdf2_sha1_batch_lanes(const char *passphrase[],
+                                   const char *ssid[],
+                                   const size_t ssid_len[], size_t num,
+                                   int iterations, u8 *buf[], size_t buflen)
+{
+        struct pbkdf2_sha1_lane *lanes, *lane;
+        size_t blocks, num_lanes, i, b;
+        int ret = 0;
+
+        blocks = (buflen + SHA1_MAC_LEN - 1) / SHA1_MAC_LEN;
+        num_lanes = num * blocks;
+        if (num_lanes == 0)
+                return 0;
+        lanes = os_zalloc(num_lanes * sizeof(*lanes));
+        if (lanes == NULL)
+                return -1;
+
+        lane = lanes;
+        for (i = 0; i < num && ret == 0; i++) {
+                for (b = 0; b < blocks; b++) {
+                        /* Fails if there is no SHA-1 compression function */
+                        ret = pbkdf2_sha1_key_init(
+                                &lane->hkey, (const u8 *) passphrase[i],
+                                os_strlen(passphrase[i]));
+                        if (ret < 0)
+                                break;
+                        pbkdf2_sha1_u1(passphrase[i], ssid[i], ssid_len[i],
+                                       b + 1, lane->u1);
+                        lane->out = buf[i] + b * SHA1_MAC_LEN;
+                        lane->out_len = buflen - b * SHA1_MAC_LEN;
+                        if (lane->out_len > SHA1_MAC_LEN)
+                                lane->out_len = SHA1_MAC_LEN;
+                        lane++;
+                }
+        }
+
+        for (i = 0; ret == 0 && i < num_lanes; i += PBKDF2_LANES)
+                pbkdf2_sha1_iterate_lanes(&lanes[i], num_lanes - i,
+                                          iterations);
+
+        os_memset(lanes, 0, num_lanes * sizeof(*lanes));
+        os_free(lanes);
+        return ret;
+}
+
+#endif /* PBKDF2_LANES */
+
+
+/**
+ * pbkdf2_sha1_batch - PBKDF2-SHA1 for multiple passphrase/SSID pairs
+ * @passphrase: Array of ASCII passphrases
+ * @ssid: Array of SSIDs
+ * @ssid_len: Array of SSID lengths in bytes
+ * @num: Number of entries in the arrays
+ * @iterations: Number of iterations to run
+ * @buf: Array of buffers for the generated keys
+ * @buflen: Length of each buffer in bytes
+ *
+ * This function produces the same keys as calling pbkdf2_sha1() separately
+ * for each entry, but runs four (SSE2) or eight (AVX2) of the F() blocks in
+ * parallel when the compiler targets one of these instruction sets.
+ */
+void pbkdf2_sha1_batch(const char *passphrase[], const char *ssid[],
+                       const size_t ssid_len[], size_t num, int iterations,
+                       u8 *buf[], size_t buflen)
+{
+        size_t i;
+
+#ifdef PBKDF2_LANES
+        if (pbkdf2_sha1_batch_lanes(passphrase, ssid, ssid_len, num,
+                                    iterations, buf, buflen) == 0)
+                return;
+#endif /* PBKDF2_LANES */
+
+        for (i = 0; i < num; i++)
+                pbkdf2_sha1(passphrase[i], ssid[i], ssid_len[i], iterations,
+                            buf[i], buflen);
+}
+
+
+struct pbkdf2_sha1_ctx {
+        struct pbkdf2_sha1_key hkey;
+        int fast;
+        char *passphrase;
+        char *ssid;
+        size_t ssid_len;
+        int iterations;
+        unsigned int count; /* current F() block, 1..n */
+        int iter; /* iterations done for the current block */
+        u8 u[SHA1_MAC_LEN];
+        u8 digest[SHA1_MAC_LEN];
+        u8 *buf;
+        size_t buflen, pos;
+};
+
+
+/**
+ * pbkdf2_sha1_init - Start incremental PBKDF2-SHA1 operation
+ * @passphrase: ASCII passphrase
+ * @ssid: SSID
+ * @ssid_len: SSID length in bytes
+ * @iterations: Number of iterations to run
+ * @buflen: Length of the generated key in bytes
+ * Returns: Context for pbkdf2_sha1_update() or %NULL on failure
+ *
+ * This is an incremental version of pbkdf2_sha1() that allows the caller to
+ * split the derivation into small steps, e.g., to avoid blocking the event
+ * loop for the whole duration of the operation.
+ */
+struct pbkdf2_sha1_ctx * pbkdf2_sha1_init(const char *passphrase,
+                                          const char *ssid, size_t ssid_len,
+                                          int iterations, size_t buflen)
+{
+        struct pbkdf2_sha1_ctx *ctx;
+
+        ctx = os_zalloc(sizeof(*ctx));
+        if (ctx == NULL)
+                return NULL;
+        ctx->passphrase = os_strdup(passphrase);
+        ctx->ssid = os_malloc(ssid_len ? ssid_len : 1);
+        ctx->buf = os_zalloc(buflen ? buflen : 1);
+        if (ctx->passphrase == NULL || ctx->ssid == NULL ||
+            ctx->buf == NULL) {
+                pbkdf2_sha1_deinit(ctx, NULL);
+                return NULL;
+        }
+        os_memcpy(ctx->ssid, ssid, ssid_len);
+        ctx->ssid_len = ssid_len;
+        ctx->iterations = iterations;
+        ctx->buflen = buflen;
+        ctx->fast = pbkdf2_sha1_key_init(&ctx->hkey,
+                                         (const u8 *) passphrase,
+                                         os_strlen(passphrase)) == 0;
+        return ctx;
+}
+
+
+/**
+ * pbkdf2_sha1_update - Run a part of incremental PBKDF2-SHA1 operation
+ * @ctx: Context from pbkdf2_sha1_init()
+ * @max_iter: Maximum number of iterations to run in this call
+ * Returns: 1 if the key has been completed, 0 if more calls are needed
+ */
+int pbkdf2_sha1_update(struct pbkdf2_sha1_ctx *ctx, int max_iter)
+{
+        size_t plen;
+        int n;
+
+        while (max_iter > 0 && ctx->pos < ctx->buflen) {
+                if (ctx->iter == 0) {
+                        ctx->count++;
+                        pbkdf2_sha1_u1(ctx->passphrase, ctx->ssid,
+                                       ctx->ssid_len, ctx->count, ctx->u);
+                        os_memcpy(ctx->digest, ctx->u, SHA1_MAC_LEN);
+                        ctx->iter = 1;
+                        max_iter--;
+                }
+
+                n = ctx->iterations - ctx->iter;
+                if (n > max_iter)
+                        n = max_iter;
+                if (ctx->fast)
+                        pbkdf2_sha1_iterate(&ctx->hkey, ctx->u, ctx->digest,
+                                            n);
+                else
+                        pbkdf2_sha1_iterate_hmac(ctx->passphrase, ctx->u,
+                                                 ctx->digest, n);
+                ctx->iter += n;
+                max_iter -= n;
+
+                if (ctx->iter >= ctx->iterations) {
+                        plen = ctx->buflen - ctx->pos;
+                        if (plen > SHA1_MAC_LEN)
+                                plen = SHA1_MAC_LEN;
+                        os_memcpy(ctx->buf + ctx->pos, ctx->digest, plen);
+                        ctx->pos += plen;
+                        ctx->iter = 0;
+                }
+        }
+
+        return ctx->pos == ctx->buflen;
+}
+
+
+/**
+ * pbkdf2_sha1_deinit - Finish incremental PBKDF2-SHA1 operation
+ * @ctx: Context from pbkdf2_sha1_init()
+ * @buf: Buffer for the generated key (buflen bytes) or %NULL to abort
+ * Returns: 0 on success, -1 if the operation had not been completed
+ */
+int pbkdf2_sha1_deinit(struct pbkdf2_sha1_ctx *ctx, u8 *buf)
+{
+        int ret = -1;
+
+        if (ctx == NULL)
+                return -1;
+        if (ctx->buf && ctx->pos == ctx->buflen) {
+                if (buf)
+                        os_memcpy(buf, ctx->buf, ctx->buflen);
+                ret = 0;
+        }
+        if (ctx->passphrase) {
+                os_memset(ctx->passphrase, 0, os_strlen(ctx->passphrase));
+                os_free(ctx->passphrase);
+        }
+        os_free(ctx->ssid);
+        if (ctx->buf) {
+                os_memset(ctx->buf, 0, ctx->buflen);
+                os_free(ctx->buf);
+        }
+        os_memset(ctx, 0, sizeof(*ctx));
+        os_free(ctx);
+        return ret;
 }
 
 #endif /* CONFIG_NO_PBKDF2 */
@@ -468,6 +976,13 @@ void sha1_vector(size_t num_elem, const u8 *addr[], const size_t *len,
 }
 
 
+int sha1_transform(u32 state[5], const u8 data[64])
+{
+        SHA1Transform(state, data);
+        return 0;
+}
+
+
 #ifndef CONFIG_NO_FIPS186_2_PRF
 int fips186_2_prf(const u8 *seed, size_t seed_len, u8 *x, size_t xlen)
 {
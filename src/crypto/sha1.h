@@ -30,6 +30,15 @@ int __must_check tls_prf(const u8 *secret, size_t secret_len,
        u8 *out, size_t outlen);
 void pbkdf2_sha1(const char *passphrase, const char *ssid, size_t ssid_len,
      int iterations, u8 *buf, size_t buflen);
+void pbkdf2_sha1_batch(const char *passphrase[], const char *ssid[],
+                       const size_t ssid_len[], size_t num, int iterations,
+                       u8 *buf[], size_t buflen);
+struct pbkdf2_sha1_ctx;
+struct pbkdf2_sha1_ctx * pbkdf2_sha1_init(const char *passphrase,
+                                          const char *ssid, size_t ssid_len,
+                                          int iterations, size_t buflen);
+int pbkdf2_sha1_update(struct pbkdf2_sha1_ctx *ctx, int max_iter);
+int pbkdf2_sha1_deinit(struct pbkdf2_sha1_ctx *ctx, u8 *buf);
 void sha1_prf_ccx(const u8 *key, size_t key_len, const char *label,
                   const u8 *data, size_t data_len, u8 *buf, size_t buf_len);
 #ifdef CONFIG_CRYPTO_INTERNAL
@@ -92,6 +92,7 @@ struct wpa_scan_result {
  * @level: signal level
  * @tsf: Timestamp
  * @ie_len: length of the following IE field in octets
+ * @flags: WPA_SCAN_* flags; drivers must set this to zero
  *
  * This structure is used as a generic format for scan results from the
  * driver. Each driver interface implementation is responsible for converting
@@ -112,17 +113,32 @@ struct wpa_scan_res {
   int level;
   u64 tsf;
   size_t ie_len;
-  /* followed by ie_len octets of IEs */
+  unsigned int flags;
+  /* followed by ie_len octets of IEs and optionally the IE index */
 };
 
+/* IE index follows the IEs; see wpa_scan_results_index() */
+#define WPA_SCAN_IE_INDEXED BIT(0)
+
+struct wpa_scan_arena;
+
 /**
  * struct wpa_scan_results - Scan results
  * @res: Array of pointers to allocated variable length scan result entries
  * @num: Number of entries in the scan result array
+ * @res_size: Allocated size of the res array (in entries) when entries are
+ *  added with wpa_scan_results_add(); zero otherwise
+ * @arena: Memory blocks used for entries added with wpa_scan_results_add()
+ *
+ * Driver wrappers can either allocate each entry separately and build the res
+ * array themselves or use wpa_scan_results_add() to store the entries in a
+ * common arena. In both cases, wpa_scan_results_free() frees the results.
  */
 struct wpa_scan_results {
   struct wpa_scan_res **res;
   size_t num;
+  size_t res_size;
+  struct wpa_scan_arena *arena;
 };
 
 /**
@@ -323,6 +339,51 @@ struct wpa_driver_capa {
  * struct wpa_driver_ops::set_key using alg = WPA_ALG_PMK */
 #define WPA_DRIVER_FLAGS_4WAY_HANDSHAKE 0x00000008
   unsigned int flags;
+
+  /**
+   * max_scan_ssids - Maximum number of SSIDs in a scan2() request
+   *
+   * Zero means that the driver did not report a limit; this is handled
+   * as one SSID per scan request.
+   */
+  int max_scan_ssids;
+};
+
+#define WPAS_MAX_SCAN_SSIDS 16
+
+/**
+ * struct wpa_driver_scan_params - Scan parameters
+ * Data for struct wpa_driver_ops::scan2().
+ */
+struct wpa_driver_scan_params {
+  /**
+   * ssids - SSIDs to scan for
+   */
+  struct wpa_driver_scan_ssid {
+    /**
+     * ssid - Specific SSID to scan for (ProbeReq)
+     * %NULL or zero-length SSID is used to indicate active scan
+     * with wildcard SSID.
+     */
+    const u8 *ssid;
+
+    /**
+     * ssid_len - Length of the SSID in octets
+     */
+    size_t ssid_len;
+  } ssids[WPAS_MAX_SCAN_SSIDS];
+
+  /**
+   * num_ssids - Number of entries in ssids array
+   * Zero indicates a request for a passive scan.
+   */
+  size_t num_ssids;
+
+  /**
+   * freqs - Array of frequencies (in MHz) to scan or %NULL for all
+   * The array is terminated with a zero entry.
+   */
+  const int *freqs;
 };
 
 
@@ -1028,6 +1089,24 @@ struct wpa_driver_ops {
    * failure
    */
   struct wpa_interface_info * (*get_interfaces)(void *global_priv);
+
+  /**
+   * scan2 - Request the driver to initiate scan
+   * @priv: private driver interface data
+   * @params: Scan parameters
+   *
+   * Returns: 0 on success, -1 on failure
+   *
+   * This is an extended version of scan() that can request multiple SSIDs
+   * (up to struct wpa_driver_capa::max_scan_ssids) and limit the scan to
+   * a set of frequencies. If this handler is not implemented, scan() is
+   * used with the first SSID and all channels.
+   *
+   * Once the scan results are ready, the driver should report scan
+   * results event for wpa_supplicant which will eventually request the
+   * results with wpa_driver_get_scan_results2().
+   */
+  int (*scan2)(void *priv, struct wpa_driver_scan_params *params);
 };
 
 /* Function to check whether a driver is for wired connections */
@@ -1357,7 +1436,11 @@ const u8 * wpa_scan_get_vendor_ie(const struct wpa_scan_res *res,
 struct wpabuf * wpa_scan_get_vendor_ie_multi(const struct wpa_scan_res *res,
                u32 vendor_type);
 int wpa_scan_get_max_rate(const struct wpa_scan_res *res);
+size_t wpa_scan_res_size(const struct wpa_scan_res *res);
 void wpa_scan_results_free(struct wpa_scan_results *res);
+struct wpa_scan_res * wpa_scan_results_add(struct wpa_scan_results *res,
+             size_t ie_len);
+void wpa_scan_results_index(struct wpa_scan_results *res);
 void wpa_scan_sort_results(struct wpa_scan_results *res);
 
 #endif /* DRIVER_H */
@@ -1516,6 +1516,48 @@ err1:
 }
 
 
+static int wiphy_info_handler(struct nl_msg *msg, void *arg)
+{
+        struct nlattr *tb[NL80211_ATTR_MAX + 1];
+        struct genlmsghdr *gnlh = nlmsg_data(nlmsg_hdr(msg));
+        struct wpa_driver_nl80211_data *drv = arg;
+
+        nla_parse(tb, NL80211_ATTR_MAX, genlmsg_attrdata(gnlh, 0),
+                  genlmsg_attrlen(gnlh, 0), NULL);
+
+        if (tb[NL80211_ATTR_MAX_NUM_SCAN_SSIDS])
+                drv->capa.max_scan_ssids =
+                        nla_get_u8(tb[NL80211_ATTR_MAX_NUM_SCAN_SSIDS]);
+
+        return NL_SKIP;
+}
+
+
+static void wpa_driver_nl80211_get_wiphy_info(
+        struct wpa_driver_nl80211_data *drv)
+{
+        struct nl_msg *msg;
+
+        msg = nlmsg_alloc();
+        if (!msg)
+                return;
+
+        genlmsg_put(msg, 0, 0, genl_family_get_id(drv->nl80211), 0,
+                    0, NL80211_CMD_GET_WIPHY, 0);
+
+        NLA_PUT_U32(msg, NL80211_ATTR_IFINDEX, drv->ifindex);
+
+        if (send_and_recv_msgs(drv, msg, wiphy_info_handler, drv) == 0) {
+                wpa_printf(MSG_DEBUG, "nl80211: max_scan_ssids=%d",
+                           drv->capa.max_scan_ssids);
+                return;
+        }
+        msg = NULL;
+nla_put_failure:
+        nlmsg_free(msg);
+}
+
+
 static void
 wpa_driver_nl80211_finish_drv_init(struct wpa_driver_nl80211_data *drv)
 {
@@ -1542,6 +1584,7 @@ wpa_driver_nl80211_finish_drv_init(struct wpa_driver_nl80211_data *drv)
         wpa_driver_nl80211_flush_pmkid(drv);
 
         wpa_driver_nl80211_get_range(drv);
+        wpa_driver_nl80211_get_wiphy_info(drv);
 
         wpa_driver_nl80211_send_oper_ifla(drv, 1, IF_OPER_DORMANT);
 }
@@ -1617,25 +1660,26 @@ static void wpa_driver_nl80211_scan_timeout(void *eloop_ctx, void *timeout_ctx)
 
 
 /**
- * wpa_driver_nl80211_scan - Request the driver to initiate scan
+ * wpa_driver_nl80211_scan2 - Request the driver to initiate scan
  * @priv: Pointer to private wext data from wpa_driver_nl80211_init()
- * @ssid: Specific SSID to scan for (ProbeReq) or %NULL to scan for
- *        all SSIDs (either active scan with broadcast SSID or passive
- *        scan
- * @ssid_len: Length of the SSID
+ * @params: Scan parameters
  * Returns: 0 on success, -1 on failure
  */
-static int wpa_driver_nl80211_scan(void *priv, const u8 *ssid, size_t ssid_len)
+static int wpa_driver_nl80211_scan2(void *priv,
+                                    struct wpa_driver_scan_params *params)
 {
         struct wpa_driver_nl80211_data *drv = priv;
         int ret = 0, timeout;
-        struct nl_msg *msg, *ssids;
+        struct nl_msg *msg, *ssids, *freqs;
+        size_t i;
 
         msg = nlmsg_alloc();
         ssids = nlmsg_alloc();
-        if (!msg || !ssids) {
+        freqs = nlmsg_alloc();
+        if (!msg || !ssids || !freqs) {
                 nlmsg_free(msg);
                 nlmsg_free(ssids);
+                nlmsg_free(freqs);
                 return -1;
         }
 
@@ -1644,14 +1688,27 @@ static int wpa_driver_nl80211_scan(void *priv, const u8 *ssid, size_t ssid_len)
 
         NLA_PUT_U32(msg, NL80211_ATTR_IFINDEX, drv->ifindex);
 
-        if (ssid && ssid_len) {
-                /* Request an active scan for a specific SSID */
-                NLA_PUT(ssids, 1, ssid_len, ssid);
-        } else {
-                /* Request an active scan for wildcard SSID */
-                NLA_PUT(ssids, 1, 0, "");
+        for (i = 0; i < params->num_ssids; i++) {
+                wpa_hexdump_ascii(MSG_MSGDUMP, "nl80211: Scan SSID",
+                                  params->ssids[i].ssid,
+                                  params->ssids[i].ssid_len);
+                if (params->ssids[i].ssid)
+                        NLA_PUT(ssids, i + 1, params->ssids[i].ssid_len,
+                                params->ssids[i].ssid);
+                else
+                        NLA_PUT(ssids, i + 1, 0, ""); /* wildcard SSID */
+        }
+        if (params->num_ssids)
+                nla_put_nested(msg, NL80211_ATTR_SCAN_SSIDS, ssids);
+
+        if (params->freqs) {
+                for (i = 0; params->freqs[i]; i++) {
+                        wpa_printf(MSG_MSGDUMP, "nl80211: Scan frequency %u "
+                                   "MHz", params->freqs[i]);
+                        NLA_PUT_U32(freqs, i + 1, params->freqs[i]);
+                }
+                nla_put_nested(msg, NL80211_ATTR_SCAN_FREQUENCIES, freqs);
         }
-        nla_put_nested(msg, NL80211_ATTR_SCAN_SSIDS, ssids);
 
         ret = send_and_recv_msgs(drv, msg, NULL, NULL);
         msg = NULL;
@@ -1680,11 +1737,35 @@ static int wpa_driver_nl80211_scan(void *priv, const u8 *ssid, size_t ssid_len)
 
 nla_put_failure:
         nlmsg_free(ssids);
+        nlmsg_free(freqs);
         nlmsg_free(msg);
         return ret;
 }
 
 
+/**
+ * wpa_driver_nl80211_scan - Request the driver to initiate scan
+ * @priv: Pointer to private wext data from wpa_driver_nl80211_init()
+ * @ssid: Specific SSID to scan for (ProbeReq) or %NULL to scan for
+ *        all SSIDs (either active scan with broadcast SSID or passive
+ *        scan
+ * @ssid_len: Length of the SSID
+ * Returns: 0 on success, -1 on failure
+ */
+static int wpa_driver_nl80211_scan(void *priv, const u8 *ssid, size_t ssid_len)
+{
+        struct wpa_driver_scan_params params;
+
+        os_memset(&params, 0, sizeof(params));
+        /* Request an active scan for a specific SSID or the wildcard SSID */
+        params.ssids[0].ssid = ssid;
+        params.ssids[0].ssid_len = ssid_len;
+        params.num_ssids = 1;
+
+        return wpa_driver_nl80211_scan2(priv, &params);
+}
+
+
 static int bss_info_handler(struct nl_msg *msg, void *arg)
 {
         struct nlattr *tb[NL80211_ATTR_MAX + 1];
@@ -1701,7 +1782,6 @@ static int bss_info_handler(struct nl_msg *msg, void *arg)
                 [NL80211_BSS_SIGNAL_UNSPEC] = { .type = NLA_U8 },
         };
         struct wpa_scan_results *res = arg;
-        struct wpa_scan_res **tmp;
         struct wpa_scan_res *r;
         const u8 *ie;
         size_t ie_len;
@@ -1721,7 +1801,7 @@ static int bss_info_handler(struct nl_msg *msg, void *arg)
                 ie_len = 0;
         }
 
-        r = os_zalloc(sizeof(*r) + ie_len);
+        r = wpa_scan_results_add(res, ie_len);
         if (r == NULL)
                 return NL_SKIP;
         if (bss[NL80211_BSS_BSSID])
@@ -1739,19 +1819,9 @@ static int bss_info_handler(struct nl_msg *msg, void *arg)
                 r->level = nla_get_u32(bss[NL80211_BSS_SIGNAL_MBM]);
         if (bss[NL80211_BSS_TSF])
                 r->tsf = nla_get_u64(bss[NL80211_BSS_TSF]);
-        r->ie_len = ie_len;
         if (ie)
                 os_memcpy(r + 1, ie, ie_len);
 
-        tmp = os_realloc(res->res,
-                         (res->num + 1) * sizeof(struct wpa_scan_res *));
-        if (tmp == NULL) {
-                os_free(r);
-                return NL_SKIP;
-        }
-        tmp[res->num++] = r;
-        res->res = tmp;
-
         return NL_SKIP;
 }
 
@@ -2738,6 +2808,7 @@ const struct wpa_driver_ops wpa_driver_nl80211_ops = {
         .set_countermeasures = wpa_driver_nl80211_set_countermeasures,
         .set_drop_unencrypted = wpa_driver_nl80211_set_drop_unencrypted,
         .scan = wpa_driver_nl80211_scan,
+        .scan2 = wpa_driver_nl80211_scan2,
         .get_scan_results2 = wpa_driver_nl80211_get_scan_results,
         .deauthenticate = wpa_driver_nl80211_deauthenticate,
         .disassociate = wpa_driver_nl80211_disassociate,
@@ -187,6 +187,8 @@ wpa_driver_privsep_get_scan_results2(void *priv)
                         os_free(r);
                         break;
                 }
+                /* flags describe the memory layout in the sender */
+                r->flags = 0;
 
                 results->res[results->num++] = r;
         }
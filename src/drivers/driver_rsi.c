@@ -1140,14 +1140,54 @@ int wpa_driver_rsi_scan(void *priv, const u8 *ssid, size_t ssid_len)
 }
 
 
+/* Number of consecutive small scan results before the buffer is shrunk */
+#define RSI_SCAN_BUF_SHRINK_COUNT 5
+
+
+static void wpa_driver_rsi_update_scan_buf_len(
+        struct wpa_driver_rsi_data *drv, size_t buf_len, size_t used)
+{
+        /*
+         * Grow immediately, but shrink only after the results have been
+         * small for a number of consecutive scans so that the size does not
+         * oscillate when the number of BSSes varies between scans.
+         */
+        if (used > buf_len / 4 || buf_len <= IW_SCAN_MAX_DATA) {
+                drv->scan_buf_small = 0;
+                drv->scan_buf_len = buf_len;
+                return;
+        }
+
+        if (++drv->scan_buf_small < RSI_SCAN_BUF_SHRINK_COUNT) {
+                drv->scan_buf_len = buf_len;
+                return;
+        }
+
+        drv->scan_buf_small = 0;
+        drv->scan_buf_len = buf_len / 2;
+        if (drv->scan_buf_len < IW_SCAN_MAX_DATA)
+                drv->scan_buf_len = IW_SCAN_MAX_DATA;
+        wpa_printf(MSG_DEBUG, "SIOCGIWSCAN: shrinking buffer to %lu bytes",
+                   (unsigned long) drv->scan_buf_len);
+}
+
+
 static u8 * wpa_driver_rsi_giwscan(struct wpa_driver_rsi_data *drv,
                                     size_t *len)
 {
         struct iwreq iwr;
         u8 *res_buf;
         size_t res_buf_len;
+        int retries = 0;
 
-        res_buf_len = IW_SCAN_MAX_DATA;
+        /*
+         * Start from the size that was needed for the previous scan results
+         * to avoid failing SIOCGIWSCAN calls in dense environments; each one
+         * makes the kernel regenerate the full event stream.
+         */
+        res_buf_len = drv->scan_buf_len;
+        if (res_buf_len < IW_SCAN_MAX_DATA)
+                res_buf_len = IW_SCAN_MAX_DATA;
         for (;;) {
                 res_buf = os_malloc(res_buf_len);
                 if (res_buf == NULL)
@@ -1163,6 +1203,8 @@ static u8 * wpa_driver_rsi_giwscan(struct wpa_driver_rsi_data *drv,
                 if (errno == E2BIG && res_buf_len < 65535) {
                         os_free(res_buf);
                         res_buf = NULL;
+                        retries++;
+                        drv->scan_buf_retries++;
                         res_buf_len *= 2;
                         if (res_buf_len > 65535)
                                 res_buf_len = 65535; /* 16-bit length field */
@@ -1182,6 +1224,12 @@ static u8 * wpa_driver_rsi_giwscan(struct wpa_driver_rsi_data *drv,
         }
         *len = iwr.u.data.length;
 
+        wpa_printf(MSG_DEBUG, "SIOCGIWSCAN: %lu bytes in %lu byte buffer "
+                   "(%d retries, %u total)", (unsigned long) *len,
+                   (unsigned long) res_buf_len, retries,
+                   drv->scan_buf_retries);
+        wpa_driver_rsi_update_scan_buf_len(drv, res_buf_len, *len);
+
         return res_buf;
 }
 
@@ -1194,6 +1242,7 @@ struct rsi_scan_data {
         struct wpa_scan_res res;
         u8 *ie;
         size_t ie_len;
+        size_t ie_size; /* allocated size of ie; reused for all BSSes */
         u8 ssid[32];
         size_t ssid_len;
         int maxrate;
@@ -1313,6 +1362,33 @@ static void rsi_get_scan_rate(struct iw_event *iwe,
 }
 
 
+/*
+ * Reserve room for len more octets of IEs for the current BSS. The buffer is
+ * grown geometrically and kept for the following BSSes, so that merging IEs
+ * does not need to reallocate it for each event.
+ */
+static u8 * rsi_scan_data_ie_extend(struct rsi_scan_data *res, size_t len)
+{
+        size_t size;
+        u8 *tmp;
+
+        if (res->ie_len + len > res->ie_size) {
+                size = res->ie_size ? 2 * res->ie_size : 256;
+                while (size < res->ie_len + len)
+                        size *= 2;
+                tmp = os_realloc(res->ie, size);
+                if (tmp == NULL)
+                        return NULL;
+                res->ie = tmp;
+                res->ie_size = size;
+        }
+
+        tmp = res->ie + res->ie_len;
+        res->ie_len += len;
+        return tmp;
+}
+
+
 static void rsi_get_scan_iwevgenie(struct iw_event *iwe,
                                     struct rsi_scan_data *res, char *custom,
                                     char *end)
@@ -1330,12 +1406,10 @@ static void rsi_get_scan_iwevgenie(struct iw_event *iwe,
                 return;
         }
 
-        tmp = os_realloc(res->ie, res->ie_len + gend - gpos);
+        tmp = rsi_scan_data_ie_extend(res, gend - gpos);
         if (tmp == NULL)
                 return;
-        os_memcpy(tmp + res->ie_len, gpos, gend - gpos);
-        res->ie = tmp;
-        res->ie_len += gend - gpos;
+        os_memcpy(tmp, gpos, gend - gpos);
 }
 
 
@@ -1358,12 +1432,10 @@ static void rsi_get_scan_custom(struct iw_event *iwe,
                 if (bytes & 1 || bytes == 0)
                         return;
                 bytes /= 2;
-                tmp = os_realloc(res->ie, res->ie_len + bytes);
+                tmp = rsi_scan_data_ie_extend(res, bytes);
                 if (tmp == NULL)
                         return;
-                hexstr2bin(spos, tmp + res->ie_len, bytes);
-                res->ie = tmp;
-                res->ie_len += bytes;
+                hexstr2bin(spos, tmp, bytes);
         } else if (clen > 7 && os_strncmp(custom, "rsn_ie=", 7) == 0) {
                 char *spos;
                 int bytes;
@@ -1372,12 +1444,10 @@ static void rsi_get_scan_custom(struct iw_event *iwe,
                 if (bytes & 1 || bytes == 0)
                         return;
                 bytes /= 2;
-                tmp = os_realloc(res->ie, res->ie_len + bytes);
+                tmp = rsi_scan_data_ie_extend(res, bytes);
                 if (tmp == NULL)
                         return;
-                hexstr2bin(spos, tmp + res->ie_len, bytes);
-                res->ie = tmp;
-                res->ie_len += bytes;
+                hexstr2bin(spos, tmp, bytes);
         } else if (clen > 4 && os_strncmp(custom, "tsf=", 4) == 0) {
                 char *spos;
                 int bytes;
@@ -1406,7 +1476,6 @@ static int rsi_19_iw_point(struct wpa_driver_rsi_data *drv, u16 cmd)
 static void wpa_driver_rsi_add_scan_entry(struct wpa_scan_results *res,
                                            struct rsi_scan_data *data)
 {
-        struct wpa_scan_res **tmp;
         struct wpa_scan_res *r;
         size_t extra_len;
         u8 *pos, *end, *ssid_ie = NULL, *rate_ie = NULL;
@@ -1432,11 +1501,12 @@ static void wpa_driver_rsi_add_scan_entry(struct wpa_scan_results *res,
         if (rate_ie == NULL && data->maxrate)
                 extra_len += 3;
 
-        r = os_zalloc(sizeof(*r) + extra_len + data->ie_len);
+        r = wpa_scan_results_add(res, extra_len + data->ie_len);
         if (r == NULL)
                 return;
         os_memcpy(r, &data->res, sizeof(*r));
         r->ie_len = extra_len + data->ie_len;
+        r->flags = 0;
         pos = (u8 *) (r + 1);
         if (ssid_ie == NULL) {
                 /*
@@ -1459,15 +1529,6 @@ static void wpa_driver_rsi_add_scan_entry(struct wpa_scan_results *res,
         }
         if (data->ie)
                 os_memcpy(pos, data->ie, data->ie_len);
-
-        tmp = os_realloc(res->res,
-                         (res->num + 1) * sizeof(struct wpa_scan_res *));
-        if (tmp == NULL) {
-                os_free(r);
-                return;
-        }
-        tmp[res->num++] = r;
-        res->res = tmp;
 }
                                       
 
@@ -1486,6 +1547,8 @@ struct wpa_scan_results * wpa_driver_rsi_get_scan_results(void *priv)
         char *pos, *end, *custom;
         struct wpa_scan_results *res;
         struct rsi_scan_data data;
+        u8 *ie;
+        size_t ie_size;
 
         res_buf = wpa_driver_rsi_giwscan(drv, &len);
         if (res_buf == NULL)
@@ -1528,8 +1591,11 @@ struct wpa_scan_results * wpa_driver_rsi_get_scan_results(void *priv)
                         if (!first)
                                 wpa_driver_rsi_add_scan_entry(res, &data);
                         first = 0;
-                        os_free(data.ie);
+                        ie = data.ie;
+                        ie_size = data.ie_size;
                         os_memset(&data, 0, sizeof(data));
+                        data.ie = ie;
+                        data.ie_size = ie_size;
                         os_memcpy(data.res.bssid,
                                   iwe->u.ap_addr.sa_data, ETH_ALEN);
                         break;
@@ -45,6 +45,13 @@ struct wpa_driver_rsi_data {
   char mlmedev[IFNAMSIZ + 1];
 
   int scan_complete_events;
+
+  /* SIOCGIWSCAN buffer size that is used to start the next fetch */
+  size_t scan_buf_len;
+  /* number of consecutive fetches that used less than 1/4 of the buffer */
+  int scan_buf_small;
+  /* number of SIOCGIWSCAN retries with a larger buffer (E2BIG) */
+  unsigned int scan_buf_retries;
 };
 
 int wpa_driver_rsi_get_ifflags(struct wpa_driver_rsi_data *drv, int *flags);
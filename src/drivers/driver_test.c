@@ -151,10 +151,20 @@ static void wpa_driver_scan_dir(struct wpa_driver_test_data *drv,
 #endif /* DRIVER_TEST_UNIX */
 
 
-static int wpa_driver_test_scan(void *priv, const u8 *ssid, size_t ssid_len)
+static int wpa_driver_test_scan2(void *priv,
+                                 struct wpa_driver_scan_params *params)
 {
         struct wpa_driver_test_data *drv = priv;
+        size_t i;
+
         wpa_printf(MSG_DEBUG, "%s: priv=%p", __func__, priv);
+        for (i = 0; i < params->num_ssids; i++)
+                wpa_hexdump_ascii(MSG_DEBUG, "Scan SSID",
+                                  params->ssids[i].ssid,
+                                  params->ssids[i].ssid_len);
+        for (i = 0; params->freqs && params->freqs[i]; i++)
+                wpa_printf(MSG_DEBUG, "Scan frequency %d MHz",
+                           params->freqs[i]);
 
         drv->num_scanres = 0;
 
@@ -184,6 +194,19 @@ static int wpa_driver_test_scan(void *priv, const u8 *ssid, size_t ssid_len)
 }
 
 
+static int wpa_driver_test_scan(void *priv, const u8 *ssid, size_t ssid_len)
+{
+        struct wpa_driver_scan_params params;
+
+        os_memset(&params, 0, sizeof(params));
+        params.ssids[0].ssid = ssid;
+        params.ssids[0].ssid_len = ssid_len;
+        params.num_ssids = 1;
+
+        return wpa_driver_test_scan2(priv, &params);
+}
+
+
 static struct wpa_scan_results * wpa_driver_test_get_scan_results2(void *priv)
 {
         struct wpa_driver_test_data *drv = priv;
@@ -926,6 +949,7 @@ static int wpa_driver_test_get_capa(void *priv, struct wpa_driver_capa *capa)
                 WPA_DRIVER_AUTH_LEAP;
         if (drv->use_mlme)
                 capa->flags |= WPA_DRIVER_FLAGS_USER_SPACE_MLME;
+        capa->max_scan_ssids = 4;
 
         return 0;
 }
@@ -1226,5 +1250,6 @@ const struct wpa_driver_ops wpa_driver_test_ops = {
         wpa_driver_test_global_init,
         wpa_driver_test_global_deinit,
         wpa_driver_test_init2,
-        wpa_driver_test_get_interfaces
+        wpa_driver_test_get_interfaces,
+        wpa_driver_test_scan2
 };
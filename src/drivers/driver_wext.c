@@ -1067,20 +1067,32 @@ void wpa_driver_wext_scan_timeout(void *eloop_ctx, void *timeout_ctx)
 
 
 /**
- * wpa_driver_wext_scan - Request the driver to initiate scan
+ * wpa_driver_wext_scan2 - Request the driver to initiate scan
  * @priv: Pointer to private wext data from wpa_driver_wext_init()
- * @ssid: Specific SSID to scan for (ProbeReq) or %NULL to scan for
- *        all SSIDs (either active scan with broadcast SSID or passive
- *        scan
- * @ssid_len: Length of the SSID
+ * @params: Scan parameters
  * Returns: 0 on success, -1 on failure
+ *
+ * WEXT can only request one specific SSID per scan, so only the first SSID
+ * in params is used. The scan is limited to params->freqs with
+ * IW_SCAN_THIS_FREQ; drivers that do not support this scan all channels.
  */
-int wpa_driver_wext_scan(void *priv, const u8 *ssid, size_t ssid_len)
+int wpa_driver_wext_scan2(void *priv, struct wpa_driver_scan_params *params)
 {
         struct wpa_driver_wext_data *drv = priv;
         struct iwreq iwr;
         int ret = 0, timeout;
         struct iw_scan_req req;
+        const u8 *ssid = NULL;
+        size_t ssid_len = 0, i;
+
+        if (params->num_ssids) {
+                ssid = params->ssids[0].ssid;
+                ssid_len = params->ssids[0].ssid_len;
+        }
+        if (params->num_ssids > 1)
+                wpa_printf(MSG_DEBUG, "%s: only the first of %lu SSIDs is "
+                           "used", __FUNCTION__,
+                           (unsigned long) params->num_ssids);
 
         if (ssid_len > IW_ESSID_MAX_SIZE) {
                 wpa_printf(MSG_DEBUG, "%s: too long SSID (%lu)",
@@ -1090,16 +1102,28 @@ int wpa_driver_wext_scan(void *priv, const u8 *ssid, size_t ssid_len)
 
         os_memset(&iwr, 0, sizeof(iwr));
         os_strlcpy(iwr.ifr_name, drv->ifname, IFNAMSIZ);
+        os_memset(&req, 0, sizeof(req));
+        req.bssid.sa_family = ARPHRD_ETHER;
+        os_memset(req.bssid.sa_data, 0xff, ETH_ALEN);
 
         if (ssid && ssid_len) {
-                os_memset(&req, 0, sizeof(req));
                 req.essid_len = ssid_len;
-                req.bssid.sa_family = ARPHRD_ETHER;
-                os_memset(req.bssid.sa_data, 0xff, ETH_ALEN);
                 os_memcpy(req.essid, ssid, ssid_len);
+                iwr.u.data.flags |= IW_SCAN_THIS_ESSID;
+        }
+
+        for (i = 0; params->freqs && params->freqs[i] &&
+                     i < IW_MAX_FREQUENCIES; i++) {
+                req.channel_list[i].m = params->freqs[i] * 100000;
+                req.channel_list[i].e = 1;
+                req.num_channels++;
+        }
+        if (req.num_channels)
+                iwr.u.data.flags |= IW_SCAN_THIS_FREQ;
+
+        if (iwr.u.data.flags) {
                 iwr.u.data.pointer = (caddr_t) &req;
                 iwr.u.data.length = sizeof(req);
-                iwr.u.data.flags = IW_SCAN_THIS_ESSID;
         }
 
         if (ioctl(drv->ioctl_sock, SIOCSIWSCAN, &iwr) < 0) {
@@ -1128,14 +1152,76 @@ int wpa_driver_wext_scan(void *priv, const u8 *ssid, size_t ssid_len)
 }
 
 
+/**
+ * wpa_driver_wext_scan - Request the driver to initiate scan
+ * @priv: Pointer to private wext data from wpa_driver_wext_init()
+ * @ssid: Specific SSID to scan for (ProbeReq) or %NULL to scan for
+ *        all SSIDs (either active scan with broadcast SSID or passive
+ *        scan
+ * @ssid_len: Length of the SSID
+ * Returns: 0 on success, -1 on failure
+ */
+int wpa_driver_wext_scan(void *priv, const u8 *ssid, size_t ssid_len)
+{
+        struct wpa_driver_scan_params params;
+
+        os_memset(&params, 0, sizeof(params));
+        params.ssids[0].ssid = ssid;
+        params.ssids[0].ssid_len = ssid_len;
+        params.num_ssids = 1;
+
+        return wpa_driver_wext_scan2(priv, &params);
+}
+
+
+/* Number of consecutive small scan results before the buffer is shrunk */
+#define WEXT_SCAN_BUF_SHRINK_COUNT 5
+
+
+static void wpa_driver_wext_update_scan_buf_len(
+        struct wpa_driver_wext_data *drv, size_t buf_len, size_t used)
+{
+        /*
+         * Grow immediately, but shrink only after the results have been
+         * small for a number of consecutive scans so that the size does not
+         * oscillate when the number of BSSes varies between scans.
+         */
+        if (used > buf_len / 4 || buf_len <= IW_SCAN_MAX_DATA) {
+                drv->scan_buf_small = 0;
+                drv->scan_buf_len = buf_len;
+                return;
+        }
+
+        if (++drv->scan_buf_small < WEXT_SCAN_BUF_SHRINK_COUNT) {
+                drv->scan_buf_len = buf_len;
+                return;
+        }
+
+        drv->scan_buf_small = 0;
+        drv->scan_buf_len = buf_len / 2;
+        if (drv->scan_buf_len < IW_SCAN_MAX_DATA)
+                drv->scan_buf_len = IW_SCAN_MAX_DATA;
+        wpa_printf(MSG_DEBUG, "SIOCGIWSCAN: shrinking buffer to %lu bytes",
+                   (unsigned long) drv->scan_buf_len);
+}
+
+
 static u8 * wpa_driver_wext_giwscan(struct wpa_driver_wext_data *drv,
                                     size_t *len)
 {
         struct iwreq iwr;
         u8 *res_buf;
         size_t res_buf_len;
+        int retries = 0;
 
-        res_buf_len = IW_SCAN_MAX_DATA;
+        /*
+         * Start from the size that was needed for the previous scan results
+         * to avoid failing SIOCGIWSCAN calls in dense environments; each one
+         * makes the kernel regenerate the full event stream.
+         */
+        res_buf_len = drv->scan_buf_len;
+        if (res_buf_len < IW_SCAN_MAX_DATA)
+                res_buf_len = IW_SCAN_MAX_DATA;
         for (;;) {
                 res_buf = os_malloc(res_buf_len);
                 if (res_buf == NULL)
@@ -1151,6 +1237,8 @@ static u8 * wpa_driver_wext_giwscan(struct wpa_driver_wext_data *drv,
                 if (errno == E2BIG && res_buf_len < 65535) {
                         os_free(res_buf);
                         res_buf = NULL;
+                        retries++;
+                        drv->scan_buf_retries++;
                         res_buf_len *= 2;
                         if (res_buf_len > 65535)
                                 res_buf_len = 65535; /* 16-bit length field */
@@ -1170,6 +1258,12 @@ static u8 * wpa_driver_wext_giwscan(struct wpa_driver_wext_data *drv,
         }
         *len = iwr.u.data.length;
 
+        wpa_printf(MSG_DEBUG, "SIOCGIWSCAN: %lu bytes in %lu byte buffer "
+                   "(%d retries, %u total)", (unsigned long) *len,
+                   (unsigned long) res_buf_len, retries,
+                   drv->scan_buf_retries);
+        wpa_driver_wext_update_scan_buf_len(drv, res_buf_len, *len);
+
         return res_buf;
 }
 
@@ -1182,6 +1276,7 @@ struct wext_scan_data {
         struct wpa_scan_res res;
         u8 *ie;
         size_t ie_len;
+        size_t ie_size; /* allocated size of ie; reused for all BSSes */
         u8 ssid[32];
         size_t ssid_len;
         int maxrate;
@@ -1301,6 +1396,33 @@ static void wext_get_scan_rate(struct iw_event *iwe,
 }
 
 
+/*
+ * Reserve room for len more octets of IEs for the current BSS. The buffer is
+ * grown geometrically and kept for the following BSSes, so that merging IEs
+ * does not need to reallocate it for each event.
+ */
+static u8 * wext_scan_data_ie_extend(struct wext_scan_data *res, size_t len)
+{
+        size_t size;
+        u8 *tmp;
+
+        if (res->ie_len + len > res->ie_size) {
+                size = res->ie_size ? 2 * res->ie_size : 256;
+                while (size < res->ie_len + len)
+                        size *= 2;
+                tmp = os_realloc(res->ie, size);
+                if (tmp == NULL)
+                        return NULL;
+                res->ie = tmp;
+                res->ie_size = size;
+        }
+
+        tmp = res->ie + res->ie_len;
+        res->ie_len += len;
+        return tmp;
+}
+
+
 static void wext_get_scan_iwevgenie(struct iw_event *iwe,
                                     struct wext_scan_data *res, char *custom,
                                     char *end)
@@ -1318,12 +1440,10 @@ static void wext_get_scan_iwevgenie(struct iw_event *iwe,
                 return;
         }
 
-        tmp = os_realloc(res->ie, res->ie_len + gend - gpos);
+        tmp = wext_scan_data_ie_extend(res, gend - gpos);
         if (tmp == NULL)
                 return;
-        os_memcpy(tmp + res->ie_len, gpos, gend - gpos);
-        res->ie = tmp;
-        res->ie_len += gend - gpos;
+        os_memcpy(tmp, gpos, gend - gpos);
 }
 
 
@@ -1346,12 +1466,10 @@ static void wext_get_scan_custom(struct iw_event *iwe,
                 if (bytes & 1 || bytes == 0)
                         return;
                 bytes /= 2;
-                tmp = os_realloc(res->ie, res->ie_len + bytes);
+                tmp = wext_scan_data_ie_extend(res, bytes);
                 if (tmp == NULL)
                         return;
-                hexstr2bin(spos, tmp + res->ie_len, bytes);
-                res->ie = tmp;
-                res->ie_len += bytes;
+                hexstr2bin(spos, tmp, bytes);
         } else if (clen > 7 && os_strncmp(custom, "rsn_ie=", 7) == 0) {
                 char *spos;
                 int bytes;
@@ -1360,12 +1478,10 @@ static void wext_get_scan_custom(struct iw_event *iwe,
                 if (bytes & 1 || bytes == 0)
                         return;
                 bytes /= 2;
-                tmp = os_realloc(res->ie, res->ie_len + bytes);
+                tmp = wext_scan_data_ie_extend(res, bytes);
                 if (tmp == NULL)
                         return;
-                hexstr2bin(spos, tmp + res->ie_len, bytes);
-                res->ie = tmp;
-                res->ie_len += bytes;
+                hexstr2bin(spos, tmp, bytes);
         } else if (clen > 4 && os_strncmp(custom, "tsf=", 4) == 0) {
                 char *spos;
                 int bytes;
@@ -1394,7 +1510,6 @@ static int wext_19_iw_point(struct wpa_driver_wext_data *drv, u16 cmd)
 static void wpa_driver_wext_add_scan_entry(struct wpa_scan_results *res,
                                            struct wext_scan_data *data)
 {
-        struct wpa_scan_res **tmp;
         struct wpa_scan_res *r;
         size_t extra_len;
         u8 *pos, *end, *ssid_ie = NULL, *rate_ie = NULL;
@@ -1420,11 +1535,12 @@ static void wpa_driver_wext_add_scan_entry(struct wpa_scan_results *res,
         if (rate_ie == NULL && data->maxrate)
                 extra_len += 3;
 
-        r = os_zalloc(sizeof(*r) + extra_len + data->ie_len);
+        r = wpa_scan_results_add(res, extra_len + data->ie_len);
         if (r == NULL)
                 return;
         os_memcpy(r, &data->res, sizeof(*r));
         r->ie_len = extra_len + data->ie_len;
+        r->flags = 0;
         pos = (u8 *) (r + 1);
         if (ssid_ie == NULL) {
                 /*
@@ -1447,15 +1563,6 @@ static void wpa_driver_wext_add_scan_entry(struct wpa_scan_results *res,
         }
         if (data->ie)
                 os_memcpy(pos, data->ie, data->ie_len);
-
-        tmp = os_realloc(res->res,
-                         (res->num + 1) * sizeof(struct wpa_scan_res *));
-        if (tmp == NULL) {
-                os_free(r);
-                return;
-        }
-        tmp[res->num++] = r;
-        res->res = tmp;
 }
                                       
 
@@ -1474,6 +1581,8 @@ struct wpa_scan_results * wpa_driver_wext_get_scan_results(void *priv)
         char *pos, *end, *custom;
         struct wpa_scan_results *res;
         struct wext_scan_data data;
+        u8 *ie;
+        size_t ie_size;
 
         res_buf = wpa_driver_wext_giwscan(drv, &len);
         if (res_buf == NULL)
@@ -1516,8 +1625,11 @@ struct wpa_scan_results * wpa_driver_wext_get_scan_results(void *priv)
                         if (!first)
                                 wpa_driver_wext_add_scan_entry(res, &data);
                         first = 0;
-                        os_free(data.ie);
+                        ie = data.ie;
+                        ie_size = data.ie_size;
                         os_memset(&data, 0, sizeof(data));
+                        data.ie = ie;
+                        data.ie_size = ie_size;
                         os_memcpy(data.res.bssid,
                                   iwe->u.ap_addr.sa_data, ETH_ALEN);
                         break;
@@ -1599,6 +1711,7 @@ static int wpa_driver_wext_get_range(void *priv)
                            range->we_version_source,
                            range->enc_capa);
                 drv->has_capability = 1;
+                drv->capa.max_scan_ssids = 1;
                 drv->we_version_compiled = range->we_version_compiled;
                 if (range->enc_capa & IW_ENC_CAPA_WPA) {
                         drv->capa.key_mgmt |= WPA_DRIVER_CAPA_KEY_MGMT_WPA |
@@ -2359,6 +2472,7 @@ const struct wpa_driver_ops wpa_driver_wext_ops = {
         .set_countermeasures = wpa_driver_wext_set_countermeasures,
         .set_drop_unencrypted = wpa_driver_wext_set_drop_unencrypted,
         .scan = wpa_driver_wext_scan,
+        .scan2 = wpa_driver_wext_scan2,
         .get_scan_results2 = wpa_driver_wext_get_scan_results,
         .deauthenticate = wpa_driver_wext_deauthenticate,
         .disassociate = wpa_driver_wext_disassociate,
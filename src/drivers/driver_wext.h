@@ -43,6 +43,13 @@ struct wpa_driver_wext_data {
   char mlmedev[IFNAMSIZ + 1];
 
   int scan_complete_events;
+
+  /* SIOCGIWSCAN buffer size that is used to start the next fetch */
+  size_t scan_buf_len;
+  /* number of consecutive fetches that used less than 1/4 of the buffer */
+  int scan_buf_small;
+  /* number of SIOCGIWSCAN retries with a larger buffer (E2BIG) */
+  unsigned int scan_buf_retries;
 };
 
 int wpa_driver_wext_get_ifflags(struct wpa_driver_wext_data *drv, int *flags);
@@ -58,6 +65,7 @@ int wpa_driver_wext_set_key(void *priv, wpa_alg alg,
           int set_tx, const u8 *seq, size_t seq_len,
           const u8 *key, size_t key_len);
 int wpa_driver_wext_scan(void *priv, const u8 *ssid, size_t ssid_len);
+int wpa_driver_wext_scan2(void *priv, struct wpa_driver_scan_params *params);
 struct wpa_scan_results * wpa_driver_wext_get_scan_results(void *priv);
 
 void wpa_driver_wext_scan_timeout(void *eloop_ctx, void *timeout_ctx);
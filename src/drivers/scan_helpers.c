@@ -19,11 +19,66 @@
 #include "ieee802_11_defs.h"
 
 
+#define WPA_SCAN_IE_INDEX_VENDORS 8
+
+/*
+ * IE index stored after the IEs of an indexed scan result. Offsets are stored
+ * as offset + 1 so that zero means that the IE is not present. The size is
+ * fixed (about 560 octets) regardless of the number of IEs.
+ */
+struct wpa_scan_ie_index {
+        u16 ie[256];
+        u32 vendor_type[WPA_SCAN_IE_INDEX_VENDORS];
+        u16 vendor[WPA_SCAN_IE_INDEX_VENDORS];
+        u8 num_vendor;
+        u8 vendor_overflow; /* more vendor types than fit into the table */
+};
+
+
+static size_t wpa_scan_ie_index_offset(const struct wpa_scan_res *res)
+{
+        return (sizeof(*res) + res->ie_len + 3) & ~((size_t) 3);
+}
+
+
+static const struct wpa_scan_ie_index *
+wpa_scan_ie_index(const struct wpa_scan_res *res)
+{
+        if (!(res->flags & WPA_SCAN_IE_INDEXED))
+                return NULL;
+        return (const struct wpa_scan_ie_index *)
+                ((const u8 *) res + wpa_scan_ie_index_offset(res));
+}
+
+
+/**
+ * wpa_scan_res_size - Get the allocated size of a scan result
+ * @res: Scan result
+ * Returns: Number of octets used by the scan result, including the IEs and the
+ * IE index, if present
+ *
+ * This is the length that needs to be copied when duplicating a scan result.
+ */
+size_t wpa_scan_res_size(const struct wpa_scan_res *res)
+{
+        if (res->flags & WPA_SCAN_IE_INDEXED)
+                return wpa_scan_ie_index_offset(res) +
+                        sizeof(struct wpa_scan_ie_index);
+        return sizeof(*res) + res->ie_len;
+}
+
+
 const u8 * wpa_scan_get_ie(const struct wpa_scan_res *res, u8 ie)
 {
+        const struct wpa_scan_ie_index *idx;
         const u8 *end, *pos;
 
         pos = (const u8 *) (res + 1);
+
+        idx = wpa_scan_ie_index(res);
+        if (idx)
+                return idx->ie[ie] ? pos + idx->ie[ie] - 1 : NULL;
+
         end = pos + res->ie_len;
 
         while (pos + 1 < end) {
@@ -41,9 +96,22 @@ const u8 * wpa_scan_get_ie(const struct wpa_scan_res *res, u8 ie)
 const u8 * wpa_scan_get_vendor_ie(const struct wpa_scan_res *res,
                                   u32 vendor_type)
 {
+        const struct wpa_scan_ie_index *idx;
         const u8 *end, *pos;
+        int i;
 
         pos = (const u8 *) (res + 1);
+
+        idx = wpa_scan_ie_index(res);
+        if (idx) {
+                for (i = 0; i < idx->num_vendor; i++) {
+                        if (idx->vendor_type[i] == vendor_type)
+                                return pos + idx->vendor[i] - 1;
+                }
+                if (!idx->vendor_overflow)
+                        return NULL;
+        }
+
         end = pos + res->ie_len;
 
         while (pos + 1 < end) {
@@ -59,6 +127,81 @@ const u8 * wpa_scan_get_vendor_ie(const struct wpa_scan_res *res,
 }
 
 
+static void wpa_scan_ie_index_build(const struct wpa_scan_res *res,
+                                    struct wpa_scan_ie_index *idx)
+{
+        const u8 *start, *end, *pos;
+        u32 type;
+        int i;
+
+        os_memset(idx, 0, sizeof(*idx));
+        start = pos = (const u8 *) (res + 1);
+        end = pos + res->ie_len;
+
+        while (pos + 1 < end) {
+                if (pos + 2 + pos[1] > end)
+                        break;
+                if (idx->ie[pos[0]] == 0)
+                        idx->ie[pos[0]] = pos - start + 1;
+                if (pos[0] == WLAN_EID_VENDOR_SPECIFIC && pos[1] >= 4) {
+                        type = WPA_GET_BE32(&pos[2]);
+                        for (i = 0; i < idx->num_vendor; i++) {
+                                if (idx->vendor_type[i] == type)
+                                        break;
+                        }
+                        if (i == idx->num_vendor &&
+                            i < WPA_SCAN_IE_INDEX_VENDORS) {
+                                idx->vendor_type[i] = type;
+                                idx->vendor[i] = pos - start + 1;
+                                idx->num_vendor++;
+                        } else if (i == idx->num_vendor)
+                                idx->vendor_overflow = 1;
+                }
+                pos += 2 + pos[1];
+        }
+}
+
+
+static int wpa_scan_arena_owns(const struct wpa_scan_results *res,
+                               const struct wpa_scan_res *r);
+
+
+/**
+ * wpa_scan_results_index - Add IE indexes to scan results
+ * @res: Scan results from the driver
+ *
+ * This function walks the IEs of each scan result once and stores an index
+ * after the IEs so that wpa_scan_get_ie() and wpa_scan_get_vendor_ie() do not
+ * need to walk the IEs again. Scan results that cannot be indexed (e.g., due
+ * to allocation failure) continue to work without the index.
+ */
+void wpa_scan_results_index(struct wpa_scan_results *res)
+{
+        struct wpa_scan_res *r;
+        size_t i, offset;
+
+        for (i = 0; i < res->num; i++) {
+                r = res->res[i];
+                if (r == NULL)
+                        continue;
+                r->flags &= ~WPA_SCAN_IE_INDEXED;
+                if (r->ie_len >= 0xffff)
+                        continue;
+                offset = wpa_scan_ie_index_offset(r);
+                /* Arena entries have room reserved for the index */
+                if (!wpa_scan_arena_owns(res, r))
+                        r = os_realloc(r, offset +
+                                       sizeof(struct wpa_scan_ie_index));
+                if (r == NULL)
+                        continue;
+                wpa_scan_ie_index_build(
+                        r, (struct wpa_scan_ie_index *) ((u8 *) r + offset));
+                r->flags |= WPA_SCAN_IE_INDEXED;
+                res->res[i] = r;
+        }
+}
+
+
 struct wpabuf * wpa_scan_get_vendor_ie_multi(const struct wpa_scan_res *res,
                                              u32 vendor_type)
 {
@@ -112,56 +255,194 @@ int wpa_scan_get_max_rate(const struct wpa_scan_res *res)
 }
 
 
+/*
+ * Scan result arena. Entries added with wpa_scan_results_add() are placed
+ * back-to-back in large blocks so that a scan result table with hundreds of
+ * BSSes needs only a handful of allocations and can be freed in one go.
+ */
+#define WPA_SCAN_ARENA_BLOCK 8192
+#define WPA_SCAN_ARENA_BLOCK_MAX 65536
+#define WPA_SCAN_ARENA_ALIGN 8
+#define WPA_SCAN_ARENA_ROUND(len) \
+        (((len) + WPA_SCAN_ARENA_ALIGN - 1) & \
+         ~((size_t) WPA_SCAN_ARENA_ALIGN - 1))
+#define WPA_SCAN_RES_INITIAL 16
+
+struct wpa_scan_arena {
+        struct wpa_scan_arena *next;
+        size_t size;
+        size_t used;
+        /* followed by padding to WPA_SCAN_ARENA_ALIGN and size octets of
+         * entry data */
+};
+
+#define WPA_SCAN_ARENA_HDR WPA_SCAN_ARENA_ROUND(sizeof(struct wpa_scan_arena))
+
+
+/*
+ * Entries added with wpa_scan_results_add() are recognized by their address
+ * rather than by a flag in the entry, since drivers fill in the flags.
+ */
+static int wpa_scan_arena_owns(const struct wpa_scan_results *res,
+                               const struct wpa_scan_res *r)
+{
+        const struct wpa_scan_arena *a;
+        const u8 *start, *pos = (const u8 *) r;
+
+        for (a = res->arena; a; a = a->next) {
+                start = (const u8 *) a + WPA_SCAN_ARENA_HDR;
+                if (pos >= start && pos < start + a->used)
+                        return 1;
+        }
+        return 0;
+}
+
+
+static void * wpa_scan_arena_alloc(struct wpa_scan_results *res, size_t len)
+{
+        struct wpa_scan_arena *a = res->arena;
+        size_t size;
+        u8 *pos;
+
+        len = WPA_SCAN_ARENA_ROUND(len);
+        if (a == NULL || a->size - a->used < len) {
+                /* Grow the block size with the table */
+                size = a ? 2 * a->size : WPA_SCAN_ARENA_BLOCK;
+                if (size > WPA_SCAN_ARENA_BLOCK_MAX)
+                        size = WPA_SCAN_ARENA_BLOCK_MAX;
+                if (size < len)
+                        size = len;
+                a = os_malloc(WPA_SCAN_ARENA_HDR + size);
+                if (a == NULL)
+                        return NULL;
+                a->size = size;
+                a->used = 0;
+                a->next = res->arena;
+                res->arena = a;
+        }
+
+        pos = (u8 *) a + WPA_SCAN_ARENA_HDR + a->used;
+        a->used += len;
+        return pos;
+}
+
+
+/**
+ * wpa_scan_results_add - Add a new entry to scan results
+ * @res: Scan results
+ * @ie_len: Length of the IEs that follow the entry
+ * Returns: Pointer to the new entry or %NULL on failure
+ *
+ * This function allocates a zeroed entry with room for ie_len octets of IEs
+ * (and for the index built by wpa_scan_results_index()) from the arena of the
+ * scan results and appends it to res->res. The entry's ie_len is set, but the
+ * caller is responsible for filling in the other fields and the IEs. Entries
+ * added this way must not be freed or reallocated separately; they are
+ * released by wpa_scan_results_free().
+ */
+struct wpa_scan_res * wpa_scan_results_add(struct wpa_scan_results *res,
+                                           size_t ie_len)
+{
+        struct wpa_scan_res **tmp, *r;
+        size_t len, num;
+
+        if (res->num == res->res_size) {
+                num = res->res_size ? 2 * res->res_size :
+                        WPA_SCAN_RES_INITIAL;
+                tmp = os_realloc(res->res, num * sizeof(struct wpa_scan_res *));
+                if (tmp == NULL)
+                        return NULL;
+                res->res = tmp;
+                res->res_size = num;
+        }
+
+        len = ((sizeof(*r) + ie_len + 3) & ~((size_t) 3));
+        if (ie_len < 0xffff)
+                len += sizeof(struct wpa_scan_ie_index);
+        r = wpa_scan_arena_alloc(res, len);
+        if (r == NULL)
+                return NULL;
+        os_memset(r, 0, sizeof(*r));
+        r->ie_len = ie_len;
+        res->res[res->num++] = r;
+
+        return r;
+}
+
+
 void wpa_scan_results_free(struct wpa_scan_results *res)
 {
+        struct wpa_scan_arena *a, *prev;
         size_t i;
 
         if (res == NULL)
                 return;
 
-        for (i = 0; i < res->num; i++)
-                os_free(res->res[i]);
+        for (i = 0; i < res->num; i++) {
+                if (res->res[i] && !wpa_scan_arena_owns(res, res->res[i]))
+                        os_free(res->res[i]);
+        }
+        a = res->arena;
+        while (a) {
+                prev = a;
+                a = a->next;
+                os_free(prev);
+        }
         os_free(res->res);
         os_free(res);
 }
 
 
-/* Compare function for sorting scan results. Return >0 if @b is considered
- * better. */
-static int wpa_scan_result_compar(const void *a, const void *b)
+/*
+ * Sort keys for scan results. These are extracted in one pass over the IEs so
+ * that the comparison function does not need to parse the IEs again for each
+ * comparison.
+ */
+struct wpa_scan_sort_key {
+        struct wpa_scan_res *res;
+        int level;
+        int qual;
+        int maxrate;
+        u8 wpa;
+        u8 privacy;
+};
+
+
+static void wpa_scan_sort_key_init(struct wpa_scan_sort_key *key,
+                                   struct wpa_scan_res *res)
 {
-        struct wpa_scan_res **_wa = (void *) a;
-        struct wpa_scan_res **_wb = (void *) b;
-        struct wpa_scan_res *wa = *_wa;
-        struct wpa_scan_res *wb = *_wb;
-        int wpa_a, wpa_b, maxrate_a, maxrate_b;
+        key->res = res;
+        key->level = res->level;
+        key->qual = res->qual;
+        key->maxrate = wpa_scan_get_max_rate(res);
+        key->wpa = wpa_scan_get_vendor_ie(res, WPA_IE_VENDOR_TYPE) != NULL ||
+                wpa_scan_get_ie(res, WLAN_EID_RSN) != NULL;
+        key->privacy = !!(res->caps & IEEE80211_CAP_PRIVACY);
+}
 
-        /* WPA/WPA2 support preferred */
-        wpa_a = wpa_scan_get_vendor_ie(wa, WPA_IE_VENDOR_TYPE) != NULL ||
-                wpa_scan_get_ie(wa, WLAN_EID_RSN) != NULL;
-        wpa_b = wpa_scan_get_vendor_ie(wb, WPA_IE_VENDOR_TYPE) != NULL ||
-                wpa_scan_get_ie(wb, WLAN_EID_RSN) != NULL;
 
-        if (wpa_b && !wpa_a)
+/* Compare function for sorting scan results. Return >0 if @wb is considered
+ * better. */
+static int wpa_scan_key_compar(const struct wpa_scan_sort_key *wa,
+                               const struct wpa_scan_sort_key *wb)
+{
+        /* WPA/WPA2 support preferred */
+        if (wb->wpa && !wa->wpa)
                 return 1;
-        if (!wpa_b && wpa_a)
+        if (!wb->wpa && wa->wpa)
                 return -1;
 
         /* privacy support preferred */
-        if ((wa->caps & IEEE80211_CAP_PRIVACY) == 0 &&
-            (wb->caps & IEEE80211_CAP_PRIVACY))
+        if (!wa->privacy && wb->privacy)
                 return 1;
-        if ((wa->caps & IEEE80211_CAP_PRIVACY) &&
-            (wb->caps & IEEE80211_CAP_PRIVACY) == 0)
+        if (wa->privacy && !wb->privacy)
                 return -1;
 
         /* best/max rate preferred if signal level close enough XXX */
         if ((wa->level && wb->level && abs(wb->level - wa->level) < 5) ||
             (wa->qual && wb->qual && abs(wb->qual - wa->qual) < 10)) {
-                maxrate_a = wpa_scan_get_max_rate(wa);
-                maxrate_b = wpa_scan_get_max_rate(wb);
-                if (maxrate_a != maxrate_b)
-                        return maxrate_b - maxrate_a;
+                if (wa->maxrate != wb->maxrate)
+                        return wb->maxrate - wa->maxrate;
         }
 
         /* use freq for channel preference */
@@ -175,8 +456,59 @@ static int wpa_scan_result_compar(const void *a, const void *b)
 }
 
 
+static int wpa_scan_sort_key_compar(const void *a, const void *b)
+{
+        const struct wpa_scan_sort_key *const *wa = a;
+        const struct wpa_scan_sort_key *const *wb = b;
+
+        return wpa_scan_key_compar(*wa, *wb);
+}
+
+
+/* Fallback comparison on the scan results when sort keys cannot be
+ * allocated. */
+static int wpa_scan_result_compar(const void *a, const void *b)
+{
+        struct wpa_scan_res **_wa = (void *) a;
+        struct wpa_scan_res **_wb = (void *) b;
+        struct wpa_scan_sort_key wa, wb;
+
+        wpa_scan_sort_key_init(&wa, *_wa);
+        wpa_scan_sort_key_init(&wb, *_wb);
+        return wpa_scan_key_compar(&wa, &wb);
+}
+
+
 void wpa_scan_sort_results(struct wpa_scan_results *res)
 {
-        qsort(res->res, res->num, sizeof(struct wpa_scan_res *),
-              wpa_scan_result_compar);
+        struct wpa_scan_sort_key *keys, **sorted;
+        size_t i;
+
+        if (res->num < 2)
+                return;
+
+        /*
+         * Sort an array of pointers to the keys so that qsort() sees the same
+         * element size and makes the same comparisons as when sorting
+         * res->res directly. This keeps the order identical even though the
+         * comparison is not transitive.
+         */
+        keys = os_malloc(res->num * (sizeof(*keys) + sizeof(*sorted)));
+        if (keys == NULL) {
+                qsort(res->res, res->num, sizeof(struct wpa_scan_res *),
+                      wpa_scan_result_compar);
+                return;
+        }
+        sorted = (struct wpa_scan_sort_key **) (keys + res->num);
+
+        for (i = 0; i < res->num; i++) {
+                wpa_scan_sort_key_init(&keys[i], res->res[i]);
+                sorted[i] = &keys[i];
+        }
+
+        qsort(sorted, res->num, sizeof(*sorted), wpa_scan_sort_key_compar);
+
+        for (i = 0; i < res->num; i++)
+                res->res[i] = sorted[i]->res;
+        os_free(keys);
 }
@@ -40,7 +40,19 @@ struct eapol_sm {
         unsigned int heldWhile;
         unsigned int startWhen;
         unsigned int idleWhile; /* for EAP state machine */
-        int timer_tick_enabled;
+
+        /*
+         * Absolute expiration times of the running timers above. The timer
+         * variables hold the remaining time in seconds (rounded up) as of the
+         * latest eapol_port_timers_update() call. A single eloop timeout is
+         * registered for the earliest expiration instead of a periodic tick.
+         */
+        struct {
+                struct os_reltime authWhile;
+                struct os_reltime heldWhile;
+                struct os_reltime startWhen;
+                struct os_reltime idleWhile;
+        } expire;
 
         /* Global variables */
         Boolean eapFail;
@@ -197,55 +209,113 @@ static void eapol_sm_abort_cached(struct eapol_sm *sm);
 static void eapol_sm_step_timeout(void *eloop_ctx, void *timeout_ctx);
 
 
-/* Port Timers state machine - implemented as a function that will be called
- * once a second as a registered event loop timeout */
-static void eapol_port_timers_tick(void *eloop_ctx, void *timeout_ctx)
+/* Port Timers state machine - implemented without a periodic tick: each
+ * running timer has an absolute expiration time and a single event loop
+ * timeout is registered for the earliest one */
+
+static void eapol_port_timers_tick(void *eloop_ctx, void *timeout_ctx);
+
+
+static int eapol_port_timer_update(unsigned int *timer,
+                                   struct os_reltime *expire,
+                                   struct os_reltime *now, const char *name)
 {
-        struct eapol_sm *sm = timeout_ctx;
+        struct os_reltime left;
 
-        if (sm->authWhile > 0) {
-                sm->authWhile--;
-                if (sm->authWhile == 0)
-                        wpa_printf(MSG_DEBUG, "EAPOL: authWhile --> 0");
-        }
-        if (sm->heldWhile > 0) {
-                sm->heldWhile--;
-                if (sm->heldWhile == 0)
-                        wpa_printf(MSG_DEBUG, "EAPOL: heldWhile --> 0");
-        }
-        if (sm->startWhen > 0) {
-                sm->startWhen--;
-                if (sm->startWhen == 0)
-                        wpa_printf(MSG_DEBUG, "EAPOL: startWhen --> 0");
-        }
-        if (sm->idleWhile > 0) {
-                sm->idleWhile--;
-                if (sm->idleWhile == 0)
-                        wpa_printf(MSG_DEBUG, "EAPOL: idleWhile --> 0");
-        }
+        if (*timer == 0)
+                return 0;
 
-        if (sm->authWhile | sm->heldWhile | sm->startWhen | sm->idleWhile) {
-                eloop_register_timeout(1, 0, eapol_port_timers_tick, eloop_ctx,
-                                       sm);
-        } else {
-                wpa_printf(MSG_DEBUG, "EAPOL: disable timer tick");
-                sm->timer_tick_enabled = 0;
+        if (!os_reltime_before(now, expire)) {
+                *timer = 0;
+                wpa_printf(MSG_DEBUG, "EAPOL: %s --> 0", name);
+                return 0;
         }
-        eapol_sm_step(sm);
+
+        os_reltime_sub(expire, now, &left);
+        *timer = left.sec + (left.usec > 0 ? 1 : 0);
+        return 1;
 }
 
 
-static void eapol_enable_timer_tick(struct eapol_sm *sm)
+static int eapol_port_timers_update(struct eapol_sm *sm)
 {
-        if (sm->timer_tick_enabled)
-                return;
-        wpa_printf(MSG_DEBUG, "EAPOL: enable timer tick");
-        sm->timer_tick_enabled = 1;
+        struct os_reltime now;
+        int running = 0;
+
+        os_get_reltime(&now);
+        running |= eapol_port_timer_update(&sm->authWhile,
+                                           &sm->expire.authWhile, &now,
+                                           "authWhile");
+        running |= eapol_port_timer_update(&sm->heldWhile,
+                                           &sm->expire.heldWhile, &now,
+                                           "heldWhile");
+        running |= eapol_port_timer_update(&sm->startWhen,
+                                           &sm->expire.startWhen, &now,
+                                           "startWhen");
+        running |= eapol_port_timer_update(&sm->idleWhile,
+                                           &sm->expire.idleWhile, &now,
+                                           "idleWhile");
+        return running;
+}
+
+
+static void eapol_port_timers_schedule(struct eapol_sm *sm)
+{
+        struct os_reltime *next = NULL, now, left;
+
         eloop_cancel_timeout(eapol_port_timers_tick, NULL, sm);
-        eloop_register_timeout(1, 0, eapol_port_timers_tick, NULL, sm);
+
+        if (sm->authWhile)
+                next = &sm->expire.authWhile;
+        if (sm->heldWhile &&
+            (next == NULL || os_reltime_before(&sm->expire.heldWhile, next)))
+                next = &sm->expire.heldWhile;
+        if (sm->startWhen &&
+            (next == NULL || os_reltime_before(&sm->expire.startWhen, next)))
+                next = &sm->expire.startWhen;
+        if (sm->idleWhile &&
+            (next == NULL || os_reltime_before(&sm->expire.idleWhile, next)))
+                next = &sm->expire.idleWhile;
+        if (next == NULL)
+                return;
+
+        os_get_reltime(&now);
+        if (os_reltime_before(&now, next))
+                os_reltime_sub(next, &now, &left);
+        else
+                left.sec = left.usec = 0;
+        eloop_register_timeout(left.sec, left.usec, eapol_port_timers_tick,
+                               NULL, sm);
 }
 
 
+static void eapol_port_timers_tick(void *eloop_ctx, void *timeout_ctx)
+{
+        struct eapol_sm *sm = timeout_ctx;
+
+        if (!eapol_port_timers_update(sm))
+                wpa_printf(MSG_DEBUG, "EAPOL: no port timers running");
+        eapol_port_timers_schedule(sm);
+        eapol_sm_step(sm);
+}
+
+
+static void eapol_port_timer_start(struct eapol_sm *sm, unsigned int *timer,
+                                   struct os_reltime *expire,
+                                   unsigned int value)
+{
+        *timer = value;
+        if (value) {
+                os_get_reltime(expire);
+                expire->sec += value;
+        }
+        eapol_port_timers_schedule(sm);
+}
+
+#define eapol_port_timer_set(sm, timer, value) \
+        eapol_port_timer_start((sm), &(sm)->timer, &(sm)->expire.timer, (value))
+
+
 SM_STATE(SUPP_PAE, LOGOFF)
 {
         SM_ENTRY(SUPP_PAE, LOGOFF);
@@ -274,7 +344,7 @@ SM_STATE(SUPP_PAE, CONNECTING)
         int send_start = sm->SUPP_PAE_state == SUPP_PAE_CONNECTING;
         SM_ENTRY(SUPP_PAE, CONNECTING);
         if (send_start) {
-                sm->startWhen = sm->startPeriod;
+                eapol_port_timer_set(sm, startWhen, sm->startPeriod);
                 sm->startCount++;
         } else {
                 /*
@@ -286,12 +356,11 @@ SM_STATE(SUPP_PAE, CONNECTING)
                  */
 #ifdef CONFIG_WPS
                 /* Reduce latency on starting WPS negotiation. */
-                sm->startWhen = 1;
+                eapol_port_timer_set(sm, startWhen, 1);
 #else /* CONFIG_WPS */
-                sm->startWhen = 3;
+                eapol_port_timer_set(sm, startWhen, 3);
 #endif /* CONFIG_WPS */
         }
-        eapol_enable_timer_tick(sm);
         sm->eapolEap = FALSE;
         if (send_start)
                 eapol_sm_txStart(sm);
@@ -314,8 +383,7 @@ SM_STATE(SUPP_PAE, AUTHENTICATING)
 SM_STATE(SUPP_PAE, HELD)
 {
         SM_ENTRY(SUPP_PAE, HELD);
-        sm->heldWhile = sm->heldPeriod;
-        eapol_enable_timer_tick(sm);
+        eapol_port_timer_set(sm, heldWhile, sm->heldPeriod);
         sm->suppPortStatus = Unauthorized;
         sm->cb_status = EAPOL_CB_FAILURE;
 }
@@ -474,7 +542,7 @@ SM_STEP(KEY_RX)
 SM_STATE(SUPP_BE, REQUEST)
 {
         SM_ENTRY(SUPP_BE, REQUEST);
-        sm->authWhile = 0;
+        eapol_port_timer_set(sm, authWhile, 0);
         sm->eapReq = TRUE;
         eapol_sm_getSuppRsp(sm);
 }
@@ -535,8 +603,7 @@ SM_STATE(SUPP_BE, INITIALIZE)
 SM_STATE(SUPP_BE, RECEIVE)
 {
         SM_ENTRY(SUPP_BE, RECEIVE);
-        sm->authWhile = sm->authPeriod;
-        eapol_enable_timer_tick(sm);
+        eapol_port_timer_set(sm, authWhile, sm->authPeriod);
         sm->eapolEap = FALSE;
         sm->eapNoResp = FALSE;
         sm->initial_req = FALSE;
@@ -1149,7 +1216,7 @@ int eapol_determine_timeout_period(struct eapol_sm *sm)
 {
    if (sm->eap->eapfailure)
    {
-        sm->idleWhile = 180;
+        eapol_port_timer_set(sm, idleWhile, 180);
         return 180;
    }
    else
@@ -1513,8 +1580,7 @@ static void eapol_sm_abort_cached(struct eapol_sm *sm)
 
         /* Make sure we do not start sending EAPOL-Start frames first, but
          * instead move to RESTART state to start EAPOL authentication. */
-        sm->startWhen = 3;
-        eapol_enable_timer_tick(sm);
+        eapol_port_timer_set(sm, startWhen, 3);
 
         if (sm->ctx->aborted_cached)
                 sm->ctx->aborted_cached(sm->ctx->ctx);
@@ -1730,6 +1796,7 @@ static unsigned int eapol_sm_get_int(void *ctx, enum eapol_int_var variable)
                 return 0;
         switch (variable) {
         case EAPOL_idleWhile:
+                eapol_port_timers_update(sm);
                 return sm->idleWhile;
         }
         return 0;
@@ -1744,8 +1811,7 @@ static void eapol_sm_set_int(void *ctx, enum eapol_int_var variable,
                 return;
         switch (variable) {
         case EAPOL_idleWhile:
-                sm->idleWhile = value;
-                eapol_enable_timer_tick(sm);
+                eapol_port_timer_set(sm, idleWhile, value);
                 break;
         }
 }
@@ -1867,9 +1933,6 @@ struct eapol_sm *eapol_sm_init(struct eapol_ctx *ctx)
         sm->initialize = FALSE;
         eapol_sm_step(sm);
 
-        sm->timer_tick_enabled = 1;
-        eloop_register_timeout(1, 0, eapol_port_timers_tick, NULL, sm);
-
         return sm;
 }
 
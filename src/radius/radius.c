@@ -27,6 +27,30 @@ radius_get_attr_hdr(struct radius_msg *msg, int idx)
 }
 
 
+/* Returns the index of the first attribute of the given type at or after
+ * index start or -1 if there is no such attribute. */
+static int radius_msg_find_attr(struct radius_msg *msg, u8 type, size_t start)
+{
+        size_t i;
+
+        if (msg->attr_index[type])
+                i = msg->attr_index[type] - 1;
+        else if (msg->attr_used <= RADIUS_ATTR_INDEX_LIMIT)
+                return -1;
+        else
+                i = RADIUS_ATTR_INDEX_LIMIT;
+
+        if (i < start)
+                i = start;
+        for (; i < msg->attr_used; i++) {
+                if (radius_get_attr_hdr(msg, i)->type == type)
+                        return i;
+        }
+
+        return -1;
+}
+
+
 struct radius_msg *radius_msg_new(u8 code, u8 identifier)
 {
         struct radius_msg *msg;
@@ -85,7 +109,9 @@ void radius_msg_set_hdr(struct radius_msg *msg, u8 code, u8 identifier)
 
 void radius_msg_free(struct radius_msg *msg)
 {
-        os_free(msg->buf);
+        if (!msg->buf_borrowed)
+                os_free(msg->buf);
+        msg->buf_borrowed = 0;
         msg->buf = NULL;
         msg->hdr = NULL;
         msg->buf_size = msg->buf_used = 0;
@@ -93,6 +119,7 @@ void radius_msg_free(struct radius_msg *msg)
         os_free(msg->attr_pos);
         msg->attr_pos = NULL;
         msg->attr_size = msg->attr_used = 0;
+        os_memset(msg->attr_index, 0, sizeof(msg->attr_index));
 }
 
 
@@ -389,6 +416,10 @@ void radius_msg_finish_acct(struct radius_msg *msg, const u8 *secret,
 static int radius_msg_add_attr_to_array(struct radius_msg *msg,
                                         struct radius_attr_hdr *attr)
 {
+        if (msg->attr_used < RADIUS_ATTR_INDEX_LIMIT &&
+            msg->attr_index[attr->type] == 0)
+                msg->attr_index[attr->type] = msg->attr_used + 1;
+
         if (msg->attr_used >= msg->attr_size) {
                 size_t *nattr_pos;
                 int nlen = msg->attr_size * 2;
@@ -429,7 +460,14 @@ struct radius_attr_hdr *radius_msg_add_attr(struct radius_msg *msg, u8 type,
 
                 while (nlen < buf_needed)
                         nlen *= 2;
-                nbuf = os_realloc(msg->buf, nlen);
+                if (msg->buf_borrowed) {
+                        nbuf = os_malloc(nlen);
+                        if (nbuf == NULL)
+                                return NULL;
+                        os_memcpy(nbuf, msg->buf, msg->buf_size);
+                        msg->buf_borrowed = 0;
+                } else
+                        nbuf = os_realloc(msg->buf, nlen);
                 if (nbuf == NULL)
                         return NULL;
                 msg->buf = nbuf;
@@ -453,68 +491,159 @@ struct radius_attr_hdr *radius_msg_add_attr(struct radius_msg *msg, u8 type,
 }
 
 
-struct radius_msg *radius_msg_parse(const u8 *data, size_t len)
+/* Validate the message header and attributes; returns number of attributes */
+static int radius_msg_check(const u8 *data, size_t len, size_t *msg_len)
 {
-        struct radius_msg *msg;
-        struct radius_hdr *hdr;
-        struct radius_attr_hdr *attr;
-        size_t msg_len;
-        unsigned char *pos, *end;
+        const struct radius_hdr *hdr;
+        const struct radius_attr_hdr *attr;
+        const u8 *pos, *end;
+        int count = 0;
 
         if (data == NULL || len < sizeof(*hdr))
-                return NULL;
+                return -1;
 
-        hdr = (struct radius_hdr *) data;
+        hdr = (const struct radius_hdr *) data;
 
-        msg_len = ntohs(hdr->length);
-        if (msg_len < sizeof(*hdr) || msg_len > len) {
+        *msg_len = ntohs(hdr->length);
+        if (*msg_len < sizeof(*hdr) || *msg_len > len) {
                 printf("Invalid RADIUS message length\n");
-                return NULL;
+                return -1;
         }
 
-        if (msg_len < len) {
+        if (*msg_len < len) {
                 printf("Ignored %lu extra bytes after RADIUS message\n",
-                       (unsigned long) len - msg_len);
+                       (unsigned long) len - *msg_len);
         }
 
-        msg = os_malloc(sizeof(*msg));
+        pos = (const u8 *) (hdr + 1);
+        end = data + *msg_len;
+        while (pos < end) {
+                if ((size_t) (end - pos) < sizeof(*attr))
+                        return -1;
+
+                attr = (const struct radius_attr_hdr *) pos;
+
+                if (pos + attr->length > end || attr->length < sizeof(*attr))
+                        return -1;
+
+                /* TODO: check that attr->length is suitable for attr->type */
+
+                count++;
+                pos += attr->length;
+        }
+
+        return count;
+}
+
+
+static struct radius_msg * radius_msg_parse_buf(u8 *buf, size_t msg_len,
+                                                int count, int borrowed)
+{
+        struct radius_msg *msg;
+        struct radius_attr_hdr *attr;
+        unsigned char *pos, *end;
+
+        msg = os_zalloc(sizeof(*msg));
         if (msg == NULL)
                 return NULL;
 
-        if (radius_msg_initialize(msg, msg_len)) {
+        /* The attribute array is allocated once for all attributes */
+        msg->attr_size = count > 0 ? count : 1;
+        msg->attr_pos = os_malloc(msg->attr_size * sizeof(*msg->attr_pos));
+        if (msg->attr_pos == NULL) {
                 os_free(msg);
                 return NULL;
         }
 
-        os_memcpy(msg->buf, data, msg_len);
+        msg->buf = buf;
+        msg->buf_borrowed = borrowed;
         msg->buf_size = msg->buf_used = msg_len;
+        msg->hdr = (struct radius_hdr *) msg->buf;
 
         /* parse attributes */
         pos = (unsigned char *) (msg->hdr + 1);
         end = msg->buf + msg->buf_used;
         while (pos < end) {
-                if ((size_t) (end - pos) < sizeof(*attr))
-                        goto fail;
-
                 attr = (struct radius_attr_hdr *) pos;
+                radius_msg_add_attr_to_array(msg, attr);
+                pos += attr->length;
+        }
 
-                if (pos + attr->length > end || attr->length < sizeof(*attr))
-                        goto fail;
+        return msg;
+}
 
-                /* TODO: check that attr->length is suitable for attr->type */
 
-                if (radius_msg_add_attr_to_array(msg, attr))
-                        goto fail;
+struct radius_msg *radius_msg_parse(const u8 *data, size_t len)
+{
+        struct radius_msg *msg;
+        size_t msg_len;
+        int count;
+        u8 *buf;
 
-                pos += attr->length;
-        }
+        count = radius_msg_check(data, len, &msg_len);
+        if (count < 0)
+                return NULL;
+
+        buf = os_malloc(msg_len);
+        if (buf == NULL)
+                return NULL;
+        os_memcpy(buf, data, msg_len);
 
+        msg = radius_msg_parse_buf(buf, msg_len, count, 0);
+        if (msg == NULL)
+                os_free(buf);
         return msg;
+}
 
- fail:
-        radius_msg_free(msg);
-        os_free(msg);
-        return NULL;
+
+/**
+ * radius_msg_parse_borrow - Parse a RADIUS message without copying it
+ * @data: Received RADIUS message
+ * @len: Length of data in octets
+ * Returns: Parsed message or %NULL on failure
+ *
+ * The returned message refers to data instead of a copy of it, so data must
+ * not be modified or freed before radius_msg_free() is called for the message
+ * or the message is detached from data with radius_msg_own_buf(). Adding
+ * attributes to the message copies it automatically.
+ */
+struct radius_msg *radius_msg_parse_borrow(u8 *data, size_t len)
+{
+        size_t msg_len;
+        int count;
+
+        count = radius_msg_check(data, len, &msg_len);
+        if (count < 0)
+                return NULL;
+
+        return radius_msg_parse_buf(data, msg_len, count, 1);
+}
+
+
+/**
+ * radius_msg_own_buf - Copy a borrowed message buffer
+ * @msg: RADIUS message from radius_msg_parse_borrow()
+ * Returns: 0 on success, -1 on failure
+ *
+ * This needs to be called before a message from radius_msg_parse_borrow() is
+ * used after the receive buffer has been released.
+ */
+int radius_msg_own_buf(struct radius_msg *msg)
+{
+        u8 *buf;
+
+        if (!msg->buf_borrowed)
+                return 0;
+
+        buf = os_malloc(msg->buf_used);
+        if (buf == NULL)
+                return -1;
+        os_memcpy(buf, msg->buf, msg->buf_used);
+        msg->buf = buf;
+        msg->hdr = (struct radius_hdr *) buf;
+        msg->buf_size = msg->buf_used;
+        msg->buf_borrowed = 0;
+        return 0;
 }
 
 
@@ -546,13 +675,18 @@ u8 *radius_msg_get_eap(struct radius_msg *msg, size_t *eap_len)
 {
         u8 *eap, *pos;
         size_t len, i;
+        int first;
         struct radius_attr_hdr *attr;
 
         if (msg == NULL)
                 return NULL;
 
+        first = radius_msg_find_attr(msg, RADIUS_ATTR_EAP_MESSAGE, 0);
+        if (first < 0)
+                return NULL;
+
         len = 0;
-        for (i = 0; i < msg->attr_used; i++) {
+        for (i = first; i < msg->attr_used; i++) {
                 attr = radius_get_attr_hdr(msg, i);
                 if (attr->type == RADIUS_ATTR_EAP_MESSAGE)
                         len += attr->length - sizeof(struct radius_attr_hdr);
@@ -566,7 +700,7 @@ u8 *radius_msg_get_eap(struct radius_msg *msg, size_t *eap_len)
                 return NULL;
 
         pos = eap;
-        for (i = 0; i < msg->attr_used; i++) {
+        for (i = first; i < msg->attr_used; i++) {
                 attr = radius_get_attr_hdr(msg, i);
                 if (attr->type == RADIUS_ATTR_EAP_MESSAGE) {
                         int flen = attr->length - sizeof(*attr);
@@ -587,23 +721,20 @@ int radius_msg_verify_msg_auth(struct radius_msg *msg, const u8 *secret,
 {
         u8 auth[MD5_MAC_LEN], orig[MD5_MAC_LEN];
         u8 orig_authenticator[16];
-        struct radius_attr_hdr *attr = NULL, *tmp;
-        size_t i;
+        struct radius_attr_hdr *attr;
+        int idx;
 
-        for (i = 0; i < msg->attr_used; i++) {
-                tmp = radius_get_attr_hdr(msg, i);
-                if (tmp->type == RADIUS_ATTR_MESSAGE_AUTHENTICATOR) {
-                        if (attr != NULL) {
-                                printf("Multiple Message-Authenticator "
-                                       "attributes in RADIUS message\n");
-                                return 1;
-                        }
-                        attr = tmp;
-                }
+        idx = radius_msg_find_attr(msg, RADIUS_ATTR_MESSAGE_AUTHENTICATOR, 0);
+        if (idx < 0) {
+                printf("No Message-Authenticator attribute found\n");
+                return 1;
         }
+        attr = radius_get_attr_hdr(msg, idx);
 
-        if (attr == NULL) {
-                printf("No Message-Authenticator attribute found\n");
+        if (radius_msg_find_attr(msg, RADIUS_ATTR_MESSAGE_AUTHENTICATOR,
+                                 idx + 1) >= 0) {
+                printf("Multiple Message-Authenticator attributes in RADIUS "
+                       "message\n");
                 return 1;
         }
 
@@ -672,17 +803,15 @@ int radius_msg_copy_attr(struct radius_msg *dst, struct radius_msg *src,
                          u8 type)
 {
         struct radius_attr_hdr *attr;
-        size_t i;
-        int count = 0;
+        int i, count = 0;
 
-        for (i = 0; i < src->attr_used; i++) {
+        for (i = radius_msg_find_attr(src, type, 0); i >= 0;
+             i = radius_msg_find_attr(src, type, i + 1)) {
                 attr = radius_get_attr_hdr(src, i);
-                if (attr->type == type) {
-                        if (!radius_msg_add_attr(dst, type, (u8 *) (attr + 1),
-                                                 attr->length - sizeof(*attr)))
-                                return -1;
-                        count++;
-                }
+                if (!radius_msg_add_attr(dst, type, (u8 *) (attr + 1),
+                                         attr->length - sizeof(*attr)))
+                        return -1;
+                count++;
         }
 
         return count;
@@ -723,12 +852,16 @@ static u8 *radius_msg_get_vendor_attr(struct radius_msg *msg, u32 vendor,
                                       u8 subtype, size_t *alen)
 {
         u8 *data, *pos;
-        size_t i, len;
+        size_t len;
+        int i;
 
         if (msg == NULL)
                 return NULL;
 
-        for (i = 0; i < msg->attr_used; i++) {
+        for (i = radius_msg_find_attr(msg, RADIUS_ATTR_VENDOR_SPECIFIC, 0);
+             i >= 0;
+             i = radius_msg_find_attr(msg, RADIUS_ATTR_VENDOR_SPECIFIC,
+                                      i + 1)) {
                 struct radius_attr_hdr *attr = radius_get_attr_hdr(msg, i);
                 size_t left;
                 u32 vendor_id;
@@ -1097,19 +1230,14 @@ radius_msg_add_attr_user_password(struct radius_msg *msg,
 
 int radius_msg_get_attr(struct radius_msg *msg, u8 type, u8 *buf, size_t len)
 {
-        struct radius_attr_hdr *attr = NULL, *tmp;
-        size_t i, dlen;
-
-        for (i = 0; i < msg->attr_used; i++) {
-                tmp = radius_get_attr_hdr(msg, i);
-                if (tmp->type == type) {
-                        attr = tmp;
-                        break;
-                }
-        }
+        struct radius_attr_hdr *attr;
+        size_t dlen;
+        int idx;
 
-        if (!attr)
+        idx = radius_msg_find_attr(msg, type, 0);
+        if (idx < 0)
                 return -1;
+        attr = radius_get_attr_hdr(msg, idx);
 
         dlen = attr->length - sizeof(*attr);
         if (buf)
@@ -1121,13 +1249,13 @@ int radius_msg_get_attr(struct radius_msg *msg, u8 type, u8 *buf, size_t len)
 int radius_msg_get_attr_ptr(struct radius_msg *msg, u8 type, u8 **buf,
                             size_t *len, const u8 *start)
 {
-        size_t i;
+        int i;
         struct radius_attr_hdr *attr = NULL, *tmp;
 
-        for (i = 0; i < msg->attr_used; i++) {
+        for (i = radius_msg_find_attr(msg, type, 0); i >= 0;
+             i = radius_msg_find_attr(msg, type, i + 1)) {
                 tmp = radius_get_attr_hdr(msg, i);
-                if (tmp->type == type &&
-                    (start == NULL || (u8 *) tmp > start)) {
+                if (start == NULL || (u8 *) tmp > start) {
                         attr = tmp;
                         break;
                 }
@@ -1144,13 +1272,12 @@ int radius_msg_get_attr_ptr(struct radius_msg *msg, u8 type, u8 **buf,
 
 int radius_msg_count_attr(struct radius_msg *msg, u8 type, int min_len)
 {
-        size_t i;
-        int count;
+        int i, count = 0;
 
-        for (count = 0, i = 0; i < msg->attr_used; i++) {
+        for (i = radius_msg_find_attr(msg, type, 0); i >= 0;
+             i = radius_msg_find_attr(msg, type, i + 1)) {
                 struct radius_attr_hdr *attr = radius_get_attr_hdr(msg, i);
-                if (attr->type == type &&
-                    attr->length >= sizeof(struct radius_attr_hdr) + min_len)
+                if (attr->length >= sizeof(struct radius_attr_hdr) + min_len)
                         count++;
         }
 
@@ -186,6 +186,14 @@ struct radius_msg {
          * struct radius_attr_hdr). */
   size_t attr_size; /* total size of the attribute pointer array */
   size_t attr_used; /* total number of attributes in the array */
+
+  /* attr_index[type] is 1 + index (in attr_pos) of the first attribute of
+   * each type or 0 if the message has no such attribute (within the first
+   * RADIUS_ATTR_INDEX_LIMIT attributes) */
+  u16 attr_index[256];
+
+  int buf_borrowed; /* buf belongs to the caller of
+         * radius_msg_parse_borrow() */
 };
 
 
@@ -195,6 +203,9 @@ struct radius_msg {
 /* Default size to be allocated for attribute array */
 #define RADIUS_DEFAULT_ATTR_COUNT 16
 
+/* Number of attributes that can be included in attr_index */
+#define RADIUS_ATTR_INDEX_LIMIT 0xffff
+
 
 /* MAC address ASCII format for IEEE 802.1X use
  * (draft-congdon-radius-8021x-20.txt) */
@@ -216,6 +227,8 @@ void radius_msg_finish_acct(struct radius_msg *msg, const u8 *secret,
 struct radius_attr_hdr *radius_msg_add_attr(struct radius_msg *msg, u8 type,
               const u8 *data, size_t data_len);
 struct radius_msg *radius_msg_parse(const u8 *data, size_t len);
+struct radius_msg *radius_msg_parse_borrow(u8 *data, size_t len);
+int radius_msg_own_buf(struct radius_msg *msg);
 int radius_msg_add_eap(struct radius_msg *msg, const u8 *data,
            size_t data_len);
 u8 *radius_msg_get_eap(struct radius_msg *msg, size_t *len);
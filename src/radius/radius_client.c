@@ -52,7 +52,7 @@ struct radius_msg_list {
         os_time_t next_try;
         int attempts;
         int next_wait;
-        struct os_time last_attempt;
+        struct os_reltime last_attempt;
 
         u8 *shared_secret;
         size_t shared_secret_len;
@@ -192,7 +192,7 @@ static int radius_client_retransmit(struct radius_client_data *radius,
                        HOSTAPD_LEVEL_DEBUG, "Resending RADIUS message (id=%d)",
                        entry->msg->hdr->identifier);
 
-        os_get_time(&entry->last_attempt);
+        os_get_reltime(&entry->last_attempt);
         if (send(s, entry->msg->buf, entry->msg->buf_used, 0) < 0)
                 radius_client_handle_send_error(radius, s, entry->msg_type);
 
@@ -214,7 +214,7 @@ static void radius_client_timer(void *eloop_ctx, void *timeout_ctx)
 {
         struct radius_client_data *radius = eloop_ctx;
         struct hostapd_radius_servers *conf = radius->conf;
-        struct os_time now;
+        struct os_reltime now;
         os_time_t first;
         struct radius_msg_list *entry, *prev, *tmp;
         int auth_failover = 0, acct_failover = 0;
@@ -224,7 +224,7 @@ static void radius_client_timer(void *eloop_ctx, void *timeout_ctx)
         if (!entry)
                 return;
 
-        os_get_time(&now);
+        os_get_reltime(&now);
         first = 0;
 
         prev = NULL;
@@ -322,7 +322,7 @@ static void radius_client_timer(void *eloop_ctx, void *timeout_ctx)
 
 static void radius_client_update_timeout(struct radius_client_data *radius)
 {
-        struct os_time now;
+        struct os_reltime now;
         os_time_t first;
         struct radius_msg_list *entry;
 
@@ -338,7 +338,7 @@ static void radius_client_update_timeout(struct radius_client_data *radius)
                         first = entry->next_try;
         }
 
-        os_get_time(&now);
+        os_get_reltime(&now);
         if (first < now.sec)
                 first = now.sec;
         eloop_register_timeout(first - now.sec, 0, radius_client_timer, radius,
@@ -378,7 +378,7 @@ static void radius_client_list_add(struct radius_client_data *radius,
         entry->msg_type = msg_type;
         entry->shared_secret = shared_secret;
         entry->shared_secret_len = shared_secret_len;
-        os_get_time(&entry->last_attempt);
+        os_get_reltime(&entry->last_attempt);
         entry->first_try = entry->last_attempt.sec;
         entry->next_try = entry->first_try + RADIUS_CLIENT_FIRST_WAIT;
         entry->attempts = 1;
@@ -510,7 +510,7 @@ static void radius_client_receive(int sock, void *eloop_ctx, void *sock_ctx)
         struct radius_rx_handler *handlers;
         size_t num_handlers, i;
         struct radius_msg_list *req, *prev_req;
-        struct os_time now;
+        struct os_reltime now;
         struct hostapd_radius_server *rconf;
         int invalid_authenticator = 0;
 
@@ -589,7 +589,7 @@ static void radius_client_receive(int sock, void *eloop_ctx, void *sock_ctx)
                 goto fail;
         }
 
-        os_get_time(&now);
+        os_get_reltime(&now);
         roundtrip = (now.sec - req->last_attempt.sec) * 100 +
                 (now.usec - req->last_attempt.usec) / 10000;
         hostapd_logger(radius->ctx, req->addr, HOSTAPD_MODULE_RADIUS,
@@ -12,8 +12,14 @@
  * See README and COPYING for more details.
  */
 
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE /* recvmmsg() and sendmmsg() */
+#endif /* __linux__ && !_GNU_SOURCE */
+
 #include "includes.h"
 #include <net/if.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
 
 #include "common.h"
 #include "radius.h"
@@ -23,8 +29,33 @@
 #include "radius_server.h"
 
 #define RADIUS_SESSION_TIMEOUT 60
+#define RADIUS_SESSION_REMOVE_TIMEOUT 10
 #define RADIUS_MAX_SESSION 100
-#define RADIUS_MAX_MSG_LEN 3000
+#define RADIUS_SESSION_HASH_MIN_SIZE 64
+/* Maximum length of a RADIUS packet (RFC 2865, Section 3) */
+#define RADIUS_MAX_MSG_LEN 4096
+/* Maximum number of datagrams received or sent with one system call */
+#define RADIUS_SERVER_BATCH 32
+
+/*
+ * In worker mode, the worker index is stored in the most significant bits
+ * of the session id so that the dispatcher can find the worker of a session
+ * from the State attribute.
+ */
+#define RADIUS_MAX_WORKERS 64
+#define RADIUS_WORKER_SHIFT 24
+#define RADIUS_WORKER_SESS_MASK ((1U << RADIUS_WORKER_SHIFT) - 1)
+
+/* Minimum time between restarts of a worker process that has exited */
+#define RADIUS_WORKER_RESTART_INTERVAL 1
+
+#if defined(__linux__) && defined(MSG_WAITFORONE)
+#define RADIUS_SERVER_MMSG
+#endif /* __linux__ && MSG_WAITFORONE */
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif /* MSG_NOSIGNAL */
 
 static struct eapol_callbacks radius_server_eapol_cb;
 
@@ -45,7 +76,11 @@ struct radius_server_counters {
 };
 
 struct radius_session {
-        struct radius_session *next;
+        struct radius_session *hnext; /* next in the sess_id hash bucket */
+        struct radius_session *ehnext; /* next in the eap hash bucket */
+        struct radius_session *exp_next, *exp_prev; /* expiration queue */
+        struct os_reltime expire;
+        int completed;
         struct radius_client *client;
         struct radius_server_data *server;
         unsigned int sess_id;
@@ -72,16 +107,123 @@ struct radius_client {
 #endif /* CONFIG_IPV6 */
         char *shared_secret;
         int shared_secret_len;
-        struct radius_session *sessions;
         struct radius_server_counters counters;
 };
 
+/*
+ * Path-compressed binary (Patricia) trie of client prefixes. Each node covers
+ * the first prefix_len bits of key; client is set if a client entry uses
+ * exactly that prefix. IPv4 addresses use the first four bytes of the key.
+ */
+struct radius_client_node {
+        struct radius_client_node *child[2];
+        struct radius_client *client;
+        int prefix_len;
+        u8 key[16];
+};
+
+/*
+ * Clients read from a single client file. The table is replaced as a whole
+ * when the file is reloaded.
+ */
+struct radius_client_table {
+        struct radius_client *clients; /* in client file order */
+        struct radius_client_node *trie;
+        unsigned int num_clients;
+        unsigned int num_nodes;
+};
+
+struct radius_server_pkt {
+        union {
+                struct sockaddr_storage ss;
+                struct sockaddr_in sin;
+#ifdef CONFIG_IPV6
+                struct sockaddr_in6 sin6;
+#endif /* CONFIG_IPV6 */
+        } addr;
+        socklen_t addrlen;
+        size_t len;
+        u8 buf[RADIUS_MAX_MSG_LEN];
+};
+
+/*
+ * Preallocated packet buffers. All datagrams that are queued on the socket
+ * (up to RADIUS_SERVER_BATCH) are received on one eloop wakeup and the
+ * replies to them are queued and sent together once the batch has been
+ * processed.
+ */
+struct radius_server_io {
+        struct radius_server_pkt rx[RADIUS_SERVER_BATCH];
+        struct radius_server_pkt tx[RADIUS_SERVER_BATCH];
+        unsigned int num_tx;
+#ifdef RADIUS_SERVER_MMSG
+        struct mmsghdr rx_msg[RADIUS_SERVER_BATCH];
+        struct mmsghdr tx_msg[RADIUS_SERVER_BATCH];
+        struct iovec rx_iov[RADIUS_SERVER_BATCH];
+        struct iovec tx_iov[RADIUS_SERVER_BATCH];
+        int no_mmsg; /* recvmmsg()/sendmmsg() not supported by the kernel */
+#endif /* RADIUS_SERVER_MMSG */
+        u32 rx_calls;
+        u32 rx_packets;
+        u32 tx_calls;
+        u32 tx_packets;
+        unsigned int rx_max_batch;
+};
+
+/*
+ * Sessions expire a fixed time after they are started (or completed), so a
+ * FIFO queue is in expiration order and a single eloop timeout for the head
+ * of the queues is enough for all sessions.
+ */
+struct radius_session_queue {
+        struct radius_session *head;
+        struct radius_session *tail;
+};
+
+/* Worker process as seen from the dispatcher */
+struct radius_server_worker {
+        pid_t pid;
+        int sock; /* -1 if the worker is not running */
+        struct os_reltime started;
+        u32 dispatched;
+        u32 dropped;
+        u32 restarts;
+};
+
+/* Statistics of a worker process in memory shared with the dispatcher */
+struct radius_server_worker_stats {
+        struct radius_server_counters counters;
+        int num_sess;
+        int peak_sess;
+        unsigned int sess_hash_size;
+        u32 sess_evictions;
+        u32 sess_timeouts;
+        u32 sess_limit_rejects;
+};
+
 struct radius_server_data {
         int auth_sock;
-        struct radius_client *clients;
+        struct radius_server_io *io;
+        int num_workers;
+        struct radius_server_worker *workers; /* dispatcher only */
+        struct radius_server_worker_stats *worker_stats; /* shared */
+        unsigned int next_worker;
+        int worker; /* index of this worker process or -1 */
+        struct radius_client_table *clients;
         unsigned int next_sess_id;
         void *conf_ctx;
         int num_sess;
+        int max_sess;
+        int peak_sess;
+        struct radius_session **sess_hash;
+        struct radius_session **eap_hash; /* sessions by EAP state machine */
+        unsigned int sess_hash_size; /* size of both hash tables */
+        struct radius_session_queue pending; /* authentication in progress */
+        struct radius_session_queue done; /* completed, kept for duplicates */
+        struct os_reltime timer_expire; /* shared timer; sec == 0 if unset */
+        u32 sess_evictions;
+        u32 sess_timeouts;
+        u32 sess_limit_rejects;
         void *eap_sim_db_priv;
         void *ssl_ctx;
         u8 *pac_opaque_encr_key;
@@ -116,44 +258,141 @@ wpa_hexdump(MSG_MSGDUMP, "RADIUS SRV: " args)
 wpa_hexdump_ascii(MSG_MSGDUMP, "RADIUS SRV: " args)
 
 
-static void radius_server_session_timeout(void *eloop_ctx, void *timeout_ctx);
-static void radius_server_session_remove_timeout(void *eloop_ctx,
-                                                 void *timeout_ctx);
+static void radius_server_session_expire(void *eloop_ctx, void *timeout_ctx);
+static void radius_server_free_sessions(struct radius_server_data *data);
+static int radius_server_restart_worker(struct radius_server_data *data,
+                                        struct radius_server_worker *worker);
+static void radius_server_worker_exited(struct radius_server_data *data,
+                                        struct radius_server_worker *worker);
 
 
-static struct radius_client *
-radius_server_get_client(struct radius_server_data *data, struct in_addr *addr,
-                         int ipv6)
+static int radius_client_key_bit(const u8 *key, int bit)
 {
-        struct radius_client *client = data->clients;
+        return (key[bit / 8] >> (7 - bit % 8)) & 1;
+}
 
-        while (client) {
-#ifdef CONFIG_IPV6
-                if (ipv6) {
-                        struct in6_addr *addr6;
-                        int i;
-
-                        addr6 = (struct in6_addr *) addr;
-                        for (i = 0; i < 16; i++) {
-                                if ((addr6->s6_addr[i] &
-                                     client->mask6.s6_addr[i]) !=
-                                    (client->addr6.s6_addr[i] &
-                                     client->mask6.s6_addr[i])) {
-                                        i = 17;
-                                        break;
-                                }
-                        }
-                        if (i == 16) {
-                                break;
-                        }
-                }
-#endif /* CONFIG_IPV6 */
-                if (!ipv6 && (client->addr.s_addr & client->mask.s_addr) ==
-                    (addr->s_addr & client->mask.s_addr)) {
+
+/* Number of leading bits (up to max_len) that are equal in a and b */
+static int radius_client_key_common(const u8 *a, const u8 *b, int max_len)
+{
+        int len = 0;
+        u8 diff;
+
+        while (len + 8 <= max_len && a[len / 8] == b[len / 8])
+                len += 8;
+        if (len >= max_len)
+                return max_len;
+        diff = a[len / 8] ^ b[len / 8];
+        while (len < max_len && !(diff & (0x80 >> (len % 8))))
+                len++;
+        return len;
+}
+
+
+static struct radius_client_node *
+radius_client_node_alloc(struct radius_client_table *table, const u8 *key,
+                         int prefix_len)
+{
+        struct radius_client_node *node;
+        int bytes = prefix_len / 8;
+
+        node = os_zalloc(sizeof(*node));
+        if (node == NULL)
+                return NULL;
+        node->prefix_len = prefix_len;
+        os_memcpy(node->key, key, bytes);
+        if (prefix_len % 8)
+                node->key[bytes] = key[bytes] & (0xff << (8 - prefix_len % 8));
+        table->num_nodes++;
+        return node;
+}
+
+
+static int radius_client_trie_add(struct radius_client_table *table,
+                                  const u8 *key, int prefix_len,
+                                  struct radius_client *client)
+{
+        struct radius_client_node **pos = &table->trie, *node, *split, *leaf;
+        int common;
+
+        while ((node = *pos) != NULL) {
+                common = radius_client_key_common(
+                        key, node->key, prefix_len < node->prefix_len ?
+                        prefix_len : node->prefix_len);
+                if (common < node->prefix_len)
                         break;
+                if (prefix_len == node->prefix_len) {
+                        /* The first entry for a duplicate prefix is used */
+                        if (node->client == NULL)
+                                node->client = client;
+                        return 0;
                 }
+                pos = &node->child[radius_client_key_bit(key,
+                                                         node->prefix_len)];
+        }
 
-                client = client->next;
+        if (node == NULL) {
+                leaf = radius_client_node_alloc(table, key, prefix_len);
+                if (leaf == NULL)
+                        return -1;
+                leaf->client = client;
+                *pos = leaf;
+                return 0;
+        }
+
+        /* Split the node at the first differing bit */
+        split = radius_client_node_alloc(table, key, common);
+        if (split == NULL)
+                return -1;
+        split->child[radius_client_key_bit(node->key, common)] = node;
+        if (common == prefix_len) {
+                split->client = client;
+        } else {
+                leaf = radius_client_node_alloc(table, key, prefix_len);
+                if (leaf == NULL) {
+                        os_free(split);
+                        return -1;
+                }
+                leaf->client = client;
+                split->child[radius_client_key_bit(key, common)] = leaf;
+        }
+        *pos = split;
+        return 0;
+}
+
+
+static void radius_client_trie_free(struct radius_client_node *node)
+{
+        if (node == NULL)
+                return;
+        radius_client_trie_free(node->child[0]);
+        radius_client_trie_free(node->child[1]);
+        os_free(node);
+}
+
+
+static struct radius_client *
+radius_server_get_client(struct radius_client_table *table,
+                         struct in_addr *addr, int ipv6)
+{
+        struct radius_client_node *node = table->trie;
+        struct radius_client *client = NULL;
+        const u8 *key = (const u8 *) addr;
+        int key_len = ipv6 ? 128 : 32;
+
+        /* The deepest matching node with a client is the most specific
+         * client prefix for the address. */
+        while (node) {
+                if (radius_client_key_common(key, node->key,
+                                             node->prefix_len) <
+                    node->prefix_len)
+                        break;
+                if (node->client)
+                        client = node->client;
+                if (node->prefix_len >= key_len)
+                        break;
+                node = node->child[radius_client_key_bit(key,
+                                                         node->prefix_len)];
         }
 
         return client;
@@ -161,26 +400,139 @@ radius_server_get_client(struct radius_server_data *data, struct in_addr *addr,
 
 
 static struct radius_session *
-radius_server_get_session(struct radius_client *client, unsigned int sess_id)
+radius_server_get_session(struct radius_server_data *data,
+                          struct radius_client *client, unsigned int sess_id)
 {
-        struct radius_session *sess = client->sessions;
+        struct radius_session *sess;
+
+        if (data->sess_hash == NULL)
+                return NULL;
 
+        sess = data->sess_hash[sess_id & (data->sess_hash_size - 1)];
         while (sess) {
-                if (sess->sess_id == sess_id) {
+                if (sess->sess_id == sess_id)
                         break;
-                }
-                sess = sess->next;
+                sess = sess->hnext;
         }
 
+        if (sess && sess->client != client)
+                return NULL;
         return sess;
 }
 
 
+static unsigned int radius_server_eap_hash(const struct eap_sm *eap,
+                                           unsigned int size)
+{
+        unsigned long val = (unsigned long) eap >> 4;
+
+        return (val ^ (val >> 10) ^ (val >> 20)) & (size - 1);
+}
+
+
+static int radius_server_sess_hash_resize(struct radius_server_data *data,
+                                          unsigned int size)
+{
+        struct radius_session **nhash, **nehash, **bucket, *sess, *next;
+        unsigned int i;
+
+        nhash = os_zalloc(size * sizeof(struct radius_session *));
+        nehash = os_zalloc(size * sizeof(struct radius_session *));
+        if (nhash == NULL || nehash == NULL) {
+                os_free(nhash);
+                os_free(nehash);
+                return -1;
+        }
+        for (i = 0; i < data->sess_hash_size; i++) {
+                for (sess = data->sess_hash[i]; sess; sess = next) {
+                        next = sess->hnext;
+                        bucket = &nhash[sess->sess_id & (size - 1)];
+                        sess->hnext = *bucket;
+                        *bucket = sess;
+                }
+                for (sess = data->eap_hash[i]; sess; sess = next) {
+                        next = sess->ehnext;
+                        bucket = &nehash[radius_server_eap_hash(sess->eap,
+                                                                size)];
+                        sess->ehnext = *bucket;
+                        *bucket = sess;
+                }
+        }
+        os_free(data->sess_hash);
+        os_free(data->eap_hash);
+        data->sess_hash = nhash;
+        data->eap_hash = nehash;
+        data->sess_hash_size = size;
+        return 0;
+}
+
+
+static void radius_server_queue_add(struct radius_session_queue *queue,
+                                    struct radius_session *sess)
+{
+        sess->exp_next = NULL;
+        sess->exp_prev = queue->tail;
+        if (queue->tail)
+                queue->tail->exp_next = sess;
+        else
+                queue->head = sess;
+        queue->tail = sess;
+}
+
+
+static void radius_server_queue_del(struct radius_session_queue *queue,
+                                    struct radius_session *sess)
+{
+        if (sess->exp_prev)
+                sess->exp_prev->exp_next = sess->exp_next;
+        else
+                queue->head = sess->exp_next;
+        if (sess->exp_next)
+                sess->exp_next->exp_prev = sess->exp_prev;
+        else
+                queue->tail = sess->exp_prev;
+        sess->exp_next = sess->exp_prev = NULL;
+}
+
+
+static void radius_server_session_timer(struct radius_server_data *data,
+                                        struct os_reltime *expire)
+{
+        struct os_reltime now, diff;
+
+        /* The timer is only moved earlier; a late timer is re-armed when it
+         * fires. */
+        if (data->timer_expire.sec &&
+            !os_reltime_before(expire, &data->timer_expire))
+                return;
+
+        eloop_cancel_timeout(radius_server_session_expire, data, NULL);
+        data->timer_expire = *expire;
+        os_get_reltime(&now);
+        if (os_reltime_before(&now, expire))
+                os_reltime_sub(expire, &now, &diff);
+        else
+                diff.sec = diff.usec = 0;
+        eloop_register_timeout(diff.sec, diff.usec,
+                               radius_server_session_expire, data, NULL);
+}
+
+
+static void radius_server_session_enqueue(struct radius_server_data *data,
+                                          struct radius_session_queue *queue,
+                                          struct radius_session *sess,
+                                          int timeout)
+{
+        os_get_reltime(&sess->expire);
+        sess->expire.sec += timeout;
+        radius_server_queue_add(queue, sess);
+        radius_server_session_timer(data, &sess->expire);
+}
+
+
 static void radius_server_session_free(struct radius_server_data *data,
                                        struct radius_session *sess)
 {
-        eloop_cancel_timeout(radius_server_session_timeout, data, sess);
-        eloop_cancel_timeout(radius_server_session_remove_timeout, data, sess);
         eap_server_sm_deinit(sess->eap);
         if (sess->last_msg) {
                 radius_msg_free(sess->last_msg);
@@ -192,53 +544,111 @@ static void radius_server_session_free(struct radius_server_data *data,
                 os_free(sess->last_reply);
         }
         os_free(sess);
-        data->num_sess--;
 }
 
 
 static void radius_server_session_remove(struct radius_server_data *data,
                                          struct radius_session *sess)
 {
-        struct radius_client *client = sess->client;
-        struct radius_session *session, *prev;
-
-        eloop_cancel_timeout(radius_server_session_remove_timeout, data, sess);
-
-        prev = NULL;
-        session = client->sessions;
-        while (session) {
-                if (session == sess) {
-                        if (prev == NULL) {
-                                client->sessions = sess->next;
-                        } else {
-                                prev->next = sess->next;
-                        }
-                        radius_server_session_free(data, sess);
-                        break;
-                }
-                prev = session;
-                session = session->next;
+        struct radius_session **pos;
+
+        pos = &data->sess_hash[sess->sess_id & (data->sess_hash_size - 1)];
+        while (*pos && *pos != sess)
+                pos = &(*pos)->hnext;
+        if (*pos)
+                *pos = sess->hnext;
+
+        if (sess->eap) {
+                pos = &data->eap_hash[radius_server_eap_hash(
+                                sess->eap, data->sess_hash_size)];
+                while (*pos && *pos != sess)
+                        pos = &(*pos)->ehnext;
+                if (*pos)
+                        *pos = sess->ehnext;
         }
+
+        radius_server_queue_del(sess->completed ? &data->done :
+                                &data->pending, sess);
+        data->num_sess--;
+        radius_server_session_free(data, sess);
 }
 
 
-static void radius_server_session_remove_timeout(void *eloop_ctx,
-                                                 void *timeout_ctx)
+static void radius_server_add_counters(struct radius_server_counters *sum,
+                                       const struct radius_server_counters *c)
 {
-        struct radius_server_data *data = eloop_ctx;
-        struct radius_session *sess = timeout_ctx;
-        RADIUS_DEBUG("Removing completed session 0x%x", sess->sess_id);
-        radius_server_session_remove(data, sess);
+        sum->access_requests += c->access_requests;
+        sum->invalid_requests += c->invalid_requests;
+        sum->dup_access_requests += c->dup_access_requests;
+        sum->access_accepts += c->access_accepts;
+        sum->access_rejects += c->access_rejects;
+        sum->access_challenges += c->access_challenges;
+        sum->malformed_access_requests += c->malformed_access_requests;
+        sum->bad_authenticators += c->bad_authenticators;
+        sum->packets_dropped += c->packets_dropped;
+        sum->unknown_types += c->unknown_types;
 }
 
 
-static void radius_server_session_timeout(void *eloop_ctx, void *timeout_ctx)
+/* Copy the statistics of a worker process to the dispatcher */
+static void radius_server_worker_publish(struct radius_server_data *data)
+{
+        struct radius_server_worker_stats *stats;
+
+        if (data->worker < 0)
+                return;
+        stats = &data->worker_stats[data->worker];
+        stats->counters = data->counters;
+        stats->num_sess = data->num_sess;
+        stats->peak_sess = data->peak_sess;
+        stats->sess_hash_size = data->sess_hash_size;
+        stats->sess_evictions = data->sess_evictions;
+        stats->sess_timeouts = data->sess_timeouts;
+        stats->sess_limit_rejects = data->sess_limit_rejects;
+}
+
+
+static void radius_server_session_expire(void *eloop_ctx, void *timeout_ctx)
 {
         struct radius_server_data *data = eloop_ctx;
-        struct radius_session *sess = timeout_ctx;
+        struct radius_session *sess;
+        struct os_reltime now;
 
-        RADIUS_DEBUG("Timing out authentication session 0x%x", sess->sess_id);
-        radius_server_session_remove(data, sess);
+        data->timer_expire.sec = 0;
+        os_get_reltime(&now);
+
+        while ((sess = data->done.head) &&
+               !os_reltime_before(&now, &sess->expire)) {
+                RADIUS_DEBUG("Removing completed session 0x%x", sess->sess_id);
+                radius_server_session_remove(data, sess);
+        }
+
+        while ((sess = data->pending.head) &&
+               !os_reltime_before(&now, &sess->expire)) {
+                RADIUS_DEBUG("Timing out authentication session 0x%x",
+                             sess->sess_id);
+                data->sess_timeouts++;
+                radius_server_session_remove(data, sess);
+        }
+
+        if (data->done.head)
+                radius_server_session_timer(data, &data->done.head->expire);
+        if (data->pending.head)
+                radius_server_session_timer(data,
+                                            &data->pending.head->expire);
+        radius_server_worker_publish(data);
+}
+
+
+/* Move a session to the queue of completed sessions */
+static void radius_server_session_done(struct radius_server_data *data,
+                                       struct radius_session *sess)
+{
+        radius_server_queue_del(sess->completed ? &data->done :
+                                &data->pending, sess);
+        sess->completed = 1;
+        radius_server_session_enqueue(data, &data->done, sess,
+                                      RADIUS_SESSION_REMOVE_TIMEOUT);
 }
 
 
@@ -246,14 +656,29 @@ static struct radius_session *
 radius_server_new_session(struct radius_server_data *data,
                           struct radius_client *client)
 {
-        struct radius_session *sess;
+        struct radius_session *sess, **bucket;
+
+        if (data->num_sess >= data->max_sess && data->done.head) {
+                /* Completed sessions are only kept to reply to duplicates */
+                RADIUS_DEBUG("Session table full - evicting completed "
+                             "session 0x%x", data->done.head->sess_id);
+                data->sess_evictions++;
+                radius_server_session_remove(data, data->done.head);
+        }
 
-        if (data->num_sess >= RADIUS_MAX_SESSION) {
+        if (data->num_sess >= data->max_sess) {
                 RADIUS_DEBUG("Maximum number of existing session - no room "
                              "for a new session");
+                data->sess_limit_rejects++;
                 return NULL;
         }
 
+        if ((unsigned int) data->num_sess >= data->sess_hash_size &&
+            radius_server_sess_hash_resize(data, data->sess_hash_size ?
+                                           data->sess_hash_size * 2 :
+                                           RADIUS_SESSION_HASH_MIN_SIZE) < 0)
+                return NULL;
+
         sess = os_zalloc(sizeof(*sess));
         if (sess == NULL)
                 return NULL;
@@ -261,11 +686,17 @@ radius_server_new_session(struct radius_server_data *data,
         sess->server = data;
         sess->client = client;
         sess->sess_id = data->next_sess_id++;
-        sess->next = client->sessions;
-        client->sessions = sess;
-        eloop_register_timeout(RADIUS_SESSION_TIMEOUT, 0,
-                               radius_server_session_timeout, data, sess);
+        if (data->worker >= 0)
+                sess->sess_id = (sess->sess_id & RADIUS_WORKER_SESS_MASK) |
+                        (data->worker << RADIUS_WORKER_SHIFT);
+        bucket = &data->sess_hash[sess->sess_id & (data->sess_hash_size - 1)];
+        sess->hnext = *bucket;
+        *bucket = sess;
+        radius_server_session_enqueue(data, &data->pending, sess,
+                                      RADIUS_SESSION_TIMEOUT);
         data->num_sess++;
+        if (data->num_sess > data->peak_sess)
+                data->peak_sess = data->num_sess;
         return sess;
 }
 
@@ -278,7 +709,7 @@ radius_server_get_new_session(struct radius_server_data *data,
         u8 *user;
         size_t user_len;
         int res;
-        struct radius_session *sess;
+        struct radius_session *sess, **bucket;
         struct eap_config eap_conf;
 
         RADIUS_DEBUG("Creating a new session");
@@ -331,9 +762,13 @@ radius_server_get_new_session(struct radius_server_data *data,
         if (sess->eap == NULL) {
                 RADIUS_DEBUG("Failed to initialize EAP state machine for the "
                              "new session");
-                radius_server_session_free(data, sess);
+                radius_server_session_remove(data, sess);
                 return NULL;
         }
+        bucket = &data->eap_hash[radius_server_eap_hash(
+                        sess->eap, data->sess_hash_size)];
+        sess->ehnext = *bucket;
+        *bucket = sess;
         sess->eap_if = eap_get_interface(sess->eap);
         sess->eap_if->eapRestart = TRUE;
         sess->eap_if->portEnabled = TRUE;
@@ -418,6 +853,80 @@ radius_server_encapsulate_eap(struct radius_server_data *data,
 }
 
 
+static void radius_server_flush(struct radius_server_data *data)
+{
+        struct radius_server_io *io = data->io;
+        struct radius_server_pkt *pkt;
+        unsigned int i = 0;
+        int res;
+
+#ifdef RADIUS_SERVER_MMSG
+        while (!io->no_mmsg && i < io->num_tx) {
+                res = sendmmsg(data->auth_sock, &io->tx_msg[i],
+                               io->num_tx - i, 0);
+                if (res < 0 && errno == ENOSYS) {
+                        io->no_mmsg = 1;
+                        break;
+                }
+                io->tx_calls++;
+                if (res <= 0) {
+                        /* Drop the datagram that could not be sent */
+                        perror("sendmmsg[RADIUS SRV]");
+                        i++;
+                        continue;
+                }
+                io->tx_packets += res;
+                i += res;
+        }
+#endif /* RADIUS_SERVER_MMSG */
+
+        for (; i < io->num_tx; i++) {
+                pkt = &io->tx[i];
+                io->tx_calls++;
+                if (sendto(data->auth_sock, pkt->buf, pkt->len, 0,
+                           (struct sockaddr *) &pkt->addr, pkt->addrlen) < 0)
+                        perror("sendto[RADIUS SRV]");
+                else
+                        io->tx_packets++;
+        }
+
+        io->num_tx = 0;
+}
+
+
+/* Queue a datagram to be sent with the next radius_server_flush() */
+static int radius_server_send(struct radius_server_data *data,
+                              struct radius_msg *msg,
+                              struct sockaddr *to, socklen_t tolen)
+{
+        struct radius_server_io *io = data->io;
+        struct radius_server_pkt *pkt;
+
+        if (msg->buf_used > RADIUS_MAX_MSG_LEN ||
+            tolen > sizeof(pkt->addr)) {
+                RADIUS_DEBUG("Too long reply (%lu bytes) - not sent",
+                             (unsigned long) msg->buf_used);
+                return -1;
+        }
+
+        if (io->num_tx == RADIUS_SERVER_BATCH)
+                radius_server_flush(data);
+
+        pkt = &io->tx[io->num_tx];
+        os_memcpy(pkt->buf, msg->buf, msg->buf_used);
+        pkt->len = msg->buf_used;
+        os_memcpy(&pkt->addr, to, tolen);
+        pkt->addrlen = tolen;
+#ifdef RADIUS_SERVER_MMSG
+        io->tx_iov[io->num_tx].iov_len = pkt->len;
+        io->tx_msg[io->num_tx].msg_hdr.msg_namelen = tolen;
+#endif /* RADIUS_SERVER_MMSG */
+        io->num_tx++;
+
+        return 0;
+}
+
+
 static int radius_server_reject(struct radius_server_data *data,
                                 struct radius_client *client,
                                 struct radius_msg *request,
@@ -465,11 +974,8 @@ static int radius_server_reject(struct radius_server_data *data,
 
         data->counters.access_rejects++;
         client->counters.access_rejects++;
-        if (sendto(data->auth_sock, msg->buf, msg->buf_used, 0,
-                   (struct sockaddr *) from, sizeof(*from)) < 0) {
-                perror("sendto[RADIUS SRV]");
+        if (radius_server_send(data, msg, from, fromlen) < 0)
                 ret = -1;
-        }
 
         radius_msg_free(msg);
         os_free(msg);
@@ -502,7 +1008,7 @@ static int radius_server_request(struct radius_server_data *data,
                 state_included = res >= 0;
                 if (res == sizeof(statebuf)) {
                         state = WPA_GET_BE32(statebuf);
-                        sess = radius_server_get_session(client, state);
+                        sess = radius_server_get_session(data, client, state);
                 } else {
                         sess = NULL;
                 }
@@ -523,6 +1029,9 @@ static int radius_server_request(struct radius_server_data *data,
                                              from_addr, from_port);
                         return -1;
                 }
+                /* NAS address for finding the client after a reload */
+                os_memcpy(&sess->last_from, from, fromlen);
+                sess->last_fromlen = fromlen;
         }
 
         if (sess->last_from_port == from_port &&
@@ -534,12 +1043,8 @@ static int radius_server_request(struct radius_server_data *data,
                 client->counters.dup_access_requests++;
 
                 if (sess->last_reply) {
-                        res = sendto(data->auth_sock, sess->last_reply->buf,
-                                     sess->last_reply->buf_used, 0,
-                                     (struct sockaddr *) from, fromlen);
-                        if (res < 0) {
-                                perror("sendto[RADIUS SRV]");
-                        }
+                        radius_server_send(data, sess->last_reply, from,
+                                           fromlen);
                         return 0;
                 }
 
@@ -583,6 +1088,10 @@ static int radius_server_request(struct radius_server_data *data,
                 RADIUS_DEBUG("No EAP data from the state machine, but eapFail "
                              "set");
         } else if (eap_sm_method_pending(sess->eap)) {
+                /* The message is processed again after the receive buffer
+                 * has been reused */
+                if (radius_msg_own_buf(msg) < 0)
+                        return -1;
                 if (sess->last_msg) {
                         radius_msg_free(sess->last_msg);
                         os_free(sess->last_msg);
@@ -628,11 +1137,7 @@ static int radius_server_request(struct radius_server_data *data,
                         client->counters.access_challenges++;
                         break;
                 }
-                res = sendto(data->auth_sock, reply->buf, reply->buf_used, 0,
-                             (struct sockaddr *) from, fromlen);
-                if (res < 0) {
-                        perror("sendto[RADIUS SRV]");
-                }
+                radius_server_send(data, reply, from, fromlen);
                 if (sess->last_reply) {
                         radius_msg_free(sess->last_reply);
                         os_free(sess->last_reply);
@@ -650,71 +1155,48 @@ static int radius_server_request(struct radius_server_data *data,
         if (is_complete) {
                 RADIUS_DEBUG("Removing completed session 0x%x after timeout",
                              sess->sess_id);
-                eloop_cancel_timeout(radius_server_session_remove_timeout,
-                                     data, sess);
-                eloop_register_timeout(10, 0,
-                                       radius_server_session_remove_timeout,
-                                       data, sess);
+                radius_server_session_done(data, sess);
         }
 
         return 0;
 }
 
 
-static void radius_server_receive_auth(int sock, void *eloop_ctx,
-                                       void *sock_ctx)
+static void radius_server_handle_packet(struct radius_server_data *data,
+                                        struct radius_server_pkt *pkt)
 {
-        struct radius_server_data *data = eloop_ctx;
-        u8 *buf = NULL;
-        union {
-                struct sockaddr_storage ss;
-                struct sockaddr_in sin;
-#ifdef CONFIG_IPV6
-                struct sockaddr_in6 sin6;
-#endif /* CONFIG_IPV6 */
-        } from;
-        socklen_t fromlen;
-        int len;
+        u8 *buf = pkt->buf;
+        size_t len = pkt->len;
         struct radius_client *client = NULL;
         struct radius_msg *msg = NULL;
         char abuf[50];
         int from_port = 0;
 
-        buf = os_malloc(RADIUS_MAX_MSG_LEN);
-        if (buf == NULL) {
-                goto fail;
-        }
-
-        fromlen = sizeof(from);
-        len = recvfrom(sock, buf, RADIUS_MAX_MSG_LEN, 0,
-                       (struct sockaddr *) &from.ss, &fromlen);
-        if (len < 0) {
-                perror("recvfrom[radius_server]");
-                goto fail;
-        }
-
 #ifdef CONFIG_IPV6
         if (data->ipv6) {
-                if (inet_ntop(AF_INET6, &from.sin6.sin6_addr, abuf,
+                if (inet_ntop(AF_INET6, &pkt->addr.sin6.sin6_addr, abuf,
                               sizeof(abuf)) == NULL)
                         abuf[0] = '\0';
-                from_port = ntohs(from.sin6.sin6_port);
-                RADIUS_DEBUG("Received %d bytes from %s:%d",
-                             len, abuf, from_port);
+                from_port = ntohs(pkt->addr.sin6.sin6_port);
+                RADIUS_DEBUG("Received %lu bytes from %s:%d",
+                             (unsigned long) len, abuf, from_port);
 
-                client = radius_server_get_client(data,
+                client = radius_server_get_client(data->clients,
                                                   (struct in_addr *)
-                                                  &from.sin6.sin6_addr, 1);
+                                                  &pkt->addr.sin6.sin6_addr,
+                                                  1);
         }
 #endif /* CONFIG_IPV6 */
 
         if (!data->ipv6) {
-                os_strlcpy(abuf, inet_ntoa(from.sin.sin_addr), sizeof(abuf));
-                from_port = ntohs(from.sin.sin_port);
-                RADIUS_DEBUG("Received %d bytes from %s:%d",
-                             len, abuf, from_port);
-
-                client = radius_server_get_client(data, &from.sin.sin_addr, 0);
+                os_strlcpy(abuf, inet_ntoa(pkt->addr.sin.sin_addr),
+                           sizeof(abuf));
+                from_port = ntohs(pkt->addr.sin.sin_port);
+                RADIUS_DEBUG("Received %lu bytes from %s:%d",
+                             (unsigned long) len, abuf, from_port);
+
+                client = radius_server_get_client(data->clients,
+                                                  &pkt->addr.sin.sin_addr, 0);
         }
 
         RADIUS_DUMP("Received data", buf, len);
@@ -725,7 +1207,8 @@ static void radius_server_receive_auth(int sock, void *eloop_ctx,
                 goto fail;
         }
 
-        msg = radius_msg_parse(buf, len);
+        /* The receive buffer stays valid until the packet is handled */
+        msg = radius_msg_parse_borrow(buf, len);
         if (msg == NULL) {
                 RADIUS_DEBUG("Parsing incoming RADIUS frame failed");
                 data->counters.malformed_access_requests++;
@@ -733,9 +1216,6 @@ static void radius_server_receive_auth(int sock, void *eloop_ctx,
                 goto fail;
         }
 
-        os_free(buf);
-        buf = NULL;
-
         if (wpa_debug_level <= MSG_MSGDUMP) {
                 radius_msg_dump(msg);
         }
@@ -758,9 +1238,9 @@ static void radius_server_receive_auth(int sock, void *eloop_ctx,
                 goto fail;
         }
 
-        if (radius_server_request(data, msg, (struct sockaddr *) &from,
-                                  fromlen, client, abuf, from_port, NULL) ==
-            -2)
+        if (radius_server_request(data, msg, (struct sockaddr *) &pkt->addr,
+                                  pkt->addrlen, client, abuf, from_port,
+                                  NULL) == -2)
                 return; /* msg was stored with the session */
 
 fail:
@@ -768,7 +1248,501 @@ fail:
                 radius_msg_free(msg);
                 os_free(msg);
         }
-        os_free(buf);
+}
+
+
+/* Receive the queued datagrams into io->rx; returns the number received */
+static int radius_server_recv(struct radius_server_data *data, int sock)
+{
+        struct radius_server_io *io = data->io;
+        struct radius_server_pkt *pkt;
+        int len;
+
+#ifdef RADIUS_SERVER_MMSG
+        if (!io->no_mmsg) {
+                int i, num;
+
+                for (i = 0; i < RADIUS_SERVER_BATCH; i++)
+                        io->rx_msg[i].msg_hdr.msg_namelen =
+                                sizeof(io->rx[i].addr);
+                num = recvmmsg(sock, io->rx_msg, RADIUS_SERVER_BATCH,
+                               MSG_DONTWAIT, NULL);
+                if (num >= 0 || errno != ENOSYS) {
+                        io->rx_calls++;
+                        if (num < 0) {
+                                perror("recvmmsg[radius_server]");
+                                return -1;
+                        }
+                        for (i = 0; i < num; i++) {
+                                io->rx[i].len = io->rx_msg[i].msg_len;
+                                io->rx[i].addrlen =
+                                        io->rx_msg[i].msg_hdr.msg_namelen;
+                        }
+                        return num;
+                }
+                io->no_mmsg = 1;
+        }
+#endif /* RADIUS_SERVER_MMSG */
+
+        pkt = &io->rx[0];
+        pkt->addrlen = sizeof(pkt->addr);
+        io->rx_calls++;
+        len = recvfrom(sock, pkt->buf, RADIUS_MAX_MSG_LEN, 0,
+                       (struct sockaddr *) &pkt->addr.ss, &pkt->addrlen);
+        if (len < 0) {
+                perror("recvfrom[radius_server]");
+                return -1;
+        }
+        pkt->len = len;
+        return 1;
+}
+
+
+/* Find the session id from the State attribute without parsing the message */
+static int radius_server_pkt_state(struct radius_server_pkt *pkt, u32 *state)
+{
+        struct radius_hdr *hdr = (struct radius_hdr *) pkt->buf;
+        const u8 *pos, *end;
+
+        if (pkt->len < sizeof(*hdr) || ntohs(hdr->length) > pkt->len)
+                return -1;
+
+        pos = (const u8 *) (hdr + 1);
+        end = pkt->buf + ntohs(hdr->length);
+        while (end - pos >= 2) {
+                if (pos[1] < 2 || pos[1] > end - pos)
+                        return -1;
+                if (pos[0] == RADIUS_ATTR_STATE && pos[1] == 2 + 4) {
+                        *state = WPA_GET_BE32(pos + 2);
+                        return 0;
+                }
+                pos += pos[1];
+        }
+
+        return -1;
+}
+
+
+/* Pass a received datagram to the worker that owns its session */
+static void radius_server_dispatch(struct radius_server_data *data,
+                                   struct radius_server_pkt *pkt)
+{
+        struct radius_server_worker *worker = NULL;
+        struct iovec iov[3];
+        struct msghdr msg;
+        u32 state;
+        int i;
+
+        if (radius_server_pkt_state(pkt, &state) == 0) {
+                worker = &data->workers[(state >> RADIUS_WORKER_SHIFT) %
+                                        data->num_workers];
+                /* The sessions of an exited worker are lost; a restarted
+                 * worker rejects the request */
+                if (worker->sock < 0 &&
+                    radius_server_restart_worker(data, worker) < 0)
+                        worker = NULL;
+        } else {
+                /* New sessions skip workers that cannot be restarted yet */
+                for (i = 0; i < data->num_workers; i++) {
+                        worker = &data->workers[data->next_worker++ %
+                                                data->num_workers];
+                        if (worker->sock >= 0 ||
+                            radius_server_restart_worker(data, worker) == 0)
+                                break;
+                        worker = NULL;
+                }
+        }
+        if (worker == NULL) {
+                data->counters.packets_dropped++;
+                return;
+        }
+
+        iov[0].iov_base = &pkt->addr;
+        iov[0].iov_len = sizeof(pkt->addr);
+        iov[1].iov_base = &pkt->addrlen;
+        iov[1].iov_len = sizeof(pkt->addrlen);
+        iov[2].iov_base = pkt->buf;
+        iov[2].iov_len = pkt->len;
+        os_memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = iov;
+        msg.msg_iovlen = 3;
+
+        /* A busy worker drops requests like a full socket buffer would; the
+         * NAS retransmits them. */
+        if (sendmsg(worker->sock, &msg, MSG_DONTWAIT | MSG_NOSIGNAL) < 0) {
+                if (errno == EPIPE || errno == ECONNRESET)
+                        radius_server_worker_exited(data, worker);
+                else if (errno != EAGAIN && errno != EWOULDBLOCK)
+                        perror("sendmsg[RADIUS SRV worker]");
+                worker->dropped++;
+                data->counters.packets_dropped++;
+                return;
+        }
+        worker->dispatched++;
+}
+
+
+static void radius_server_receive_auth(int sock, void *eloop_ctx,
+                                       void *sock_ctx)
+{
+        struct radius_server_data *data = eloop_ctx;
+        int i, num;
+
+        num = radius_server_recv(data, sock);
+        if (num <= 0)
+                return;
+
+        data->io->rx_packets += num;
+        if ((unsigned int) num > data->io->rx_max_batch)
+                data->io->rx_max_batch = num;
+
+        for (i = 0; i < num; i++) {
+                if (data->workers)
+                        radius_server_dispatch(data, &data->io->rx[i]);
+                else
+                        radius_server_handle_packet(data, &data->io->rx[i]);
+        }
+
+        radius_server_flush(data);
+}
+
+
+static void radius_server_receive_worker(int sock, void *eloop_ctx,
+                                         void *sock_ctx)
+{
+        struct radius_server_data *data = eloop_ctx;
+        struct radius_server_pkt *pkt;
+        struct iovec iov[3];
+        struct msghdr msg;
+        ssize_t res;
+        int i, num;
+
+        for (num = 0; num < RADIUS_SERVER_BATCH; num++) {
+                pkt = &data->io->rx[num];
+                iov[0].iov_base = &pkt->addr;
+                iov[0].iov_len = sizeof(pkt->addr);
+                iov[1].iov_base = &pkt->addrlen;
+                iov[1].iov_len = sizeof(pkt->addrlen);
+                iov[2].iov_base = pkt->buf;
+                iov[2].iov_len = RADIUS_MAX_MSG_LEN;
+                os_memset(&msg, 0, sizeof(msg));
+                msg.msg_iov = iov;
+                msg.msg_iovlen = 3;
+
+                res = recvmsg(sock, &msg, MSG_DONTWAIT);
+                if (res == 0 && num == 0) {
+                        /* Dispatcher has exited */
+                        eloop_terminate();
+                        return;
+                }
+                if (res < (ssize_t) (iov[0].iov_len + iov[1].iov_len))
+                        break;
+                pkt->len = res - iov[0].iov_len - iov[1].iov_len;
+                if (pkt->addrlen == 0) {
+                        /* Client file reload forwarded by the dispatcher */
+                        if (pkt->len > 0) {
+                                pkt->buf[pkt->len - 1] = '\0';
+                                radius_server_reload_clients(
+                                        data, (char *) pkt->buf);
+                        }
+                        num--;
+                }
+        }
+
+        data->io->rx_calls++;
+        data->io->rx_packets += num;
+        if ((unsigned int) num > data->io->rx_max_batch)
+                data->io->rx_max_batch = num;
+
+        /* Replies are sent directly on the shared RADIUS socket */
+        for (i = 0; i < num; i++)
+                radius_server_handle_packet(data, &data->io->rx[i]);
+        radius_server_flush(data);
+
+        radius_server_worker_publish(data);
+}
+
+
+/* Ask the workers to re-read the client file after the dispatcher did */
+static void radius_server_reload_workers(struct radius_server_data *data,
+                                         const char *client_file)
+{
+        struct radius_server_pkt *pkt = &data->io->rx[0];
+        struct iovec iov[3];
+        struct msghdr msg;
+        int i;
+
+        /* A datagram without an address is a reload request */
+        os_memset(&pkt->addr, 0, sizeof(pkt->addr));
+        pkt->addrlen = 0;
+        iov[0].iov_base = &pkt->addr;
+        iov[0].iov_len = sizeof(pkt->addr);
+        iov[1].iov_base = &pkt->addrlen;
+        iov[1].iov_len = sizeof(pkt->addrlen);
+        iov[2].iov_base = (char *) client_file;
+        iov[2].iov_len = os_strlen(client_file) + 1;
+        os_memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = iov;
+        msg.msg_iovlen = 3;
+
+        if (iov[2].iov_len > RADIUS_MAX_MSG_LEN) {
+                RADIUS_ERROR("Client file name too long for the workers");
+                return;
+        }
+
+        /* Unlike requests, this is not dropped if the worker is busy. An
+         * exited worker reads the new file when it is restarted. */
+        for (i = 0; i < data->num_workers; i++) {
+                if (data->workers[i].sock < 0)
+                        continue;
+                if (sendmsg(data->workers[i].sock, &msg, MSG_NOSIGNAL) == 0)
+                        continue;
+                if (errno == EPIPE || errno == ECONNRESET)
+                        radius_server_worker_exited(data, &data->workers[i]);
+                else
+                        perror("sendmsg[RADIUS SRV worker reload]");
+        }
+}
+
+
+static void radius_server_worker_terminate(int sig, void *eloop_ctx,
+                                           void *signal_ctx)
+{
+        eloop_terminate();
+}
+
+
+/*
+ * Worker process main loop. The event loop copied from the parent belongs
+ * to the parent process, so the worker closes the sockets registered in it
+ * (except the shared RADIUS socket) and starts with an empty one that only
+ * handles its own dispatcher socket and session timers.
+ */
+static void radius_server_worker_run(struct radius_server_data *data,
+                                     int sock)
+{
+        int i;
+
+        if (eloop_fork_cleanup(data->auth_sock) < 0) {
+                /* Drop the parent's timeouts and close at least the sockets
+                 * of the other workers so that their exit is noticed */
+                for (i = 0; i < data->num_workers; i++) {
+                        if (i != data->worker && data->workers[i].sock >= 0)
+                                close(data->workers[i].sock);
+                }
+                eloop_destroy();
+        }
+        os_free(data->workers);
+        data->workers = NULL;
+        eloop_init(NULL);
+        eloop_register_signal_terminate(radius_server_worker_terminate, data);
+        if (eloop_register_read_sock(sock, radius_server_receive_worker,
+                                     data, NULL) == 0) {
+                RADIUS_DEBUG("Worker %d started (pid %d)", data->worker,
+                             (int) getpid());
+                eloop_run();
+                eloop_unregister_read_sock(sock);
+        }
+        radius_server_free_sessions(data);
+        eloop_destroy();
+        _exit(0);
+}
+
+
+static void radius_server_receive_worker_exit(int sock, void *eloop_ctx,
+                                              void *sock_ctx)
+{
+        struct radius_server_data *data = eloop_ctx;
+        struct radius_server_worker *worker = sock_ctx;
+
+        radius_server_worker_exited(data, worker);
+        radius_server_restart_worker(data, worker);
+}
+
+
+/* Start the worker process for a worker slot */
+static int radius_server_spawn_worker(struct radius_server_data *data,
+                                      struct radius_server_worker *worker)
+{
+        int sv[2];
+        pid_t pid;
+
+        if (socketpair(AF_UNIX, SOCK_SEQPACKET, 0, sv) < 0) {
+                perror("socketpair[RADIUS SRV]");
+                return -1;
+        }
+
+        os_get_reltime(&worker->started);
+        pid = fork();
+        if (pid < 0) {
+                perror("fork[RADIUS SRV]");
+                close(sv[0]);
+                close(sv[1]);
+                return -1;
+        }
+
+        if (pid == 0) {
+                /* The sockets of the other workers are closed by
+                 * radius_server_worker_run() */
+                close(sv[0]);
+                data->worker = worker - data->workers;
+                data->next_sess_id = 0;
+                os_memset(&data->counters, 0, sizeof(data->counters));
+                data->peak_sess = 0;
+                data->sess_evictions = 0;
+                data->sess_timeouts = 0;
+                data->sess_limit_rejects = 0;
+                radius_server_worker_run(data, sv[1]);
+        }
+
+        close(sv[1]);
+        worker->sock = sv[0];
+        worker->pid = pid;
+        /* The worker never writes to the socket; it is readable only when
+         * the worker has exited */
+        if (eloop_register_read_sock(worker->sock,
+                                     radius_server_receive_worker_exit,
+                                     data, worker) < 0) {
+                radius_server_worker_exited(data, worker);
+                return -1;
+        }
+        return 0;
+}
+
+
+/* Restart an exited worker unless it was started very recently */
+static int radius_server_restart_worker(struct radius_server_data *data,
+                                        struct radius_server_worker *worker)
+{
+        struct os_reltime now, age;
+
+        os_get_reltime(&now);
+        os_reltime_sub(&now, &worker->started, &age);
+        if (age.sec < RADIUS_WORKER_RESTART_INTERVAL)
+                return -1;
+        if (radius_server_spawn_worker(data, worker) < 0)
+                return -1;
+        worker->restarts++;
+        RADIUS_DEBUG("Worker %d restarted (pid %d)",
+                     (int) (worker - data->workers), (int) worker->pid);
+        return 0;
+}
+
+
+/*
+ * Reap a worker process that has exited. Its sessions are lost, but its
+ * statistics are kept in the dispatcher's counters.
+ */
+static void radius_server_worker_exited(struct radius_server_data *data,
+                                        struct radius_server_worker *worker)
+{
+        struct radius_server_worker_stats *stats;
+        int idx = worker - data->workers;
+
+        eloop_unregister_read_sock(worker->sock);
+        close(worker->sock);
+        worker->sock = -1;
+        if (worker->pid > 0)
+                waitpid(worker->pid, NULL, 0);
+        RADIUS_ERROR("Worker %d (pid %d) exited", idx, (int) worker->pid);
+        worker->pid = 0;
+
+        stats = &data->worker_stats[idx];
+        radius_server_add_counters(&data->counters, &stats->counters);
+        if (stats->peak_sess > data->peak_sess)
+                data->peak_sess = stats->peak_sess;
+        data->sess_evictions += stats->sess_evictions;
+        data->sess_timeouts += stats->sess_timeouts;
+        data->sess_limit_rejects += stats->sess_limit_rejects;
+        os_memset(stats, 0, sizeof(*stats));
+}
+
+
+static int radius_server_start_workers(struct radius_server_data *data,
+                                       int num_workers)
+{
+        int i;
+
+        data->workers = os_zalloc(num_workers * sizeof(*data->workers));
+        if (data->workers == NULL)
+                return -1;
+        for (i = 0; i < num_workers; i++)
+                data->workers[i].sock = -1;
+        data->num_workers = num_workers;
+
+        data->worker_stats = mmap(NULL, num_workers *
+                                  sizeof(struct radius_server_worker_stats),
+                                  PROT_READ | PROT_WRITE,
+                                  MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+        if (data->worker_stats == MAP_FAILED) {
+                perror("mmap[RADIUS SRV]");
+                data->worker_stats = NULL;
+                return -1;
+        }
+
+        for (i = 0; i < num_workers; i++) {
+                if (radius_server_spawn_worker(data, &data->workers[i]) < 0)
+                        return -1;
+        }
+
+        return 0;
+}
+
+
+static void radius_server_stop_workers(struct radius_server_data *data)
+{
+        struct radius_server_worker *worker;
+        int i;
+
+        for (i = 0; i < data->num_workers; i++) {
+                worker = &data->workers[i];
+                if (worker->sock < 0)
+                        continue;
+                eloop_unregister_read_sock(worker->sock);
+                close(worker->sock);
+                kill(worker->pid, SIGTERM);
+        }
+        for (i = 0; i < data->num_workers; i++) {
+                if (data->workers[i].sock >= 0)
+                        waitpid(data->workers[i].pid, NULL, 0);
+        }
+        os_free(data->workers);
+        data->workers = NULL;
+        if (data->worker_stats)
+                munmap(data->worker_stats, data->num_workers *
+                       sizeof(struct radius_server_worker_stats));
+        data->worker_stats = NULL;
+        data->num_workers = 0;
+}
+
+
+static struct radius_server_io * radius_server_io_init(void)
+{
+        struct radius_server_io *io;
+#ifdef RADIUS_SERVER_MMSG
+        int i;
+#endif /* RADIUS_SERVER_MMSG */
+
+        io = os_zalloc(sizeof(*io));
+        if (io == NULL)
+                return NULL;
+
+#ifdef RADIUS_SERVER_MMSG
+        for (i = 0; i < RADIUS_SERVER_BATCH; i++) {
+                io->rx_iov[i].iov_base = io->rx[i].buf;
+                io->rx_iov[i].iov_len = RADIUS_MAX_MSG_LEN;
+                io->rx_msg[i].msg_hdr.msg_name = &io->rx[i].addr;
+                io->rx_msg[i].msg_hdr.msg_iov = &io->rx_iov[i];
+                io->rx_msg[i].msg_hdr.msg_iovlen = 1;
+
+                io->tx_iov[i].iov_base = io->tx[i].buf;
+                io->tx_msg[i].msg_hdr.msg_name = &io->tx[i].addr;
+                io->tx_msg[i].msg_hdr.msg_iov = &io->tx_iov[i];
+                io->tx_msg[i].msg_hdr.msg_iovlen = 1;
+        }
+#endif /* RADIUS_SERVER_MMSG */
+
+        return io;
 }
 
 
@@ -841,44 +1815,50 @@ static int radius_server_open_socket6(int port)
 #endif /* CONFIG_IPV6 */
 
 
-static void radius_server_free_sessions(struct radius_server_data *data,
-                                        struct radius_session *sessions)
+static void radius_server_free_sessions(struct radius_server_data *data)
 {
-        struct radius_session *session, *prev;
-
-        session = sessions;
-        while (session) {
-                prev = session;
-                session = session->next;
-                radius_server_session_free(data, prev);
-        }
+        while (data->pending.head)
+                radius_server_session_remove(data, data->pending.head);
+        while (data->done.head)
+                radius_server_session_remove(data, data->done.head);
+        eloop_cancel_timeout(radius_server_session_expire, data, NULL);
+        data->timer_expire.sec = 0;
+        os_free(data->sess_hash);
+        data->sess_hash = NULL;
+        os_free(data->eap_hash);
+        data->eap_hash = NULL;
+        data->sess_hash_size = 0;
 }
 
 
-static void radius_server_free_clients(struct radius_server_data *data,
-                                       struct radius_client *clients)
+static void radius_server_free_clients(struct radius_client_table *table)
 {
         struct radius_client *client, *prev;
 
-        client = clients;
+        if (table == NULL)
+                return;
+
+        client = table->clients;
         while (client) {
                 prev = client;
                 client = client->next;
 
-                radius_server_free_sessions(data, prev->sessions);
                 os_free(prev->shared_secret);
                 os_free(prev);
         }
+        radius_client_trie_free(table->trie);
+        os_free(table);
 }
 
 
-static struct radius_client *
+static struct radius_client_table *
 radius_server_read_clients(const char *client_file, int ipv6)
 {
         FILE *f;
         const int buf_size = 1024;
         char *buf, *pos;
-        struct radius_client *clients, *tail, *entry;
+        struct radius_client_table *table;
+        struct radius_client *tail, *entry;
         int line = 0, mask, failed = 0, i;
         struct in_addr addr;
 #ifdef CONFIG_IPV6
@@ -893,12 +1873,15 @@ radius_server_read_clients(const char *client_file, int ipv6)
         }
 
         buf = os_malloc(buf_size);
-        if (buf == NULL) {
+        table = os_zalloc(sizeof(*table));
+        if (buf == NULL || table == NULL) {
+                os_free(buf);
+                os_free(table);
                 fclose(f);
                 return NULL;
         }
 
-        clients = tail = NULL;
+        tail = NULL;
         while (fgets(buf, buf_size, f)) {
                 /* Configuration file format:
                  * 192.168.1.0/24 secret
@@ -1006,23 +1989,114 @@ radius_server_read_clients(const char *client_file, int ipv6)
 #endif /* CONFIG_IPV6 */
 
                 if (tail == NULL) {
-                        clients = tail = entry;
+                        table->clients = tail = entry;
                 } else {
                         tail->next = entry;
                         tail = entry;
                 }
+                table->num_clients++;
+
+#ifdef CONFIG_IPV6
+                if (ipv6 &&
+                    radius_client_trie_add(table, entry->addr6.s6_addr, mask,
+                                           entry) < 0) {
+                        failed = 1;
+                        break;
+                }
+#endif /* CONFIG_IPV6 */
+                if (!ipv6 &&
+                    radius_client_trie_add(table, (u8 *) &entry->addr.s_addr,
+                                           mask, entry) < 0) {
+                        failed = 1;
+                        break;
+                }
         }
 
         if (failed) {
                 RADIUS_ERROR("Invalid line %d in '%s'", line, client_file);
-                radius_server_free_clients(NULL, clients);
-                clients = NULL;
+                radius_server_free_clients(table);
+                table = NULL;
+        } else if (table->clients == NULL) {
+                radius_server_free_clients(table);
+                table = NULL;
         }
 
         os_free(buf);
         fclose(f);
 
-        return clients;
+        return table;
+}
+
+
+/*
+ * Move the sessions in a queue to the clients in a new client table. A session
+ * uses the client that now matches the address of its NAS, so that requests
+ * from the NAS still find the session. Sessions of NASes that are no longer
+ * clients are removed.
+ */
+static void radius_server_move_sessions(struct radius_server_data *data,
+                                        struct radius_client_table *table,
+                                        struct radius_session_queue *queue)
+{
+        struct radius_session *sess, *next;
+        struct radius_client *client;
+        struct in_addr *addr = NULL;
+
+        for (sess = queue->head; sess; sess = next) {
+                next = sess->exp_next;
+#ifdef CONFIG_IPV6
+                if (data->ipv6)
+                        addr = (struct in_addr *)
+                                &((struct sockaddr_in6 *)
+                                  &sess->last_from)->sin6_addr;
+#endif /* CONFIG_IPV6 */
+                if (!data->ipv6)
+                        addr = &((struct sockaddr_in *)
+                                 &sess->last_from)->sin_addr;
+                client = radius_server_get_client(table, addr, data->ipv6);
+                if (client == NULL) {
+                        RADIUS_DEBUG("Client removed - removing session 0x%x",
+                                     sess->sess_id);
+                        radius_server_session_remove(data, sess);
+                        continue;
+                }
+                sess->client = client;
+        }
+}
+
+
+/**
+ * radius_server_reload_clients - Re-read the RADIUS client file
+ * @data: RADIUS server data from radius_server_init()
+ * @client_file: Client file to read
+ * Returns: 0 on success, -1 on failure
+ *
+ * The new client table is built completely before it replaces the current
+ * one, so the current clients remain in use if the file cannot be read.
+ * Existing sessions are moved to the new client entries, so authentications
+ * in progress continue unless their NAS was removed from the file. In worker
+ * mode, the workers are asked to reload the file, too.
+ */
+int radius_server_reload_clients(struct radius_server_data *data,
+                                 const char *client_file)
+{
+        struct radius_client_table *table, *old;
+
+        table = radius_server_read_clients(client_file, data->ipv6);
+        if (table == NULL)
+                return -1;
+
+        radius_server_move_sessions(data, table, &data->pending);
+        radius_server_move_sessions(data, table, &data->done);
+        old = data->clients;
+        data->clients = table;
+        radius_server_free_clients(old);
+
+        RADIUS_DEBUG("Reloaded %u clients from '%s' (%u trie nodes)",
+                     table->num_clients, client_file, table->num_nodes);
+        if (data->workers)
+                radius_server_reload_workers(data, client_file);
+        return 0;
 }
 
 
@@ -1039,9 +2113,20 @@ radius_server_init(struct radius_server_conf *conf)
         }
 #endif /* CONFIG_IPV6 */
 
+        if (conf->num_workers > RADIUS_MAX_WORKERS ||
+            (conf->num_workers > 0 &&
+             (conf->eap_sim_db_priv || conf->wps))) {
+                fprintf(stderr, "Invalid number of RADIUS server workers "
+                        "(max %d; not supported with EAP-SIM/AKA database "
+                        "or WPS).\n", RADIUS_MAX_WORKERS);
+                return NULL;
+        }
+
         data = os_zalloc(sizeof(*data));
         if (data == NULL)
                 return NULL;
+        data->auth_sock = -1;
+        data->worker = -1;
 
         os_get_time(&data->start_time);
         data->conf_ctx = conf->conf_ctx;
@@ -1070,6 +2155,8 @@ radius_server_init(struct radius_server_conf *conf)
         data->eap_sim_aka_result_ind = conf->eap_sim_aka_result_ind;
         data->tnc = conf->tnc;
         data->wps = conf->wps;
+        data->max_sess = conf->max_sessions > 0 ? conf->max_sessions :
+                RADIUS_MAX_SESSION;
         if (conf->eap_req_id_text) {
                 data->eap_req_id_text = os_malloc(conf->eap_req_id_text_len);
                 if (data->eap_req_id_text) {
@@ -1079,6 +2166,12 @@ radius_server_init(struct radius_server_conf *conf)
                 }
         }
 
+        data->io = radius_server_io_init();
+        if (data->io == NULL) {
+                radius_server_deinit(data);
+                return NULL;
+        }
+
         data->clients = radius_server_read_clients(conf->client_file,
                                                    conf->ipv6);
         if (data->clients == NULL) {
@@ -1106,6 +2199,13 @@ radius_server_init(struct radius_server_conf *conf)
                 return NULL;
         }
 
+        if (conf->num_workers > 0 &&
+            radius_server_start_workers(data, conf->num_workers) < 0) {
+                printf("Failed to start RADIUS server worker processes\n");
+                radius_server_deinit(data);
+                return NULL;
+        }
+
         return data;
 }
 
@@ -1115,12 +2215,17 @@ void radius_server_deinit(struct radius_server_data *data)
         if (data == NULL)
                 return;
 
+        if (data->workers)
+                radius_server_stop_workers(data);
+
         if (data->auth_sock >= 0) {
                 eloop_unregister_read_sock(data->auth_sock);
                 close(data->auth_sock);
         }
 
-        radius_server_free_clients(data, data->clients);
+        radius_server_free_sessions(data);
+        radius_server_free_clients(data->clients);
+        os_free(data->io);
 
         os_free(data->pac_opaque_encr_key);
         os_free(data->eap_fast_a_id);
@@ -1138,6 +2243,11 @@ int radius_server_get_mib(struct radius_server_data *data, char *buf,
         char *end, *pos;
         struct os_time now;
         struct radius_client *cli;
+        struct radius_server_counters total;
+        struct radius_server_worker_stats *stats;
+        int num_sess, peak_sess;
+        unsigned int hash_size;
+        u32 evictions, timeouts, limit_rejects;
 
         /* RFC 2619 - RADIUS Authentication Server MIB */
 
@@ -1163,6 +2273,26 @@ int radius_server_get_mib(struct radius_server_data *data, char *buf,
         }
         pos += ret;
 
+        /* In worker mode, the requests and sessions are counted by the
+         * workers and the dispatcher keeps the totals of exited workers */
+        total = data->counters;
+        num_sess = data->num_sess;
+        peak_sess = data->peak_sess;
+        hash_size = data->sess_hash_size;
+        evictions = data->sess_evictions;
+        timeouts = data->sess_timeouts;
+        limit_rejects = data->sess_limit_rejects;
+        for (idx = 0; idx < (unsigned int) data->num_workers; idx++) {
+                stats = &data->worker_stats[idx];
+                radius_server_add_counters(&total, &stats->counters);
+                num_sess += stats->num_sess;
+                peak_sess += stats->peak_sess;
+                hash_size += stats->sess_hash_size;
+                evictions += stats->sess_evictions;
+                timeouts += stats->sess_timeouts;
+                limit_rejects += stats->sess_limit_rejects;
+        }
+
         ret = os_snprintf(pos, end - pos,
                           "radiusAuthServTotalAccessRequests=%u\n"
                           "radiusAuthServTotalInvalidRequests=%u\n"
@@ -1174,23 +2304,85 @@ int radius_server_get_mib(struct radius_server_data *data, char *buf,
                           "radiusAuthServTotalBadAuthenticators=%u\n"
                           "radiusAuthServTotalPacketsDropped=%u\n"
                           "radiusAuthServTotalUnknownTypes=%u\n",
-                          data->counters.access_requests,
-                          data->counters.invalid_requests,
-                          data->counters.dup_access_requests,
-                          data->counters.access_accepts,
-                          data->counters.access_rejects,
-                          data->counters.access_challenges,
-                          data->counters.malformed_access_requests,
-                          data->counters.bad_authenticators,
-                          data->counters.packets_dropped,
-                          data->counters.unknown_types);
+                          total.access_requests,
+                          total.invalid_requests,
+                          total.dup_access_requests,
+                          total.access_accepts,
+                          total.access_rejects,
+                          total.access_challenges,
+                          total.malformed_access_requests,
+                          total.bad_authenticators,
+                          total.packets_dropped,
+                          total.unknown_types);
+        if (ret < 0 || ret >= end - pos) {
+                *pos = '\0';
+                return pos - buf;
+        }
+        pos += ret;
+
+        ret = os_snprintf(pos, end - pos,
+                          "radiusAuthServSessions=%d\n"
+                          "radiusAuthServMaxSessions=%d\n"
+                          "radiusAuthServPeakSessions=%d\n"
+                          "radiusAuthServSessionHashSize=%u\n"
+                          "radiusAuthServSessionEvictions=%u\n"
+                          "radiusAuthServSessionTimeouts=%u\n"
+                          "radiusAuthServSessionLimitRejects=%u\n",
+                          num_sess, data->max_sess, peak_sess, hash_size,
+                          evictions, timeouts, limit_rejects);
+        if (ret < 0 || ret >= end - pos) {
+                *pos = '\0';
+                return pos - buf;
+        }
+        pos += ret;
+
+        ret = os_snprintf(pos, end - pos,
+                          "radiusAuthServRecvCalls=%u\n"
+                          "radiusAuthServRecvPackets=%u\n"
+                          "radiusAuthServRecvMaxBatch=%u\n"
+                          "radiusAuthServSendCalls=%u\n"
+                          "radiusAuthServSendPackets=%u\n",
+                          data->io->rx_calls, data->io->rx_packets,
+                          data->io->rx_max_batch, data->io->tx_calls,
+                          data->io->tx_packets);
+        if (ret < 0 || ret >= end - pos) {
+                *pos = '\0';
+                return pos - buf;
+        }
+        pos += ret;
+
+        for (idx = 0; idx < (unsigned int) data->num_workers; idx++) {
+                ret = os_snprintf(pos, end - pos,
+                                  "radiusAuthServWorkerIndex=%u\n"
+                                  "radiusAuthServWorkerPid=%d\n"
+                                  "radiusAuthServWorkerRunning=%d\n"
+                                  "radiusAuthServWorkerRestarts=%u\n"
+                                  "radiusAuthServWorkerDispatched=%u\n"
+                                  "radiusAuthServWorkerDropped=%u\n",
+                                  idx, (int) data->workers[idx].pid,
+                                  data->workers[idx].sock >= 0,
+                                  data->workers[idx].restarts,
+                                  data->workers[idx].dispatched,
+                                  data->workers[idx].dropped);
+                if (ret < 0 || ret >= end - pos) {
+                        *pos = '\0';
+                        return pos - buf;
+                }
+                pos += ret;
+        }
+
+        /* The workers have their own copies of the client table */
+        ret = os_snprintf(pos, end - pos,
+                          "radiusAuthServClientCountersTracked=%d\n",
+                          data->workers == NULL);
         if (ret < 0 || ret >= end - pos) {
                 *pos = '\0';
                 return pos - buf;
         }
         pos += ret;
 
-        for (cli = data->clients, idx = 0; cli; cli = cli->next, idx++) {
+        for (cli = data->clients->clients, idx = 0; cli;
+             cli = cli->next, idx++) {
                 char abuf[50], mbuf[50];
 #ifdef CONFIG_IPV6
                 if (data->ipv6) {
@@ -1209,7 +2401,17 @@ int radius_server_get_mib(struct radius_server_data *data, char *buf,
 
                 ret = os_snprintf(pos, end - pos,
                                   "radiusAuthClientIndex=%u\n"
-                                  "radiusAuthClientAddress=%s/%s\n"
+                                  "radiusAuthClientAddress=%s/%s\n",
+                                  idx, abuf, mbuf);
+                if (ret < 0 || ret >= end - pos) {
+                        *pos = '\0';
+                        return pos - buf;
+                }
+                pos += ret;
+                if (data->workers)
+                        continue;
+
+                ret = os_snprintf(pos, end - pos,
                                   "radiusAuthServAccessRequests=%u\n"
                                   "radiusAuthServDupAccessRequests=%u\n"
                                   "radiusAuthServAccessAccepts=%u\n"
@@ -1219,8 +2421,6 @@ int radius_server_get_mib(struct radius_server_data *data, char *buf,
                                   "radiusAuthServBadAuthenticators=%u\n"
                                   "radiusAuthServPacketsDropped=%u\n"
                                   "radiusAuthServUnknownTypes=%u\n",
-                                  idx,
-                                  abuf, mbuf,
                                   cli->counters.access_requests,
                                   cli->counters.dup_access_requests,
                                   cli->counters.access_accepts,
@@ -1271,27 +2471,21 @@ static struct eapol_callbacks radius_server_eapol_cb =
 
 void radius_server_eap_pending_cb(struct radius_server_data *data, void *ctx)
 {
-        struct radius_client *cli;
-        struct radius_session *s, *sess = NULL;
+        struct radius_session *sess;
         struct radius_msg *msg;
+        int res;
 
-        if (data == NULL)
+        if (data == NULL || data->eap_hash == NULL)
                 return;
 
-        for (cli = data->clients; cli; cli = cli->next) {
-                for (s = cli->sessions; s; s = s->next) {
-                        if (s->eap == ctx && s->last_msg) {
-                                sess = s;
-                                break;
-                        }
-                        if (sess)
-                                break;
-                }
-                if (sess)
-                        break;
-        }
+        /* ctx is the EAP state machine of the session; it may already have
+         * been freed, so it is only used as a key. */
+        sess = data->eap_hash[radius_server_eap_hash(ctx,
+                                                     data->sess_hash_size)];
+        while (sess && sess->eap != ctx)
+                sess = sess->ehnext;
 
-        if (sess == NULL) {
+        if (sess == NULL || sess->last_msg == NULL) {
                 RADIUS_DEBUG("No session matched callback ctx");
                 return;
         }
@@ -1299,11 +2493,13 @@ void radius_server_eap_pending_cb(struct radius_server_data *data, void *ctx)
         msg = sess->last_msg;
         sess->last_msg = NULL;
         eap_sm_pending_cb(sess->eap);
-        if (radius_server_request(data, msg,
-                                  (struct sockaddr *) &sess->last_from,
-                                  sess->last_fromlen, cli,
-                                  sess->last_from_addr,
-                                  sess->last_from_port, sess) == -2)
+        res = radius_server_request(data, msg,
+                                    (struct sockaddr *) &sess->last_from,
+                                    sess->last_fromlen, sess->client,
+                                    sess->last_from_addr,
+                                    sess->last_from_port, sess);
+        radius_server_flush(data);
+        if (res == -2)
                 return; /* msg was stored with the session */
 
         radius_msg_free(msg);
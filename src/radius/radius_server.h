@@ -39,6 +39,28 @@ struct radius_server_conf {
           int phase2, struct eap_user *user);
   const char *eap_req_id_text;
   size_t eap_req_id_text_len;
+
+  /**
+   * max_sessions - Maximum number of concurrent sessions (0 = default)
+   *
+   * When the limit is reached, the oldest completed session (kept only to
+   * reply to retransmitted requests) is evicted to make room for a new
+   * one. If all sessions are still in progress, new sessions are rejected.
+   */
+  int max_sessions;
+
+  /**
+   * num_workers - Number of worker processes (0 = no workers)
+   *
+   * With workers, the calling process only receives the requests and
+   * passes them to the worker processes, which run the EAP sessions and
+   * send the replies. Each worker has its own event loop and copy of the
+   * TLS context, so a slow handshake only delays the sessions of its own
+   * worker. Sessions are assigned to workers by the State attribute.
+   * Session limits and counters apply per worker. Workers cannot be used
+   * with eap_sim_db_priv or wps, which depend on the parent process.
+   */
+  int num_workers;
 };
 
 
@@ -49,6 +71,9 @@ radius_server_init(struct radius_server_conf *conf);
 
 void radius_server_deinit(struct radius_server_data *data);
 
+int radius_server_reload_clients(struct radius_server_data *data,
+                                 const char *client_file);
+
 int radius_server_get_mib(struct radius_server_data *data, char *buf,
         size_t buflen);
 
@@ -66,6 +91,13 @@ static inline void radius_server_deinit(struct radius_server_data *data)
 {
 }
 
+static inline int
+radius_server_reload_clients(struct radius_server_data *data,
+                             const char *client_file)
+{
+  return -1;
+}
+
 static inline int radius_server_get_mib(struct radius_server_data *data,
           char *buf, size_t buflen)
 {
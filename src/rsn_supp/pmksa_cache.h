@@ -23,11 +23,11 @@ struct rsn_pmksa_cache_entry {
   u8 pmkid[PMKID_LEN];
   u8 pmk[PMK_LEN];
   size_t pmk_len;
-  os_time_t expiration;
+  os_time_t expiration; /* os_get_reltime() seconds */
   int akmp; /* WPA_KEY_MGMT_* */
   u8 aa[ETH_ALEN];
 
-  os_time_t reauth_time;
+  os_time_t reauth_time; /* os_get_reltime() seconds */
 
   /**
    * network_ctx - Network configuration context
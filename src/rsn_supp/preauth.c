@@ -423,23 +423,18 @@ void pmksa_candidate_add(struct wpa_sm *sm, const u8 *bssid,
 /* TODO: schedule periodic scans if current AP supports preauth */
 
 /**
- * rsn_preauth_scan_results - Process scan results to find PMKSA candidates
+ * rsn_preauth_scan_results - Start processing scan results for candidates
  * @sm: Pointer to WPA state machine data from wpa_sm_init()
- * @results: Scan results
+ * Returns: 0 if ready to process results or -1 to skip processing
  *
- * This functions goes through the scan results and adds all suitable APs
- * (Authenticators) into PMKSA candidate list.
+ * This function is used to notify RSN code about start of new scan results
+ * processing. The actual scan results will be provided by calling
+ * rsn_preauth_scan_result() for each BSS if this function returned 0.
  */
-void rsn_preauth_scan_results(struct wpa_sm *sm,
-                              struct wpa_scan_results *results)
+int rsn_preauth_scan_results(struct wpa_sm *sm)
 {
-        struct wpa_scan_res *r;
-        struct wpa_ie_data ie;
-        int i;
-        struct rsn_pmksa_cache_entry *pmksa;
-
         if (sm->ssid_len == 0)
-                return;
+                return -1;
 
         /*
          * TODO: is it ok to free all candidates? What about the entries
@@ -447,37 +442,47 @@ void rsn_preauth_scan_results(struct wpa_sm *sm,
          */
         pmksa_candidate_free(sm);
 
-        for (i = results->num - 1; i >= 0; i--) {
-                const u8 *ssid, *rsn;
+        return 0;
+}
 
-                r = results->res[i];
 
-                ssid = wpa_scan_get_ie(r, WLAN_EID_SSID);
-                if (ssid == NULL || ssid[1] != sm->ssid_len ||
-                    os_memcmp(ssid + 2, sm->ssid, ssid[1]) != 0)
-                        continue;
+/**
+ * rsn_preauth_scan_result - Process a scan result for PMKSA candidates
+ * @sm: Pointer to WPA state machine data from wpa_sm_init()
+ * @bssid: BSSID of the AP
+ * @ssid: SSID of the AP
+ * @ssid_len: Length of the SSID
+ * @rsn: Parsed RSN IE of the AP
+ *
+ * This function adds the AP into PMKSA candidate list if it is suitable for
+ * pre-authentication. Scan results are expected to be provided in reverse
+ * order of preference.
+ */
+void rsn_preauth_scan_result(struct wpa_sm *sm, const u8 *bssid,
+                             const u8 *ssid, size_t ssid_len,
+                             const struct wpa_ie_data *rsn)
+{
+        struct rsn_pmksa_cache_entry *pmksa;
 
-                if (os_memcmp(r->bssid, sm->bssid, ETH_ALEN) == 0)
-                        continue;
+        if (ssid_len != sm->ssid_len ||
+            os_memcmp(ssid, sm->ssid, ssid_len) != 0)
+                return;
 
-                rsn = wpa_scan_get_ie(r, WLAN_EID_RSN);
-                if (rsn == NULL || wpa_parse_wpa_ie(rsn, 2 + rsn[1], &ie))
-                        continue;
+        if (os_memcmp(bssid, sm->bssid, ETH_ALEN) == 0)
+                return;
 
-                pmksa = pmksa_cache_get(sm->pmksa, r->bssid, NULL);
-                if (pmksa &&
-                    (!pmksa->opportunistic ||
-                     !(ie.capabilities & WPA_CAPABILITY_PREAUTH)))
-                        continue;
+        pmksa = pmksa_cache_get(sm->pmksa, bssid, NULL);
+        if (pmksa &&
+            (!pmksa->opportunistic ||
+             !(rsn->capabilities & WPA_CAPABILITY_PREAUTH)))
+                return;
 
-                /*
-                 * Give less priority to candidates found from normal
-                 * scan results.
-                 */
-                pmksa_candidate_add(sm, r->bssid,
-                                    PMKID_CANDIDATE_PRIO_SCAN,
-                                    ie.capabilities & WPA_CAPABILITY_PREAUTH);
-        }
+        /*
+         * Give less priority to candidates found from normal
+         * scan results.
+         */
+        pmksa_candidate_add(sm, bssid, PMKID_CANDIDATE_PRIO_SCAN,
+                            rsn->capabilities & WPA_CAPABILITY_PREAUTH);
 }
 
 
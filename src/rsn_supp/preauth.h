@@ -15,7 +15,7 @@
 #ifndef PREAUTH_H
 #define PREAUTH_H
 
-struct wpa_scan_results;
+struct wpa_ie_data;
 
 #if defined(IEEE8021X_EAPOL) && !defined(CONFIG_NO_WPA2)
 
@@ -23,8 +23,10 @@ void pmksa_candidate_free(struct wpa_sm *sm);
 int rsn_preauth_init(struct wpa_sm *sm, const u8 *dst,
          struct eap_peer_config *eap_conf);
 void rsn_preauth_deinit(struct wpa_sm *sm);
-void rsn_preauth_scan_results(struct wpa_sm *sm,
-            struct wpa_scan_results *results);
+int rsn_preauth_scan_results(struct wpa_sm *sm);
+void rsn_preauth_scan_result(struct wpa_sm *sm, const u8 *bssid,
+           const u8 *ssid, size_t ssid_len,
+           const struct wpa_ie_data *rsn);
 void pmksa_candidate_add(struct wpa_sm *sm, const u8 *bssid,
        int prio, int preauth);
 void rsn_preauth_candidate_process(struct wpa_sm *sm);
@@ -51,8 +53,15 @@ static inline int rsn_preauth_init(struct wpa_sm *sm, const u8 *dst,
 static inline void rsn_preauth_deinit(struct wpa_sm *sm)
 {
 }
-static inline void rsn_preauth_scan_results(struct wpa_sm *sm,
-              struct wpa_scan_results *results)
+static inline int rsn_preauth_scan_results(struct wpa_sm *sm)
+{
+  return -1;
+}
+
+static inline void rsn_preauth_scan_result(struct wpa_sm *sm,
+             const u8 *bssid,
+             const u8 *ssid, size_t ssid_len,
+             const struct wpa_ie_data *rsn)
 {
 }
 
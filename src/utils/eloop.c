@@ -16,6 +16,7 @@
 
 #include "common.h"
 #include "eloop.h"
+#include "eloop_i.h"
 
 
 struct eloop_sock {
@@ -25,21 +26,6 @@ struct eloop_sock {
         eloop_sock_handler handler;
 };
 
-struct eloop_timeout {
-        struct os_time time;
-        void *eloop_data;
-        void *user_data;
-        eloop_timeout_handler handler;
-        struct eloop_timeout *next;
-};
-
-struct eloop_signal {
-        int sig;
-        void *user_data;
-        eloop_signal_handler handler;
-        int signaled;
-};
-
 struct eloop_sock_table {
         int count;
         struct eloop_sock *table;
@@ -47,23 +33,11 @@ struct eloop_sock_table {
 };
 
 struct eloop_data {
-        void *user_data;
-
         int max_sock;
 
         struct eloop_sock_table readers;
         struct eloop_sock_table writers;
         struct eloop_sock_table exceptions;
-
-        struct eloop_timeout *timeout;
-
-        int signal_count;
-        struct eloop_signal *signals;
-        int signaled;
-        int pending_terminate;
-
-        int terminate;
-        int reader_table_changed;
 };
 
 static struct eloop_data eloop;
@@ -72,7 +46,7 @@ static struct eloop_data eloop;
 int eloop_init(void *user_data)
 {
         os_memset(&eloop, 0, sizeof(eloop));
-        eloop.user_data = user_data;
+        eloop_common_init(user_data);
         return 0;
 }
 
@@ -233,221 +207,12 @@ void eloop_unregister_sock(int sock, eloop_event_type type)
 }
 
 
-int eloop_register_timeout(unsigned int secs, unsigned int usecs,
-                           eloop_timeout_handler handler,
-                           void *eloop_data, void *user_data)
-{
-        struct eloop_timeout *timeout, *tmp, *prev;
-
-        timeout = os_malloc(sizeof(*timeout));
-        if (timeout == NULL)
-                return -1;
-        if (os_get_time(&timeout->time) < 0) {
-                os_free(timeout);
-                return -1;
-        }
-        timeout->time.sec += secs;
-        timeout->time.usec += usecs;
-        while (timeout->time.usec >= 1000000) {
-                timeout->time.sec++;
-                timeout->time.usec -= 1000000;
-        }
-        timeout->eloop_data = eloop_data;
-        timeout->user_data = user_data;
-        timeout->handler = handler;
-        timeout->next = NULL;
-
-        if (eloop.timeout == NULL) {
-                eloop.timeout = timeout;
-                return 0;
-        }
-
-        prev = NULL;
-        tmp = eloop.timeout;
-        while (tmp != NULL) {
-                if (os_time_before(&timeout->time, &tmp->time))
-                        break;
-                prev = tmp;
-                tmp = tmp->next;
-        }
-
-        if (prev == NULL) {
-                timeout->next = eloop.timeout;
-                eloop.timeout = timeout;
-        } else {
-                timeout->next = prev->next;
-                prev->next = timeout;
-        }
-
-        return 0;
-}
-
-
-int eloop_cancel_timeout(eloop_timeout_handler handler,
-                         void *eloop_data, void *user_data)
-{
-        struct eloop_timeout *timeout, *prev, *next;
-        int removed = 0;
-
-        prev = NULL;
-        timeout = eloop.timeout;
-        while (timeout != NULL) {
-                next = timeout->next;
-
-                if (timeout->handler == handler &&
-                    (timeout->eloop_data == eloop_data ||
-                     eloop_data == ELOOP_ALL_CTX) &&
-                    (timeout->user_data == user_data ||
-                     user_data == ELOOP_ALL_CTX)) {
-                        if (prev == NULL)
-                                eloop.timeout = next;
-                        else
-                                prev->next = next;
-                        os_free(timeout);
-                        removed++;
-                } else
-                        prev = timeout;
-
-                timeout = next;
-        }
-
-        return removed;
-}
-
-
-int eloop_is_timeout_registered(eloop_timeout_handler handler,
-                                void *eloop_data, void *user_data)
-{
-        struct eloop_timeout *tmp;
-
-        tmp = eloop.timeout;
-        while (tmp != NULL) {
-                if (tmp->handler == handler &&
-                    tmp->eloop_data == eloop_data &&
-                    tmp->user_data == user_data)
-                        return 1;
-
-                tmp = tmp->next;
-        }
-
-        return 0;
-}
-
-
-#ifndef CONFIG_NATIVE_WINDOWS
-static void eloop_handle_alarm(int sig)
-{
-        fprintf(stderr, "eloop: could not process SIGINT or SIGTERM in two "
-                "seconds. Looks like there\n"
-                "is a bug that ends up in a busy loop that "
-                "prevents clean shutdown.\n"
-                "Killing program forcefully.\n");
-        exit(1);
-}
-#endif /* CONFIG_NATIVE_WINDOWS */
-
-
-static void eloop_handle_signal(int sig)
-{
-        int i;
-
-#ifndef CONFIG_NATIVE_WINDOWS
-        if ((sig == SIGINT || sig == SIGTERM) && !eloop.pending_terminate) {
-                /* Use SIGALRM to break out from potential busy loops that
-                 * would not allow the program to be killed. */
-                eloop.pending_terminate = 1;
-                signal(SIGALRM, eloop_handle_alarm);
-                alarm(2);
-        }
-#endif /* CONFIG_NATIVE_WINDOWS */
-
-        eloop.signaled++;
-        for (i = 0; i < eloop.signal_count; i++) {
-                if (eloop.signals[i].sig == sig) {
-                        eloop.signals[i].signaled++;
-                        break;
-                }
-        }
-}
-
-
-static void eloop_process_pending_signals(void)
-{
-        int i;
-
-        if (eloop.signaled == 0)
-                return;
-        eloop.signaled = 0;
-
-        if (eloop.pending_terminate) {
-#ifndef CONFIG_NATIVE_WINDOWS
-                alarm(0);
-#endif /* CONFIG_NATIVE_WINDOWS */
-                eloop.pending_terminate = 0;
-        }
-
-        for (i = 0; i < eloop.signal_count; i++) {
-                if (eloop.signals[i].signaled) {
-                        eloop.signals[i].signaled = 0;
-                        eloop.signals[i].handler(eloop.signals[i].sig,
-                                                 eloop.user_data,
-                                                 eloop.signals[i].user_data);
-                }
-        }
-}
-
-
-int eloop_register_signal(int sig, eloop_signal_handler handler,
-                          void *user_data)
-{
-        struct eloop_signal *tmp;
-
-        tmp = (struct eloop_signal *)
-                os_realloc(eloop.signals,
-                           (eloop.signal_count + 1) *
-                           sizeof(struct eloop_signal));
-        if (tmp == NULL)
-                return -1;
-
-        tmp[eloop.signal_count].sig = sig;
-        tmp[eloop.signal_count].user_data = user_data;
-        tmp[eloop.signal_count].handler = handler;
-        tmp[eloop.signal_count].signaled = 0;
-        eloop.signal_count++;
-        eloop.signals = tmp;
-        signal(sig, eloop_handle_signal);
-
-        return 0;
-}
-
-
-int eloop_register_signal_terminate(eloop_signal_handler handler,
-                                    void *user_data)
-{
-        int ret = eloop_register_signal(SIGINT, handler, user_data);
-        if (ret == 0)
-                ret = eloop_register_signal(SIGTERM, handler, user_data);
-        return ret;
-}
-
-
-int eloop_register_signal_reconfig(eloop_signal_handler handler,
-                                   void *user_data)
-{
-#ifdef CONFIG_NATIVE_WINDOWS
-        return 0;
-#else /* CONFIG_NATIVE_WINDOWS */
-        return eloop_register_signal(SIGHUP, handler, user_data);
-#endif /* CONFIG_NATIVE_WINDOWS */
-}
-
-
 void eloop_run(void)
 {
         fd_set *rfds, *wfds, *efds;
-        int res;
+        int res, timeout;
         struct timeval _tv;
-        struct os_time tv, now;
+        struct os_reltime tv;
 
         rfds = os_malloc(sizeof(*rfds));
         wfds = os_malloc(sizeof(*wfds));
@@ -457,19 +222,12 @@ void eloop_run(void)
                 goto out;
         }
 
-        while (!eloop.terminate &&
-               (eloop.timeout || eloop.readers.count > 0 ||
-                eloop.writers.count > 0 || eloop.exceptions.count > 0)) {
-                if (eloop.timeout) {
-                        os_get_time(&now);
-                        if (os_time_before(&now, &eloop.timeout->time))
-                                os_time_sub(&eloop.timeout->time, &now, &tv);
-                        else
-                                tv.sec = tv.usec = 0;
-#if 0
-                        printf("next timeout in %lu.%06lu sec\n",
-                               tv.sec, tv.usec);
-#endif
+        while (!eloop_terminated()) {
+                timeout = eloop_common_next_timeout(&tv);
+                if (!timeout && eloop.readers.count == 0 &&
+                    eloop.writers.count == 0 && eloop.exceptions.count == 0)
+                        break;
+                if (timeout) {
                         _tv.tv_sec = tv.sec;
                         _tv.tv_usec = tv.usec;
                 }
@@ -478,27 +236,12 @@ void eloop_run(void)
                 eloop_sock_table_set_fds(&eloop.writers, wfds);
                 eloop_sock_table_set_fds(&eloop.exceptions, efds);
                 res = select(eloop.max_sock + 1, rfds, wfds, efds,
-                             eloop.timeout ? &_tv : NULL);
+                             timeout ? &_tv : NULL);
                 if (res < 0 && errno != EINTR && errno != 0) {
                         perror("select");
                         goto out;
                 }
-                eloop_process_pending_signals();
-
-                /* check if some registered timeouts have occurred */
-                if (eloop.timeout) {
-                        struct eloop_timeout *tmp;
-
-                        os_get_time(&now);
-                        if (!os_time_before(&now, &eloop.timeout->time)) {
-                                tmp = eloop.timeout;
-                                eloop.timeout = eloop.timeout->next;
-                                tmp->handler(tmp->eloop_data,
-                                             tmp->user_data);
-                                os_free(tmp);
-                        }
-
-                }
+                eloop_common_process();
 
                 if (res <= 0)
                         continue;
@@ -515,46 +258,36 @@ out:
 }
 
 
-void eloop_terminate(void)
+void eloop_destroy(void)
 {
-        eloop.terminate = 1;
+        eloop_common_destroy();
+        eloop_sock_table_destroy(&eloop.readers);
+        eloop_sock_table_destroy(&eloop.writers);
+        eloop_sock_table_destroy(&eloop.exceptions);
 }
 
 
-void eloop_destroy(void)
+static void eloop_sock_table_close(struct eloop_sock_table *table,
+                                   int keep_sock)
 {
-        struct eloop_timeout *timeout, *prev;
-        struct os_time now;
-
-        timeout = eloop.timeout;
-        if (timeout)
-                os_get_time(&now);
-        while (timeout != NULL) {
-                int sec, usec;
-                prev = timeout;
-                timeout = timeout->next;
-                sec = prev->time.sec - now.sec;
-                usec = prev->time.usec - now.usec;
-                if (prev->time.usec < now.usec) {
-                        sec--;
-                        usec += 1000000;
-                }
-                printf("ELOOP: remaining timeout: %d.%06d eloop_data=%p "
-                       "user_data=%p handler=%p\n",
-                       sec, usec, prev->eloop_data, prev->user_data,
-                       prev->handler);
-                os_free(prev);
+        int i;
+
+        for (i = 0; i < table->count; i++) {
+                if (table->table[i].sock != keep_sock)
+                        close(table->table[i].sock);
         }
-        eloop_sock_table_destroy(&eloop.readers);
-        eloop_sock_table_destroy(&eloop.writers);
-        eloop_sock_table_destroy(&eloop.exceptions);
-        os_free(eloop.signals);
+        table->count = 0;
 }
 
 
-int eloop_terminated(void)
+int eloop_fork_cleanup(int keep_sock)
 {
-        return eloop.terminate;
+        eloop_common_release();
+        eloop_sock_table_close(&eloop.readers, keep_sock);
+        eloop_sock_table_close(&eloop.writers, keep_sock);
+        eloop_sock_table_close(&eloop.exceptions, keep_sock);
+        eloop_destroy();
+        return 0;
 }
 
 
@@ -569,9 +302,3 @@ void eloop_wait_for_read_sock(int sock)
         FD_SET(sock, &rfds);
         select(sock + 1, &rfds, NULL, NULL, NULL);
 }
-
-
-void * eloop_get_user_data(void)
-{
-        return eloop.user_data;
-}
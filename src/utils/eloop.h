@@ -28,6 +28,24 @@
  */
 #define ELOOP_ALL_CTX (void *) -1
 
+struct eloop_timeout;
+
+/**
+ * struct eloop_stats - Event loop statistics
+ * @wakeups: Number of event loop iterations (returns from the wait call)
+ * @timeouts_fired: Total number of timeout handlers called
+ * @timeout_batches: Number of iterations that called at least one timeout
+ * @last_batch: Number of timeout handlers called in the latest such iteration
+ * @max_batch: Largest number of timeout handlers called in one iteration
+ */
+struct eloop_stats {
+        unsigned int wakeups;
+        unsigned int timeouts_fired;
+        unsigned int timeout_batches;
+        unsigned int last_batch;
+        unsigned int max_batch;
+};
+
 /**
  * eloop_event_type - eloop socket event type for eloop_register_sock()
  * @EVENT_TYPE_READ: Socket has data available for reading
@@ -192,6 +210,38 @@ int eloop_register_timeout(unsigned int secs, unsigned int usecs,
          eloop_timeout_handler handler,
          void *eloop_data, void *user_data);
 
+/**
+ * eloop_register_timeout_handle - Register timeout and return a handle to it
+ * @secs: Number of seconds to the timeout
+ * @usecs: Number of microseconds to the timeout
+ * @handler: Callback function to be called when timeout occurs
+ * @eloop_data: Callback context data (eloop_ctx)
+ * @user_data: Callback context data (sock_ctx)
+ * @handle: Handle storage; set to the new timeout on success
+ * Returns: 0 on success, -1 on failure
+ *
+ * Like eloop_register_timeout(), but the timeout can later be cancelled with
+ * eloop_cancel_timeout_handle() without a search. If *handle refers to a
+ * registered timeout, that timeout is cancelled first, i.e., this re-arms
+ * the timeout. eloop sets *handle to %NULL when the timeout is cancelled or
+ * just before the handler is called, so the handle storage must remain valid
+ * while the timeout is registered. *handle must be %NULL initially.
+ */
+int eloop_register_timeout_handle(unsigned int secs, unsigned int usecs,
+         eloop_timeout_handler handler,
+         void *eloop_data, void *user_data,
+         struct eloop_timeout **handle);
+
+/**
+ * eloop_cancel_timeout_handle - Cancel a timeout by its handle
+ * @handle: Handle storage used with eloop_register_timeout_handle()
+ * Returns: 1 if the timeout was cancelled, 0 if it was not registered
+ *
+ * This does not need to look up the timeout. It is safe to call this after
+ * the timeout has already been called or cancelled (*handle is %NULL then).
+ */
+int eloop_cancel_timeout_handle(struct eloop_timeout **handle);
+
 /**
  * eloop_cancel_timeout - Cancel timeouts
  * @handler: Matching callback function
@@ -312,6 +362,20 @@ void eloop_terminate(void);
  */
 void eloop_destroy(void);
 
+/**
+ * eloop_fork_cleanup - Release the event loop inherited from the parent
+ * @keep_sock: Registered socket that is not closed or -1
+ *
+ * A child process created with fork() that runs its own event loop calls this
+ * before eloop_init(). The registered sockets (except @keep_sock) and the
+ * internal descriptors of the parent's event loop are closed and the
+ * registered timeouts and signal handlers are removed without calling them.
+ * Returns: 0 on success, -1 if not supported by the event loop implementation
+ * (only the select() and epoll based ones support it); eloop_destroy() can then
+ * be used to drop the inherited timeouts, but the sockets are left open.
+ */
+int eloop_fork_cleanup(int keep_sock);
+
 /**
  * eloop_terminated - Check whether event loop has been terminated
  * Returns: 1 = event loop terminate, 0 = event loop still running
@@ -331,6 +395,12 @@ int eloop_terminated(void);
  */
 void eloop_wait_for_read_sock(int sock);
 
+/**
+ * eloop_get_stats - Get event loop statistics
+ * @stats: Buffer for returning the statistics
+ */
+void eloop_get_stats(struct eloop_stats *stats);
+
 /**
  * eloop_get_user_data - Get global user data
  * Returns: user_data pointer that was registered with eloop_init()
@@ -0,0 +1,622 @@
+/*
+ * Event loop - timeouts and signals shared by the socket backends
+ * Copyright (c) 2002-2005, Jouni Malinen <j@w1.fi>
+ * Copyright (c) 2026, agent <agent@local>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * Alternatively, this software may be distributed under the terms of BSD
+ * license.
+ *
+ * See README and COPYING for more details.
+ */
+
+#include "includes.h"
+
+#include "common.h"
+#include "eloop.h"
+#include "eloop_i.h"
+
+
+struct eloop_timeout {
+        struct os_reltime time;
+        unsigned int seq; /* registration order; keeps equal expiry FIFO */
+        int heap_idx; /* position in eloop.timeout heap */
+        void *eloop_data;
+        void *user_data;
+        eloop_timeout_handler handler;
+        struct eloop_timeout *hnext; /* next entry in the same hash bucket */
+        struct eloop_timeout **hpprev; /* pointer to this entry in bucket */
+        struct eloop_timeout **handle; /* cleared when removed, or NULL */
+};
+
+struct eloop_signal {
+        int sig;
+        void *user_data;
+        eloop_signal_handler handler;
+        int signaled;
+};
+
+struct eloop_data {
+        void *user_data;
+
+        /*
+         * Pending timeouts are kept in a binary min-heap ordered by expiry
+         * time (timeout[0] is the next one to expire) and indexed by a hash
+         * of <handler,eloop_data,user_data> for cancel/lookup operations.
+         * Timeouts registered with a handle can also be removed directly.
+         */
+        struct eloop_timeout **timeout;
+        int timeout_count;
+        int timeout_alloc;
+        unsigned int timeout_seq;
+        struct eloop_timeout **timeout_hash;
+        unsigned int timeout_hash_size; /* power of two */
+
+        int signal_count;
+        struct eloop_signal *signals;
+        int signaled;
+        int pending_terminate;
+
+        int terminate;
+
+        struct eloop_stats stats;
+};
+
+static struct eloop_data eloop;
+
+
+void eloop_common_init(void *user_data)
+{
+        os_memset(&eloop, 0, sizeof(eloop));
+        eloop.user_data = user_data;
+}
+
+
+static int eloop_timeout_before(struct eloop_timeout *a,
+                                struct eloop_timeout *b)
+{
+        if (os_reltime_before(&a->time, &b->time))
+                return 1;
+        if (os_reltime_before(&b->time, &a->time))
+                return 0;
+        /* Same expiry time: fire in the order of registration */
+        return (int) (a->seq - b->seq) < 0;
+}
+
+
+static void eloop_timeout_heap_set(int idx, struct eloop_timeout *timeout)
+{
+        eloop.timeout[idx] = timeout;
+        timeout->heap_idx = idx;
+}
+
+
+static void eloop_timeout_heap_up(int idx)
+{
+        struct eloop_timeout *timeout = eloop.timeout[idx];
+
+        while (idx > 0) {
+                int parent = (idx - 1) / 2;
+                if (!eloop_timeout_before(timeout, eloop.timeout[parent]))
+                        break;
+                eloop_timeout_heap_set(idx, eloop.timeout[parent]);
+                idx = parent;
+        }
+        eloop_timeout_heap_set(idx, timeout);
+}
+
+
+static void eloop_timeout_heap_down(int idx)
+{
+        struct eloop_timeout *timeout = eloop.timeout[idx];
+
+        for (;;) {
+                int child = 2 * idx + 1;
+                if (child >= eloop.timeout_count)
+                        break;
+                if (child + 1 < eloop.timeout_count &&
+                    eloop_timeout_before(eloop.timeout[child + 1],
+                                         eloop.timeout[child]))
+                        child++;
+                if (!eloop_timeout_before(eloop.timeout[child], timeout))
+                        break;
+                eloop_timeout_heap_set(idx, eloop.timeout[child]);
+                idx = child;
+        }
+        eloop_timeout_heap_set(idx, timeout);
+}
+
+
+static void eloop_timeout_heap_remove(struct eloop_timeout *timeout)
+{
+        int idx = timeout->heap_idx;
+
+        eloop.timeout_count--;
+        if (idx == eloop.timeout_count)
+                return;
+        eloop_timeout_heap_set(idx, eloop.timeout[eloop.timeout_count]);
+        if (idx > 0 && eloop_timeout_before(eloop.timeout[idx],
+                                            eloop.timeout[(idx - 1) / 2]))
+                eloop_timeout_heap_up(idx);
+        else
+                eloop_timeout_heap_down(idx);
+}
+
+
+static unsigned int eloop_timeout_hash(eloop_timeout_handler handler,
+                                       void *eloop_data, void *user_data)
+{
+        unsigned long h;
+
+        h = (unsigned long) handler;
+        h = h * 31 + (unsigned long) eloop_data;
+        h = h * 31 + (unsigned long) user_data;
+        h ^= h >> 16;
+        h ^= h >> 7;
+        return (unsigned int) h & (eloop.timeout_hash_size - 1);
+}
+
+
+static void eloop_timeout_hash_add(struct eloop_timeout *timeout)
+{
+        unsigned int h = eloop_timeout_hash(timeout->handler,
+                                            timeout->eloop_data,
+                                            timeout->user_data);
+        timeout->hnext = eloop.timeout_hash[h];
+        if (timeout->hnext)
+                timeout->hnext->hpprev = &timeout->hnext;
+        timeout->hpprev = &eloop.timeout_hash[h];
+        eloop.timeout_hash[h] = timeout;
+}
+
+
+static void eloop_timeout_hash_del(struct eloop_timeout *timeout)
+{
+        *timeout->hpprev = timeout->hnext;
+        if (timeout->hnext)
+                timeout->hnext->hpprev = timeout->hpprev;
+        if (timeout->handle)
+                *timeout->handle = NULL;
+}
+
+
+static int eloop_timeout_hash_resize(unsigned int size)
+{
+        struct eloop_timeout **hash;
+        int i;
+
+        hash = os_zalloc(size * sizeof(struct eloop_timeout *));
+        if (hash == NULL)
+                return -1;
+        os_free(eloop.timeout_hash);
+        eloop.timeout_hash = hash;
+        eloop.timeout_hash_size = size;
+        for (i = 0; i < eloop.timeout_count; i++)
+                eloop_timeout_hash_add(eloop.timeout[i]);
+        return 0;
+}
+
+
+static void eloop_timeout_unlink(struct eloop_timeout *timeout)
+{
+        eloop_timeout_hash_del(timeout);
+        eloop_timeout_heap_remove(timeout);
+}
+
+
+static int eloop_timeout_add(unsigned int secs, unsigned int usecs,
+                             eloop_timeout_handler handler,
+                             void *eloop_data, void *user_data,
+                             struct eloop_timeout **handle)
+{
+        struct eloop_timeout *timeout;
+
+        if (eloop.timeout_count == eloop.timeout_alloc) {
+                struct eloop_timeout **tmp;
+                int alloc = eloop.timeout_alloc ? 2 * eloop.timeout_alloc :
+                        16;
+                tmp = os_realloc(eloop.timeout,
+                                 alloc * sizeof(struct eloop_timeout *));
+                if (tmp == NULL)
+                        return -1;
+                eloop.timeout = tmp;
+                eloop.timeout_alloc = alloc;
+        }
+        if ((unsigned int) eloop.timeout_count >= eloop.timeout_hash_size &&
+            eloop_timeout_hash_resize(eloop.timeout_hash_size ?
+                                      2 * eloop.timeout_hash_size : 16) < 0)
+                return -1;
+
+        timeout = os_malloc(sizeof(*timeout));
+        if (timeout == NULL)
+                return -1;
+        if (os_get_reltime(&timeout->time) < 0) {
+                os_free(timeout);
+                return -1;
+        }
+        timeout->time.sec += secs;
+        timeout->time.usec += usecs;
+        while (timeout->time.usec >= 1000000) {
+                timeout->time.sec++;
+                timeout->time.usec -= 1000000;
+        }
+        timeout->seq = eloop.timeout_seq++;
+        timeout->eloop_data = eloop_data;
+        timeout->user_data = user_data;
+        timeout->handler = handler;
+        timeout->handle = handle;
+        if (handle)
+                *handle = timeout;
+
+        eloop_timeout_hash_add(timeout);
+        eloop_timeout_heap_set(eloop.timeout_count++, timeout);
+        eloop_timeout_heap_up(timeout->heap_idx);
+
+        return 0;
+}
+
+
+int eloop_register_timeout(unsigned int secs, unsigned int usecs,
+                           eloop_timeout_handler handler,
+                           void *eloop_data, void *user_data)
+{
+        return eloop_timeout_add(secs, usecs, handler, eloop_data, user_data,
+                                 NULL);
+}
+
+
+int eloop_register_timeout_handle(unsigned int secs, unsigned int usecs,
+                                  eloop_timeout_handler handler,
+                                  void *eloop_data, void *user_data,
+                                  struct eloop_timeout **handle)
+{
+        eloop_cancel_timeout_handle(handle);
+        return eloop_timeout_add(secs, usecs, handler, eloop_data, user_data,
+                                 handle);
+}
+
+
+int eloop_cancel_timeout_handle(struct eloop_timeout **handle)
+{
+        struct eloop_timeout *timeout = *handle;
+
+        if (timeout == NULL)
+                return 0;
+        /* Clears *handle; no hash bucket or heap search is needed */
+        eloop_timeout_unlink(timeout);
+        os_free(timeout);
+        return 1;
+}
+
+
+static int eloop_cancel_timeout_all_ctx(eloop_timeout_handler handler,
+                                        void *eloop_data, void *user_data)
+{
+        struct eloop_timeout *timeout;
+        int i, count = 0, removed = 0;
+
+        /*
+         * Wildcard matches cannot use the hash index, so filter the heap
+         * array in place and restore the heap property afterwards.
+         */
+        for (i = 0; i < eloop.timeout_count; i++) {
+                timeout = eloop.timeout[i];
+                if (timeout->handler == handler &&
+                    (timeout->eloop_data == eloop_data ||
+                     eloop_data == ELOOP_ALL_CTX) &&
+                    (timeout->user_data == user_data ||
+                     user_data == ELOOP_ALL_CTX)) {
+                        eloop_timeout_hash_del(timeout);
+                        os_free(timeout);
+                        removed++;
+                } else
+                        eloop_timeout_heap_set(count++, timeout);
+        }
+        eloop.timeout_count = count;
+
+        if (removed) {
+                for (i = count / 2 - 1; i >= 0; i--)
+                        eloop_timeout_heap_down(i);
+        }
+
+        return removed;
+}
+
+
+int eloop_cancel_timeout(eloop_timeout_handler handler,
+                         void *eloop_data, void *user_data)
+{
+        struct eloop_timeout *timeout, *next;
+        int removed = 0;
+
+        if (eloop.timeout_count == 0)
+                return 0;
+
+        if (eloop_data == ELOOP_ALL_CTX || user_data == ELOOP_ALL_CTX)
+                return eloop_cancel_timeout_all_ctx(handler, eloop_data,
+                                                    user_data);
+
+        timeout = eloop.timeout_hash[eloop_timeout_hash(handler, eloop_data,
+                                                        user_data)];
+        while (timeout != NULL) {
+                next = timeout->hnext;
+                if (timeout->handler == handler &&
+                    timeout->eloop_data == eloop_data &&
+                    timeout->user_data == user_data) {
+                        eloop_timeout_unlink(timeout);
+                        os_free(timeout);
+                        removed++;
+                }
+                timeout = next;
+        }
+
+        return removed;
+}
+
+
+int eloop_is_timeout_registered(eloop_timeout_handler handler,
+                                void *eloop_data, void *user_data)
+{
+        struct eloop_timeout *tmp;
+
+        if (eloop.timeout_count == 0)
+                return 0;
+
+        tmp = eloop.timeout_hash[eloop_timeout_hash(handler, eloop_data,
+                                                    user_data)];
+        while (tmp != NULL) {
+                if (tmp->handler == handler &&
+                    tmp->eloop_data == eloop_data &&
+                    tmp->user_data == user_data)
+                        return 1;
+
+                tmp = tmp->hnext;
+        }
+
+        return 0;
+}
+
+
+#ifndef CONFIG_NATIVE_WINDOWS
+static void eloop_handle_alarm(int sig)
+{
+        fprintf(stderr, "eloop: could not process SIGINT or SIGTERM in two "
+                "seconds. Looks like there\n"
+                "is a bug that ends up in a busy loop that "
+                "prevents clean shutdown.\n"
+                "Killing program forcefully.\n");
+        exit(1);
+}
+#endif /* CONFIG_NATIVE_WINDOWS */
+
+
+static void eloop_handle_signal(int sig)
+{
+        int i;
+
+#ifndef CONFIG_NATIVE_WINDOWS
+        if ((sig == SIGINT || sig == SIGTERM) && !eloop.pending_terminate) {
+                /* Use SIGALRM to break out from potential busy loops that
+                 * would not allow the program to be killed. */
+                eloop.pending_terminate = 1;
+                signal(SIGALRM, eloop_handle_alarm);
+                alarm(2);
+        }
+#endif /* CONFIG_NATIVE_WINDOWS */
+
+        eloop.signaled++;
+        for (i = 0; i < eloop.signal_count; i++) {
+                if (eloop.signals[i].sig == sig) {
+                        eloop.signals[i].signaled++;
+                        break;
+                }
+        }
+}
+
+
+static void eloop_process_pending_signals(void)
+{
+        int i;
+
+        if (eloop.signaled == 0)
+                return;
+        eloop.signaled = 0;
+
+        if (eloop.pending_terminate) {
+#ifndef CONFIG_NATIVE_WINDOWS
+                alarm(0);
+#endif /* CONFIG_NATIVE_WINDOWS */
+                eloop.pending_terminate = 0;
+        }
+
+        for (i = 0; i < eloop.signal_count; i++) {
+                if (eloop.signals[i].signaled) {
+                        eloop.signals[i].signaled = 0;
+                        eloop.signals[i].handler(eloop.signals[i].sig,
+                                                 eloop.user_data,
+                                                 eloop.signals[i].user_data);
+                }
+        }
+}
+
+
+int eloop_register_signal(int sig, eloop_signal_handler handler,
+                          void *user_data)
+{
+        struct eloop_signal *tmp;
+
+        tmp = (struct eloop_signal *)
+                os_realloc(eloop.signals,
+                           (eloop.signal_count + 1) *
+                           sizeof(struct eloop_signal));
+        if (tmp == NULL)
+                return -1;
+
+        tmp[eloop.signal_count].sig = sig;
+        tmp[eloop.signal_count].user_data = user_data;
+        tmp[eloop.signal_count].handler = handler;
+        tmp[eloop.signal_count].signaled = 0;
+        eloop.signal_count++;
+        eloop.signals = tmp;
+        signal(sig, eloop_handle_signal);
+
+        return 0;
+}
+
+
+int eloop_register_signal_terminate(eloop_signal_handler handler,
+                                    void *user_data)
+{
+        int ret = eloop_register_signal(SIGINT, handler, user_data);
+        if (ret == 0)
+                ret = eloop_register_signal(SIGTERM, handler, user_data);
+        return ret;
+}
+
+
+int eloop_register_signal_reconfig(eloop_signal_handler handler,
+                                   void *user_data)
+{
+#ifdef CONFIG_NATIVE_WINDOWS
+        return 0;
+#else /* CONFIG_NATIVE_WINDOWS */
+        return eloop_register_signal(SIGHUP, handler, user_data);
+#endif /* CONFIG_NATIVE_WINDOWS */
+}
+
+
+static void eloop_process_timeouts(void)
+{
+        struct eloop_timeout *tmp;
+        struct os_reltime now;
+        unsigned int seq_end, fired = 0;
+
+        if (eloop.timeout_count == 0)
+                return;
+
+        /*
+         * Call all timeouts that are due at a single time snapshot. Timeouts
+         * registered by the handlers during this batch are left for the next
+         * iteration even if they are already due, so that a handler
+         * re-registering itself with zero delay cannot starve sockets.
+         */
+        os_get_reltime(&now);
+        seq_end = eloop.timeout_seq;
+        while (eloop.timeout_count > 0 && !eloop.terminate) {
+                tmp = eloop.timeout[0];
+                if (os_reltime_before(&now, &tmp->time) ||
+                    (int) (tmp->seq - seq_end) >= 0)
+                        break;
+                eloop_timeout_unlink(tmp);
+                tmp->handler(tmp->eloop_data, tmp->user_data);
+                os_free(tmp);
+                fired++;
+        }
+
+        if (fired) {
+                eloop.stats.timeouts_fired += fired;
+                eloop.stats.timeout_batches++;
+                eloop.stats.last_batch = fired;
+                if (fired > eloop.stats.max_batch)
+                        eloop.stats.max_batch = fired;
+        }
+}
+
+
+int eloop_common_next_timeout(struct os_reltime *tv)
+{
+        struct os_reltime now;
+
+        if (eloop.timeout_count == 0)
+                return 0;
+
+        os_get_reltime(&now);
+        if (os_reltime_before(&now, &eloop.timeout[0]->time))
+                os_reltime_sub(&eloop.timeout[0]->time, &now, tv);
+        else
+                tv->sec = tv->usec = 0;
+        return 1;
+}
+
+
+void eloop_common_process(void)
+{
+        eloop.stats.wakeups++;
+        eloop_process_pending_signals();
+
+        /* check if some registered timeouts have occurred */
+        eloop_process_timeouts();
+}
+
+
+void eloop_terminate(void)
+{
+        eloop.terminate = 1;
+}
+
+
+void eloop_common_destroy(void)
+{
+        struct eloop_timeout *timeout;
+        struct os_reltime now;
+        int i;
+
+        if (eloop.timeout_count > 0)
+                os_get_reltime(&now);
+        for (i = 0; i < eloop.timeout_count; i++) {
+                int sec, usec;
+                timeout = eloop.timeout[i];
+                sec = timeout->time.sec - now.sec;
+                usec = timeout->time.usec - now.usec;
+                if (timeout->time.usec < now.usec) {
+                        sec--;
+                        usec += 1000000;
+                }
+                printf("ELOOP: remaining timeout: %d.%06d eloop_data=%p "
+                       "user_data=%p handler=%p\n",
+                       sec, usec, timeout->eloop_data, timeout->user_data,
+                       timeout->handler);
+                os_free(timeout);
+        }
+        os_free(eloop.timeout);
+        os_free(eloop.timeout_hash);
+        eloop.timeout = NULL;
+        eloop.timeout_hash = NULL;
+        eloop.timeout_count = eloop.timeout_alloc = 0;
+        eloop.timeout_hash_size = 0;
+        os_free(eloop.signals);
+        eloop.signals = NULL;
+        eloop.signal_count = 0;
+}
+
+
+void eloop_common_release(void)
+{
+        int i;
+
+        for (i = 0; i < eloop.timeout_count; i++)
+                os_free(eloop.timeout[i]);
+        eloop.timeout_count = 0;
+        eloop_common_destroy();
+}
+
+
+int eloop_terminated(void)
+{
+        return eloop.terminate;
+}
+
+
+void eloop_get_stats(struct eloop_stats *stats)
+{
+        os_memcpy(stats, &eloop.stats, sizeof(*stats));
+}
+
+
+void * eloop_get_user_data(void)
+{
+        return eloop.user_data;
+}
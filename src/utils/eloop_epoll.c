@@ -0,0 +1,418 @@
+/*
+ * Event loop based on Linux epoll
+ * Copyright (c) 2002-2005, Jouni Malinen <j@w1.fi>
+ * Copyright (c) 2026, agent <agent@local>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * Alternatively, this software may be distributed under the terms of BSD
+ * license.
+ *
+ * See README and COPYING for more details.
+ */
+
+#include "includes.h"
+#include <sys/epoll.h>
+#include <poll.h>
+#include <limits.h>
+
+#include "common.h"
+#include "eloop.h"
+#include "eloop_i.h"
+
+
+struct eloop_sock {
+        int sock;
+        void *eloop_data;
+        void *user_data;
+        eloop_sock_handler handler;
+};
+
+struct eloop_sock_table {
+        int count;
+        struct eloop_sock *table;
+        int changed;
+
+        /*
+         * fd_map[sock] is the index of sock in table + 1 (0 = not
+         * registered); allows dispatching epoll events without a table scan
+         */
+        int *fd_map;
+        int fd_map_len;
+};
+
+struct eloop_data {
+        int epoll_fd;
+        int epoll_count; /* number of sockets in the epoll set */
+        struct epoll_event *epoll_events;
+        int epoll_events_len;
+
+        struct eloop_sock_table readers;
+        struct eloop_sock_table writers;
+        struct eloop_sock_table exceptions;
+};
+
+static struct eloop_data eloop;
+
+
+int eloop_init(void *user_data)
+{
+        os_memset(&eloop, 0, sizeof(eloop));
+        eloop_common_init(user_data);
+        eloop.epoll_fd = epoll_create(16);
+        if (eloop.epoll_fd < 0) {
+                perror("epoll_create");
+                return -1;
+        }
+        return 0;
+}
+
+
+static struct eloop_sock * eloop_sock_table_get(struct eloop_sock_table *table,
+                                                int sock)
+{
+        if (sock < 0 || sock >= table->fd_map_len || table->fd_map[sock] == 0)
+                return NULL;
+        return &table->table[table->fd_map[sock] - 1];
+}
+
+
+static u32 eloop_sock_events(int sock)
+{
+        u32 events = 0;
+
+        if (eloop_sock_table_get(&eloop.readers, sock))
+                events |= EPOLLIN;
+        if (eloop_sock_table_get(&eloop.writers, sock))
+                events |= EPOLLOUT;
+        if (eloop_sock_table_get(&eloop.exceptions, sock))
+                events |= EPOLLPRI;
+        return events;
+}
+
+
+static int eloop_epoll_update(int sock, u32 old_events)
+{
+        struct epoll_event ev;
+        u32 events = eloop_sock_events(sock);
+        int op;
+
+        if (events == old_events)
+                return 0;
+
+        if (old_events == 0)
+                op = EPOLL_CTL_ADD;
+        else if (events == 0)
+                op = EPOLL_CTL_DEL;
+        else
+                op = EPOLL_CTL_MOD;
+
+        os_memset(&ev, 0, sizeof(ev));
+        ev.events = events;
+        ev.data.fd = sock;
+        if (epoll_ctl(eloop.epoll_fd, op, sock, &ev) < 0) {
+                perror("epoll_ctl");
+                return -1;
+        }
+
+        if (op == EPOLL_CTL_ADD)
+                eloop.epoll_count++;
+        else if (op == EPOLL_CTL_DEL)
+                eloop.epoll_count--;
+        return 0;
+}
+
+
+static void eloop_sock_table_remove_entry(struct eloop_sock_table *table,
+                                          int sock)
+{
+        int i, j;
+
+        i = table->fd_map[sock] - 1;
+        table->fd_map[sock] = 0;
+        if (i != table->count - 1) {
+                os_memmove(&table->table[i], &table->table[i + 1],
+                           (table->count - i - 1) *
+                           sizeof(struct eloop_sock));
+                for (j = i; j < table->count - 1; j++)
+                        table->fd_map[table->table[j].sock]--;
+        }
+        table->count--;
+        table->changed = 1;
+}
+
+
+static int eloop_sock_table_add_sock(struct eloop_sock_table *table,
+                                     int sock, eloop_sock_handler handler,
+                                     void *eloop_data, void *user_data)
+{
+        struct eloop_sock *tmp;
+        u32 old_events;
+
+        if (table == NULL || sock < 0)
+                return -1;
+
+        if (eloop_sock_table_get(table, sock)) {
+                printf("ELOOP: socket %d already registered\n", sock);
+                return -1;
+        }
+
+        if (sock >= table->fd_map_len) {
+                int *map, len = table->fd_map_len ? table->fd_map_len : 16;
+                while (len <= sock)
+                        len *= 2;
+                map = os_realloc(table->fd_map, len * sizeof(int));
+                if (map == NULL)
+                        return -1;
+                os_memset(&map[table->fd_map_len], 0,
+                          (len - table->fd_map_len) * sizeof(int));
+                table->fd_map = map;
+                table->fd_map_len = len;
+        }
+
+        tmp = (struct eloop_sock *)
+                os_realloc(table->table,
+                           (table->count + 1) * sizeof(struct eloop_sock));
+        if (tmp == NULL)
+                return -1;
+
+        old_events = eloop_sock_events(sock);
+
+        tmp[table->count].sock = sock;
+        tmp[table->count].eloop_data = eloop_data;
+        tmp[table->count].user_data = user_data;
+        tmp[table->count].handler = handler;
+        table->count++;
+        table->table = tmp;
+        table->fd_map[sock] = table->count;
+        table->changed = 1;
+
+        if (eloop_epoll_update(sock, old_events) < 0) {
+                eloop_sock_table_remove_entry(table, sock);
+                return -1;
+        }
+
+        return 0;
+}
+
+
+static void eloop_sock_table_remove_sock(struct eloop_sock_table *table,
+                                         int sock)
+{
+        u32 old_events;
+
+        if (table == NULL || eloop_sock_table_get(table, sock) == NULL)
+                return;
+
+        old_events = eloop_sock_events(sock);
+        eloop_sock_table_remove_entry(table, sock);
+        eloop_epoll_update(sock, old_events);
+}
+
+
+static void eloop_sock_table_dispatch(struct eloop_sock_table *table,
+                                      u32 mask, struct epoll_event *events,
+                                      int nevents)
+{
+        struct eloop_sock *s;
+        int i;
+
+        if (table == NULL || table->table == NULL)
+                return;
+
+        /*
+         * Only ready sockets are visited. Each event is looked up through the
+         * fd map at dispatch time, so a socket unregistered by an earlier
+         * handler is skipped; as in the select() loop, the rest of the table
+         * is not processed in this round once a handler changes it.
+         */
+        table->changed = 0;
+        for (i = 0; i < nevents; i++) {
+                if (!(events[i].events & mask))
+                        continue;
+                s = eloop_sock_table_get(table, events[i].data.fd);
+                if (s == NULL)
+                        continue;
+                s->handler(s->sock, s->eloop_data, s->user_data);
+                if (table->changed)
+                        break;
+        }
+}
+
+
+static void eloop_sock_table_destroy(struct eloop_sock_table *table)
+{
+        if (table) {
+                int i;
+                for (i = 0; i < table->count && table->table; i++) {
+                        printf("ELOOP: remaining socket: sock=%d "
+                               "eloop_data=%p user_data=%p handler=%p\n",
+                               table->table[i].sock,
+                               table->table[i].eloop_data,
+                               table->table[i].user_data,
+                               table->table[i].handler);
+                }
+                os_free(table->table);
+                os_free(table->fd_map);
+        }
+}
+
+
+int eloop_register_read_sock(int sock, eloop_sock_handler handler,
+                             void *eloop_data, void *user_data)
+{
+        return eloop_register_sock(sock, EVENT_TYPE_READ, handler,
+                                   eloop_data, user_data);
+}
+
+
+void eloop_unregister_read_sock(int sock)
+{
+        eloop_unregister_sock(sock, EVENT_TYPE_READ);
+}
+
+
+static struct eloop_sock_table *eloop_get_sock_table(eloop_event_type type)
+{
+        switch (type) {
+        case EVENT_TYPE_READ:
+                return &eloop.readers;
+        case EVENT_TYPE_WRITE:
+                return &eloop.writers;
+        case EVENT_TYPE_EXCEPTION:
+                return &eloop.exceptions;
+        }
+
+        return NULL;
+}
+
+
+int eloop_register_sock(int sock, eloop_event_type type,
+                        eloop_sock_handler handler,
+                        void *eloop_data, void *user_data)
+{
+        struct eloop_sock_table *table;
+
+        table = eloop_get_sock_table(type);
+        return eloop_sock_table_add_sock(table, sock, handler,
+                                         eloop_data, user_data);
+}
+
+
+void eloop_unregister_sock(int sock, eloop_event_type type)
+{
+        struct eloop_sock_table *table;
+
+        table = eloop_get_sock_table(type);
+        eloop_sock_table_remove_sock(table, sock);
+}
+
+
+void eloop_run(void)
+{
+        int res, timeout_ms;
+        struct os_reltime tv;
+
+        while (!eloop_terminated()) {
+                timeout_ms = -1;
+                if (eloop_common_next_timeout(&tv)) {
+                        /* round up to avoid waking up before the timeout */
+                        if (tv.sec >= INT_MAX / 1000)
+                                timeout_ms = INT_MAX;
+                        else
+                                timeout_ms = tv.sec * 1000 +
+                                        (tv.usec + 999) / 1000;
+                } else if (eloop.readers.count == 0 &&
+                           eloop.writers.count == 0 &&
+                           eloop.exceptions.count == 0)
+                        break;
+
+                if (eloop.epoll_events_len < eloop.epoll_count) {
+                        struct epoll_event *tmp;
+                        int len = eloop.epoll_count * 2;
+                        tmp = os_realloc(eloop.epoll_events,
+                                         len * sizeof(struct epoll_event));
+                        if (tmp == NULL) {
+                                printf("eloop_run - malloc failed\n");
+                                return;
+                        }
+                        eloop.epoll_events = tmp;
+                        eloop.epoll_events_len = len;
+                }
+
+                res = epoll_wait(eloop.epoll_fd, eloop.epoll_events,
+                                 eloop.epoll_events_len > 0 ?
+                                 eloop.epoll_events_len : 1, timeout_ms);
+                if (res < 0 && errno != EINTR && errno != 0) {
+                        perror("epoll_wait");
+                        return;
+                }
+                eloop_common_process();
+
+                if (res <= 0)
+                        continue;
+
+                eloop_sock_table_dispatch(&eloop.readers,
+                                          EPOLLIN | EPOLLERR | EPOLLHUP,
+                                          eloop.epoll_events, res);
+                eloop_sock_table_dispatch(&eloop.writers,
+                                          EPOLLOUT | EPOLLERR | EPOLLHUP,
+                                          eloop.epoll_events, res);
+                eloop_sock_table_dispatch(&eloop.exceptions, EPOLLPRI,
+                                          eloop.epoll_events, res);
+        }
+}
+
+
+void eloop_destroy(void)
+{
+        eloop_common_destroy();
+        eloop_sock_table_destroy(&eloop.readers);
+        eloop_sock_table_destroy(&eloop.writers);
+        eloop_sock_table_destroy(&eloop.exceptions);
+        os_free(eloop.epoll_events);
+        eloop.epoll_events = NULL;
+        if (eloop.epoll_fd >= 0)
+                close(eloop.epoll_fd);
+        eloop.epoll_fd = -1;
+}
+
+
+static void eloop_sock_table_close(struct eloop_sock_table *table,
+                                   int keep_sock)
+{
+        int i;
+
+        for (i = 0; i < table->count; i++) {
+                if (table->table[i].sock != keep_sock)
+                        close(table->table[i].sock);
+        }
+        table->count = 0;
+}
+
+
+int eloop_fork_cleanup(int keep_sock)
+{
+        eloop_common_release();
+        eloop_sock_table_close(&eloop.readers, keep_sock);
+        eloop_sock_table_close(&eloop.writers, keep_sock);
+        eloop_sock_table_close(&eloop.exceptions, keep_sock);
+        eloop_destroy();
+        return 0;
+}
+
+
+void eloop_wait_for_read_sock(int sock)
+{
+        struct pollfd pfd;
+
+        if (sock < 0)
+                return;
+
+        os_memset(&pfd, 0, sizeof(pfd));
+        pfd.fd = sock;
+        pfd.events = POLLIN;
+        poll(&pfd, 1, -1);
+}
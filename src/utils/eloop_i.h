@@ -0,0 +1,60 @@
+/*
+ * Event loop - internal definitions shared by the socket backends
+ * Copyright (c) 2002-2005, Jouni Malinen <j@w1.fi>
+ * Copyright (c) 2026, agent <agent@local>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * Alternatively, this software may be distributed under the terms of BSD
+ * license.
+ *
+ * See README and COPYING for more details.
+ *
+ * eloop_common.c implements timeouts, signals, termination and statistics
+ * for the eloop.h interface. A socket backend (eloop.c for select(),
+ * eloop_epoll.c for epoll) implements eloop_init(), socket registration,
+ * eloop_run(), eloop_destroy() and eloop_wait_for_read_sock() on top of the
+ * functions defined here.
+ */
+
+#ifndef ELOOP_I_H
+#define ELOOP_I_H
+
+/**
+ * eloop_common_init - Initialize timeout and signal data
+ * @user_data: Global user_data from eloop_init()
+ */
+void eloop_common_init(void *user_data);
+
+/**
+ * eloop_common_destroy - Free remaining timeouts and signal handlers
+ */
+void eloop_common_destroy(void);
+
+/**
+ * eloop_common_release - Free timeouts and signal handlers without reporting
+ *
+ * Used to release the event loop inherited over fork(); see
+ * eloop_fork_cleanup().
+ */
+void eloop_common_release(void);
+
+/**
+ * eloop_common_next_timeout - Get the time until the next timeout
+ * @tv: Buffer for the remaining time (zero if the timeout is already due)
+ * Returns: 1 if a timeout is registered, 0 if not (tv is not set)
+ */
+int eloop_common_next_timeout(struct os_reltime *tv);
+
+/**
+ * eloop_common_process - Process events after a wakeup
+ *
+ * Count the wakeup, call the handlers for pending signals, and call all
+ * timeouts that have expired. Socket backends call this after each return
+ * from their wait call and before dispatching ready sockets.
+ */
+void eloop_common_process(void);
+
+#endif /* ELOOP_I_H */
@@ -26,11 +26,12 @@ struct eloop_sock {
 };
 
 struct eloop_timeout {
-        struct os_time time;
+        struct os_reltime time;
         void *eloop_data;
         void *user_data;
         void (*handler)(void *eloop_ctx, void *sock_ctx);
         struct eloop_timeout *next;
+        struct eloop_timeout **handle;
 };
 
 struct eloop_signal {
@@ -55,6 +56,8 @@ struct eloop_data {
 
         int terminate;
         int reader_table_changed;
+
+        struct eloop_stats stats;
 };
 
 static struct eloop_data eloop;
@@ -118,16 +121,18 @@ void eloop_unregister_read_sock(int sock)
 }
 
 
-int eloop_register_timeout(unsigned int secs, unsigned int usecs,
-                           void (*handler)(void *eloop_ctx, void *timeout_ctx),
-                           void *eloop_data, void *user_data)
+static int eloop_timeout_add(unsigned int secs, unsigned int usecs,
+                             void (*handler)(void *eloop_ctx,
+                                             void *timeout_ctx),
+                             void *eloop_data, void *user_data,
+                             struct eloop_timeout **handle)
 {
         struct eloop_timeout *timeout, *tmp, *prev;
 
         timeout = (struct eloop_timeout *) malloc(sizeof(*timeout));
         if (timeout == NULL)
                 return -1;
-        os_get_time(&timeout->time);
+        os_get_reltime(&timeout->time);
         timeout->time.sec += secs;
         timeout->time.usec += usecs;
         while (timeout->time.usec >= 1000000) {
@@ -138,6 +143,9 @@ int eloop_register_timeout(unsigned int secs, unsigned int usecs,
         timeout->user_data = user_data;
         timeout->handler = handler;
         timeout->next = NULL;
+        timeout->handle = handle;
+        if (handle)
+                *handle = timeout;
 
         if (eloop.timeout == NULL) {
                 eloop.timeout = timeout;
@@ -147,7 +155,7 @@ int eloop_register_timeout(unsigned int secs, unsigned int usecs,
         prev = NULL;
         tmp = eloop.timeout;
         while (tmp != NULL) {
-                if (os_time_before(&timeout->time, &tmp->time))
+                if (os_reltime_before(&timeout->time, &tmp->time))
                         break;
                 prev = tmp;
                 tmp = tmp->next;
@@ -165,6 +173,51 @@ int eloop_register_timeout(unsigned int secs, unsigned int usecs,
 }
 
 
+int eloop_register_timeout(unsigned int secs, unsigned int usecs,
+                           void (*handler)(void *eloop_ctx, void *timeout_ctx),
+                           void *eloop_data, void *user_data)
+{
+        return eloop_timeout_add(secs, usecs, handler, eloop_data, user_data,
+                                 NULL);
+}
+
+
+int eloop_register_timeout_handle(unsigned int secs, unsigned int usecs,
+                                  eloop_timeout_handler handler,
+                                  void *eloop_data, void *user_data,
+                                  struct eloop_timeout **handle)
+{
+        eloop_cancel_timeout_handle(handle);
+        return eloop_timeout_add(secs, usecs, handler, eloop_data, user_data,
+                                 handle);
+}
+
+
+int eloop_cancel_timeout_handle(struct eloop_timeout **handle)
+{
+        struct eloop_timeout *timeout, *prev;
+
+        if (*handle == NULL)
+                return 0;
+
+        prev = NULL;
+        timeout = eloop.timeout;
+        while (timeout != NULL && timeout != *handle) {
+                prev = timeout;
+                timeout = timeout->next;
+        }
+        *handle = NULL;
+        if (timeout == NULL)
+                return 0;
+        if (prev == NULL)
+                eloop.timeout = timeout->next;
+        else
+                prev->next = timeout->next;
+        free(timeout);
+        return 1;
+}
+
+
 int eloop_cancel_timeout(void (*handler)(void *eloop_ctx, void *sock_ctx),
                          void *eloop_data, void *user_data)
 {
@@ -185,6 +238,8 @@ int eloop_cancel_timeout(void (*handler)(void *eloop_ctx, void *sock_ctx),
                                 eloop.timeout = next;
                         else
                                 prev->next = next;
+                        if (timeout->handle)
+                                *timeout->handle = NULL;
                         free(timeout);
                         removed++;
                 } else
@@ -314,14 +369,15 @@ int eloop_register_signal_reconfig(void (*handler)(int sig, void *eloop_ctx,
 void eloop_run(void)
 {
         int i;
-        struct os_time tv, now;
+        struct os_reltime tv, now;
 
         while (!eloop.terminate &&
                 (eloop.timeout || eloop.reader_count > 0)) {
                 if (eloop.timeout) {
-                        os_get_time(&now);
-                        if (os_time_before(&now, &eloop.timeout->time))
-                                os_time_sub(&eloop.timeout->time, &now, &tv);
+                        os_get_reltime(&now);
+                        if (os_reltime_before(&now, &eloop.timeout->time))
+                                os_reltime_sub(&eloop.timeout->time, &now,
+                                               &tv);
                         else
                                 tv.sec = tv.usec = 0;
                 }
@@ -332,19 +388,26 @@ void eloop_run(void)
                  */
                 os_sleep(1, 0); /* just a dummy wait for testing */
 
+                eloop.stats.wakeups++;
                 eloop_process_pending_signals();
 
                 /* check if some registered timeouts have occurred */
                 if (eloop.timeout) {
                         struct eloop_timeout *tmp;
 
-                        os_get_time(&now);
-                        if (!os_time_before(&now, &eloop.timeout->time)) {
+                        os_get_reltime(&now);
+                        if (!os_reltime_before(&now, &eloop.timeout->time)) {
                                 tmp = eloop.timeout;
                                 eloop.timeout = eloop.timeout->next;
+                                if (tmp->handle)
+                                        *tmp->handle = NULL;
                                 tmp->handler(tmp->eloop_data,
                                              tmp->user_data);
                                 free(tmp);
+                                eloop.stats.timeouts_fired++;
+                                eloop.stats.timeout_batches++;
+                                eloop.stats.last_batch = 1;
+                                eloop.stats.max_batch = 1;
                         }
 
                 }
@@ -389,6 +452,13 @@ void eloop_destroy(void)
 }
 
 
+int eloop_fork_cleanup(int keep_sock)
+{
+        /* Not supported; the registered sockets are not closed */
+        return -1;
+}
+
+
 int eloop_terminated(void)
 {
         return eloop.terminate;
@@ -404,6 +474,12 @@ void eloop_wait_for_read_sock(int sock)
 }
 
 
+void eloop_get_stats(struct eloop_stats *stats)
+{
+        memcpy(stats, &eloop.stats, sizeof(*stats));
+}
+
+
 void * eloop_get_user_data(void)
 {
         return eloop.user_data;
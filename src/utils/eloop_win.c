@@ -35,11 +35,12 @@ struct eloop_event {
 };
 
 struct eloop_timeout {
-        struct os_time time;
+        struct os_reltime time;
         void *eloop_data;
         void *user_data;
         eloop_timeout_handler handler;
         struct eloop_timeout *next;
+        struct eloop_timeout **handle;
 };
 
 struct eloop_signal {
@@ -69,6 +70,8 @@ struct eloop_data {
         int terminate;
         int reader_table_changed;
 
+        struct eloop_stats stats;
+
         struct eloop_signal term_signal;
         HANDLE term_event;
 
@@ -241,16 +244,17 @@ void eloop_unregister_event(void *event, size_t event_size)
 }
 
 
-int eloop_register_timeout(unsigned int secs, unsigned int usecs,
-                           eloop_timeout_handler handler,
-                           void *eloop_data, void *user_data)
+static int eloop_timeout_add(unsigned int secs, unsigned int usecs,
+                             eloop_timeout_handler handler,
+                             void *eloop_data, void *user_data,
+                             struct eloop_timeout **handle)
 {
         struct eloop_timeout *timeout, *tmp, *prev;
 
         timeout = os_malloc(sizeof(*timeout));
         if (timeout == NULL)
                 return -1;
-        os_get_time(&timeout->time);
+        os_get_reltime(&timeout->time);
         timeout->time.sec += secs;
         timeout->time.usec += usecs;
         while (timeout->time.usec >= 1000000) {
@@ -261,6 +265,9 @@ int eloop_register_timeout(unsigned int secs, unsigned int usecs,
         timeout->user_data = user_data;
         timeout->handler = handler;
         timeout->next = NULL;
+        timeout->handle = handle;
+        if (handle)
+                *handle = timeout;
 
         if (eloop.timeout == NULL) {
                 eloop.timeout = timeout;
@@ -270,7 +277,7 @@ int eloop_register_timeout(unsigned int secs, unsigned int usecs,
         prev = NULL;
         tmp = eloop.timeout;
         while (tmp != NULL) {
-                if (os_time_before(&timeout->time, &tmp->time))
+                if (os_reltime_before(&timeout->time, &tmp->time))
                         break;
                 prev = tmp;
                 tmp = tmp->next;
@@ -288,6 +295,51 @@ int eloop_register_timeout(unsigned int secs, unsigned int usecs,
 }
 
 
+int eloop_register_timeout(unsigned int secs, unsigned int usecs,
+                           eloop_timeout_handler handler,
+                           void *eloop_data, void *user_data)
+{
+        return eloop_timeout_add(secs, usecs, handler, eloop_data, user_data,
+                                 NULL);
+}
+
+
+int eloop_register_timeout_handle(unsigned int secs, unsigned int usecs,
+                                  eloop_timeout_handler handler,
+                                  void *eloop_data, void *user_data,
+                                  struct eloop_timeout **handle)
+{
+        eloop_cancel_timeout_handle(handle);
+        return eloop_timeout_add(secs, usecs, handler, eloop_data, user_data,
+                                 handle);
+}
+
+
+int eloop_cancel_timeout_handle(struct eloop_timeout **handle)
+{
+        struct eloop_timeout *timeout, *prev;
+
+        if (*handle == NULL)
+                return 0;
+
+        prev = NULL;
+        timeout = eloop.timeout;
+        while (timeout != NULL && timeout != *handle) {
+                prev = timeout;
+                timeout = timeout->next;
+        }
+        *handle = NULL;
+        if (timeout == NULL)
+                return 0;
+        if (prev == NULL)
+                eloop.timeout = timeout->next;
+        else
+                prev->next = timeout->next;
+        os_free(timeout);
+        return 1;
+}
+
+
 int eloop_cancel_timeout(eloop_timeout_handler handler,
                          void *eloop_data, void *user_data)
 {
@@ -308,6 +360,8 @@ int eloop_cancel_timeout(eloop_timeout_handler handler,
                                 eloop.timeout = next;
                         else
                                 prev->next = next;
+                        if (timeout->handle)
+                                *timeout->handle = NULL;
                         os_free(timeout);
                         removed++;
                 } else
@@ -456,7 +510,7 @@ int eloop_register_signal_reconfig(eloop_signal_handler handler,
 
 void eloop_run(void)
 {
-        struct os_time tv, now;
+        struct os_reltime tv, now;
         DWORD count, ret, timeout, err;
         size_t i;
 
@@ -465,9 +519,10 @@ void eloop_run(void)
                 eloop.event_count > 0)) {
                 tv.sec = tv.usec = 0;
                 if (eloop.timeout) {
-                        os_get_time(&now);
-                        if (os_time_before(&now, &eloop.timeout->time))
-                                os_time_sub(&eloop.timeout->time, &now, &tv);
+                        os_get_reltime(&now);
+                        if (os_reltime_before(&now, &eloop.timeout->time))
+                                os_reltime_sub(&eloop.timeout->time, &now,
+                                               &tv);
                 }
 
                 count = 0;
@@ -500,19 +555,26 @@ void eloop_run(void)
 #endif /* _WIN32_WCE */
                 err = GetLastError();
 
+                eloop.stats.wakeups++;
                 eloop_process_pending_signals();
 
                 /* check if some registered timeouts have occurred */
                 if (eloop.timeout) {
                         struct eloop_timeout *tmp;
 
-                        os_get_time(&now);
-                        if (!os_time_before(&now, &eloop.timeout->time)) {
+                        os_get_reltime(&now);
+                        if (!os_reltime_before(&now, &eloop.timeout->time)) {
                                 tmp = eloop.timeout;
                                 eloop.timeout = eloop.timeout->next;
+                                if (tmp->handle)
+                                        *tmp->handle = NULL;
                                 tmp->handler(tmp->eloop_data,
                                              tmp->user_data);
                                 os_free(tmp);
+                                eloop.stats.timeouts_fired++;
+                                eloop.stats.timeout_batches++;
+                                eloop.stats.last_batch = 1;
+                                eloop.stats.max_batch = 1;
                         }
 
                 }
@@ -588,6 +650,13 @@ void eloop_destroy(void)
 }
 
 
+int eloop_fork_cleanup(int keep_sock)
+{
+        /* Not supported; the registered sockets are not closed */
+        return -1;
+}
+
+
 int eloop_terminated(void)
 {
         return eloop.terminate;
@@ -616,6 +685,12 @@ void eloop_wait_for_read_sock(int sock)
 }
 
 
+void eloop_get_stats(struct eloop_stats *stats)
+{
+        os_memcpy(stats, &eloop.stats, sizeof(*stats));
+}
+
+
 void * eloop_get_user_data(void)
 {
         return eloop.user_data;
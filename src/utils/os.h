@@ -52,6 +52,33 @@ int os_get_time(struct os_time *t);
   } \
 } while (0)
 
+/**
+ * struct os_reltime - Relative time (monotonic clock)
+ *
+ * Values are only meaningful relative to each other; they are not affected by
+ * changes to the system wall clock time. Use this for timers and timeouts and
+ * struct os_time for timestamps that are reported or compared to calendar
+ * time (e.g., log messages and certificate validity).
+ */
+struct os_reltime {
+  os_time_t sec;
+  os_time_t usec;
+};
+
+/**
+ * os_get_reltime - Get relative time (sec, usec)
+ * @t: Pointer to buffer for the time
+ * Returns: 0 on success, -1 on failure
+ */
+int os_get_reltime(struct os_reltime *t);
+
+
+/* Helper macros for handling struct os_reltime */
+
+#define os_reltime_before(a, b) os_time_before((a), (b))
+
+#define os_reltime_sub(a, b, res) os_time_sub((a), (b), (res))
+
 /**
  * os_mktime - Convert broken-down time into seconds since 1970-01-01
  * @year: Four digit year
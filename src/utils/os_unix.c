@@ -36,6 +36,22 @@ int os_get_time(struct os_time *t)
 }
 
 
+int os_get_reltime(struct os_reltime *t)
+{
+#ifdef CLOCK_MONOTONIC
+        struct timespec ts;
+
+        if (clock_gettime(CLOCK_MONOTONIC, &ts) == 0) {
+                t->sec = ts.tv_sec;
+                t->usec = ts.tv_nsec / 1000;
+                return 0;
+        }
+#endif /* CLOCK_MONOTONIC */
+        /* Fall back to wall clock time if monotonic clock is not available */
+        return os_get_time((struct os_time *) t);
+}
+
+
 int os_mktime(int year, int month, int day, int hour, int min, int sec,
               os_time_t *t)
 {
@@ -52,6 +52,21 @@ int os_get_time(struct os_time *t)
 }
 
 
+int os_get_reltime(struct os_reltime *t)
+{
+        LARGE_INTEGER freq, count;
+
+        if (QueryPerformanceFrequency(&freq) && freq.QuadPart > 0 &&
+            QueryPerformanceCounter(&count)) {
+                t->sec = (os_time_t) (count.QuadPart / freq.QuadPart);
+                t->usec = (os_time_t) ((count.QuadPart % freq.QuadPart) *
+                                       1000000 / freq.QuadPart);
+                return 0;
+        }
+        return os_get_time((struct os_time *) t);
+}
+
+
 int os_mktime(int year, int month, int day, int hour, int min, int sec,
               os_time_t *t)
 {
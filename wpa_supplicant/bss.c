@@ -0,0 +1,581 @@
+/*
+ * wpa_supplicant - BSS table
+ * Copyright (c) 2026, agent <agent@local>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * Alternatively, this software may be distributed under the terms of BSD
+ * license.
+ *
+ * See README and COPYING for more details.
+ */
+
+#include "includes.h"
+
+#include "common.h"
+#include "wpa.h"
+#include "drivers/driver.h"
+#include "wpa_supplicant_i.h"
+#include "ieee802_11_defs.h"
+#include "wps/wps.h"
+#include "config_ssid.h"
+#include "bss.h"
+
+
+static unsigned int wpa_bss_hash(const u8 *bssid)
+{
+        return (bssid[4] ^ bssid[5]) & (WPA_BSS_HASH_SIZE - 1);
+}
+
+
+static void wpa_bss_unlink(struct wpa_supplicant *wpa_s, struct wpa_bss *bss)
+{
+        if (bss->prev)
+                bss->prev->next = bss->next;
+        else
+                wpa_s->bss = bss->next;
+        if (bss->next)
+                bss->next->prev = bss->prev;
+        else
+                wpa_s->bss_tail = bss->prev;
+        bss->next = bss->prev = NULL;
+}
+
+
+static void wpa_bss_link_tail(struct wpa_supplicant *wpa_s,
+                              struct wpa_bss *bss)
+{
+        bss->prev = wpa_s->bss_tail;
+        bss->next = NULL;
+        if (wpa_s->bss_tail)
+                wpa_s->bss_tail->next = bss;
+        else
+                wpa_s->bss = bss;
+        wpa_s->bss_tail = bss;
+}
+
+
+static void wpa_bss_remove(struct wpa_supplicant *wpa_s, struct wpa_bss *bss)
+{
+        struct wpa_bss **pos;
+
+        pos = &wpa_s->bss_hash[wpa_bss_hash(bss->bssid)];
+        while (*pos && *pos != bss)
+                pos = &(*pos)->hnext;
+        if (*pos)
+                *pos = bss->hnext;
+
+        wpa_bss_unlink(wpa_s, bss);
+        wpa_s->num_bss--;
+        wpa_printf(MSG_DEBUG, "BSS: Remove id %u BSSID " MACSTR " SSID '%s'",
+                   bss->id, MAC2STR(bss->bssid),
+                   wpa_ssid_txt(bss->ssid, bss->ssid_len));
+        os_free(bss->res);
+        os_free(bss);
+}
+
+
+/**
+ * wpa_bss_get - Fetch a BSS table entry based on BSSID and SSID
+ * @wpa_s: Pointer to wpa_supplicant data
+ * @bssid: BSSID
+ * @ssid: SSID
+ * @ssid_len: Length of @ssid
+ * Returns: Pointer to the BSS entry or %NULL if not found
+ */
+struct wpa_bss * wpa_bss_get(struct wpa_supplicant *wpa_s, const u8 *bssid,
+                             const u8 *ssid, size_t ssid_len)
+{
+        struct wpa_bss *bss;
+
+        for (bss = wpa_s->bss_hash[wpa_bss_hash(bssid)]; bss;
+             bss = bss->hnext) {
+                if (os_memcmp(bss->bssid, bssid, ETH_ALEN) == 0 &&
+                    bss->ssid_len == ssid_len &&
+                    os_memcmp(bss->ssid, ssid, ssid_len) == 0)
+                        return bss;
+        }
+        return NULL;
+}
+
+
+/**
+ * wpa_bss_get_bssid - Fetch the most recently updated BSS entry for a BSSID
+ * @wpa_s: Pointer to wpa_supplicant data
+ * @bssid: BSSID
+ * Returns: Pointer to the BSS entry or %NULL if not found
+ */
+struct wpa_bss * wpa_bss_get_bssid(struct wpa_supplicant *wpa_s,
+                                   const u8 *bssid)
+{
+        struct wpa_bss *bss, *found = NULL;
+
+        for (bss = wpa_s->bss_hash[wpa_bss_hash(bssid)]; bss;
+             bss = bss->hnext) {
+                if (os_memcmp(bss->bssid, bssid, ETH_ALEN) != 0)
+                        continue;
+                if (found == NULL ||
+                    bss->last_update_idx > found->last_update_idx)
+                        found = bss;
+        }
+        return found;
+}
+
+
+/**
+ * wpa_bss_age - Get the number of seconds since a BSS was last seen
+ * @bss: BSS table entry
+ * Returns: Age of the entry in seconds
+ */
+unsigned int wpa_bss_age(struct wpa_bss *bss)
+{
+        struct os_reltime now, age;
+
+        os_get_reltime(&now);
+        os_reltime_sub(&now, &bss->last_seen, &age);
+        return age.sec;
+}
+
+
+static void wpa_bss_parse_ies(struct wpa_bss *bss)
+{
+        const struct wpa_scan_res *res = bss->res;
+        const u8 *ie;
+#ifdef CONFIG_WPS
+        struct wpabuf *wps_ie;
+#endif /* CONFIG_WPS */
+
+        bss->flags = 0;
+
+        ie = wpa_scan_get_vendor_ie(res, WPA_IE_VENDOR_TYPE);
+        if (ie) {
+                bss->flags |= WPA_BSS_WPA_IE;
+                if (wpa_parse_wpa_ie(ie, 2 + ie[1], &bss->wpa) == 0)
+                        bss->flags |= WPA_BSS_WPA_IE_VALID;
+        }
+
+        ie = wpa_scan_get_ie(res, WLAN_EID_RSN);
+        if (ie) {
+                bss->flags |= WPA_BSS_RSN_IE;
+                if (wpa_parse_wpa_ie(ie, 2 + ie[1], &bss->rsn) == 0)
+                        bss->flags |= WPA_BSS_RSN_IE_VALID;
+        }
+
+        bss->max_rate = wpa_scan_get_max_rate(res);
+
+#ifdef CONFIG_WPS
+        wps_ie = wpa_scan_get_vendor_ie_multi(res, WPS_IE_VENDOR_TYPE);
+        if (wps_ie) {
+                bss->flags |= WPA_BSS_WPS;
+                if (wps_is_selected_pbc_registrar(wps_ie))
+                        bss->flags |= WPA_BSS_WPS_PBC;
+                else if (wps_is_selected_pin_registrar(wps_ie))
+                        bss->flags |= WPA_BSS_WPS_PIN;
+                wpabuf_free(wps_ie);
+        }
+#endif /* CONFIG_WPS */
+}
+
+
+static int wpa_bss_copy_res(struct wpa_bss *bss, struct wpa_scan_res *res)
+{
+        struct wpa_scan_res *copy;
+        size_t len = wpa_scan_res_size(res);
+        int changed;
+
+        changed = bss->res == NULL || bss->res->ie_len != res->ie_len ||
+                os_memcmp(bss->res + 1, res + 1, res->ie_len) != 0;
+
+        if (bss->res == NULL || wpa_scan_res_size(bss->res) != len) {
+                copy = os_realloc(bss->res, len);
+                if (copy == NULL)
+                        return -1;
+                bss->res = copy;
+        }
+        os_memcpy(bss->res, res, len);
+
+        bss->freq = res->freq;
+        if (bss->last_update_idx == 0)
+                bss->level_avg = res->level;
+        else
+                bss->level_avg = (3 * bss->level_avg + res->level) / 4;
+
+        if (changed)
+                wpa_bss_parse_ies(bss);
+
+        return 0;
+}
+
+
+/*
+ * Make room for a new entry when the table is full by removing the least
+ * recently updated entry. Entries included in the current scan (they are
+ * referenced from last_scan_res) and the current BSS are never removed.
+ */
+static int wpa_bss_make_room(struct wpa_supplicant *wpa_s)
+{
+        struct wpa_bss *bss;
+
+        if (wpa_s->num_bss < WPA_BSS_MAX_COUNT)
+                return 0;
+
+        for (bss = wpa_s->bss; bss; bss = bss->next) {
+                if (bss->last_update_idx == wpa_s->bss_update_idx)
+                        return -1;
+                if (os_memcmp(bss->bssid, wpa_s->bssid, ETH_ALEN) != 0)
+                        break;
+        }
+        if (bss == NULL)
+                return -1;
+
+        wpa_printf(MSG_DEBUG, "BSS: Table full (%u entries)",
+                   (unsigned int) wpa_s->num_bss);
+        wpa_bss_remove(wpa_s, bss);
+        return 0;
+}
+
+
+static struct wpa_bss * wpa_bss_add(struct wpa_supplicant *wpa_s,
+                                    const u8 *ssid, size_t ssid_len,
+                                    struct wpa_scan_res *res)
+{
+        struct wpa_bss *bss;
+        unsigned int hash;
+
+        if (wpa_bss_make_room(wpa_s) < 0) {
+                wpa_printf(MSG_DEBUG, "BSS: Table full - ignore BSSID "
+                           MACSTR, MAC2STR(res->bssid));
+                return NULL;
+        }
+
+        bss = os_zalloc(sizeof(*bss));
+        if (bss == NULL)
+                return NULL;
+        if (wpa_bss_copy_res(bss, res) < 0) {
+                os_free(bss);
+                return NULL;
+        }
+
+        bss->id = wpa_s->bss_next_id++;
+        os_memcpy(bss->bssid, res->bssid, ETH_ALEN);
+        os_memcpy(bss->ssid, ssid, ssid_len);
+        bss->ssid_len = ssid_len;
+        os_get_reltime(&bss->first_seen);
+
+        hash = wpa_bss_hash(bss->bssid);
+        bss->hnext = wpa_s->bss_hash[hash];
+        wpa_s->bss_hash[hash] = bss;
+        wpa_bss_link_tail(wpa_s, bss);
+        wpa_s->num_bss++;
+
+        wpa_printf(MSG_DEBUG, "BSS: Add new id %u BSSID " MACSTR " SSID '%s'",
+                   bss->id, MAC2STR(bss->bssid),
+                   wpa_ssid_txt(ssid, ssid_len));
+
+        return bss;
+}
+
+
+static void wpa_bss_ess_chan_seen(struct wpa_ess_chans *ess, int freq,
+                                  struct os_reltime *seen)
+{
+        struct wpa_ess_chan *chan = NULL;
+        size_t i;
+
+        if (freq <= 0)
+                return;
+
+        for (i = 0; i < ess->num_chan; i++) {
+                if (ess->chan[i].freq == freq) {
+                        chan = &ess->chan[i];
+                        break;
+                }
+        }
+        if (chan == NULL && ess->num_chan < WPA_ESS_CHAN_MAX)
+                chan = &ess->chan[ess->num_chan++];
+        if (chan == NULL) {
+                /* Replace the channel that has not been seen for longest */
+                chan = &ess->chan[0];
+                for (i = 1; i < ess->num_chan; i++) {
+                        if (os_reltime_before(&ess->chan[i].last_seen,
+                                              &chan->last_seen))
+                                chan = &ess->chan[i];
+                }
+        }
+
+        if (chan->freq == freq &&
+            os_reltime_before(seen, &chan->last_seen))
+                return;
+        chan->freq = freq;
+        chan->last_seen = *seen;
+}
+
+
+/*
+ * Find the channel history for an ESS or add one (seeded from the BSS table).
+ * The list is kept in most recently used order and the entries after the
+ * first WPA_ESS_HIST_MAX ones are dropped.
+ */
+static struct wpa_ess_chans * wpa_bss_ess_get(struct wpa_supplicant *wpa_s,
+                                              const u8 *ssid, size_t ssid_len)
+{
+        struct wpa_ess_chans *ess, *prev = NULL;
+        struct wpa_bss *bss;
+        int count;
+
+        for (ess = wpa_s->ess_chans; ess; prev = ess, ess = ess->next) {
+                if (ess->ssid_len == ssid_len &&
+                    os_memcmp(ess->ssid, ssid, ssid_len) == 0)
+                        break;
+        }
+
+        if (ess) {
+                if (prev) {
+                        prev->next = ess->next;
+                        ess->next = wpa_s->ess_chans;
+                        wpa_s->ess_chans = ess;
+                }
+                return ess;
+        }
+
+        ess = os_zalloc(sizeof(*ess));
+        if (ess == NULL)
+                return NULL;
+        os_memcpy(ess->ssid, ssid, ssid_len);
+        ess->ssid_len = ssid_len;
+        for (bss = wpa_s->bss; bss; bss = bss->next) {
+                if (bss->ssid_len == ssid_len &&
+                    os_memcmp(bss->ssid, ssid, ssid_len) == 0)
+                        wpa_bss_ess_chan_seen(ess, bss->freq,
+                                              &bss->last_seen);
+        }
+        ess->next = wpa_s->ess_chans;
+        wpa_s->ess_chans = ess;
+
+        /* Drop the least recently used entry; the new one stays at the front */
+        for (prev = ess, count = 1; prev->next; prev = prev->next, count++) {
+                if (count == WPA_ESS_HIST_MAX) {
+                        os_free(prev->next);
+                        prev->next = NULL;
+                        break;
+                }
+        }
+
+        return ess;
+}
+
+
+/**
+ * wpa_bss_ess_freqs - Get the channels on which an ESS has recently been seen
+ * @wpa_s: Pointer to wpa_supplicant data
+ * @ssid: SSID of the ESS
+ * @ssid_len: Length of @ssid
+ * Returns: Allocated zero-terminated array of frequencies (in MHz) or %NULL if
+ * no recent channels are known or on allocation failure
+ */
+int * wpa_bss_ess_freqs(struct wpa_supplicant *wpa_s, const u8 *ssid,
+                        size_t ssid_len)
+{
+        struct wpa_ess_chans *ess;
+        struct os_reltime now, age;
+        int *freqs;
+        size_t i, num = 0;
+
+        ess = wpa_bss_ess_get(wpa_s, ssid, ssid_len);
+        if (ess == NULL || ess->num_chan == 0)
+                return NULL;
+
+        freqs = os_malloc((ess->num_chan + 1) * sizeof(int));
+        if (freqs == NULL)
+                return NULL;
+
+        os_get_reltime(&now);
+        for (i = 0; i < ess->num_chan; i++) {
+                os_reltime_sub(&now, &ess->chan[i].last_seen, &age);
+                if (age.sec < WPA_ESS_CHAN_AGE)
+                        freqs[num++] = ess->chan[i].freq;
+        }
+        freqs[num] = 0;
+
+        if (num == 0) {
+                os_free(freqs);
+                return NULL;
+        }
+        return freqs;
+}
+
+
+static int wpa_bss_in_scan(const int *freqs, int freq)
+{
+        if (freqs == NULL)
+                return 1;
+        for (; *freqs; freqs++) {
+                if (*freqs == freq)
+                        return 1;
+        }
+        return 0;
+}
+
+
+/*
+ * Count a missed scan only for entries on the channels that were scanned, so
+ * that roaming scans limited to a few channels do not expire the rest of the
+ * table. The entries at the tail of the list were updated by this scan.
+ */
+static void wpa_bss_count_misses(struct wpa_supplicant *wpa_s)
+{
+        struct wpa_bss *bss;
+
+        for (bss = wpa_s->bss; bss; bss = bss->next) {
+                if (bss->last_update_idx == wpa_s->bss_update_idx)
+                        break;
+                if (wpa_bss_in_scan(wpa_s->last_scan_freqs, bss->freq))
+                        bss->scan_miss_count++;
+        }
+}
+
+
+/*
+ * The table is ordered by last update, so expired entries are always at the
+ * head of the list and expiration stops at the first entry that is recent
+ * enough. Entries that are old enough, but have not been missed by enough
+ * scans of their channel, are skipped.
+ */
+static void wpa_bss_expire(struct wpa_supplicant *wpa_s,
+                           struct os_reltime *now)
+{
+        struct wpa_bss *bss, *next;
+        struct os_reltime age;
+
+        for (bss = wpa_s->bss; bss; bss = next) {
+                next = bss->next;
+                if (bss->last_update_idx == wpa_s->bss_update_idx)
+                        break;
+                os_reltime_sub(now, &bss->last_seen, &age);
+                if (age.sec < WPA_BSS_EXPIRATION_AGE)
+                        break;
+                if (bss->scan_miss_count >= WPA_BSS_EXPIRATION_SCAN_COUNT)
+                        wpa_bss_remove(wpa_s, bss);
+        }
+}
+
+
+/**
+ * wpa_bss_update_scan_res - Update the BSS table from new scan results
+ * @wpa_s: Pointer to wpa_supplicant data
+ * @scan_res: Scan results (sorted in order of preference)
+ * Returns: 0 on success, -1 on failure
+ *
+ * This function adds new entries and updates existing ones based on the scan
+ * results and expires entries that have not been seen for a while. The
+ * entries included in the scan are stored in wpa_s->last_scan_res in the same
+ * order as in @scan_res.
+ */
+int wpa_bss_update_scan_res(struct wpa_supplicant *wpa_s,
+                            struct wpa_scan_results *scan_res)
+{
+        struct wpa_bss *bss, **n;
+        struct wpa_ess_chans *ess;
+        struct wpa_ssid *ssid;
+        struct os_reltime now;
+        size_t i;
+
+        wpa_s->last_scan_res_used = 0;
+        if (scan_res->num > wpa_s->last_scan_res_size) {
+                n = os_realloc(wpa_s->last_scan_res,
+                               scan_res->num * sizeof(struct wpa_bss *));
+                if (n == NULL)
+                        return -1;
+                wpa_s->last_scan_res = n;
+                wpa_s->last_scan_res_size = scan_res->num;
+        }
+
+        os_get_reltime(&now);
+        wpa_s->bss_update_idx++;
+
+        ssid = wpa_s->current_ssid;
+        ess = ssid && ssid->ssid_len ?
+                wpa_bss_ess_get(wpa_s, ssid->ssid, ssid->ssid_len) : NULL;
+
+        for (i = 0; i < scan_res->num; i++) {
+                struct wpa_scan_res *res = scan_res->res[i];
+                const u8 *ie;
+                size_t ssid_len;
+
+                if (res == NULL)
+                        continue;
+                ie = wpa_scan_get_ie(res, WLAN_EID_SSID);
+                ssid_len = ie ? ie[1] : 0;
+                if (ssid_len > 32) {
+                        wpa_printf(MSG_DEBUG, "BSS: Ignore result with "
+                                   "invalid SSID IE from " MACSTR,
+                                   MAC2STR(res->bssid));
+                        continue;
+                }
+                ie = ie ? ie + 2 : (const u8 *) "";
+
+                bss = wpa_bss_get(wpa_s, res->bssid, ie, ssid_len);
+                if (bss == NULL) {
+                        bss = wpa_bss_add(wpa_s, ie, ssid_len, res);
+                        if (bss == NULL)
+                                continue;
+                } else if (bss->last_update_idx == wpa_s->bss_update_idx) {
+                        /* Duplicate entry; keep the preferred one */
+                        continue;
+                } else {
+                        if (wpa_bss_copy_res(bss, res) < 0)
+                                continue;
+                        wpa_bss_unlink(wpa_s, bss);
+                        wpa_bss_link_tail(wpa_s, bss);
+                }
+
+                bss->last_seen = now;
+                bss->last_update_idx = wpa_s->bss_update_idx;
+                bss->scan_miss_count = 0;
+                wpa_s->last_scan_res[wpa_s->last_scan_res_used++] = bss;
+
+                if (ess && ess->ssid_len == ssid_len &&
+                    os_memcmp(ess->ssid, ie, ssid_len) == 0)
+                        wpa_bss_ess_chan_seen(ess, bss->freq, &now);
+        }
+
+        wpa_bss_count_misses(wpa_s);
+        wpa_bss_expire(wpa_s, &now);
+
+        return 0;
+}
+
+
+/**
+ * wpa_bss_flush - Remove all entries from the BSS table
+ * @wpa_s: Pointer to wpa_supplicant data
+ */
+void wpa_bss_flush(struct wpa_supplicant *wpa_s)
+{
+        wpa_s->last_scan_res_used = 0;
+        while (wpa_s->bss)
+                wpa_bss_remove(wpa_s, wpa_s->bss);
+}
+
+
+/**
+ * wpa_bss_deinit - Free the BSS table
+ * @wpa_s: Pointer to wpa_supplicant data
+ */
+void wpa_bss_deinit(struct wpa_supplicant *wpa_s)
+{
+        struct wpa_ess_chans *ess;
+
+        wpa_bss_flush(wpa_s);
+        while ((ess = wpa_s->ess_chans) != NULL) {
+                wpa_s->ess_chans = ess->next;
+                os_free(ess);
+        }
+        os_free(wpa_s->last_scan_res);
+        wpa_s->last_scan_res = NULL;
+        os_free(wpa_s->last_scan_freqs);
+        wpa_s->last_scan_freqs = NULL;
+        wpa_s->last_scan_res_size = 0;
+}
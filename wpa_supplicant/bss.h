@@ -0,0 +1,163 @@
+/*
+ * wpa_supplicant - BSS table
+ * Copyright (c) 2026, agent <agent@local>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * Alternatively, this software may be distributed under the terms of BSD
+ * license.
+ *
+ * See README and COPYING for more details.
+ */
+
+#ifndef BSS_H
+#define BSS_H
+
+#include "wpa_common.h"
+
+struct wpa_scan_res;
+struct wpa_scan_results;
+
+#define WPA_BSS_WPA_IE          BIT(0)
+#define WPA_BSS_WPA_IE_VALID    BIT(1)
+#define WPA_BSS_RSN_IE          BIT(2)
+#define WPA_BSS_RSN_IE_VALID    BIT(3)
+#define WPA_BSS_WPS             BIT(4)
+#define WPA_BSS_WPS_PBC         BIT(5)
+#define WPA_BSS_WPS_PIN         BIT(6)
+
+/*
+ * Remove entries missed by this many scans of their channel and not seen for
+ * this many seconds
+ */
+#define WPA_BSS_EXPIRATION_SCAN_COUNT 2
+#define WPA_BSS_EXPIRATION_AGE 180
+/* Maximum number of entries; the least recently updated one is replaced */
+#define WPA_BSS_MAX_COUNT 200
+
+/**
+ * struct wpa_bss - BSS table entry
+ *
+ * Entries are keyed by BSSID and SSID and are kept across scans. The
+ * information elements are parsed only when they change so that BSS
+ * selection and the control interface do not need to walk the raw IE data.
+ */
+struct wpa_bss {
+  /**
+   * next - Next (more recently updated) entry in the table
+   */
+  struct wpa_bss *next;
+
+  /**
+   * prev - Previous (less recently updated) entry in the table
+   */
+  struct wpa_bss *prev;
+
+  /**
+   * hnext - Next entry in the same BSSID hash bucket
+   */
+  struct wpa_bss *hnext;
+
+  /**
+   * id - Unique identifier for this entry
+   */
+  unsigned int id;
+
+  /**
+   * flags - WPA_BSS_* flags from IE parsing
+   */
+  unsigned int flags;
+
+  u8 bssid[ETH_ALEN];
+  u8 ssid[32];
+  size_t ssid_len;
+  int freq;
+
+  /**
+   * max_rate - Highest supported rate in units of 500 kbps
+   */
+  int max_rate;
+
+  /**
+   * level_avg - Exponentially weighted average of the signal level
+   */
+  int level_avg;
+
+  /**
+   * wpa - Parsed WPA IE (valid if WPA_BSS_WPA_IE_VALID is set)
+   */
+  struct wpa_ie_data wpa;
+
+  /**
+   * rsn - Parsed RSN IE (valid if WPA_BSS_RSN_IE_VALID is set)
+   */
+  struct wpa_ie_data rsn;
+
+  /**
+   * first_seen - Time when the entry was added
+   */
+  struct os_reltime first_seen;
+
+  /**
+   * last_seen - Time of the last scan that included this BSS
+   */
+  struct os_reltime last_seen;
+
+  /**
+   * last_update_idx - Value of wpa_s->bss_update_idx at last update
+   */
+  unsigned int last_update_idx;
+
+  /**
+   * scan_miss_count - Number of scans of this channel that missed the BSS
+   */
+  unsigned int scan_miss_count;
+
+  /**
+   * res - Copy of the latest scan result for this BSS
+   *
+   * The IEs follow the structure as with struct wpa_scan_res, so this can
+   * be used with wpa_scan_get_ie() and when requesting association.
+   */
+  struct wpa_scan_res *res;
+};
+
+/* Channel history kept for the most recently used ESSes */
+#define WPA_ESS_CHAN_MAX 16
+#define WPA_ESS_CHAN_AGE 600
+#define WPA_ESS_HIST_MAX 4
+
+/**
+ * struct wpa_ess_chans - Channels on which an ESS has recently been seen
+ *
+ * This is maintained for the ESS of the current network from all scans and
+ * used to limit background roaming scans to the channels that are in use by
+ * the ESS. The history outlives the BSS table entries so that APs on
+ * channels that are not included in partial scans are not forgotten.
+ */
+struct wpa_ess_chans {
+  struct wpa_ess_chans *next;
+  u8 ssid[32];
+  size_t ssid_len;
+  size_t num_chan;
+  struct wpa_ess_chan {
+    int freq;
+    struct os_reltime last_seen;
+  } chan[WPA_ESS_CHAN_MAX];
+};
+
+void wpa_bss_deinit(struct wpa_supplicant *wpa_s);
+void wpa_bss_flush(struct wpa_supplicant *wpa_s);
+int wpa_bss_update_scan_res(struct wpa_supplicant *wpa_s,
+                            struct wpa_scan_results *scan_res);
+struct wpa_bss * wpa_bss_get(struct wpa_supplicant *wpa_s, const u8 *bssid,
+                             const u8 *ssid, size_t ssid_len);
+struct wpa_bss * wpa_bss_get_bssid(struct wpa_supplicant *wpa_s,
+                                   const u8 *bssid);
+unsigned int wpa_bss_age(struct wpa_bss *bss);
+int * wpa_bss_ess_freqs(struct wpa_supplicant *wpa_s, const u8 *ssid,
+                        size_t ssid_len);
+
+#endif /* BSS_H */
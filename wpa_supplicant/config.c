@@ -370,6 +370,7 @@ static int wpa_config_parse_psk(const struct parse_data *data,
         ssid->passphrase = NULL;
 
         ssid->psk_set = 1;
+        ssid->psk_pending = 0;
         wpa_hexdump_key(MSG_MSGDUMP, "PSK", ssid->psk, PMK_LEN);
         return 0;
 }
@@ -1413,6 +1414,179 @@ static const struct parse_data ssid_fields[] = {
 #undef FUNC_KEY
 #define NUM_SSID_FIELDS (sizeof(ssid_fields) / sizeof(ssid_fields[0]))
 
+static struct wpa_field_index ssid_fields_index;
+
+
+static unsigned int wpa_config_field_hash(const char *name, size_t len)
+{
+        unsigned int hash = 2166136261U;
+        size_t i;
+
+        for (i = 0; i < len; i++) {
+                hash ^= (u8) name[i];
+                hash *= 16777619;
+        }
+        return hash;
+}
+
+
+/* Field tables have the name as the first member of each entry */
+static const char * wpa_config_field_name(const void *table,
+                                          size_t entry_size, size_t i)
+{
+        return *(char * const *) ((const u8 *) table + i * entry_size);
+}
+
+
+static void wpa_config_field_index_build(struct wpa_field_index *idx,
+                                         const void *table, size_t entry_size,
+                                         size_t num)
+{
+        const char *name;
+        unsigned int pos;
+        size_t i;
+
+        if (num >= WPA_FIELD_INDEX_SIZE / 2) {
+                idx->state = -1;
+                return;
+        }
+
+        os_memset(idx->slot, 0, sizeof(idx->slot));
+        for (i = 0; i < num; i++) {
+                name = wpa_config_field_name(table, entry_size, i);
+                pos = wpa_config_field_hash(name, os_strlen(name));
+                while (idx->slot[pos % WPA_FIELD_INDEX_SIZE])
+                        pos++;
+                idx->slot[pos % WPA_FIELD_INDEX_SIZE] = i + 1;
+        }
+        idx->state = 1;
+}
+
+
+/**
+ * wpa_config_field_lookup - Find a field by name in a field table
+ * @idx: Name index for the table (zero initialized before the first call)
+ * @table: Field table; the first member of each entry is the name (char *)
+ * @entry_size: Size of a table entry
+ * @num: Number of entries in the table
+ * @name: Field name (does not need to be nul terminated)
+ * @name_len: Length of the name
+ * Returns: Position of the field in the table or -1 if not found
+ *
+ * The index is built on the first call. Field lookups are done for every line
+ * of the configuration file and for each network variable set or read through
+ * the control interfaces, so a hash lookup is used instead of comparing the
+ * name against every entry of the table.
+ */
+int wpa_config_field_lookup(struct wpa_field_index *idx, const void *table,
+                            size_t entry_size, size_t num, const char *name,
+                            size_t name_len)
+{
+        const char *fname;
+        unsigned int pos;
+        size_t i;
+
+        if (idx->state == 0)
+                wpa_config_field_index_build(idx, table, entry_size, num);
+
+        if (idx->state < 0) {
+                for (i = 0; i < num; i++) {
+                        fname = wpa_config_field_name(table, entry_size, i);
+                        if (os_strncmp(fname, name, name_len) == 0 &&
+                            fname[name_len] == '\0')
+                                return i;
+                }
+                return -1;
+        }
+
+        pos = wpa_config_field_hash(name, name_len);
+        while (idx->slot[pos % WPA_FIELD_INDEX_SIZE]) {
+                i = idx->slot[pos % WPA_FIELD_INDEX_SIZE] - 1;
+                fname = wpa_config_field_name(table, entry_size, i);
+                if (os_strncmp(fname, name, name_len) == 0 &&
+                    fname[name_len] == '\0')
+                        return i;
+                pos++;
+        }
+
+        return -1;
+}
+
+
+static const struct parse_data * wpa_config_get_field(const char *var)
+{
+        int i;
+
+        i = wpa_config_field_lookup(&ssid_fields_index, ssid_fields,
+                                    sizeof(ssid_fields[0]), NUM_SSID_FIELDS,
+                                    var, os_strlen(var));
+        return i < 0 ? NULL : &ssid_fields[i];
+}
+
+
+#define WPA_ID_HASH_MIN_SIZE 16
+
+
+static int wpa_config_prio_bucket(const u8 *ssid, size_t ssid_len)
+{
+        unsigned int hash = 0;
+        size_t i;
+
+        if (ssid_len == 0)
+                return -1;
+        for (i = 0; i < ssid_len; i++)
+                hash = hash * 31 + ssid[i];
+        return hash % WPA_PRIO_INDEX_SIZE;
+}
+
+
+static void wpa_config_prio_index_add(struct wpa_prio_index *pidx,
+                                      struct wpa_ssid *ssid)
+{
+        struct wpa_ssid **head, **tail;
+
+        ssid->hnext = NULL;
+        ssid->prio_bucket = wpa_config_prio_bucket(ssid->ssid, ssid->ssid_len);
+        ssid->prio_group = pidx->priority;
+        if (ssid->prio_bucket < 0) {
+                head = &pidx->wildcard;
+                tail = &pidx->wildcard_tail;
+        } else {
+                head = &pidx->ssid_hash[ssid->prio_bucket];
+                tail = &pidx->ssid_tail[ssid->prio_bucket];
+        }
+        ssid->hprev = *tail;
+        if (*tail)
+                (*tail)->hnext = ssid;
+        else
+                *head = ssid;
+        *tail = ssid;
+}
+
+
+/*
+ * Find the priority group for a priority value. The groups are sorted in
+ * decreasing priority order, so a binary search is used. Returns 1 if the
+ * group exists (its index is stored in *prio) or 0 if not (the index at which
+ * it would be inserted is stored in *prio).
+ */
+static int wpa_config_find_prio(struct wpa_config *config, int priority,
+                                int *prio)
+{
+        int lo = 0, hi = config->num_prio, mid;
+
+        while (lo < hi) {
+                mid = (lo + hi) / 2;
+                if (config->prio_index[mid].priority > priority)
+                        lo = mid + 1;
+                else
+                        hi = mid;
+        }
+        *prio = lo;
+        return lo < config->num_prio &&
+                config->prio_index[lo].priority == priority;
+}
+
 
 /**
  * wpa_config_add_prio_network - Add a network to priority lists
@@ -1422,27 +1596,30 @@ static const struct parse_data ssid_fields[] = {
  *
  * This function is used to add a network block to the priority list of
  * networks. This must be called for each network when reading in the full
- * configuration. In addition, this can be used indirectly when updating
- * priorities by calling wpa_config_update_prio_list().
+ * configuration. The network is appended to the end of its priority group, so
+ * the networks must be added in the order of the global network list.
  */
 int wpa_config_add_prio_network(struct wpa_config *config,
                                 struct wpa_ssid *ssid)
 {
         int prio;
-        struct wpa_ssid *prev, **nlist;
+        struct wpa_ssid **nlist;
+        struct wpa_prio_index *nindex, *pidx;
+
+        ssid->pnext = ssid->pprev = NULL;
 
         /*
          * Add to an existing priority list if one is available for the
          * configured priority level for this network.
          */
-        for (prio = 0; prio < config->num_prio; prio++) {
-                prev = config->pssid[prio];
-                if (prev->priority == ssid->priority) {
-                        while (prev->pnext)
-                                prev = prev->pnext;
-                        prev->pnext = ssid;
-                        return 0;
-                }
+        if (wpa_config_find_prio(config, ssid->priority, &prio)) {
+                pidx = &config->prio_index[prio];
+                ssid->pprev = pidx->tail;
+                ssid->prio_pos = pidx->tail->prio_pos + 1;
+                pidx->tail->pnext = ssid;
+                pidx->tail = ssid;
+                wpa_config_prio_index_add(pidx, ssid);
+                return 0;
         }
 
         /* First network for this priority - add a new priority list */
@@ -1450,18 +1627,90 @@ int wpa_config_add_prio_network(struct wpa_config *config,
                            (config->num_prio + 1) * sizeof(struct wpa_ssid *));
         if (nlist == NULL)
                 return -1;
+        config->pssid = nlist;
 
-        for (prio = 0; prio < config->num_prio; prio++) {
-                if (nlist[prio]->priority < ssid->priority)
-                        break;
-        }
+        nindex = os_realloc(config->prio_index,
+                            (config->num_prio + 1) *
+                            sizeof(struct wpa_prio_index));
+        if (nindex == NULL)
+                return -1;
+        config->prio_index = nindex;
 
         os_memmove(&nlist[prio + 1], &nlist[prio],
                    (config->num_prio - prio) * sizeof(struct wpa_ssid *));
+        os_memmove(&nindex[prio + 1], &nindex[prio],
+                   (config->num_prio - prio) * sizeof(struct wpa_prio_index));
 
         nlist[prio] = ssid;
+        ssid->prio_pos = 0;
+        os_memset(&nindex[prio], 0, sizeof(struct wpa_prio_index));
+        nindex[prio].priority = ssid->priority;
+        nindex[prio].tail = ssid;
+        wpa_config_prio_index_add(&nindex[prio], ssid);
         config->num_prio++;
-        config->pssid = nlist;
+
+        return 0;
+}
+
+
+/*
+ * Remove a network from the priority lists. The lists are doubly linked, so
+ * this does not depend on the number of networks. Returns -1 if the network is
+ * not in the lists; the caller must then rebuild the lists with
+ * wpa_config_update_prio_list().
+ */
+static int wpa_config_remove_prio_network(struct wpa_config *config,
+                                          struct wpa_ssid *ssid)
+{
+        struct wpa_prio_index *pidx;
+        struct wpa_ssid **head, **tail;
+        int prio;
+
+        if (!wpa_config_find_prio(config, ssid->prio_group, &prio))
+                return -1;
+        pidx = &config->prio_index[prio];
+        if (ssid->pprev ? ssid->pprev->pnext != ssid :
+            config->pssid[prio] != ssid)
+                return -1;
+
+        if (ssid->pprev)
+                ssid->pprev->pnext = ssid->pnext;
+        else
+                config->pssid[prio] = ssid->pnext;
+        if (ssid->pnext)
+                ssid->pnext->pprev = ssid->pprev;
+        else
+                pidx->tail = ssid->pprev;
+
+        if (ssid->prio_bucket < 0) {
+                head = &pidx->wildcard;
+                tail = &pidx->wildcard_tail;
+        } else {
+                head = &pidx->ssid_hash[ssid->prio_bucket];
+                tail = &pidx->ssid_tail[ssid->prio_bucket];
+        }
+        if (ssid->hprev)
+                ssid->hprev->hnext = ssid->hnext;
+        else
+                *head = ssid->hnext;
+        if (ssid->hnext)
+                ssid->hnext->hprev = ssid->hprev;
+        else
+                *tail = ssid->hprev;
+        ssid->pnext = ssid->pprev = NULL;
+        ssid->hnext = ssid->hprev = NULL;
+
+        if (config->pssid[prio] == NULL) {
+                /* Last network in the group - remove the priority list */
+                config->num_prio--;
+                os_memmove(&config->pssid[prio], &config->pssid[prio + 1],
+                           (config->num_prio - prio) *
+                           sizeof(struct wpa_ssid *));
+                os_memmove(&config->prio_index[prio],
+                           &config->prio_index[prio + 1],
+                           (config->num_prio - prio) *
+                           sizeof(struct wpa_prio_index));
+        }
 
         return 0;
 }
@@ -1472,9 +1721,10 @@ int wpa_config_add_prio_network(struct wpa_config *config,
  * @config: Configuration data from wpa_config_read()
  * Returns: 0 on success, -1 on failure
  *
- * This function is called to update the priority list of networks in the
- * configuration when a network is being added or removed. This is also called
- * if a priority for a network is changed.
+ * This function is called to rebuild the priority lists of networks in the
+ * configuration from the global network list, e.g., if the priority or SSID of
+ * a network has been changed. The per-priority SSID indexes are rebuilt at the
+ * same time.
  */
 static int wpa_config_update_prio_list(struct wpa_config *config)
 {
@@ -1483,11 +1733,13 @@ static int wpa_config_update_prio_list(struct wpa_config *config)
 
         os_free(config->pssid);
         config->pssid = NULL;
+        os_free(config->prio_index);
+        config->prio_index = NULL;
         config->num_prio = 0;
+        config->prio_stale = 0;
 
         ssid = config->ssid;
         while (ssid) {
-                ssid->pnext = NULL;
                 if (wpa_config_add_prio_network(config, ssid) < 0)
                         ret = -1;
                 ssid = ssid->next;
@@ -1497,6 +1749,71 @@ static int wpa_config_update_prio_list(struct wpa_config *config)
 }
 
 
+/**
+ * wpa_config_prio_changed - Mark priority lists stale after a network change
+ * @config: Configuration data from wpa_config_read()
+ * @var: Name of the changed network variable or %NULL if the SSID or priority
+ * was changed directly
+ *
+ * This must be called after the SSID or priority of a network in the priority
+ * lists has been changed (e.g., with SET_NETWORK or WPS), so that the lists
+ * are rebuilt by wpa_config_check_prio_index(). Other variables are ignored.
+ */
+void wpa_config_prio_changed(struct wpa_config *config, const char *var)
+{
+        if (var == NULL || os_strcmp(var, "ssid") == 0 ||
+            os_strcmp(var, "priority") == 0)
+                config->prio_stale = 1;
+}
+
+
+/**
+ * wpa_config_check_prio_index - Rebuild stale priority lists
+ * @config: Configuration data from wpa_config_read()
+ * Returns: 1 if the lists were rebuilt, 0 if not, or -1 on failure
+ *
+ * The lists are only rebuilt if they were marked stale with
+ * wpa_config_prio_changed(), so this is cheap enough to be done before each
+ * BSS selection.
+ */
+int wpa_config_check_prio_index(struct wpa_config *config)
+{
+        if (!config->prio_stale)
+                return 0;
+
+        wpa_printf(MSG_DEBUG, "Network SSID or priority changed - rebuild "
+                   "priority lists");
+        if (wpa_config_update_prio_list(config) < 0)
+                return -1;
+        return 1;
+}
+
+
+/**
+ * wpa_config_prio_ssid_list - Get indexed networks for an SSID
+ * @config: Configuration data from wpa_config_read()
+ * @prio: Index of the priority group (0 .. num_prio - 1)
+ * @ssid: SSID
+ * @ssid_len: Length of the SSID
+ * Returns: Head of the index bucket for the SSID
+ *
+ * The returned list is chained through the hnext field. It is in the same
+ * order as the pnext list and it may include networks with other SSIDs that
+ * share the same bucket, so the caller must compare the SSID. Networks without
+ * an SSID are not included; see config->prio_index[prio].wildcard.
+ */
+struct wpa_ssid * wpa_config_prio_ssid_list(struct wpa_config *config,
+                                            int prio, const u8 *ssid,
+                                            size_t ssid_len)
+{
+        int bucket = wpa_config_prio_bucket(ssid, ssid_len);
+
+        if (bucket < 0)
+                return NULL;
+        return config->prio_index[prio].ssid_hash[bucket];
+}
+
+
 #ifdef IEEE8021X_EAPOL
 static void eap_peer_config_free(struct eap_peer_config *eap)
 {
@@ -1605,10 +1922,81 @@ void wpa_config_free(struct wpa_config *config)
         os_free(config->serial_number);
         os_free(config->device_type);
         os_free(config->pssid);
+        os_free(config->prio_index);
+        os_free(config->id_hash);
         os_free(config);
 }
 
 
+static void wpa_config_id_hash_add(struct wpa_config *config,
+                                   struct wpa_ssid *ssid)
+{
+        struct wpa_ssid **bucket;
+
+        bucket = &config->id_hash[(unsigned int) ssid->id &
+                                  (config->id_hash_size - 1)];
+        ssid->inext = *bucket;
+        *bucket = ssid;
+        config->num_ssid++;
+        if (ssid->id > config->max_id)
+                config->max_id = ssid->id;
+}
+
+
+static int wpa_config_id_hash_resize(struct wpa_config *config, size_t size)
+{
+        struct wpa_ssid **nhash, **bucket, *ssid, *next;
+        size_t i;
+
+        nhash = os_zalloc(size * sizeof(struct wpa_ssid *));
+        if (nhash == NULL)
+                return -1;
+        for (i = 0; i < config->id_hash_size; i++) {
+                for (ssid = config->id_hash[i]; ssid; ssid = next) {
+                        next = ssid->inext;
+                        bucket = &nhash[(unsigned int) ssid->id & (size - 1)];
+                        ssid->inext = *bucket;
+                        *bucket = ssid;
+                }
+        }
+        os_free(config->id_hash);
+        config->id_hash = nhash;
+        config->id_hash_size = size;
+        return 0;
+}
+
+
+/* Build the network id index (and the list tail) on first use */
+static int wpa_config_id_hash_init(struct wpa_config *config)
+{
+        struct wpa_ssid *ssid;
+        size_t count = 0, size = WPA_ID_HASH_MIN_SIZE;
+
+        if (config->id_hash)
+                return 0;
+
+        config->ssid_tail = NULL;
+        for (ssid = config->ssid; ssid; ssid = ssid->next) {
+                ssid->prev = config->ssid_tail;
+                config->ssid_tail = ssid;
+                count++;
+        }
+        while (size < count)
+                size *= 2;
+
+        config->id_hash = os_zalloc(size * sizeof(struct wpa_ssid *));
+        if (config->id_hash == NULL)
+                return -1;
+        config->id_hash_size = size;
+        config->num_ssid = 0;
+        config->max_id = -1;
+        for (ssid = config->ssid; ssid; ssid = ssid->next)
+                wpa_config_id_hash_add(config, ssid);
+
+        return 0;
+}
+
+
 /**
  * wpa_config_get_network - Get configured network based on id
  * @config: Configuration data from wpa_config_read()
@@ -1619,13 +2007,18 @@ struct wpa_ssid * wpa_config_get_network(struct wpa_config *config, int id)
 {
         struct wpa_ssid *ssid;
 
-        ssid = config->ssid;
-        while (ssid) {
-                if (id == ssid->id)
-                        break;
-                ssid = ssid->next;
+        if (wpa_config_id_hash_init(config) < 0) {
+                for (ssid = config->ssid; ssid; ssid = ssid->next) {
+                        if (id == ssid->id)
+                                break;
+                }
+                return ssid;
         }
 
+        ssid = config->id_hash[(unsigned int) id & (config->id_hash_size - 1)];
+        while (ssid && ssid->id != id)
+                ssid = ssid->inext;
+
         return ssid;
 }
 
@@ -1637,29 +2030,27 @@ struct wpa_ssid * wpa_config_get_network(struct wpa_config *config, int id)
  */
 struct wpa_ssid * wpa_config_add_network(struct wpa_config *config)
 {
-        int id;
-        struct wpa_ssid *ssid, *last = NULL;
+        struct wpa_ssid *ssid;
 
-        id = -1;
-        ssid = config->ssid;
-        while (ssid) {
-                if (ssid->id > id)
-                        id = ssid->id;
-                last = ssid;
-                ssid = ssid->next;
-        }
-        id++;
+        if (wpa_config_id_hash_init(config) < 0)
+                return NULL;
+        if (config->num_ssid >= config->id_hash_size &&
+            wpa_config_id_hash_resize(config, config->id_hash_size * 2) < 0)
+                return NULL;
 
         ssid = os_zalloc(sizeof(*ssid));
         if (ssid == NULL)
                 return NULL;
-        ssid->id = id;
-        if (last)
-                last->next = ssid;
+        ssid->id = config->max_id + 1;
+        ssid->prev = config->ssid_tail;
+        if (config->ssid_tail)
+                config->ssid_tail->next = ssid;
         else
                 config->ssid = ssid;
+        config->ssid_tail = ssid;
+        wpa_config_id_hash_add(config, ssid);
 
-        wpa_config_update_prio_list(config);
+        wpa_config_add_prio_network(config, ssid);
 
         return ssid;
 }
@@ -1673,25 +2064,39 @@ struct wpa_ssid * wpa_config_add_network(struct wpa_config *config)
  */
 int wpa_config_remove_network(struct wpa_config *config, int id)
 {
-        struct wpa_ssid *ssid, *prev = NULL;
+        struct wpa_ssid *ssid, **pos;
 
-        ssid = config->ssid;
-        while (ssid) {
-                if (id == ssid->id)
-                        break;
-                prev = ssid;
-                ssid = ssid->next;
-        }
+        if (wpa_config_id_hash_init(config) < 0)
+                return -1;
 
+        pos = &config->id_hash[(unsigned int) id & (config->id_hash_size - 1)];
+        while (*pos && (*pos)->id != id)
+                pos = &(*pos)->inext;
+        ssid = *pos;
         if (ssid == NULL)
                 return -1;
+        *pos = ssid->inext;
+        config->num_ssid--;
 
-        if (prev)
-                prev->next = ssid->next;
+        if (ssid->prev)
+                ssid->prev->next = ssid->next;
         else
                 config->ssid = ssid->next;
+        if (ssid->next)
+                ssid->next->prev = ssid->prev;
+        else
+                config->ssid_tail = ssid->prev;
 
-        wpa_config_update_prio_list(config);
+        /* Network ids are dense, so the new maximum is found quickly */
+        if (config->num_ssid == 0)
+                config->max_id = -1;
+        else if (id == config->max_id) {
+                while (wpa_config_get_network(config, config->max_id) == NULL)
+                        config->max_id--;
+        }
+
+        if (wpa_config_remove_prio_network(config, ssid) < 0)
+                wpa_config_update_prio_list(config);
         wpa_config_free_ssid(ssid);
         return 0;
 }
@@ -1731,35 +2136,29 @@ void wpa_config_set_network_defaults(struct wpa_ssid *ssid)
 int wpa_config_set(struct wpa_ssid *ssid, const char *var, const char *value,
                    int line)
 {
-        size_t i;
-        int ret = 0;
+        const struct parse_data *field;
 
         if (ssid == NULL || var == NULL || value == NULL)
                 return -1;
 
-        for (i = 0; i < NUM_SSID_FIELDS; i++) {
-                const struct parse_data *field = &ssid_fields[i];
-                if (os_strcmp(var, field->name) != 0)
-                        continue;
-
-                if (field->parser(field, ssid, line, value)) {
-                        if (line) {
-                                wpa_printf(MSG_ERROR, "Line %d: failed to "
-                                           "parse %s '%s'.", line, var, value);
-                        }
-                        ret = -1;
-                }
-                break;
-        }
-        if (i == NUM_SSID_FIELDS) {
+        field = wpa_config_get_field(var);
+        if (field == NULL) {
                 if (line) {
                         wpa_printf(MSG_ERROR, "Line %d: unknown network field "
                                    "'%s'.", line, var);
                 }
-                ret = -1;
+                return -1;
         }
 
-        return ret;
+        if (field->parser(field, ssid, line, value)) {
+                if (line) {
+                        wpa_printf(MSG_ERROR, "Line %d: failed to "
+                                   "parse %s '%s'.", line, var, value);
+                }
+                return -1;
+        }
+
+        return 0;
 }
 
 
@@ -1778,18 +2177,16 @@ int wpa_config_set(struct wpa_ssid *ssid, const char *var, const char *value,
  */
 char * wpa_config_get(struct wpa_ssid *ssid, const char *var)
 {
-        size_t i;
+        const struct parse_data *field;
 
         if (ssid == NULL || var == NULL)
                 return NULL;
 
-        for (i = 0; i < NUM_SSID_FIELDS; i++) {
-                const struct parse_data *field = &ssid_fields[i];
-                if (os_strcmp(var, field->name) == 0)
-                        return field->writer(field, ssid);
-        }
+        field = wpa_config_get_field(var);
+        if (field == NULL)
+                return NULL;
 
-        return NULL;
+        return field->writer(field, ssid);
 }
 
 
@@ -1811,32 +2208,29 @@ char * wpa_config_get(struct wpa_ssid *ssid, const char *var)
  */
 char * wpa_config_get_no_key(struct wpa_ssid *ssid, const char *var)
 {
-        size_t i;
+        const struct parse_data *field;
+        char *res;
 
         if (ssid == NULL || var == NULL)
                 return NULL;
 
-        for (i = 0; i < NUM_SSID_FIELDS; i++) {
-                const struct parse_data *field = &ssid_fields[i];
-                if (os_strcmp(var, field->name) == 0) {
-                        char *res = field->writer(field, ssid);
-                        if (field->key_data) {
-                                if (res && res[0]) {
-                                        wpa_printf(MSG_DEBUG, "Do not allow "
-                                                   "key_data field to be "
-                                                   "exposed");
-                                        os_free(res);
-                                        return os_strdup("*");
-                                }
-
-                                os_free(res);
-                                return NULL;
-                        }
-                        return res;
+        field = wpa_config_get_field(var);
+        if (field == NULL)
+                return NULL;
+
+        res = field->writer(field, ssid);
+        if (field->key_data) {
+                if (res && res[0]) {
+                        wpa_printf(MSG_DEBUG, "Do not allow key_data field to "
+                                   "be exposed");
+                        os_free(res);
+                        return os_strdup("*");
                 }
-        }
 
-        return NULL;
+                os_free(res);
+                return NULL;
+        }
+        return res;
 }
 #endif /* NO_CONFIG_WRITE */
 
@@ -1857,6 +2251,98 @@ void wpa_config_update_psk(struct wpa_ssid *ssid)
         wpa_hexdump_key(MSG_MSGDUMP, "PSK (from passphrase)",
                         ssid->psk, PMK_LEN);
         ssid->psk_set = 1;
+        ssid->psk_pending = 0;
+#endif /* CONFIG_NO_PBKDF2 */
+}
+
+
+/**
+ * wpa_config_psk_changed - Handle a passphrase or SSID change for a network
+ * @config: Configuration data from wpa_config_read()
+ * @ssid: Pointer to network configuration data
+ *
+ * With lazy_psk=1, the PSK is only marked pending, so that it is derived
+ * without blocking when the network is selected. Otherwise, this is
+ * equivalent to wpa_config_update_psk().
+ */
+void wpa_config_psk_changed(struct wpa_config *config, struct wpa_ssid *ssid)
+{
+        if (config->lazy_psk) {
+                ssid->psk_set = 0;
+                ssid->psk_pending = 1;
+                return;
+        }
+        wpa_config_update_psk(ssid);
+}
+
+
+/**
+ * wpa_config_update_psks - Update WPA PSKs for all passphrase networks
+ * @config: Configuration data from wpa_config_read()
+ *
+ * This function is equivalent to calling wpa_config_update_psk() for each
+ * network that has a passphrase configured, but derives the PSKs with a
+ * single pbkdf2_sha1_batch() call to make use of SIMD lanes. Networks that
+ * already have a PSK set (e.g., from the PSK cache) are skipped.
+ */
+void wpa_config_update_psks(struct wpa_config *config)
+{
+#ifndef CONFIG_NO_PBKDF2
+        struct wpa_ssid *ssid;
+        const char **passphrase, **ssid_txt;
+        size_t *ssid_len, num = 0, i;
+        u8 **psk;
+
+        for (ssid = config->ssid; ssid; ssid = ssid->next) {
+                if (ssid->passphrase && !ssid->psk_set)
+                        num++;
+        }
+        if (num == 0)
+                return;
+
+        passphrase = os_malloc(num * sizeof(char *));
+        ssid_txt = os_malloc(num * sizeof(char *));
+        ssid_len = os_malloc(num * sizeof(size_t));
+        psk = os_malloc(num * sizeof(u8 *));
+        if (passphrase == NULL || ssid_txt == NULL || ssid_len == NULL ||
+            psk == NULL) {
+                for (ssid = config->ssid; ssid; ssid = ssid->next) {
+                        if (ssid->passphrase && !ssid->psk_set)
+                                wpa_config_update_psk(ssid);
+                }
+                goto done;
+        }
+
+        i = 0;
+        for (ssid = config->ssid; ssid; ssid = ssid->next) {
+                if (ssid->passphrase == NULL || ssid->psk_set)
+                        continue;
+                passphrase[i] = ssid->passphrase;
+                ssid_txt[i] = (char *) ssid->ssid;
+                ssid_len[i] = ssid->ssid_len;
+                psk[i] = ssid->psk;
+                i++;
+        }
+
+        wpa_printf(MSG_DEBUG, "Deriving PSK for %lu network(s) from "
+                   "passphrase", (unsigned long) num);
+        pbkdf2_sha1_batch(passphrase, ssid_txt, ssid_len, num, 4096, psk,
+                          PMK_LEN);
+
+        for (ssid = config->ssid; ssid; ssid = ssid->next) {
+                if (ssid->passphrase == NULL || ssid->psk_set)
+                        continue;
+                wpa_hexdump_key(MSG_MSGDUMP, "PSK (from passphrase)",
+                                ssid->psk, PMK_LEN);
+                ssid->psk_set = 1;
+                ssid->psk_pending = 0;
+        }
+
+done:
+        os_free(passphrase);
+        os_free(ssid_txt);
+        os_free(ssid_len);
+        os_free(psk);
 #endif /* CONFIG_NO_PBKDF2 */
 }
 
@@ -1959,6 +2445,9 @@ struct wpa_config * wpa_config_alloc_empty(const char *ctrl_interface,
         config->eapol_version = DEFAULT_EAPOL_VERSION;
         config->ap_scan = DEFAULT_AP_SCAN;
         config->fast_reauth = DEFAULT_FAST_REAUTH;
+        config->roam_full_scan_interval = DEFAULT_ROAM_FULL_SCAN_INTERVAL;
+        config->scan_interval = DEFAULT_SCAN_INTERVAL;
+        config->scan_interval_max = DEFAULT_SCAN_INTERVAL_MAX;
 
         if (ctrl_interface)
                 config->ctrl_interface = os_strdup(ctrl_interface);
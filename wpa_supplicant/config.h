@@ -22,10 +22,78 @@
 #define DEFAULT_AP_SCAN 1
 #endif /* CONFIG_NO_SCAN_PROCESSING */
 #define DEFAULT_FAST_REAUTH 1
+#define DEFAULT_ROAM_FULL_SCAN_INTERVAL 300
+#define DEFAULT_SCAN_INTERVAL 5
+#define DEFAULT_SCAN_INTERVAL_MAX 60
 
 #include "config_ssid.h"
 
 
+#define WPA_PRIO_INDEX_SIZE 64
+#define WPA_FIELD_INDEX_SIZE 256
+
+/**
+ * struct wpa_field_index - Name index for a constant field table
+ *
+ * This is an open addressing hash table from field name to the position of
+ * the field in a table of configuration fields (ssid_fields[] in config.c and
+ * global_fields[] in config_file.c). Since the tables are constant, the index
+ * is built once on first use and never updated. See wpa_config_field_lookup().
+ */
+struct wpa_field_index {
+  /**
+   * state - 0 = not yet built, 1 = built, -1 = table too large to index
+   */
+  int state;
+
+  /**
+   * slot - Table position + 1 for each hash slot (0 = empty)
+   */
+  unsigned short slot[WPA_FIELD_INDEX_SIZE];
+};
+
+/**
+ * struct wpa_prio_index - SSID index for a priority group
+ *
+ * Each priority group has an index from SSID to the networks that may match
+ * a BSS with that SSID. The lists are chained through the hnext field of
+ * struct wpa_ssid and kept in the same order as the pnext list. Tail pointers
+ * are maintained for all lists so that networks can be appended without
+ * walking the lists.
+ */
+struct wpa_prio_index {
+  /**
+   * priority - Priority of the networks in this group
+   */
+  int priority;
+
+  /**
+   * tail - Last network in the pnext list of this group
+   */
+  struct wpa_ssid *tail;
+
+  /**
+   * ssid_hash - Networks with an SSID, hashed by the SSID
+   */
+  struct wpa_ssid *ssid_hash[WPA_PRIO_INDEX_SIZE];
+
+  /**
+   * ssid_tail - Last network in each ssid_hash bucket
+   */
+  struct wpa_ssid *ssid_tail[WPA_PRIO_INDEX_SIZE];
+
+  /**
+   * wildcard - Networks without an SSID
+   */
+  struct wpa_ssid *wildcard;
+
+  /**
+   * wildcard_tail - Last network in the wildcard list
+   */
+  struct wpa_ssid *wildcard_tail;
+};
+
+
 /**
  * struct wpa_config - wpa_supplicant configuration data
  *
@@ -42,6 +110,36 @@ struct wpa_config {
    */
   struct wpa_ssid *ssid;
 
+  /**
+   * id_hash - Hash table from network id to network, chained via inext
+   *
+   * This is built on first use by wpa_config_get_network(),
+   * wpa_config_add_network(), or wpa_config_remove_network() and
+   * maintained by the latter two. Configuration backends build the
+   * network list directly, so this is %NULL until then.
+   */
+  struct wpa_ssid **id_hash;
+
+  /**
+   * id_hash_size - Number of buckets in id_hash (power of two)
+   */
+  size_t id_hash_size;
+
+  /**
+   * num_ssid - Number of networks in id_hash
+   */
+  size_t num_ssid;
+
+  /**
+   * max_id - Largest network id in use or -1 if none (valid with id_hash)
+   */
+  int max_id;
+
+  /**
+   * ssid_tail - Last network in the global list (valid with id_hash)
+   */
+  struct wpa_ssid *ssid_tail;
+
   /**
    * pssid - Per-priority network lists (in priority order)
    */
@@ -55,6 +153,19 @@ struct wpa_config {
    */
   int num_prio;
 
+  /**
+   * prio_index - Per-priority SSID indexes (same order as pssid)
+   */
+  struct wpa_prio_index *prio_index;
+
+  /**
+   * prio_stale - Whether the pssid lists and prio_index need a rebuild
+   *
+   * This is set with wpa_config_prio_changed() when the SSID or priority of
+   * a network is changed and cleared when the lists are rebuilt.
+   */
+  int prio_stale;
+
   /**
    * eapol_version - IEEE 802.1X/EAPOL version number
    *
@@ -243,6 +354,40 @@ struct wpa_config {
    */
   int update_config;
 
+  /**
+   * psk_cache - Whether to cache PSKs derived from passphrases
+   *
+   * If this is set, PSKs derived from network passphrases are stored in
+   * <configuration file>.psk (mode 0600) and reused when the
+   * configuration is read again, e.g., on restart or RECONFIGURE, to
+   * avoid running PBKDF2 for networks that have not changed.
+   */
+  int psk_cache;
+
+  /**
+   * psk_cache_hits - Number of PSKs found in the PSK cache
+   *
+   * This is updated when the configuration is read.
+   */
+  unsigned int psk_cache_hits;
+
+  /**
+   * psk_cache_misses - Number of PSKs that were not in the PSK cache
+   *
+   * This is updated when the configuration is read.
+   */
+  unsigned int psk_cache_misses;
+
+  /**
+   * lazy_psk - Whether to derive passphrase based PSKs only when needed
+   *
+   * If this is set, PSKs for networks with a passphrase are not derived
+   * when the configuration is read, but only when the network is selected
+   * for association. The derivation is then split into small steps so
+   * that the event loop is not blocked.
+   */
+  int lazy_psk;
+
   /**
    * blobs - Configuration blobs
    */
@@ -323,8 +468,59 @@ struct wpa_config {
    *  ctrl_iface to external program(s)
    */
   int wps_cred_processing;
-  u8 roam_hysteresis;
-  u8 roam_threshold;
+
+  /**
+   * roam_hysteresis - Required signal level improvement for roaming
+   */
+  int roam_hysteresis;
+
+  /**
+   * roam_threshold - Signal level below which roaming is not considered
+   */
+  int roam_threshold;
+
+  /**
+   * roam_scan_interval - Background roaming scan interval in seconds
+   *
+   * While associated, scan periodically for a better AP of the same ESS.
+   * These scans are limited to the channels on which the ESS has recently
+   * been seen, if the driver supports per-channel scan requests. 0 =
+   * disabled (default).
+   */
+  int roam_scan_interval;
+
+  /**
+   * roam_full_scan_interval - Full background scan interval in seconds
+   *
+   * Minimum time between background roaming scans that cover all
+   * channels. This allows APs of the ESS on new channels to be found.
+   */
+  int roam_full_scan_interval;
+
+  /**
+   * scan_interval - Initial interval in seconds for periodic scans
+   *
+   * When no suitable AP is found, a new scan is scheduled after this
+   * interval. The interval is doubled after each scan that does not find
+   * a network (up to scan_interval_max) and reset on connection,
+   * disconnection, configuration change, and explicit scan requests.
+   */
+  int scan_interval;
+
+  /**
+   * scan_interval_max - Ceiling in seconds for the periodic scan backoff
+   */
+  int scan_interval_max;
+
+  /**
+   * idle_scan_interval - Initial periodic scan interval when idle
+   *
+   * Interval in seconds for periodic scans when there are no enabled
+   * networks, e.g., to keep the scan results fresh for a user interface.
+   * The same backoff is used as with scan_interval. 0 = do not scan when
+   * idle (default).
+   */
+  int idle_scan_interval;
 };
 
 
@@ -341,8 +537,18 @@ int wpa_config_set(struct wpa_ssid *ssid, const char *var, const char *value,
 char * wpa_config_get(struct wpa_ssid *ssid, const char *var);
 char * wpa_config_get_no_key(struct wpa_ssid *ssid, const char *var);
 void wpa_config_update_psk(struct wpa_ssid *ssid);
+void wpa_config_update_psks(struct wpa_config *config);
+void wpa_config_psk_changed(struct wpa_config *config, struct wpa_ssid *ssid);
 int wpa_config_add_prio_network(struct wpa_config *config,
         struct wpa_ssid *ssid);
+void wpa_config_prio_changed(struct wpa_config *config, const char *var);
+int wpa_config_check_prio_index(struct wpa_config *config);
+int wpa_config_field_lookup(struct wpa_field_index *idx, const void *table,
+                            size_t entry_size, size_t num, const char *name,
+                            size_t name_len);
+struct wpa_ssid * wpa_config_prio_ssid_list(struct wpa_config *config,
+              int prio, const u8 *ssid,
+              size_t ssid_len);
 const struct wpa_config_blob * wpa_config_get_blob(struct wpa_config *config,
                const char *name);
 void wpa_config_set_blob(struct wpa_config *config,
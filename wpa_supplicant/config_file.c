@@ -17,10 +17,19 @@
  */
 
 #include "includes.h"
+#ifndef CONFIG_NATIVE_WINDOWS
+#include <sys/stat.h>
+#include <fcntl.h>
+#ifndef O_NOFOLLOW
+#define O_NOFOLLOW 0
+#endif /* O_NOFOLLOW */
+#endif /* CONFIG_NATIVE_WINDOWS */
 
 #include "common.h"
 #include "config.h"
 #include "base64.h"
+#include "sha1.h"
+#include "wpa_common.h"
 #include "uuid.h"
 #include "eap_peer/eap_methods.h"
 
@@ -102,12 +111,12 @@ static int wpa_config_validate_network(struct wpa_ssid *ssid, int line)
                                    "passphrase configured.", line);
                         errors++;
                 }
-                wpa_config_update_psk(ssid);
+                /* PSK is derived with wpa_config_derive_psks() */
         }
 
         if ((ssid->key_mgmt & (WPA_KEY_MGMT_PSK | WPA_KEY_MGMT_FT_PSK |
                                WPA_KEY_MGMT_PSK_SHA256)) &&
-            !ssid->psk_set) {
+            !ssid->psk_set && !ssid->passphrase) {
                 wpa_printf(MSG_ERROR, "Line %d: WPA-PSK accepted for key "
                            "management, but no PSK configured.", line);
                 errors++;
@@ -446,6 +455,10 @@ static const struct global_parse_data global_fields[] = {
 #ifndef CONFIG_NO_CONFIG_WRITE
         { INT(update_config) },
 #endif /* CONFIG_NO_CONFIG_WRITE */
+#ifndef CONFIG_NO_PSK_CACHE
+        { INT_RANGE(psk_cache, 0, 1) },
+#endif /* CONFIG_NO_PSK_CACHE */
+        { INT_RANGE(lazy_psk, 0, 1) },
         { FUNC_NO_VAR(load_dynamic_eap) },
 #ifdef CONFIG_WPS
         { FUNC(uuid) },
@@ -460,7 +473,12 @@ static const struct global_parse_data global_fields[] = {
 #endif /* CONFIG_WPS */
         { FUNC(country) },
         { INT(roam_hysteresis) },
-        { INT(roam_threshold) }
+        { INT(roam_threshold) },
+        { INT_RANGE(roam_scan_interval, 0, 3600) },
+        { INT_RANGE(roam_full_scan_interval, 0, 86400) },
+        { INT_RANGE(scan_interval, 1, 3600) },
+        { INT_RANGE(scan_interval_max, 0, 86400) },
+        { INT_RANGE(idle_scan_interval, 0, 86400) }
 };
 
 #undef FUNC
@@ -472,37 +490,397 @@ static const struct global_parse_data global_fields[] = {
 #undef STR_RANGE
 #define NUM_GLOBAL_FIELDS (sizeof(global_fields) / sizeof(global_fields[0]))
 
+static struct wpa_field_index global_fields_index;
+
 
 static int wpa_config_process_global(struct wpa_config *config, char *pos,
                                      int line)
 {
-        size_t i;
-        int ret = 0;
+        const struct global_parse_data *field;
+        const char *value;
+        int i = -1;
+
+        value = os_strchr(pos, '=');
+        if (value)
+                i = wpa_config_field_lookup(&global_fields_index,
+                                            global_fields,
+                                            sizeof(global_fields[0]),
+                                            NUM_GLOBAL_FIELDS, pos,
+                                            value - pos);
+        if (i < 0) {
+                wpa_printf(MSG_ERROR, "Line %d: unknown global field '%s'.",
+                           line, pos);
+                return -1;
+        }
+
+        field = &global_fields[i];
+        if (field->parser(field, config, line, value + 1)) {
+                wpa_printf(MSG_ERROR, "Line %d: failed to "
+                           "parse '%s'.", line, pos);
+                return -1;
+        }
+
+        return 0;
+}
+
+
+/*
+ * Derive PSKs for passphrase networks that do not have one yet, or with
+ * lazy_psk=1, only mark them to be derived when the network is selected.
+ */
+static void wpa_config_derive_psks(struct wpa_config *config)
+{
+        struct wpa_ssid *ssid;
+
+        if (!config->lazy_psk) {
+                wpa_config_update_psks(config);
+                return;
+        }
+
+        for (ssid = config->ssid; ssid; ssid = ssid->next) {
+                if (ssid->passphrase && !ssid->psk_set)
+                        ssid->psk_pending = 1;
+        }
+}
+
+
+#ifndef CONFIG_NO_PSK_CACHE
+
+/*
+ * PSK cache: <configuration file>.psk stores PSKs derived from passphrases
+ * so that PBKDF2 can be skipped for networks that have not changed since
+ * the previous time the configuration was read. Entries are indexed with
+ * HMAC-SHA1(salt, passphrase length || passphrase || SSID) using a random
+ * per-file salt, so the passphrases and SSIDs are not stored in the cache.
+ * Each PSK is stored with HMAC-SHA1(passphrase, salt || SSID || PSK), which
+ * binds it to the network in the configuration file: an entry that has been
+ * modified by anyone who does not know the passphrase is treated as a miss.
+ */
+
+#define PSK_CACHE_SALT_LEN 16
+
+struct psk_cache_entry {
+        u8 id[SHA1_MAC_LEN];
+        u8 psk[PMK_LEN];
+        u8 mac[SHA1_MAC_LEN];
+};
 
-        for (i = 0; i < NUM_GLOBAL_FIELDS; i++) {
-                const struct global_parse_data *field = &global_fields[i];
-                size_t flen = os_strlen(field->name);
-                if (os_strncmp(pos, field->name, flen) != 0 ||
-                    pos[flen] != '=')
+struct psk_cache {
+        u8 salt[PSK_CACHE_SALT_LEN];
+        struct psk_cache_entry *entry;
+        size_t num_entries;
+};
+
+
+static void psk_cache_id(const struct psk_cache *cache,
+                         const struct wpa_ssid *ssid, u8 *id)
+{
+        const u8 *addr[3];
+        size_t len[3];
+        u8 plen;
+
+        plen = os_strlen(ssid->passphrase);
+        addr[0] = &plen;
+        len[0] = 1;
+        addr[1] = (const u8 *) ssid->passphrase;
+        len[1] = plen;
+        addr[2] = ssid->ssid;
+        len[2] = ssid->ssid_len;
+        hmac_sha1_vector(cache->salt, sizeof(cache->salt), 3, addr, len, id);
+}
+
+
+static void psk_cache_mac(const struct psk_cache *cache,
+                          const struct wpa_ssid *ssid, const u8 *psk, u8 *mac)
+{
+        const u8 *addr[3];
+        size_t len[3];
+
+        addr[0] = cache->salt;
+        len[0] = sizeof(cache->salt);
+        addr[1] = ssid->ssid;
+        len[1] = ssid->ssid_len;
+        addr[2] = psk;
+        len[2] = PMK_LEN;
+        hmac_sha1_vector((const u8 *) ssid->passphrase,
+                         os_strlen(ssid->passphrase), 3, addr, len, mac);
+}
+
+
+static int psk_cache_entry_cmp(const void *a, const void *b)
+{
+        const struct psk_cache_entry *ea = a, *eb = b;
+        return os_memcmp(ea->id, eb->id, SHA1_MAC_LEN);
+}
+
+
+static void psk_cache_free(struct psk_cache *cache)
+{
+        if (cache->entry) {
+                os_memset(cache->entry, 0,
+                          cache->num_entries * sizeof(*cache->entry));
+                os_free(cache->entry);
+        }
+        os_memset(cache, 0, sizeof(*cache));
+}
+
+
+static int psk_cache_read(struct psk_cache *cache, const char *fname,
+                          const char *conf_name)
+{
+        FILE *f;
+        char buf[256], *pos;
+        int line = 0, salt = 0, errors = 0;
+        size_t alloc = 0;
+        struct psk_cache_entry *e;
+#ifndef CONFIG_NATIVE_WINDOWS
+        struct stat st, conf_st;
+#endif /* CONFIG_NATIVE_WINDOWS */
+
+        f = fopen(fname, "r");
+        if (f == NULL)
+                return -1;
+
+#ifndef CONFIG_NATIVE_WINDOWS
+        /* Only trust a private cache owned by the owner of the config */
+        if (fstat(fileno(f), &st) < 0 || stat(conf_name, &conf_st) < 0 ||
+            st.st_uid != conf_st.st_uid || (st.st_mode & 077)) {
+                wpa_printf(MSG_INFO, "PSK cache: Ignoring '%s' since its "
+                           "owner or mode does not match the configuration "
+                           "file", fname);
+                fclose(f);
+                return -1;
+        }
+#endif /* CONFIG_NATIVE_WINDOWS */
+
+        while (wpa_config_get_line(buf, sizeof(buf), f, &line, &pos)) {
+                if (!salt) {
+                        if (os_strncmp(pos, "salt=", 5) != 0 ||
+                            os_strlen(pos + 5) != 2 * PSK_CACHE_SALT_LEN ||
+                            hexstr2bin(pos + 5, cache->salt,
+                                       PSK_CACHE_SALT_LEN)) {
+                                errors++;
+                                break;
+                        }
+                        salt = 1;
                         continue;
+                }
 
-                if (field->parser(field, config, line, pos + flen + 1)) {
-                        wpa_printf(MSG_ERROR, "Line %d: failed to "
-                                   "parse '%s'.", line, pos);
-                        ret = -1;
+                if (cache->num_entries == alloc) {
+                        size_t nalloc = alloc ? 2 * alloc : 16;
+                        e = os_realloc(cache->entry, nalloc * sizeof(*e));
+                        if (e == NULL) {
+                                errors++;
+                                break;
+                        }
+                        cache->entry = e;
+                        alloc = nalloc;
+                }
+                e = &cache->entry[cache->num_entries];
+                if (os_strlen(pos) != 2 * (2 * SHA1_MAC_LEN + PMK_LEN) + 2 ||
+                    hexstr2bin(pos, e->id, SHA1_MAC_LEN) ||
+                    pos[2 * SHA1_MAC_LEN] != ' ' ||
+                    hexstr2bin(pos + 2 * SHA1_MAC_LEN + 1, e->psk,
+                               PMK_LEN) ||
+                    pos[2 * (SHA1_MAC_LEN + PMK_LEN) + 1] != ' ' ||
+                    hexstr2bin(pos + 2 * (SHA1_MAC_LEN + PMK_LEN) + 2, e->mac,
+                               SHA1_MAC_LEN)) {
+                        errors++;
+                        break;
                 }
-                break;
+                cache->num_entries++;
         }
-        if (i == NUM_GLOBAL_FIELDS) {
-                wpa_printf(MSG_ERROR, "Line %d: unknown global field '%s'.",
-                           line, pos);
-                ret = -1;
+
+        fclose(f);
+        os_memset(buf, 0, sizeof(buf));
+
+        if (errors || !salt) {
+                wpa_printf(MSG_INFO, "PSK cache: Invalid line %d in '%s'; "
+                           "ignoring the cache", line, fname);
+                psk_cache_free(cache);
+                return -1;
+        }
+
+        qsort(cache->entry, cache->num_entries, sizeof(*cache->entry),
+              psk_cache_entry_cmp);
+        return 0;
+}
+
+
+static int psk_cache_write(const struct psk_cache *cache, const char *fname)
+{
+        FILE *f;
+        char *tmp, hex[2 * PMK_LEN + 1];
+        size_t i, len;
+        int ret = 0;
+#ifndef CONFIG_NATIVE_WINDOWS
+        int fd;
+        struct stat st;
+#endif /* CONFIG_NATIVE_WINDOWS */
+
+        len = os_strlen(fname) + 5;
+        tmp = os_malloc(len);
+        if (tmp == NULL)
+                return -1;
+        os_snprintf(tmp, len, "%s.tmp", fname);
+
+#ifndef CONFIG_NATIVE_WINDOWS
+        /*
+         * Never reuse an existing file (or follow a symlink) at the temporary
+         * path: the PSKs must only ever be written to a new private file.
+         */
+        unlink(tmp);
+        fd = open(tmp, O_WRONLY | O_CREAT | O_EXCL | O_NOFOLLOW,
+                  S_IRUSR | S_IWUSR);
+        if (fd >= 0 && (fstat(fd, &st) < 0 || !S_ISREG(st.st_mode) ||
+                        fchmod(fd, S_IRUSR | S_IWUSR) < 0)) {
+                close(fd);
+                unlink(tmp);
+                fd = -1;
+        }
+        f = fd < 0 ? NULL : fdopen(fd, "w");
+        if (f == NULL && fd >= 0) {
+                close(fd);
+                unlink(tmp);
+        }
+#else /* CONFIG_NATIVE_WINDOWS */
+        f = fopen(tmp, "w");
+#endif /* CONFIG_NATIVE_WINDOWS */
+        if (f == NULL) {
+                wpa_printf(MSG_DEBUG, "PSK cache: Failed to open '%s' for "
+                           "writing", tmp);
+                os_free(tmp);
+                return -1;
         }
 
+        fprintf(f, "# wpa_supplicant PSK cache; do not edit\n");
+        wpa_snprintf_hex(hex, sizeof(hex), cache->salt, sizeof(cache->salt));
+        fprintf(f, "salt=%s\n", hex);
+        for (i = 0; i < cache->num_entries; i++) {
+                const struct psk_cache_entry *e = &cache->entry[i];
+                wpa_snprintf_hex(hex, sizeof(hex), e->id, SHA1_MAC_LEN);
+                fprintf(f, "%s ", hex);
+                wpa_snprintf_hex(hex, sizeof(hex), e->psk, PMK_LEN);
+                fprintf(f, "%s ", hex);
+                wpa_snprintf_hex(hex, sizeof(hex), e->mac, SHA1_MAC_LEN);
+                fprintf(f, "%s\n", hex);
+        }
+        os_memset(hex, 0, sizeof(hex));
+
+        if (fclose(f) != 0 || rename(tmp, fname) < 0) {
+                wpa_printf(MSG_DEBUG, "PSK cache: Failed to write '%s'",
+                           fname);
+                remove(tmp);
+                ret = -1;
+        }
+        os_free(tmp);
         return ret;
 }
 
 
+/*
+ * Fill in PSKs for passphrase networks from the cache and derive the rest.
+ * The cache file is rewritten to contain exactly the current passphrase
+ * networks with a known PSK whenever this differs from the old contents.
+ */
+static void wpa_config_psk_cache(struct wpa_config *config,
+                                 const char *conf_name)
+{
+        struct psk_cache cache, ncache;
+        struct psk_cache_entry key, *e;
+        struct wpa_ssid *ssid;
+        u8 mac[SHA1_MAC_LEN];
+        char *fname;
+        size_t len, num = 0;
+
+        len = os_strlen(conf_name) + 5;
+        fname = os_malloc(len);
+        if (fname == NULL) {
+                wpa_config_derive_psks(config);
+                return;
+        }
+        os_snprintf(fname, len, "%s.psk", conf_name);
+
+        os_memset(&cache, 0, sizeof(cache));
+        os_memset(&ncache, 0, sizeof(ncache));
+        if (psk_cache_read(&cache, fname, conf_name) < 0 &&
+            os_get_random(cache.salt, sizeof(cache.salt)) < 0) {
+                wpa_printf(MSG_DEBUG, "PSK cache: Failed to generate salt");
+                os_free(fname);
+                wpa_config_derive_psks(config);
+                return;
+        }
+
+        for (ssid = config->ssid; ssid; ssid = ssid->next) {
+                if (ssid->passphrase)
+                        num++;
+        }
+        if (num)
+                ncache.entry = os_zalloc(num * sizeof(*ncache.entry));
+        os_memcpy(ncache.salt, cache.salt, sizeof(cache.salt));
+
+        for (ssid = config->ssid; ssid; ssid = ssid->next) {
+                if (ssid->passphrase == NULL)
+                        continue;
+                psk_cache_id(&cache, ssid, key.id);
+                e = cache.num_entries ?
+                        bsearch(&key, cache.entry, cache.num_entries,
+                                sizeof(*e), psk_cache_entry_cmp) : NULL;
+                if (e) {
+                        psk_cache_mac(&cache, ssid, e->psk, mac);
+                        if (os_memcmp(mac, e->mac, SHA1_MAC_LEN) != 0) {
+                                wpa_printf(MSG_INFO, "PSK cache: Entry for "
+                                           "network id=%d does not match "
+                                           "the configuration; ignoring it",
+                                           ssid->id);
+                                e = NULL;
+                        }
+                }
+                if (e) {
+                        os_memcpy(ssid->psk, e->psk, PMK_LEN);
+                        ssid->psk_set = 1;
+                        config->psk_cache_hits++;
+                        wpa_printf(MSG_DEBUG, "PSK cache: Hit for network "
+                                   "id=%d", ssid->id);
+                } else {
+                        config->psk_cache_misses++;
+                        wpa_printf(MSG_DEBUG, "PSK cache: Miss for network "
+                                   "id=%d", ssid->id);
+                }
+        }
+
+        /* Derive the PSKs that were not found in the cache */
+        wpa_config_derive_psks(config);
+
+        wpa_printf(MSG_DEBUG, "PSK cache: %u hit(s), %u miss(es)",
+                   config->psk_cache_hits, config->psk_cache_misses);
+
+        /* PSKs left pending with lazy_psk=1 are not cached */
+        for (ssid = config->ssid; ncache.entry && ssid; ssid = ssid->next) {
+                if (ssid->passphrase == NULL || !ssid->psk_set)
+                        continue;
+                e = &ncache.entry[ncache.num_entries++];
+                psk_cache_id(&ncache, ssid, e->id);
+                os_memcpy(e->psk, ssid->psk, PMK_LEN);
+                psk_cache_mac(&ncache, ssid, e->psk, e->mac);
+        }
+        if ((ncache.entry || num == 0) &&
+            (ncache.num_entries != config->psk_cache_hits ||
+             cache.num_entries != config->psk_cache_hits)) {
+                if (ncache.num_entries)
+                        psk_cache_write(&ncache, fname);
+                else
+                        remove(fname);
+        }
+
+        psk_cache_free(&cache);
+        psk_cache_free(&ncache);
+        os_free(fname);
+}
+
+#endif /* CONFIG_NO_PSK_CACHE */
+
+
 struct wpa_config * wpa_config_read(const char *name)
 {
         FILE *f;
@@ -563,6 +941,16 @@ struct wpa_config * wpa_config_read(const char *name)
         fclose(f);
 
         config->ssid = head;
+        if (!errors) {
+#ifndef CONFIG_NO_PSK_CACHE
+                if (config->psk_cache)
+                        wpa_config_psk_cache(config, name);
+                else
+                        wpa_config_derive_psks(config);
+#else /* CONFIG_NO_PSK_CACHE */
+                wpa_config_derive_psks(config);
+#endif /* CONFIG_NO_PSK_CACHE */
+        }
         wpa_config_debug_dump_networks(config);
 
         if (errors) {
@@ -863,6 +1251,12 @@ static void wpa_config_write_global(FILE *f, struct wpa_config *config)
                         config->dot11RSNAConfigSATimeout);
         if (config->update_config)
                 fprintf(f, "update_config=%d\n", config->update_config);
+#ifndef CONFIG_NO_PSK_CACHE
+        if (config->psk_cache)
+                fprintf(f, "psk_cache=%d\n", config->psk_cache);
+#endif /* CONFIG_NO_PSK_CACHE */
+        if (config->lazy_psk)
+                fprintf(f, "lazy_psk=%d\n", config->lazy_psk);
 #ifdef CONFIG_WPS
         if (!is_nil_uuid(config->uuid)) {
                 char buf[40];
@@ -892,6 +1286,25 @@ static void wpa_config_write_global(FILE *f, struct wpa_config *config)
                 fprintf(f, "country=%c%c\n",
                         config->country[0], config->country[1]);
         }
+        if (config->roam_hysteresis)
+                fprintf(f, "roam_hysteresis=%d\n", config->roam_hysteresis);
+        if (config->roam_threshold)
+                fprintf(f, "roam_threshold=%d\n", config->roam_threshold);
+        if (config->roam_scan_interval)
+                fprintf(f, "roam_scan_interval=%d\n",
+                        config->roam_scan_interval);
+        if (config->roam_full_scan_interval !=
+            DEFAULT_ROAM_FULL_SCAN_INTERVAL)
+                fprintf(f, "roam_full_scan_interval=%d\n",
+                        config->roam_full_scan_interval);
+        if (config->scan_interval != DEFAULT_SCAN_INTERVAL)
+                fprintf(f, "scan_interval=%d\n", config->scan_interval);
+        if (config->scan_interval_max != DEFAULT_SCAN_INTERVAL_MAX)
+                fprintf(f, "scan_interval_max=%d\n",
+                        config->scan_interval_max);
+        if (config->idle_scan_interval)
+                fprintf(f, "idle_scan_interval=%d\n",
+                        config->idle_scan_interval);
 }
 
 #endif /* CONFIG_NO_CONFIG_WRITE */
@@ -48,6 +48,11 @@ struct wpa_ssid {
    */
   struct wpa_ssid *next;
 
+  /**
+   * prev - Previous network in global list (valid with config->id_hash)
+   */
+  struct wpa_ssid *prev;
+
   /**
    * pnext - Next network in per-priority list
    *
@@ -57,6 +62,48 @@ struct wpa_ssid {
    */
   struct wpa_ssid *pnext;
 
+  /**
+   * pprev - Previous network in per-priority list
+   */
+  struct wpa_ssid *pprev;
+
+  /**
+   * hnext - Next network in the same SSID index bucket
+   *
+   * Networks in the same priority class are indexed by SSID (see
+   * struct wpa_prio_index). Networks without an SSID are in a separate
+   * wildcard list.
+   */
+  struct wpa_ssid *hnext;
+
+  /**
+   * hprev - Previous network in the same SSID index bucket
+   */
+  struct wpa_ssid *hprev;
+
+  /**
+   * inext - Next network in the same network id hash bucket
+   */
+  struct wpa_ssid *inext;
+
+  /**
+   * prio_pos - Position of the network in its per-priority list
+   */
+  int prio_pos;
+
+  /**
+   * prio_bucket - SSID index bucket or -1 for the wildcard list
+   */
+  int prio_bucket;
+
+  /**
+   * prio_group - Priority of the group the network is currently in
+   *
+   * This differs from priority if the priority has been changed without
+   * updating the priority lists.
+   */
+  int prio_group;
+
   /**
    * id - Unique id for the network
    *
@@ -136,6 +183,15 @@ struct wpa_ssid {
    */
   char *passphrase;
 
+  /**
+   * psk_pending - Whether psk still needs to be derived from passphrase
+   *
+   * With lazy_psk=1, PBKDF2 is not run when the configuration is read.
+   * Instead, this flag is set and the PSK is derived when the network is
+   * selected for association.
+   */
+  int psk_pending;
+
   /**
    * pairwise_cipher - Bitfield of allowed pairwise ciphers, WPA_CIPHER_*
    */
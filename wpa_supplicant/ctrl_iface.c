@@ -29,6 +29,7 @@
 #include "ieee802_11_defs.h"
 #include "wps_supplicant.h"
 #include "wps/wps.h"
+#include "bss.h"
 
 static int wpa_supplicant_global_iface_list(struct wpa_global *global,
                                             char *buf, int len);
@@ -311,6 +312,27 @@ static int wpa_supplicant_ctrl_iface_ctrl_rsp(struct wpa_supplicant *wpa_s,
 }
 
 
+static int wpa_supplicant_ctrl_iface_eloop_mib(char *buf, size_t buflen)
+{
+        struct eloop_stats stats;
+        int ret;
+
+        eloop_get_stats(&stats);
+        ret = os_snprintf(buf, buflen,
+                          "eloopWakeups=%u\n"
+                          "eloopTimeoutsFired=%u\n"
+                          "eloopTimeoutBatches=%u\n"
+                          "eloopLastTimeoutBatch=%u\n"
+                          "eloopMaxTimeoutBatch=%u\n",
+                          stats.wakeups, stats.timeouts_fired,
+                          stats.timeout_batches, stats.last_batch,
+                          stats.max_batch);
+        if (ret < 0 || (size_t) ret >= buflen)
+                return 0;
+        return ret;
+}
+
+
 static int wpa_supplicant_ctrl_iface_status(struct wpa_supplicant *wpa_s,
                                             const char *params,
                                             char *buf, size_t buflen)
@@ -385,6 +407,16 @@ static int wpa_supplicant_ctrl_iface_status(struct wpa_supplicant *wpa_s,
         if (res >= 0)
                 pos += res;
 
+        if (verbose && wpa_s->conf->psk_cache) {
+                ret = os_snprintf(pos, end - pos, "psk_cache_hits=%u\n"
+                                  "psk_cache_misses=%u\n",
+                                  wpa_s->conf->psk_cache_hits,
+                                  wpa_s->conf->psk_cache_misses);
+                if (ret < 0 || ret >= end - pos)
+                        return pos - buf;
+                pos += ret;
+        }
+
         return pos - buf;
 }
 
@@ -522,9 +554,8 @@ static char * wpa_supplicant_cipher_txt(char *pos, char *end, int cipher)
 
 
 static char * wpa_supplicant_ie_txt(char *pos, char *end, const char *proto,
-                                    const u8 *ie, size_t ie_len)
+                                    const struct wpa_ie_data *data)
 {
-        struct wpa_ie_data data;
         int first, ret;
 
         ret = os_snprintf(pos, end - pos, "[%s-", proto);
@@ -532,7 +563,7 @@ static char * wpa_supplicant_ie_txt(char *pos, char *end, const char *proto,
                 return pos;
         pos += ret;
 
-        if (wpa_parse_wpa_ie(ie, ie_len, &data) < 0) {
+        if (data == NULL) {
                 ret = os_snprintf(pos, end - pos, "?]");
                 if (ret < 0 || ret >= end - pos)
                         return pos;
@@ -541,14 +572,14 @@ static char * wpa_supplicant_ie_txt(char *pos, char *end, const char *proto,
         }
 
         first = 1;
-        if (data.key_mgmt & WPA_KEY_MGMT_IEEE8021X) {
+        if (data->key_mgmt & WPA_KEY_MGMT_IEEE8021X) {
                 ret = os_snprintf(pos, end - pos, "%sEAP", first ? "" : "+");
                 if (ret < 0 || ret >= end - pos)
                         return pos;
                 pos += ret;
                 first = 0;
         }
-        if (data.key_mgmt & WPA_KEY_MGMT_PSK) {
+        if (data->key_mgmt & WPA_KEY_MGMT_PSK) {
                 ret = os_snprintf(pos, end - pos, "%sPSK", first ? "" : "+");
                 if (ret < 0 || ret >= end - pos)
                         return pos;
@@ -556,7 +587,7 @@ static char * wpa_supplicant_ie_txt(char *pos, char *end, const char *proto,
                 first = 0;
         }
 #ifdef CONFIG_CCKM
-        if (data.key_mgmt & WPA_KEY_MGMT_CCKM) {
+        if (data->key_mgmt & WPA_KEY_MGMT_CCKM) {
                 ret = os_snprintf(pos, end - pos, "%sCCKM", first ? "" : "+");
                 if (ret < 0 || ret >= end - pos)
                         return pos;
@@ -564,7 +595,7 @@ static char * wpa_supplicant_ie_txt(char *pos, char *end, const char *proto,
                 first = 0;
         }
 #endif
-        if (data.key_mgmt & WPA_KEY_MGMT_WPA_NONE) {
+        if (data->key_mgmt & WPA_KEY_MGMT_WPA_NONE) {
                 ret = os_snprintf(pos, end - pos, "%sNone", first ? "" : "+");
                 if (ret < 0 || ret >= end - pos)
                         return pos;
@@ -572,7 +603,7 @@ static char * wpa_supplicant_ie_txt(char *pos, char *end, const char *proto,
                 first = 0;
         }
 #ifdef CONFIG_IEEE80211R
-        if (data.key_mgmt & WPA_KEY_MGMT_FT_IEEE8021X) {
+        if (data->key_mgmt & WPA_KEY_MGMT_FT_IEEE8021X) {
                 ret = os_snprintf(pos, end - pos, "%sFT/EAP",
                                   first ? "" : "+");
                 if (ret < 0 || ret >= end - pos)
@@ -580,7 +611,7 @@ static char * wpa_supplicant_ie_txt(char *pos, char *end, const char *proto,
                 pos += ret;
                 first = 0;
         }
-        if (data.key_mgmt & WPA_KEY_MGMT_FT_PSK) {
+        if (data->key_mgmt & WPA_KEY_MGMT_FT_PSK) {
                 ret = os_snprintf(pos, end - pos, "%sFT/PSK",
                                   first ? "" : "+");
                 if (ret < 0 || ret >= end - pos)
@@ -590,7 +621,7 @@ static char * wpa_supplicant_ie_txt(char *pos, char *end, const char *proto,
         }
 #endif /* CONFIG_IEEE80211R */
 #ifdef CONFIG_IEEE80211W
-        if (data.key_mgmt & WPA_KEY_MGMT_IEEE8021X_SHA256) {
+        if (data->key_mgmt & WPA_KEY_MGMT_IEEE8021X_SHA256) {
                 ret = os_snprintf(pos, end - pos, "%sEAP-SHA256",
                                   first ? "" : "+");
                 if (ret < 0 || ret >= end - pos)
@@ -598,7 +629,7 @@ static char * wpa_supplicant_ie_txt(char *pos, char *end, const char *proto,
                 pos += ret;
                 first = 0;
         }
-        if (data.key_mgmt & WPA_KEY_MGMT_PSK_SHA256) {
+        if (data->key_mgmt & WPA_KEY_MGMT_PSK_SHA256) {
                 ret = os_snprintf(pos, end - pos, "%sPSK-SHA256",
                                   first ? "" : "+");
                 if (ret < 0 || ret >= end - pos)
@@ -608,9 +639,9 @@ static char * wpa_supplicant_ie_txt(char *pos, char *end, const char *proto,
         }
 #endif /* CONFIG_IEEE80211W */
 
-        pos = wpa_supplicant_cipher_txt(pos, end, data.pairwise_cipher);
+        pos = wpa_supplicant_cipher_txt(pos, end, data->pairwise_cipher);
 
-        if (data.capabilities & WPA_CAPABILITY_PREAUTH) {
+        if (data->capabilities & WPA_CAPABILITY_PREAUTH) {
                 ret = os_snprintf(pos, end - pos, "-preauth");
                 if (ret < 0 || ret >= end - pos)
                         return pos;
@@ -625,30 +656,45 @@ static char * wpa_supplicant_ie_txt(char *pos, char *end, const char *proto,
         return pos;
 }
 
-static char * wpa_supplicant_wps_ie_txt(char *pos, char *end,
-                                        const struct wpa_scan_res *res)
+static char * wpa_supplicant_bss_flags_txt(char *pos, char *end,
+                                           const struct wpa_bss *bss)
 {
-#ifdef CONFIG_WPS
-        struct wpabuf *wps_ie;
         int ret;
-        const char *txt;
-
-        wps_ie = wpa_scan_get_vendor_ie_multi(res, WPS_IE_VENDOR_TYPE);
-        if (wps_ie == NULL)
-                return pos;
-
-        if (wps_is_selected_pbc_registrar(wps_ie))
+        const char *txt = NULL;
+
+        if (bss->flags & WPA_BSS_WPA_IE)
+                pos = wpa_supplicant_ie_txt(pos, end, "WPA",
+                                            bss->flags & WPA_BSS_WPA_IE_VALID ?
+                                            &bss->wpa : NULL);
+        if (bss->flags & WPA_BSS_RSN_IE)
+                pos = wpa_supplicant_ie_txt(pos, end, "WPA2",
+                                            bss->flags & WPA_BSS_RSN_IE_VALID ?
+                                            &bss->rsn : NULL);
+        if (bss->flags & WPA_BSS_WPS_PBC)
                 txt = "[WPS-PBC]";
-        else if (wps_is_selected_pin_registrar(wps_ie))
+        else if (bss->flags & WPA_BSS_WPS_PIN)
                 txt = "[WPS-PIN]";
-        else
+        else if (bss->flags & WPA_BSS_WPS)
                 txt = "[WPS]";
-
-        ret = os_snprintf(pos, end - pos, "%s", txt);
-        if (ret >= 0 && ret < end - pos)
+        if (txt) {
+                ret = os_snprintf(pos, end - pos, "%s", txt);
+                if (ret < 0 || ret >= end - pos)
+                        return pos;
                 pos += ret;
-        wpabuf_free(wps_ie);
-#endif /* CONFIG_WPS */
+        }
+        if (!(bss->flags & (WPA_BSS_WPA_IE | WPA_BSS_RSN_IE)) &&
+            bss->res->caps & IEEE80211_CAP_PRIVACY) {
+                ret = os_snprintf(pos, end - pos, "[WEP]");
+                if (ret < 0 || ret >= end - pos)
+                        return pos;
+                pos += ret;
+        }
+        if (bss->res->caps & IEEE80211_CAP_IBSS) {
+                ret = os_snprintf(pos, end - pos, "[IBSS]");
+                if (ret < 0 || ret >= end - pos)
+                        return pos;
+                pos += ret;
+        }
 
         return pos;
 }
@@ -656,43 +702,23 @@ static char * wpa_supplicant_wps_ie_txt(char *pos, char *end,
 
 /* Format one result on one text line into a buffer. */
 static int wpa_supplicant_ctrl_iface_scan_result(
-        const struct wpa_scan_res *res, char *buf, size_t buflen)
+        const struct wpa_bss *bss, char *buf, size_t buflen)
 {
         char *pos, *end;
         int ret;
-        const u8 *ie, *ie2;
 
         pos = buf;
         end = buf + buflen;
 
         ret = os_snprintf(pos, end - pos, MACSTR "\t%d\t%d\t",
-                          MAC2STR(res->bssid), res->freq, res->level);
+                          MAC2STR(bss->bssid), bss->freq, bss->res->level);
         if (ret < 0 || ret >= end - pos)
                 return pos - buf;
         pos += ret;
-        ie = wpa_scan_get_vendor_ie(res, WPA_IE_VENDOR_TYPE);
-        if (ie)
-                pos = wpa_supplicant_ie_txt(pos, end, "WPA", ie, 2 + ie[1]);
-        ie2 = wpa_scan_get_ie(res, WLAN_EID_RSN);
-        if (ie2)
-                pos = wpa_supplicant_ie_txt(pos, end, "WPA2", ie2, 2 + ie2[1]);
-        pos = wpa_supplicant_wps_ie_txt(pos, end, res);
-        if (!ie && !ie2 && res->caps & IEEE80211_CAP_PRIVACY) {
-                ret = os_snprintf(pos, end - pos, "[WEP]");
-                if (ret < 0 || ret >= end - pos)
-                        return pos - buf;
-                pos += ret;
-        }
-        if (res->caps & IEEE80211_CAP_IBSS) {
-                ret = os_snprintf(pos, end - pos, "[IBSS]");
-                if (ret < 0 || ret >= end - pos)
-                        return pos - buf;
-                pos += ret;
-        }
+        pos = wpa_supplicant_bss_flags_txt(pos, end, bss);
 
-        ie = wpa_scan_get_ie(res, WLAN_EID_SSID);
         ret = os_snprintf(pos, end - pos, "\t%s",
-                          ie ? wpa_ssid_txt(ie + 2, ie[1]) : "");
+                          wpa_ssid_txt(bss->ssid, bss->ssid_len));
         if (ret < 0 || ret >= end - pos)
                 return pos - buf;
         pos += ret;
@@ -710,7 +736,6 @@ static int wpa_supplicant_ctrl_iface_scan_results(
         struct wpa_supplicant *wpa_s, char *buf, size_t buflen)
 {
         char *pos, *end;
-        struct wpa_scan_res *res;
         int ret;
         size_t i;
 
@@ -726,10 +751,9 @@ static int wpa_supplicant_ctrl_iface_scan_results(
                 return pos - buf;
         pos += ret;
 
-        for (i = 0; i < wpa_s->scan_res->num; i++) {
-                res = wpa_s->scan_res->res[i];
-                ret = wpa_supplicant_ctrl_iface_scan_result(res, pos,
-                                                            end - pos);
+        for (i = 0; i < wpa_s->last_scan_res_used; i++) {
+                ret = wpa_supplicant_ctrl_iface_scan_result(
+                        wpa_s->last_scan_res[i], pos, end - pos);
                 if (ret < 0 || ret >= end - pos)
                         return pos - buf;
                 pos += ret;
@@ -983,7 +1007,8 @@ static int wpa_supplicant_ctrl_iface_set_network(
         if ((os_strcmp(name, "psk") == 0 &&
              value[0] == '"' && ssid->ssid_len) ||
             (os_strcmp(name, "ssid") == 0 && ssid->passphrase))
-                wpa_config_update_psk(ssid);
+                wpa_config_psk_changed(wpa_s->conf, ssid);
+        wpa_config_prio_changed(wpa_s->conf, name);
 
         return 0;
 }
@@ -1370,33 +1395,28 @@ static int wpa_supplicant_ctrl_iface_bss(struct wpa_supplicant *wpa_s,
 {
         u8 bssid[ETH_ALEN];
         size_t i;
-        struct wpa_scan_results *results;
-        struct wpa_scan_res *bss;
+        struct wpa_bss *bss;
+        struct wpa_scan_res *res;
         int ret;
         char *pos, *end;
-        const u8 *ie, *ie2;
+        const u8 *ie;
 
         if (wpa_s->scan_res == NULL &&
             wpa_supplicant_get_scan_results(wpa_s) < 0)
                 return 0;
 
-        results = wpa_s->scan_res;
-        if (results == NULL)
-                return 0;
-
-        if (hwaddr_aton(cmd, bssid) == 0) {
-                for (i = 0; i < results->num; i++) {
-                        if (os_memcmp(bssid, results->res[i]->bssid, ETH_ALEN)
-                            == 0)
-                                break;
-                }
-        } else
+        if (hwaddr_aton(cmd, bssid) == 0)
+                bss = wpa_bss_get_bssid(wpa_s, bssid);
+        else {
                 i = atoi(cmd);
+                bss = i < wpa_s->last_scan_res_used ?
+                        wpa_s->last_scan_res[i] : NULL;
+        }
 
-        if (i >= results->num || results->res[i] == NULL)
+        if (bss == NULL)
                 return 0; /* no match found */
 
-        bss = results->res[i];
+        res = bss->res;
         pos = buf;
         end = buf + buflen;
         ret = os_snprintf(pos, end - pos,
@@ -1409,15 +1429,15 @@ static int wpa_supplicant_ctrl_iface_bss(struct wpa_supplicant *wpa_s,
                           "level=%d\n"
                           "tsf=%016llu\n"
                           "ie=",
-                          MAC2STR(bss->bssid), bss->freq, bss->beacon_int,
-                          bss->caps, bss->qual, bss->noise, bss->level,
-                          (unsigned long long) bss->tsf);
+                          MAC2STR(bss->bssid), bss->freq, res->beacon_int,
+                          res->caps, res->qual, res->noise, res->level,
+                          (unsigned long long) res->tsf);
         if (ret < 0 || ret >= end - pos)
                 return pos - buf;
         pos += ret;
 
-        ie = (const u8 *) (bss + 1);
-        for (i = 0; i < bss->ie_len; i++) {
+        ie = (const u8 *) (res + 1);
+        for (i = 0; i < res->ie_len; i++) {
                 ret = os_snprintf(pos, end - pos, "%02x", *ie++);
                 if (ret < 0 || ret >= end - pos)
                         return pos - buf;
@@ -1434,34 +1454,19 @@ static int wpa_supplicant_ctrl_iface_bss(struct wpa_supplicant *wpa_s,
                 return pos - buf;
         pos += ret;
 
-        ie = wpa_scan_get_vendor_ie(bss, WPA_IE_VENDOR_TYPE);
-        if (ie)
-                pos = wpa_supplicant_ie_txt(pos, end, "WPA", ie, 2 + ie[1]);
-        ie2 = wpa_scan_get_ie(bss, WLAN_EID_RSN);
-        if (ie2)
-                pos = wpa_supplicant_ie_txt(pos, end, "WPA2", ie2, 2 + ie2[1]);
-        pos = wpa_supplicant_wps_ie_txt(pos, end, bss);
-        if (!ie && !ie2 && bss->caps & IEEE80211_CAP_PRIVACY) {
-                ret = os_snprintf(pos, end - pos, "[WEP]");
-                if (ret < 0 || ret >= end - pos)
-                        return pos - buf;
-                pos += ret;
-        }
-        if (bss->caps & IEEE80211_CAP_IBSS) {
-                ret = os_snprintf(pos, end - pos, "[IBSS]");
-                if (ret < 0 || ret >= end - pos)
-                        return pos - buf;
-                pos += ret;
-        }
+        pos = wpa_supplicant_bss_flags_txt(pos, end, bss);
 
         ret = os_snprintf(pos, end - pos, "\n");
         if (ret < 0 || ret >= end - pos)
                 return pos - buf;
         pos += ret;
 
-        ie = wpa_scan_get_ie(bss, WLAN_EID_SSID);
-        ret = os_snprintf(pos, end - pos, "ssid=%s\n",
-                          ie ? wpa_ssid_txt(ie + 2, ie[1]) : "");
+        ret = os_snprintf(pos, end - pos, "ssid=%s\n"
+                          "id=%u\n"
+                          "level_avg=%d\n"
+                          "age=%u\n",
+                          wpa_ssid_txt(bss->ssid, bss->ssid_len), bss->id,
+                          bss->level_avg, wpa_bss_age(bss));
         if (ret < 0 || ret >= end - pos)
                 return pos - buf;
         pos += ret;
@@ -1522,6 +1527,13 @@ char * wpa_supplicant_ctrl_iface_process(struct wpa_supplicant *wpa_s,
                         else
                                 reply_len += res;
                 }
+                if (reply_len >= 0)
+                        reply_len += wpa_supplicant_ctrl_iface_eloop_mib(
+                                reply + reply_len, reply_size - reply_len);
+                if (reply_len >= 0)
+                        reply_len += wpa_supplicant_scan_get_mib(
+                                wpa_s, reply + reply_len,
+                                reply_size - reply_len);
         } else if (os_strncmp(buf, "STATUS", 6) == 0) {
                 reply_len = wpa_supplicant_ctrl_iface_status(
                         wpa_s, buf + 6, reply, reply_size);
@@ -1022,7 +1022,8 @@ DBusMessage * wpas_dbus_iface_set_network(DBusMessage *message,
                 if ((strcmp(entry.key, "psk") == 0 &&
                      value[0] == '"' && ssid->ssid_len) ||
                     (strcmp(entry.key, "ssid") == 0 && ssid->passphrase))
-                        wpa_config_update_psk(ssid);
+                        wpa_config_psk_changed(wpa_s->conf, ssid);
+                wpa_config_prio_changed(wpa_s->conf, entry.key);
 
                 free(value);
                 wpa_dbus_dict_entry_clear(&entry);
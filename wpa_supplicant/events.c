@@ -30,6 +30,7 @@
 #include "ctrl_iface_dbus.h"
 #include "ieee802_11_defs.h"
 #include "blacklist.h"
+#include "bss.h"
 #include "wpas_glue.h"
 #include "wps_supplicant.h"
 #include "wpa_i.h"
@@ -245,7 +246,7 @@ int wpa_supplicant_scard_init(struct wpa_supplicant *wpa_s,
 
 
 #ifndef CONFIG_NO_SCAN_PROCESSING
-static int wpa_supplicant_match_privacy(struct wpa_scan_res *bss,
+static int wpa_supplicant_match_privacy(struct wpa_bss *bss,
                                         struct wpa_ssid *ssid)
 {
         int i, privacy = 0;
@@ -271,7 +272,7 @@ static int wpa_supplicant_match_privacy(struct wpa_scan_res *bss,
                 privacy = 1;
 #endif /* IEEE8021X_EAPOL */
 
-        if (bss->caps & IEEE80211_CAP_PRIVACY)
+        if (bss->res->caps & IEEE80211_CAP_PRIVACY)
                 return privacy;
         return !privacy;
 }
@@ -279,51 +280,51 @@ static int wpa_supplicant_match_privacy(struct wpa_scan_res *bss,
 
 static int wpa_supplicant_ssid_bss_match(struct wpa_supplicant *wpa_s,
                                          struct wpa_ssid *ssid,
-                                         struct wpa_scan_res *bss)
+                                         struct wpa_bss *bss)
 {
-        struct wpa_ie_data ie;
+        const struct wpa_ie_data *ie;
         int proto_match = 0;
-        const u8 *rsn_ie, *wpa_ie;
         int ret;
 
-        ret = wpas_wps_ssid_bss_match(wpa_s, ssid, bss);
+        ret = wpas_wps_ssid_bss_match(wpa_s, ssid, bss->res);
         if (ret >= 0)
                 return ret;
 
-        rsn_ie = wpa_scan_get_ie(bss, WLAN_EID_RSN);
-        while ((ssid->proto & WPA_PROTO_RSN) && rsn_ie) {
+        while ((ssid->proto & WPA_PROTO_RSN) &&
+               (bss->flags & WPA_BSS_RSN_IE)) {
                 proto_match++;
 
-                if (wpa_parse_wpa_ie(rsn_ie, 2 + rsn_ie[1], &ie)) {
+                if (!(bss->flags & WPA_BSS_RSN_IE_VALID)) {
                         wpa_printf(MSG_DEBUG, "   skip RSN IE - parse failed");
                         break;
                 }
-                if (!(ie.proto & ssid->proto)) {
+                ie = &bss->rsn;
+                if (!(ie->proto & ssid->proto)) {
                         wpa_printf(MSG_DEBUG, "   skip RSN IE - proto "
                                    "mismatch");
                         break;
                 }
 
-                if (!(ie.pairwise_cipher & ssid->pairwise_cipher)) {
+                if (!(ie->pairwise_cipher & ssid->pairwise_cipher)) {
                         wpa_printf(MSG_DEBUG, "   skip RSN IE - PTK cipher "
                                    "mismatch");
                         break;
                 }
 
-                if (!(ie.group_cipher & ssid->group_cipher)) {
+                if (!(ie->group_cipher & ssid->group_cipher)) {
                         wpa_printf(MSG_DEBUG, "   skip RSN IE - GTK cipher "
                                    "mismatch");
                         break;
                 }
 
-                if (!(ie.key_mgmt & ssid->key_mgmt)) {
+                if (!(ie->key_mgmt & ssid->key_mgmt)) {
                         wpa_printf(MSG_DEBUG, "   skip RSN IE - key mgmt "
                                    "mismatch");
                         break;
                 }
 
 #ifdef CONFIG_IEEE80211W
-                if (!(ie.capabilities & WPA_CAPABILITY_MFPC) &&
+                if (!(ie->capabilities & WPA_CAPABILITY_MFPC) &&
                     ssid->ieee80211w == IEEE80211W_REQUIRED) {
                         wpa_printf(MSG_DEBUG, "   skip RSN IE - no mgmt frame "
                                    "protection");
@@ -335,33 +336,34 @@ static int wpa_supplicant_ssid_bss_match(struct wpa_supplicant *wpa_s,
                 return 1;
         }
 
-        wpa_ie = wpa_scan_get_vendor_ie(bss, WPA_IE_VENDOR_TYPE);
-        while ((ssid->proto & WPA_PROTO_WPA) && wpa_ie) {
+        while ((ssid->proto & WPA_PROTO_WPA) &&
+               (bss->flags & WPA_BSS_WPA_IE)) {
                 proto_match++;
 
-                if (wpa_parse_wpa_ie(wpa_ie, 2 + wpa_ie[1], &ie)) {
+                if (!(bss->flags & WPA_BSS_WPA_IE_VALID)) {
                         wpa_printf(MSG_DEBUG, "   skip WPA IE - parse failed");
                         break;
                 }
-                if (!(ie.proto & ssid->proto)) {
+                ie = &bss->wpa;
+                if (!(ie->proto & ssid->proto)) {
                         wpa_printf(MSG_DEBUG, "   skip WPA IE - proto "
                                    "mismatch");
                         break;
                 }
 
-                if (!(ie.pairwise_cipher & ssid->pairwise_cipher)) {
+                if (!(ie->pairwise_cipher & ssid->pairwise_cipher)) {
                         wpa_printf(MSG_DEBUG, "   skip WPA IE - PTK cipher "
                                    "mismatch");
                         break;
                 }
 
-                if (!(ie.group_cipher & ssid->group_cipher)) {
+                if (!(ie->group_cipher & ssid->group_cipher)) {
                         wpa_printf(MSG_DEBUG, "   skip WPA IE - GTK cipher "
                                    "mismatch");
                         break;
                 }
 
-                if (!(ie.key_mgmt & ssid->key_mgmt)) {
+                if (!(ie->key_mgmt & ssid->key_mgmt)) {
                         wpa_printf(MSG_DEBUG, "   skip WPA IE - key mgmt "
                                    "mismatch");
                         break;
@@ -378,73 +380,117 @@ static int wpa_supplicant_ssid_bss_match(struct wpa_supplicant *wpa_s,
 }
 
 
-static struct wpa_scan_res *
-wpa_supplicant_select_bss_wpa(struct wpa_supplicant *wpa_s,
-                              struct wpa_ssid *group,
+/*
+ * If in connected state, figure out the RSSI of the connected AP from the
+ * latest scan and keep using it unless the RSSI has crossed the roam
+ * threshold.
+ */
+static struct wpa_bss *
+wpa_supplicant_roam_keep_current(struct wpa_supplicant *wpa_s)
+{
+        struct wpa_bss *bss;
+
+        bss = wpa_bss_get_bssid(wpa_s, wpa_s->bssid);
+        if (bss == NULL || bss->last_update_idx != wpa_s->bss_update_idx)
+                return NULL;
+
+        wpa_s->level = bss->res->level;
+        if (wpa_s->level >= wpa_s->conf->roam_threshold)
+                return NULL;
+
+        wpa_printf(MSG_DEBUG, "Skipping searching for APs - current AP's "
+                   "RSSI %d is below the roam threshold: %d",
+                   wpa_s->level, wpa_s->conf->roam_threshold);
+        return bss;
+}
+
+
+static void wpa_supplicant_bss_debug(int i, struct wpa_bss *bss)
+{
+        wpa_printf(MSG_DEBUG, "%d: " MACSTR " ssid='%s' "
+                   "wpa_ie=%d rsn_ie=%d caps=0x%x level=%d age=%u",
+                   i, MAC2STR(bss->bssid),
+                   wpa_ssid_txt(bss->ssid, bss->ssid_len),
+                   !!(bss->flags & WPA_BSS_WPA_IE),
+                   !!(bss->flags & WPA_BSS_RSN_IE), bss->res->caps,
+                   bss->res->level, wpa_bss_age(bss));
+}
+
+
+/*
+ * Candidate networks for a BSS are the networks indexed under the SSID of the
+ * BSS and the networks without an SSID, merged in the order of the priority
+ * list so that the first match is the same as when walking the full list.
+ */
+struct wpa_ssid_candidates {
+        struct wpa_ssid *named;
+        struct wpa_ssid *wildcard;
+        const u8 *ssid;
+        size_t ssid_len;
+};
+
+
+static void wpa_supplicant_candidates_init(struct wpa_supplicant *wpa_s,
+                                           struct wpa_ssid_candidates *cand,
+                                           int prio, struct wpa_bss *bss)
+{
+        cand->named = wpa_config_prio_ssid_list(wpa_s->conf, prio, bss->ssid,
+                                                bss->ssid_len);
+        cand->wildcard = wpa_s->conf->prio_index[prio].wildcard;
+        cand->ssid = bss->ssid;
+        cand->ssid_len = bss->ssid_len;
+}
+
+
+static struct wpa_ssid *
+wpa_supplicant_next_candidate(struct wpa_ssid_candidates *cand)
+{
+        struct wpa_ssid *ssid;
+
+        /* Skip other SSIDs sharing the same index bucket */
+        while (cand->named &&
+               (cand->named->ssid_len != cand->ssid_len ||
+                os_memcmp(cand->named->ssid, cand->ssid, cand->ssid_len) != 0))
+                cand->named = cand->named->hnext;
+
+        if (cand->named == NULL ||
+            (cand->wildcard &&
+             cand->wildcard->prio_pos < cand->named->prio_pos)) {
+                ssid = cand->wildcard;
+                if (ssid)
+                        cand->wildcard = ssid->hnext;
+        } else {
+                ssid = cand->named;
+                cand->named = ssid->hnext;
+        }
+
+        return ssid;
+}
+
+
+static struct wpa_bss *
+wpa_supplicant_select_bss_wpa(struct wpa_supplicant *wpa_s, int prio,
                               struct wpa_ssid **selected_ssid)
 {
+        struct wpa_ssid_candidates cand;
         struct wpa_ssid *ssid;
-        struct wpa_scan_res *bss;
+        struct wpa_bss *bss;
         size_t i;
         struct wpa_blacklist *e;
-        const u8 *ie;
-        u8 connected = 0;
-        u8 level = 0, index = 0;
-
-        /* If we are already in the connected state then do this */
-        if ((wpa_s->wpa->proto == WPA_PROTO_RSN) || 
-            (wpa_s->wpa->proto == WPA_PROTO_WPA))  {        
-                if (wpa_s->wpa_state == WPA_COMPLETED) 
-                        connected = 1;        
-        }
-        else if (wpa_s->wpa_state == WPA_COMPLETED) {
-                        connected = 1;
-        }
+        int connected = wpa_s->wpa_state == WPA_COMPLETED;
 
         if (connected) {
-                /* If in connected state, figure out the RSSI of the 
-                 * connected AP and its corresponding entry in the 
-                 * scan table 
-                 */
-               
-                for (i = 0; i < wpa_s->scan_res->num; i++) {
-                        if (os_memcmp(wpa_s->scan_res->res[i], wpa_s->bssid, ETH_ALEN) == 0) {
-                                     wpa_s->level = wpa_s->scan_res->res[i]->level;
-                                index = i;
-                                break;
-                          }
-                }
-                if (wpa_s->level < wpa_s->conf->roam_threshold) {
-                        wpa_printf(MSG_DEBUG, "Skipping searching for APs - current AP's RSSI %d is below "
-                                              "the roam threshold: %d", wpa_s->level,
-                                              wpa_s->conf->roam_threshold);
-                         bss = wpa_s->scan_res->res[index];
-                          return bss;
+                bss = wpa_supplicant_roam_keep_current(wpa_s);
+                if (bss) {
+                        *selected_ssid = wpa_s->current_ssid;
+                        return bss;
                 }
         }
 
         wpa_printf(MSG_DEBUG, "Try to find WPA-enabled AP");
-        for (i = 0; i < wpa_s->scan_res->num; i++) {
-                const u8 *ssid_;
-                u8 wpa_ie_len, rsn_ie_len, ssid_len;
-                bss = wpa_s->scan_res->res[i];
-                level = wpa_s->scan_res->res[i]->level;
-
-                ie = wpa_scan_get_ie(bss, WLAN_EID_SSID);
-                ssid_ = ie ? ie + 2 : (u8 *) "";
-                ssid_len = ie ? ie[1] : 0;
-
-                ie = wpa_scan_get_vendor_ie(bss, WPA_IE_VENDOR_TYPE);
-                wpa_ie_len = ie ? ie[1] : 0;
-
-                ie = wpa_scan_get_ie(bss, WLAN_EID_RSN);
-                rsn_ie_len = ie ? ie[1] : 0;
-
-                wpa_printf(MSG_DEBUG, "%d: " MACSTR " ssid='%s' "
-                           "wpa_ie_len=%u rsn_ie_len=%u caps=0x%x",
-                           (int) i, MAC2STR(bss->bssid),
-                           wpa_ssid_txt(ssid_, ssid_len),
-                           wpa_ie_len, rsn_ie_len, bss->caps);
+        for (i = 0; i < wpa_s->last_scan_res_used; i++) {
+                bss = wpa_s->last_scan_res[i];
+                wpa_supplicant_bss_debug(i, bss);
 
                 e = wpa_blacklist_get(wpa_s, bss->bssid);
                 if (e && e->count > 1) {
@@ -452,17 +498,18 @@ wpa_supplicant_select_bss_wpa(struct wpa_supplicant *wpa_s,
                         continue;
                 }
 
-                if (ssid_len == 0) {
+                if (bss->ssid_len == 0) {
                         wpa_printf(MSG_DEBUG, "   skip - SSID not known");
                         continue;
                 }
 
-                if (wpa_ie_len == 0 && rsn_ie_len == 0) {
+                if (!(bss->flags & (WPA_BSS_WPA_IE | WPA_BSS_RSN_IE))) {
                         wpa_printf(MSG_DEBUG, "   skip - no WPA/RSN IE");
                         continue;
                 }
 
-                for (ssid = group; ssid; ssid = ssid->pnext) {
+                wpa_supplicant_candidates_init(wpa_s, &cand, prio, bss);
+                while ((ssid = wpa_supplicant_next_candidate(&cand))) {
                         int check_ssid = 1;
 
                         if (ssid->disabled) {
@@ -472,13 +519,14 @@ wpa_supplicant_select_bss_wpa(struct wpa_supplicant *wpa_s,
 
 #ifdef CONFIG_WPS
                         if (ssid->ssid_len == 0 &&
-                            wpas_wps_ssid_wildcard_ok(wpa_s, ssid, bss))
+                            wpas_wps_ssid_wildcard_ok(wpa_s, ssid, bss->res))
                                 check_ssid = 0;
 #endif /* CONFIG_WPS */
 
                         if (check_ssid &&
-                            (ssid_len != ssid->ssid_len ||
-                             os_memcmp(ssid_, ssid->ssid, ssid_len) != 0)) {
+                            (bss->ssid_len != ssid->ssid_len ||
+                             os_memcmp(bss->ssid, ssid->ssid,
+                                       bss->ssid_len) != 0)) {
                                 wpa_printf(MSG_DEBUG, "   skip - "
                                            "SSID mismatch");
                                 continue;
@@ -495,23 +543,24 @@ wpa_supplicant_select_bss_wpa(struct wpa_supplicant *wpa_s,
                         if (!wpa_supplicant_ssid_bss_match(wpa_s, ssid, bss))
                                 continue;
 
-                        /* Check here that if the connected AP's RSSI is better 
+                        /* Check here that if the connected AP's RSSI is better
                          * by roam hysteresis,
                          * only then issue a connect request else continue,
                          * check in the connected state only.
-                         */        
-                        if (connected) {
-                                if (wpa_s->level - level < wpa_s->conf->roam_hysteresis) {
-                                        wpa_printf(MSG_DEBUG, "   skip - "
-                                               "RSSI doesn't cross roam hystersis");        
-                                        continue;         
-                                }
+                         */
+                        if (connected &&
+                            wpa_s->level - bss->res->level <
+                            wpa_s->conf->roam_hysteresis) {
+                                wpa_printf(MSG_DEBUG, "   skip - "
+                                           "RSSI doesn't cross roam "
+                                           "hysteresis");
+                                continue;
                         }
 
                         wpa_printf(MSG_DEBUG, "   selected WPA AP "
                                    MACSTR " ssid='%s'",
                                    MAC2STR(bss->bssid),
-                                   wpa_ssid_txt(ssid_, ssid_len));
+                                   wpa_ssid_txt(bss->ssid, bss->ssid_len));
                         *selected_ssid = ssid;
                         return bss;
                 }
@@ -521,72 +570,29 @@ wpa_supplicant_select_bss_wpa(struct wpa_supplicant *wpa_s,
 }
 
 
-static struct wpa_scan_res *
-wpa_supplicant_select_bss_non_wpa(struct wpa_supplicant *wpa_s,
-                                  struct wpa_ssid *group,
+static struct wpa_bss *
+wpa_supplicant_select_bss_non_wpa(struct wpa_supplicant *wpa_s, int prio,
                                   struct wpa_ssid **selected_ssid)
 {
+        struct wpa_ssid_candidates cand;
         struct wpa_ssid *ssid;
-        struct wpa_scan_res *bss;
+        struct wpa_bss *bss;
         size_t i;
         struct wpa_blacklist *e;
-        const u8 *ie;
-        u8 connected = 0;
-        u8 level = 0, index = 0;
-
-        /* If we are already in the connected state then do this */
-        if ((wpa_s->wpa->proto == WPA_PROTO_RSN) || 
-            (wpa_s->wpa->proto == WPA_PROTO_WPA))  {        
-                if (wpa_s->wpa_state == WPA_COMPLETED) 
-                        connected = 1;        
-        }
-        else if (wpa_s->wpa_state == WPA_COMPLETED) {
-                        connected = 1;
-        }
+        int connected = wpa_s->wpa_state == WPA_COMPLETED;
 
         if (connected) {
-                /* If in connected state, figure out the RSSI of the 
-                 * connected AP and its corresponding entry in the 
-                 * scan table 
-                 */
-               
-                for (i = 0; i < wpa_s->scan_res->num; i++) {
-                        if (os_memcmp(wpa_s->scan_res->res[i], wpa_s->bssid, ETH_ALEN) == 0) {
-                                     wpa_s->level = wpa_s->scan_res->res[i]->level;
-                                index = i;
-                                break;
-                          }
-                }
-                if (wpa_s->level < wpa_s->conf->roam_threshold) {
-                        wpa_printf(MSG_DEBUG, "Skipping searching for APs as current AP's RSSI is below "
-                                              "the roam threshold: %d", wpa_s->level);
-                         bss = wpa_s->scan_res->res[index];
-                          return bss;
+                bss = wpa_supplicant_roam_keep_current(wpa_s);
+                if (bss) {
+                        *selected_ssid = wpa_s->current_ssid;
+                        return bss;
                 }
         }
 
         wpa_printf(MSG_DEBUG, "Try to find non-WPA AP");
-        for (i = 0; i < wpa_s->scan_res->num; i++) {
-                const u8 *ssid_;
-                u8 wpa_ie_len, rsn_ie_len, ssid_len;
-                bss = wpa_s->scan_res->res[i];
-                level = wpa_s->scan_res->res[i]->level;
-
-                ie = wpa_scan_get_ie(bss, WLAN_EID_SSID);
-                ssid_ = ie ? ie + 2 : (u8 *) "";
-                ssid_len = ie ? ie[1] : 0;
-
-                ie = wpa_scan_get_vendor_ie(bss, WPA_IE_VENDOR_TYPE);
-                wpa_ie_len = ie ? ie[1] : 0;
-
-                ie = wpa_scan_get_ie(bss, WLAN_EID_RSN);
-                rsn_ie_len = ie ? ie[1] : 0;
-
-                wpa_printf(MSG_DEBUG, "%d: " MACSTR " ssid='%s' "
-                           "wpa_ie_len=%u rsn_ie_len=%u caps=0x%x",
-                           (int) i, MAC2STR(bss->bssid),
-                           wpa_ssid_txt(ssid_, ssid_len),
-                           wpa_ie_len, rsn_ie_len, bss->caps);
+        for (i = 0; i < wpa_s->last_scan_res_used; i++) {
+                bss = wpa_s->last_scan_res[i];
+                wpa_supplicant_bss_debug(i, bss);
 
                 e = wpa_blacklist_get(wpa_s, bss->bssid);
                 if (e && e->count > 1) {
@@ -594,12 +600,13 @@ wpa_supplicant_select_bss_non_wpa(struct wpa_supplicant *wpa_s,
                         continue;
                 }
 
-                if (ssid_len == 0) {
+                if (bss->ssid_len == 0) {
                         wpa_printf(MSG_DEBUG, "   skip - SSID not known");
                         continue;
                 }
 
-                for (ssid = group; ssid; ssid = ssid->pnext) {
+                wpa_supplicant_candidates_init(wpa_s, &cand, prio, bss);
+                while ((ssid = wpa_supplicant_next_candidate(&cand))) {
                         int check_ssid = ssid->ssid_len != 0;
 
                         if (ssid->disabled) {
@@ -615,14 +622,15 @@ wpa_supplicant_select_bss_non_wpa(struct wpa_supplicant *wpa_s,
                                 check_ssid = 1;
                                 if (ssid->ssid_len == 0 &&
                                     wpas_wps_ssid_wildcard_ok(wpa_s, ssid,
-                                                              bss))
+                                                              bss->res))
                                         check_ssid = 0;
                         }
 #endif /* CONFIG_WPS */
 
                         if (check_ssid &&
-                            (ssid_len != ssid->ssid_len ||
-                             os_memcmp(ssid_, ssid->ssid, ssid_len) != 0)) {
+                            (bss->ssid_len != ssid->ssid_len ||
+                             os_memcmp(bss->ssid, ssid->ssid,
+                                       bss->ssid_len) != 0)) {
                                 wpa_printf(MSG_DEBUG, "   skip - "
                                            "SSID mismatch");
                                 continue;
@@ -650,7 +658,7 @@ wpa_supplicant_select_bss_non_wpa(struct wpa_supplicant *wpa_s,
                               WPA_KEY_MGMT_FT_IEEE8021X | WPA_KEY_MGMT_FT_PSK |
                               WPA_KEY_MGMT_IEEE8021X_SHA256 |
                               WPA_KEY_MGMT_PSK_SHA256)) &&
-                            (wpa_ie_len != 0 || rsn_ie_len != 0)) {
+                            (bss->flags & (WPA_BSS_WPA_IE | WPA_BSS_RSN_IE))) {
                                 wpa_printf(MSG_DEBUG, "   skip - "
                                            "WPA network");
                                 continue;
@@ -662,29 +670,30 @@ wpa_supplicant_select_bss_non_wpa(struct wpa_supplicant *wpa_s,
                                 continue;
                         }
 
-                        if (bss->caps & IEEE80211_CAP_IBSS) {
+                        if (bss->res->caps & IEEE80211_CAP_IBSS) {
                                 wpa_printf(MSG_DEBUG, "   skip - "
                                            "IBSS (adhoc) network");
                                 continue;
                         }
 
-                        /* Check here that if the connected AP's RSSI is better 
+                        /* Check here that if the connected AP's RSSI is better
                          * by roam hysteresis,
                          * only then issue a connect request else continue,
                          * check in the connected state only.
-                         */        
-                        if (connected) {
-                                if (wpa_s->level - level < wpa_s->conf->roam_hysteresis) {
-                                        wpa_printf(MSG_DEBUG, "   skip - "
-                                               "RSSI doesn't cross roam hystersis");        
-                                        continue;         
-                                }
+                         */
+                        if (connected &&
+                            wpa_s->level - bss->res->level <
+                            wpa_s->conf->roam_hysteresis) {
+                                wpa_printf(MSG_DEBUG, "   skip - "
+                                           "RSSI doesn't cross roam "
+                                           "hysteresis");
+                                continue;
                         }
 
                         wpa_printf(MSG_DEBUG, "   selected non-WPA AP "
                                    MACSTR " ssid='%s'",
                                    MAC2STR(bss->bssid),
-                                   wpa_ssid_txt(ssid_, ssid_len));
+                                   wpa_ssid_txt(bss->ssid, bss->ssid_len));
                         *selected_ssid = ssid;
                         return bss;
                 }
@@ -694,30 +703,50 @@ wpa_supplicant_select_bss_non_wpa(struct wpa_supplicant *wpa_s,
 }
 
 
-static struct wpa_scan_res *
-wpa_supplicant_select_bss(struct wpa_supplicant *wpa_s, struct wpa_ssid *group,
+static struct wpa_bss *
+wpa_supplicant_select_bss(struct wpa_supplicant *wpa_s, int prio,
                           struct wpa_ssid **selected_ssid)
 {
-        struct wpa_scan_res *selected;
+        struct wpa_bss *selected;
 
         wpa_printf(MSG_DEBUG, "Selecting BSS from priority group %d",
-                   group->priority);
+                   wpa_s->conf->pssid[prio]->priority);
 
         /* First, try to find WPA-enabled AP */
-        selected = wpa_supplicant_select_bss_wpa(wpa_s, group, selected_ssid);
+        selected = wpa_supplicant_select_bss_wpa(wpa_s, prio, selected_ssid);
         if (selected)
                 return selected;
 
         /* If no WPA-enabled AP found, try to find non-WPA AP, if configuration
          * allows this. */
-        return wpa_supplicant_select_bss_non_wpa(wpa_s, group, selected_ssid);
+        return wpa_supplicant_select_bss_non_wpa(wpa_s, prio, selected_ssid);
+}
+
+
+static void wpa_supplicant_rsn_preauth_scan_results(
+        struct wpa_supplicant *wpa_s)
+{
+        struct wpa_bss *bss;
+        size_t i;
+
+        if (rsn_preauth_scan_results(wpa_s->wpa) < 0)
+                return;
+
+        /* Add candidates in reverse order of preference */
+        for (i = wpa_s->last_scan_res_used; i > 0; i--) {
+                bss = wpa_s->last_scan_res[i - 1];
+                if (!(bss->flags & WPA_BSS_RSN_IE_VALID))
+                        continue;
+                rsn_preauth_scan_result(wpa_s->wpa, bss->bssid, bss->ssid,
+                                        bss->ssid_len, &bss->rsn);
+        }
 }
 
 
 static void wpa_supplicant_event_scan_results(struct wpa_supplicant *wpa_s)
 {
         int prio, timeout;
-        struct wpa_scan_res *selected = NULL;
+        struct wpa_bss *selected = NULL;
         struct wpa_ssid *ssid = NULL;
         u8 connected = 0;
 
@@ -755,10 +784,12 @@ static void wpa_supplicant_event_scan_results(struct wpa_supplicant *wpa_s)
                 return;
         }
 
+        wpa_config_check_prio_index(wpa_s->conf);
+
         while (selected == NULL) {
                 for (prio = 0; prio < wpa_s->conf->num_prio; prio++) {
-                        selected = wpa_supplicant_select_bss(
-                                wpa_s, wpa_s->conf->pssid[prio], &ssid);
+                        selected = wpa_supplicant_select_bss(wpa_s, prio,
+                                                             &ssid);
                         if (selected)
                                 break;
                 }
@@ -774,7 +805,7 @@ static void wpa_supplicant_event_scan_results(struct wpa_supplicant *wpa_s)
         }
 
         if (selected) {
-                if (wpas_wps_scan_pbc_overlap(wpa_s, selected, ssid)) {
+                if (wpas_wps_scan_pbc_overlap(wpa_s, selected->res, ssid)) {
                         wpa_msg(wpa_s, MSG_INFO, WPS_EVENT_OVERLAP
                                 "PBC session overlap");
                         timeout = 10;
@@ -794,12 +825,12 @@ static void wpa_supplicant_event_scan_results(struct wpa_supplicant *wpa_s)
                                 wpa_supplicant_req_scan(wpa_s, 10, 0);
                                 return;
                         }
-                        wpa_supplicant_associate(wpa_s, selected, ssid);
+                        wpa_supplicant_associate(wpa_s, selected->res, ssid);
                 } else {
                         wpa_printf(MSG_DEBUG, "Already associated with the "
                                    "selected AP.");
                 }
-                rsn_preauth_scan_results(wpa_s->wpa, wpa_s->scan_res);
+                wpa_supplicant_rsn_preauth_scan_results(wpa_s);
         } else {
                 wpa_printf(MSG_DEBUG, "No suitable AP found.");
                 if ((wpa_s->wpa->proto == WPA_PROTO_RSN) || 
@@ -812,7 +843,7 @@ static void wpa_supplicant_event_scan_results(struct wpa_supplicant *wpa_s)
                 }
 
                 if (!connected) {
-                        timeout = 5;
+                        timeout = -1; /* periodic scan with backoff */
                         goto req_scan;
                 }
         }
@@ -834,9 +865,13 @@ req_scan:
                  * to INACTIVE state.
                  */
                 wpa_supplicant_set_state(wpa_s, WPA_INACTIVE);
+                wpa_supplicant_req_periodic_scan(wpa_s);
                 return;
         }
-        wpa_supplicant_req_scan(wpa_s, timeout, 0);
+        if (timeout < 0)
+                wpa_supplicant_req_periodic_scan(wpa_s);
+        else
+                wpa_supplicant_req_scan(wpa_s, timeout, 0);
 }
 #endif /* CONFIG_NO_SCAN_PROCESSING */
 
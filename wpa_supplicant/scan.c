@@ -21,6 +21,10 @@
 #include "mlme.h"
 #include "wps_supplicant.h"
 #include "ctrl_iface_dbus.h"
+#include "bss.h"
+
+/* A driver scan that has not completed in this many seconds is assumed lost */
+#define WPA_SCAN_IN_FLIGHT_TIMEOUT 30
 
 
 static void wpa_supplicant_gen_assoc_event(struct wpa_supplicant *wpa_s)
@@ -79,6 +83,52 @@ int wpa_supplicant_enabled_networks(struct wpa_config *conf)
 }
 
 
+/*
+ * Add the enabled scan_ssid=1 networks to a scan request starting from ssid
+ * (or the beginning of the list) and wrapping around. One entry is left for
+ * the wildcard SSID that is always added last. If not all networks fit into
+ * the request, the next scan continues from where this one stopped.
+ */
+static void wpa_supplicant_scan_ssids(struct wpa_supplicant *wpa_s,
+                                      struct wpa_ssid *ssid,
+                                      struct wpa_driver_scan_params *params)
+{
+        struct wpa_ssid *start, *last = NULL;
+        size_t max_ssids = wpa_s->max_scan_ssids - 1;
+        int more = 0;
+
+        start = ssid ? ssid : wpa_s->conf->ssid;
+        ssid = start;
+        while (ssid) {
+                if (!ssid->disabled && ssid->scan_ssid) {
+                        if (params->num_ssids == max_ssids) {
+                                more = 1;
+                                break;
+                        }
+                        wpa_hexdump_ascii(MSG_DEBUG, "Scan SSID",
+                                          ssid->ssid, ssid->ssid_len);
+                        params->ssids[params->num_ssids].ssid = ssid->ssid;
+                        params->ssids[params->num_ssids].ssid_len =
+                                ssid->ssid_len;
+                        params->num_ssids++;
+                        last = ssid;
+                }
+                ssid = ssid->next;
+                if (ssid == NULL && start != wpa_s->conf->ssid)
+                        ssid = wpa_s->conf->ssid;
+                if (ssid == start)
+                        break;
+        }
+
+        wpa_s->prev_scan_ssid = more ? last : BROADCAST_SSID_SCAN;
+
+        /* Wildcard SSID to find all other networks */
+        params->ssids[params->num_ssids].ssid = NULL;
+        params->ssids[params->num_ssids].ssid_len = 0;
+        params->num_ssids++;
+}
+
+
 static void wpa_supplicant_scan(void *eloop_ctx, void *timeout_ctx)
 {
         struct wpa_supplicant *wpa_s = eloop_ctx;
@@ -88,6 +138,7 @@ static void wpa_supplicant_scan(void *eloop_ctx, void *timeout_ctx)
         const u8 *extra_ie = NULL;
         size_t extra_ie_len = 0;
         int wps = 0;
+        struct wpa_driver_scan_params params;
 #ifdef CONFIG_WPS
         enum wps_request_type req_type = WPS_REQ_ENROLLEE_INFO;
 #endif /* CONFIG_WPS */
@@ -104,7 +155,6 @@ static void wpa_supplicant_scan(void *eloop_ctx, void *timeout_ctx)
                 return;
         }
         scan_req = wpa_s->scan_req;
-        wpa_s->scan_req = 0;
 
         if (wpa_s->conf->ap_scan != 0 &&
             wpa_s->driver && IS_WIRED(wpa_s->driver)) {
@@ -114,6 +164,7 @@ static void wpa_supplicant_scan(void *eloop_ctx, void *timeout_ctx)
         }
 
         if (wpa_s->conf->ap_scan == 0) {
+                wpa_s->scan_req = 0;
                 wpa_supplicant_gen_assoc_event(wpa_s);
                 return;
         }
@@ -144,6 +195,7 @@ static void wpa_supplicant_scan(void *eloop_ctx, void *timeout_ctx)
                  * ap_scan=2 mode - try to associate with each SSID instead of
                  * scanning for each scan_ssid=1 network.
                  */
+                wpa_s->scan_req = 0;
                 if (ssid == NULL) {
                         wpa_printf(MSG_DEBUG, "wpa_supplicant_scan: Reached "
                                    "end of scan list - go back to beginning");
@@ -162,14 +214,57 @@ static void wpa_supplicant_scan(void *eloop_ctx, void *timeout_ctx)
                 return;
         }
 
-        wpa_printf(MSG_DEBUG, "Starting AP scan (%s SSID)",
-                   ssid ? "specific": "broadcast");
-        if (ssid) {
-                wpa_hexdump_ascii(MSG_DEBUG, "Scan SSID",
-                                  ssid->ssid, ssid->ssid_len);
-                wpa_s->prev_scan_ssid = ssid;
-        } else
-                wpa_s->prev_scan_ssid = BROADCAST_SSID_SCAN;
+        if (wpa_s->scanning) {
+                struct os_reltime now, age;
+                os_get_reltime(&now);
+                os_reltime_sub(&now, &wpa_s->scan_start, &age);
+                if (age.sec < WPA_SCAN_IN_FLIGHT_TIMEOUT) {
+                        /*
+                         * The results will trigger the next scan, if needed.
+                         * A manual request is kept and retried until the
+                         * previous scan has completed.
+                         */
+                        wpa_printf(MSG_DEBUG, "Previous scan still in "
+                                   "progress - skip scan request");
+                        wpa_s->scans_skipped++;
+                        if (wpa_s->scan_req &&
+                            !eloop_is_timeout_registered(wpa_supplicant_scan,
+                                                         wpa_s, NULL))
+                                eloop_register_timeout(1, 0,
+                                                       wpa_supplicant_scan,
+                                                       wpa_s, NULL);
+                        else {
+                                /* Do not limit a later scan to these
+                                 * channels */
+                                os_free(wpa_s->next_scan_freqs);
+                                wpa_s->next_scan_freqs = NULL;
+                        }
+                        return;
+                }
+                wpa_printf(MSG_DEBUG, "Previous scan did not complete in %ld "
+                           "seconds - starting a new one", (long) age.sec);
+        }
+        wpa_s->scan_req = 0;
+
+        os_memset(&params, 0, sizeof(params));
+        if (wpa_s->max_scan_ssids > 1 && !wpa_s->use_client_mlme) {
+                wpa_supplicant_scan_ssids(wpa_s, ssid, &params);
+                wpa_printf(MSG_DEBUG, "Starting AP scan (%lu specific SSIDs "
+                           "and broadcast SSID)",
+                           (unsigned long) params.num_ssids - 1);
+        } else {
+                wpa_printf(MSG_DEBUG, "Starting AP scan (%s SSID)",
+                           ssid ? "specific": "broadcast");
+                if (ssid) {
+                        wpa_hexdump_ascii(MSG_DEBUG, "Scan SSID",
+                                          ssid->ssid, ssid->ssid_len);
+                        wpa_s->prev_scan_ssid = ssid;
+                        params.ssids[0].ssid = ssid->ssid;
+                        params.ssids[0].ssid_len = ssid->ssid_len;
+                } else
+                        wpa_s->prev_scan_ssid = BROADCAST_SSID_SCAN;
+                params.num_ssids = 1;
+        }
 
 #ifdef CONFIG_WPS
         wps = wpas_wps_in_use(wpa_s->conf, &req_type);
@@ -203,20 +298,58 @@ static void wpa_supplicant_scan(void *eloop_ctx, void *timeout_ctx)
                 ieee80211_sta_set_probe_req_ie(wpa_s, extra_ie, extra_ie_len);
                 ret = ieee80211_sta_req_scan(wpa_s, ssid ? ssid->ssid : NULL,
                                              ssid ? ssid->ssid_len : 0);
+                os_free(wpa_s->last_scan_freqs);
+                wpa_s->last_scan_freqs = NULL;
         } else {
                 wpa_drv_set_probe_req_ie(wpa_s, extra_ie, extra_ie_len);
-                ret = wpa_drv_scan(wpa_s, ssid ? ssid->ssid : NULL,
-                                   ssid ? ssid->ssid_len : 0);
+                params.freqs = wpa_s->next_scan_freqs;
+                ret = wpa_drv_scan2(wpa_s, &params);
+                if (ret == 0 && params.freqs == NULL)
+                        os_get_reltime(&wpa_s->last_full_scan);
+                if (ret == 0) {
+                        /* Used to age the BSS table only on these channels */
+                        os_free(wpa_s->last_scan_freqs);
+                        wpa_s->last_scan_freqs = wpa_s->next_scan_freqs;
+                } else
+                        os_free(wpa_s->next_scan_freqs);
+                wpa_s->next_scan_freqs = NULL;
         }
 
         wpabuf_free(wps_ie);
 
         if (ret) {
                 wpa_printf(MSG_WARNING, "Failed to initiate AP scan.");
+                wpa_s->scans_failed++;
                 wpa_supplicant_notify_scanning(wpa_s, 0);
-                wpa_supplicant_req_scan(wpa_s, 10, 0);
-        } else
+                wpa_supplicant_req_periodic_scan(wpa_s);
+        } else {
                 wpa_s->scan_runs++;
+                wpa_s->scans_started++;
+                os_get_reltime(&wpa_s->scan_start);
+        }
+}
+
+
+static void wpa_supplicant_sched_scan(struct wpa_supplicant *wpa_s, int sec,
+                                      int usec)
+{
+        wpa_msg(wpa_s, MSG_DEBUG, "Setting scan request: %d sec %d usec",
+                sec, usec);
+        eloop_cancel_timeout(wpa_supplicant_scan, wpa_s, NULL);
+        eloop_register_timeout(sec, usec, wpa_supplicant_scan, wpa_s, NULL);
+}
+
+
+/**
+ * wpa_supplicant_reset_scan_backoff - Restart periodic scans from the start
+ * @wpa_s: Pointer to wpa_supplicant data
+ */
+void wpa_supplicant_reset_scan_backoff(struct wpa_supplicant *wpa_s)
+{
+        if (wpa_s->scan_interval) {
+                wpa_s->scan_interval = 0;
+                wpa_s->scan_backoff_resets++;
+        }
 }
 
 
@@ -227,10 +360,19 @@ static void wpa_supplicant_scan(void *eloop_ctx, void *timeout_ctx)
  * @usec: Number of microseconds after which to scan
  *
  * This function is used to schedule a scan for neighboring access points after
- * the specified time.
+ * the specified time. This is used for explicit requests, e.g., on link and
+ * configuration changes, and it resets the backoff of periodic scans. Periodic
+ * rescans when no suitable AP is found use wpa_supplicant_req_periodic_scan().
  */
 void wpa_supplicant_req_scan(struct wpa_supplicant *wpa_s, int sec, int usec)
 {
+        wpa_s->scan_requests++;
+        wpa_supplicant_reset_scan_backoff(wpa_s);
+
+        /* Only background roaming scans are limited to a set of channels */
+        os_free(wpa_s->next_scan_freqs);
+        wpa_s->next_scan_freqs = NULL;
+
         /* If there's at least one network that should be specifically scanned
          * then don't cancel the scan and reschedule.  Some drivers do
          * background scanning which generates frequent scan results, and that
@@ -253,10 +395,82 @@ void wpa_supplicant_req_scan(struct wpa_supplicant *wpa_s, int sec, int usec)
                 }
         }
 
-        wpa_msg(wpa_s, MSG_DEBUG, "Setting scan request: %d sec %d usec",
-                sec, usec);
-        eloop_cancel_timeout(wpa_supplicant_scan, wpa_s, NULL);
-        eloop_register_timeout(sec, usec, wpa_supplicant_scan, wpa_s, NULL);
+        wpa_supplicant_sched_scan(wpa_s, sec, usec);
+}
+
+
+/**
+ * wpa_supplicant_req_periodic_scan - Schedule the next periodic scan
+ * @wpa_s: Pointer to wpa_supplicant data
+ *
+ * This function is used when a scan did not find a suitable AP. The delay
+ * starts at scan_interval (or idle_scan_interval when there are no enabled
+ * networks) and it is doubled for each consecutive periodic scan up to
+ * scan_interval_max. The backoff is reset by wpa_supplicant_req_scan() and
+ * when a connection is completed. While connected, scans are scheduled with
+ * roam_scan_interval instead. A pending scan request is not delayed.
+ */
+void wpa_supplicant_req_periodic_scan(struct wpa_supplicant *wpa_s)
+{
+        int interval, max = wpa_s->conf->scan_interval_max;
+
+        if (eloop_is_timeout_registered(wpa_supplicant_scan, wpa_s, NULL))
+                return;
+
+        if (wpa_supplicant_enabled_networks(wpa_s->conf))
+                interval = wpa_s->conf->scan_interval;
+        else {
+                interval = wpa_s->conf->idle_scan_interval;
+                if (interval <= 0 || wpa_s->disconnected)
+                        return;
+                /* Force the scan even though no networks are enabled */
+                wpa_s->scan_req = 1;
+        }
+
+        if (wpa_s->scan_interval > interval)
+                interval = wpa_s->scan_interval;
+        if (interval * 2 <= max)
+                wpa_s->scan_interval = interval * 2;
+        else if (interval < max)
+                wpa_s->scan_interval = max;
+        else
+                wpa_s->scan_interval = interval;
+
+        wpa_s->scan_periodic++;
+        wpa_printf(MSG_DEBUG, "Periodic scan in %d seconds (next interval %d "
+                   "seconds)", interval, wpa_s->scan_interval);
+        wpa_supplicant_sched_scan(wpa_s, interval, 0);
+}
+
+
+/**
+ * wpa_supplicant_scan_get_mib - Get scan scheduler counters
+ * @wpa_s: Pointer to wpa_supplicant data
+ * @buf: Buffer for the MIB text
+ * @buflen: Length of the buffer
+ * Returns: Number of bytes written to buf
+ */
+int wpa_supplicant_scan_get_mib(struct wpa_supplicant *wpa_s, char *buf,
+                                size_t buflen)
+{
+        int ret;
+
+        ret = os_snprintf(buf, buflen,
+                          "scanRequests=%u\n"
+                          "scanPeriodic=%u\n"
+                          "scanStarted=%u\n"
+                          "scanFailed=%u\n"
+                          "scanSkippedInFlight=%u\n"
+                          "scanBackoffResets=%u\n"
+                          "scanRoaming=%u\n"
+                          "scanInterval=%d\n",
+                          wpa_s->scan_requests, wpa_s->scan_periodic,
+                          wpa_s->scans_started, wpa_s->scans_failed,
+                          wpa_s->scans_skipped, wpa_s->scan_backoff_resets,
+                          wpa_s->scan_roaming, wpa_s->scan_interval);
+        if (ret < 0 || (size_t) ret >= buflen)
+                return 0;
+        return ret;
 }
 
 
@@ -271,6 +485,107 @@ void wpa_supplicant_cancel_scan(struct wpa_supplicant *wpa_s)
 {
         wpa_msg(wpa_s, MSG_DEBUG, "Cancelling scan request");
         eloop_cancel_timeout(wpa_supplicant_scan, wpa_s, NULL);
+        os_free(wpa_s->next_scan_freqs);
+        wpa_s->next_scan_freqs = NULL;
+}
+
+
+static void wpa_supplicant_roam_scan(void *eloop_ctx, void *timeout_ctx)
+{
+        struct wpa_supplicant *wpa_s = eloop_ctx;
+        struct wpa_ssid *ssid = wpa_s->current_ssid;
+        struct wpa_bss *bss;
+        struct os_reltime now, age;
+        int *freqs = NULL, *n;
+        size_t i;
+
+        if (wpa_s->wpa_state != WPA_COMPLETED || ssid == NULL ||
+            wpa_s->conf->roam_scan_interval <= 0)
+                return;
+        eloop_register_timeout(wpa_s->conf->roam_scan_interval, 0,
+                               wpa_supplicant_roam_scan, wpa_s, NULL);
+
+        if (eloop_is_timeout_registered(wpa_supplicant_scan, wpa_s, NULL)) {
+                wpa_printf(MSG_DEBUG, "Roaming scan: scan already pending");
+                return;
+        }
+
+        os_get_reltime(&now);
+        os_reltime_sub(&now, &wpa_s->last_full_scan, &age);
+        if (wpa_s->last_full_scan.sec &&
+            age.sec < wpa_s->conf->roam_full_scan_interval &&
+            ssid->ssid_len)
+                freqs = wpa_bss_ess_freqs(wpa_s, ssid->ssid, ssid->ssid_len);
+
+        /* Make sure the channel of the current AP is included */
+        bss = wpa_bss_get_bssid(wpa_s, wpa_s->bssid);
+        if (freqs && bss && bss->freq > 0) {
+                for (i = 0; freqs[i]; i++) {
+                        if (freqs[i] == bss->freq)
+                                break;
+                }
+                if (freqs[i] == 0) {
+                        n = os_realloc(freqs, (i + 2) * sizeof(int));
+                        if (n == NULL) {
+                                os_free(freqs);
+                                freqs = NULL;
+                        } else {
+                                freqs = n;
+                                freqs[i] = bss->freq;
+                                freqs[i + 1] = 0;
+                        }
+                }
+        }
+
+        if (freqs) {
+                for (i = 0; freqs[i]; i++)
+                        ;
+                wpa_printf(MSG_DEBUG, "Roaming scan on %lu known channels",
+                           (unsigned long) i);
+        } else
+                wpa_printf(MSG_DEBUG, "Roaming scan on all channels");
+
+        /*
+         * This is not an explicit request, so the periodic scan backoff is
+         * left alone.
+         */
+        wpa_s->scan_roaming++;
+        os_free(wpa_s->next_scan_freqs);
+        wpa_s->next_scan_freqs = freqs;
+        wpa_supplicant_sched_scan(wpa_s, 0, 0);
+}
+
+
+/**
+ * wpa_supplicant_roam_scan_start - Start background roaming scans
+ * @wpa_s: Pointer to wpa_supplicant data
+ *
+ * This function is called when the connection has been completed. If
+ * roam_scan_interval is configured, scans for a better AP of the same ESS are
+ * run periodically while the connection is up. Most of them are limited to the
+ * channels on which the ESS has recently been seen and the full channel list is
+ * scanned at most every roam_full_scan_interval seconds. The results are
+ * processed as any other scan results, i.e., roam_threshold and
+ * roam_hysteresis decide whether to move to another AP.
+ */
+void wpa_supplicant_roam_scan_start(struct wpa_supplicant *wpa_s)
+{
+        if (wpa_s->conf->roam_scan_interval <= 0 ||
+            eloop_is_timeout_registered(wpa_supplicant_roam_scan, wpa_s,
+                                        NULL))
+                return;
+        eloop_register_timeout(wpa_s->conf->roam_scan_interval, 0,
+                               wpa_supplicant_roam_scan, wpa_s, NULL);
+}
+
+
+/**
+ * wpa_supplicant_roam_scan_stop - Stop background roaming scans
+ * @wpa_s: Pointer to wpa_supplicant data
+ */
+void wpa_supplicant_roam_scan_stop(struct wpa_supplicant *wpa_s)
+{
+        eloop_cancel_timeout(wpa_supplicant_roam_scan, wpa_s, NULL);
 }
 
 
@@ -0,0 +1,470 @@
+/*
+ * Test program for the BSS table
+ * Copyright (c) 2026, agent <agent@local>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * Alternatively, this software may be distributed under the terms of BSD
+ * license.
+ *
+ * See README and COPYING for more details.
+ */
+
+#include "includes.h"
+
+#include "common.h"
+#include "wpa.h"
+#include "drivers/driver.h"
+#include "../wpa_supplicant_i.h"
+#include "ieee802_11_defs.h"
+#include "../config_ssid.h"
+#include "../bss.h"
+
+static int errors;
+
+
+/* The IEs are only checked for their presence, so they are not parsed */
+int wpa_parse_wpa_ie(const u8 *wpa_ie, size_t wpa_ie_len,
+                     struct wpa_ie_data *data)
+{
+        os_memset(data, 0, sizeof(*data));
+        return 0;
+}
+
+
+#ifdef CONFIG_WPS
+int wps_is_selected_pbc_registrar(const struct wpabuf *msg)
+{
+        return 0;
+}
+
+
+int wps_is_selected_pin_registrar(const struct wpabuf *msg)
+{
+        return 0;
+}
+#endif /* CONFIG_WPS */
+
+
+/* Scan result for BSSID 02:00:00:00:xx:yy (xx:yy from id) */
+static struct wpa_scan_res * test_res(int id, const char *ssid, int freq,
+                                      int level)
+{
+        struct wpa_scan_res *res;
+        size_t ssid_len = os_strlen(ssid);
+        u8 *pos;
+
+        res = os_zalloc(sizeof(*res) + 2 + ssid_len);
+        if (res == NULL)
+                return NULL;
+        res->bssid[0] = 0x02;
+        res->bssid[4] = id >> 8;
+        res->bssid[5] = id & 0xff;
+        res->freq = freq;
+        res->level = level;
+        res->ie_len = 2 + ssid_len;
+        pos = (u8 *) (res + 1);
+        *pos++ = WLAN_EID_SSID;
+        *pos++ = ssid_len;
+        os_memcpy(pos, ssid, ssid_len);
+        return res;
+}
+
+
+struct test_bss {
+        int id;
+        const char *ssid;
+        int freq;
+        int level;
+};
+
+
+/* Feed one scan to the BSS table */
+static void test_scan(struct wpa_supplicant *wpa_s,
+                      const struct test_bss *bss, size_t num)
+{
+        struct wpa_scan_results res;
+        size_t i;
+
+        os_memset(&res, 0, sizeof(res));
+        res.res = os_zalloc((num + 1) * sizeof(struct wpa_scan_res *));
+        if (res.res == NULL) {
+                errors++;
+                return;
+        }
+        for (i = 0; i < num; i++) {
+                res.res[i] = test_res(bss[i].id, bss[i].ssid, bss[i].freq,
+                                      bss[i].level);
+                if (res.res[i] == NULL) {
+                        errors++;
+                        goto out;
+                }
+        }
+        res.num = num;
+
+        if (wpa_bss_update_scan_res(wpa_s, &res) < 0) {
+                printf("BSS table update failed\n");
+                errors++;
+        }
+
+out:
+        for (i = 0; i < num; i++)
+                os_free(res.res[i]);
+        os_free(res.res);
+}
+
+
+static struct wpa_bss * get_bss(struct wpa_supplicant *wpa_s, int id,
+                                const char *ssid)
+{
+        u8 bssid[ETH_ALEN] = { 0x02, 0, 0, 0, id >> 8, id & 0xff };
+
+        return wpa_bss_get(wpa_s, bssid, (const u8 *) ssid,
+                           os_strlen(ssid));
+}
+
+
+/* The table list must be in update order and match the hash and count */
+static void check_table(const char *name, struct wpa_supplicant *wpa_s,
+                        size_t num)
+{
+        struct wpa_bss *bss, *prev = NULL;
+        size_t count = 0;
+
+        for (bss = wpa_s->bss; bss; prev = bss, bss = bss->next) {
+                if (bss->prev != prev ||
+                    (prev && prev->last_update_idx > bss->last_update_idx) ||
+                    wpa_bss_get(wpa_s, bss->bssid, bss->ssid,
+                                bss->ssid_len) != bss) {
+                        printf("%s: inconsistent BSS table\n", name);
+                        errors++;
+                        return;
+                }
+                count++;
+        }
+        if (wpa_s->bss_tail != prev || count != num ||
+            wpa_s->num_bss != num) {
+                printf("%s: %u entries (num_bss %u), expected %u\n", name,
+                       (unsigned int) count, (unsigned int) wpa_s->num_bss,
+                       (unsigned int) num);
+                errors++;
+        }
+}
+
+
+static void age_bss(struct wpa_supplicant *wpa_s, int sec)
+{
+        struct wpa_bss *bss;
+
+        for (bss = wpa_s->bss; bss; bss = bss->next)
+                bss->last_seen.sec -= sec;
+}
+
+
+static void test_merge(struct wpa_supplicant *wpa_s)
+{
+        static const struct test_bss scan1[] = {
+                { 1, "a", 2412, -50 },
+                { 2, "b", 2437, -60 },
+                { 3, "c", 2462, -70 },
+                { 3, "hidden", 2462, -70 },
+        };
+        static const struct test_bss scan2[] = {
+                { 4, "d", 2412, -40 },
+                { 1, "a", 2412, -70 },
+                { 4, "d", 2412, -90 },
+        };
+        struct wpa_bss *a, *d;
+        unsigned int id;
+
+        test_scan(wpa_s, scan1, 4);
+        check_table("merge", wpa_s, 4);
+        a = get_bss(wpa_s, 1, "a");
+        if (a == NULL || a->level_avg != -50 || a->freq != 2412 ||
+            wpa_s->last_scan_res_used != 4 || wpa_s->last_scan_res[0] != a) {
+                printf("merge: first scan not stored\n");
+                errors++;
+                return;
+        }
+        id = a->id;
+
+        /* Existing entries are updated and moved to the tail; a duplicate
+         * within a scan is ignored */
+        test_scan(wpa_s, scan2, 3);
+        check_table("merge", wpa_s, 5);
+        d = get_bss(wpa_s, 4, "d");
+        if (get_bss(wpa_s, 1, "a") != a || a->id != id ||
+            wpa_s->last_scan_res_used != 2 || wpa_s->last_scan_res[0] != d ||
+            wpa_s->last_scan_res[1] != a || wpa_s->bss_tail != a ||
+            d == NULL || d->level_avg != -40) {
+                printf("merge: second scan not merged\n");
+                errors++;
+        }
+
+        /* Exponentially weighted average of -50 and -70 */
+        if (a->level_avg != -55) {
+                printf("merge: level_avg %d, expected -55\n", a->level_avg);
+                errors++;
+        }
+
+        if (wpa_bss_get_bssid(wpa_s, a->bssid) != a ||
+            get_bss(wpa_s, 3, "hidden") == NULL ||
+            get_bss(wpa_s, 3, "c") == NULL || get_bss(wpa_s, 2, "a")) {
+                printf("merge: wrong BSSID/SSID lookup result\n");
+                errors++;
+        }
+
+        wpa_bss_flush(wpa_s);
+        check_table("flush", wpa_s, 0);
+}
+
+
+static void test_expire(struct wpa_supplicant *wpa_s)
+{
+        static const struct test_bss scan1[] = {
+                { 1, "a", 2412, -50 },
+                { 2, "b", 2437, -50 },
+                { 3, "c", 5180, -50 },
+        };
+        static const struct test_bss scan2[] = {
+                { 1, "a", 2412, -50 },
+        };
+        struct wpa_bss *b;
+
+        /* Missed scans alone do not expire recent entries */
+        test_scan(wpa_s, scan1, 3);
+        test_scan(wpa_s, scan2, 1);
+        test_scan(wpa_s, scan2, 1);
+        b = get_bss(wpa_s, 2, "b");
+        if (b == NULL || b->scan_miss_count != 2) {
+                printf("expire: miss count %u, expected 2\n",
+                       b ? b->scan_miss_count : 0);
+                errors++;
+        }
+        check_table("expire recent", wpa_s, 3);
+
+        /* Old entries missed by enough full scans are removed */
+        age_bss(wpa_s, WPA_BSS_EXPIRATION_AGE + 1);
+        test_scan(wpa_s, scan2, 1);
+        check_table("expire full", wpa_s, 1);
+        if (get_bss(wpa_s, 1, "a") == NULL) {
+                printf("expire: entry in the scan removed\n");
+                errors++;
+        }
+
+        /* Partial scans only count misses on the scanned channels */
+        test_scan(wpa_s, scan1, 3);
+        age_bss(wpa_s, WPA_BSS_EXPIRATION_AGE + 1);
+        wpa_s->last_scan_freqs = os_zalloc(2 * sizeof(int));
+        if (wpa_s->last_scan_freqs == NULL) {
+                errors++;
+                return;
+        }
+        wpa_s->last_scan_freqs[0] = 2412;
+        test_scan(wpa_s, scan2, 1);
+        test_scan(wpa_s, scan2, 1);
+        test_scan(wpa_s, scan2, 1);
+        check_table("expire partial", wpa_s, 3);
+        b = get_bss(wpa_s, 2, "b");
+        if (b == NULL || b->scan_miss_count != 0) {
+                printf("expire: miss counted for a channel not scanned\n");
+                errors++;
+        }
+
+        wpa_s->last_scan_freqs[0] = 5180;
+        test_scan(wpa_s, scan2, 1);
+        check_table("expire partial", wpa_s, 3);
+        test_scan(wpa_s, scan2, 1);
+        check_table("expire partial", wpa_s, 2);
+        if (get_bss(wpa_s, 3, "c") || get_bss(wpa_s, 2, "b") == NULL) {
+                printf("expire: wrong entry removed by a partial scan\n");
+                errors++;
+        }
+
+        os_free(wpa_s->last_scan_freqs);
+        wpa_s->last_scan_freqs = NULL;
+        wpa_bss_flush(wpa_s);
+}
+
+
+static void test_make_room(struct wpa_supplicant *wpa_s)
+{
+        struct test_bss *scan;
+        struct wpa_bss *bss;
+        int i, num = WPA_BSS_MAX_COUNT + 50;
+
+        scan = os_zalloc(num * sizeof(*scan));
+        if (scan == NULL) {
+                errors++;
+                return;
+        }
+        for (i = 0; i < num; i++) {
+                scan[i].id = i;
+                scan[i].ssid = "room";
+                scan[i].freq = 2412;
+                scan[i].level = -50;
+        }
+
+        /* Entries in the current scan are never removed */
+        test_scan(wpa_s, scan, num);
+        check_table("make room", wpa_s, WPA_BSS_MAX_COUNT);
+        if (wpa_s->last_scan_res_used != WPA_BSS_MAX_COUNT ||
+            get_bss(wpa_s, WPA_BSS_MAX_COUNT - 1, "room") == NULL ||
+            get_bss(wpa_s, WPA_BSS_MAX_COUNT, "room")) {
+                printf("make room: entries of the current scan replaced\n");
+                errors++;
+        }
+
+        /* The least recently updated entries are replaced, except for the
+         * current BSS */
+        os_memcpy(wpa_s->bssid, get_bss(wpa_s, 0, "room")->bssid, ETH_ALEN);
+        test_scan(wpa_s, scan + WPA_BSS_MAX_COUNT, 10);
+        check_table("make room", wpa_s, WPA_BSS_MAX_COUNT);
+        if (get_bss(wpa_s, 0, "room") == NULL ||
+            get_bss(wpa_s, 1, "room") || get_bss(wpa_s, 10, "room") ||
+            get_bss(wpa_s, 11, "room") == NULL ||
+            get_bss(wpa_s, WPA_BSS_MAX_COUNT + 9, "room") == NULL) {
+                printf("make room: wrong entries replaced\n");
+                errors++;
+        }
+        bss = wpa_s->bss;
+        if (bss == NULL || os_memcmp(bss->bssid, wpa_s->bssid, ETH_ALEN)) {
+                printf("make room: current BSS not kept at the head\n");
+                errors++;
+        }
+
+        os_memset(wpa_s->bssid, 0, ETH_ALEN);
+        os_free(scan);
+        wpa_bss_flush(wpa_s);
+}
+
+
+static int count_freqs(const int *freqs)
+{
+        int num = 0;
+
+        while (freqs && freqs[num])
+                num++;
+        return num;
+}
+
+
+static void test_ess(struct wpa_supplicant *wpa_s)
+{
+        static const struct test_bss scan1[] = {
+                { 1, "ess", 2412, -50 },
+                { 2, "ess", 2437, -50 },
+                { 3, "other", 2462, -50 },
+        };
+        static const struct test_bss scan2[] = {
+                { 4, "ess", 5180, -50 },
+        };
+        struct test_bss chans[WPA_ESS_CHAN_MAX + 4];
+        struct wpa_ssid ssid;
+        struct wpa_ess_chans *ess;
+        char name[10];
+        int *freqs, i, count;
+
+        os_memset(&ssid, 0, sizeof(ssid));
+        ssid.ssid = (u8 *) "ess";
+        ssid.ssid_len = 3;
+
+        /* The history is seeded from the BSS table */
+        test_scan(wpa_s, scan1, 3);
+        freqs = wpa_bss_ess_freqs(wpa_s, ssid.ssid, ssid.ssid_len);
+        if (count_freqs(freqs) != 2 || freqs[0] != 2412 ||
+            freqs[1] != 2437) {
+                printf("ess: channels not seeded from the BSS table\n");
+                errors++;
+        }
+        os_free(freqs);
+
+        /* It is updated from all scans while connected and outlives the
+         * BSS table entries */
+        wpa_s->current_ssid = &ssid;
+        test_scan(wpa_s, scan2, 1);
+        wpa_bss_flush(wpa_s);
+        freqs = wpa_bss_ess_freqs(wpa_s, ssid.ssid, ssid.ssid_len);
+        if (count_freqs(freqs) != 3 || freqs[2] != 5180) {
+                printf("ess: channel from a later scan not added\n");
+                errors++;
+        }
+        os_free(freqs);
+
+        /* Old channels are not returned */
+        ess = wpa_s->ess_chans;
+        if (ess && ess->num_chan == 3)
+                ess->chan[0].last_seen.sec -= WPA_ESS_CHAN_AGE + 1;
+        freqs = wpa_bss_ess_freqs(wpa_s, ssid.ssid, ssid.ssid_len);
+        if (count_freqs(freqs) != 2 || freqs[0] != 2437) {
+                printf("ess: old channel returned\n");
+                errors++;
+        }
+        os_free(freqs);
+
+        /* The number of channels per ESS is bounded; the oldest one is
+         * replaced */
+        for (i = 0; i < WPA_ESS_CHAN_MAX + 4; i++) {
+                chans[i].id = 100 + i;
+                chans[i].ssid = "ess";
+                chans[i].freq = 5000 + 5 * i;
+                chans[i].level = -50;
+                test_scan(wpa_s, &chans[i], 1);
+        }
+        freqs = wpa_bss_ess_freqs(wpa_s, ssid.ssid, ssid.ssid_len);
+        if (count_freqs(freqs) != WPA_ESS_CHAN_MAX) {
+                printf("ess: %d channels, expected %d\n", count_freqs(freqs),
+                       WPA_ESS_CHAN_MAX);
+                errors++;
+        }
+        os_free(freqs);
+        wpa_s->current_ssid = NULL;
+
+        /* The number of ESSes in the history is bounded and the most
+         * recently used one is first */
+        for (i = 0; i < WPA_ESS_HIST_MAX + 2; i++) {
+                os_snprintf(name, sizeof(name), "ess-%d", i);
+                os_free(wpa_bss_ess_freqs(wpa_s, (u8 *) name,
+                                          os_strlen(name)));
+        }
+        count = 0;
+        for (ess = wpa_s->ess_chans; ess; ess = ess->next)
+                count++;
+        ess = wpa_s->ess_chans;
+        if (count != WPA_ESS_HIST_MAX || ess == NULL ||
+            ess->ssid_len != os_strlen(name) ||
+            os_memcmp(ess->ssid, name, ess->ssid_len) != 0) {
+                printf("ess: %d ESSes in the history, expected %d\n", count,
+                       WPA_ESS_HIST_MAX);
+                errors++;
+        }
+
+        wpa_bss_flush(wpa_s);
+}
+
+
+int main(int argc, char *argv[])
+{
+        struct wpa_supplicant *wpa_s;
+
+        wpa_s = os_zalloc(sizeof(*wpa_s));
+        if (wpa_s == NULL)
+                return -1;
+
+        test_merge(wpa_s);
+        test_expire(wpa_s);
+        test_make_room(wpa_s);
+        test_ess(wpa_s);
+
+        wpa_bss_deinit(wpa_s);
+        os_free(wpa_s);
+
+        if (errors) {
+                printf("BSS table test - FAILED (%d errors)\n", errors);
+                return -1;
+        }
+        printf("BSS table test - OK\n");
+        return 0;
+}
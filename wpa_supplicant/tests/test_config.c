@@ -0,0 +1,473 @@
+/*
+ * Test program and benchmark for network configuration
+ * Copyright (c) 2026, agent <agent@local>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * Alternatively, this software may be distributed under the terms of BSD
+ * license.
+ *
+ * See README and COPYING for more details.
+ */
+
+#include "includes.h"
+#include <sys/stat.h>
+
+#include "common.h"
+#include "eap_peer/eap_methods.h"
+#include "../config.h"
+
+#define BENCH_NETWORKS 10000
+#define NUM_PRIO 8
+#define PARSE_NETWORKS 5000
+#define PARSE_FILE "test_config.conf"
+#define PSK_FILE "test_config_psk.conf"
+
+
+static int errors;
+
+
+#ifdef IEEE8021X_EAPOL
+/* EAP methods are not registered; only the network lists are tested */
+EapType eap_peer_get_type(const char *name, int *vendor)
+{
+        *vendor = EAP_VENDOR_IETF;
+        return EAP_TYPE_NONE;
+}
+
+
+const char * eap_get_name(int vendor, EapType type)
+{
+        return NULL;
+}
+#endif /* IEEE8021X_EAPOL */
+
+
+static unsigned int test_rand(void)
+{
+        static unsigned int state = 0x12345678;
+        state = state * 1103515245 + 12345;
+        return state >> 8;
+}
+
+
+static double time_diff(struct os_reltime *start, struct os_reltime *end)
+{
+        struct os_reltime diff;
+        os_reltime_sub(end, start, &diff);
+        return diff.sec + diff.usec / 1000000.0;
+}
+
+
+/* Verify the priority lists and SSID indexes against the global list */
+static void check_lists(struct wpa_config *config)
+{
+        struct wpa_ssid *ssid, *pos, *last;
+        int prio, count = 0, total = 0, found;
+
+        wpa_config_check_prio_index(config);
+
+        last = NULL;
+        for (ssid = config->ssid; ssid; ssid = ssid->next) {
+                if (config->id_hash && ssid->prev != last) {
+                        printf("Bad prev link for network %d\n", ssid->id);
+                        errors++;
+                }
+                last = ssid;
+                total++;
+        }
+
+        for (prio = 0; prio < config->num_prio; prio++) {
+                struct wpa_prio_index *pidx = &config->prio_index[prio];
+                if (prio > 0 &&
+                    config->prio_index[prio - 1].priority <= pidx->priority) {
+                        printf("Priority groups out of order\n");
+                        errors++;
+                }
+                last = NULL;
+                for (ssid = config->pssid[prio]; ssid; ssid = ssid->pnext) {
+                        if (ssid->priority != pidx->priority) {
+                                printf("Network %d in wrong group\n",
+                                       ssid->id);
+                                errors++;
+                        }
+                        if (ssid->pprev != last) {
+                                printf("Bad pprev link for network %d\n",
+                                       ssid->id);
+                                errors++;
+                        }
+                        if (last && last->prio_pos >= ssid->prio_pos) {
+                                printf("Network %d out of order\n", ssid->id);
+                                errors++;
+                        }
+                        if (ssid->ssid_len)
+                                pos = wpa_config_prio_ssid_list(
+                                        config, prio, ssid->ssid,
+                                        ssid->ssid_len);
+                        else
+                                pos = pidx->wildcard;
+                        found = 0;
+                        for (; pos; pos = pos->hnext) {
+                                if (pos == ssid)
+                                        found = 1;
+                                if (pos->hnext && pos->hnext->hprev != pos) {
+                                        printf("Bad hprev link for network "
+                                               "%d\n", pos->hnext->id);
+                                        errors++;
+                                }
+                        }
+                        if (!found) {
+                                printf("Network %d not indexed\n", ssid->id);
+                                errors++;
+                        }
+                        last = ssid;
+                        count++;
+                }
+                if (pidx->tail != last) {
+                        printf("Bad tail for priority group %d\n",
+                               pidx->priority);
+                        errors++;
+                }
+        }
+
+        if (count != total) {
+                printf("%d of %d networks in priority lists\n", count, total);
+                errors++;
+        }
+}
+
+
+static int bench_parse(void)
+{
+        struct wpa_config *config;
+        struct wpa_ssid *ssid;
+        struct os_reltime t0, t1;
+        FILE *f;
+        char *val;
+        int i, count = 0;
+
+        f = fopen(PARSE_FILE, "w");
+        if (f == NULL)
+                return -1;
+        fprintf(f, "ap_scan=2\nfast_reauth=0\nscan_interval=7\n"
+                "roam_scan_interval=30\n\n");
+        for (i = 0; i < PARSE_NETWORKS; i++) {
+                fprintf(f, "network={\n"
+                        "\tssid=\"net-%d\"\n"
+                        "\tscan_ssid=1\n"
+                        "\tkey_mgmt=WPA-PSK WPA-EAP\n"
+                        "\tproto=RSN\n"
+                        "\tpairwise=CCMP\n"
+                        "\tpsk=%064x\n"
+                        "\tidentity=\"user-%d\"\n"
+                        "\tpassword=\"secret\"\n"
+                        "\tca_cert=\"/etc/cert/ca.pem\"\n"
+                        "\tphase2=\"auth=MSCHAPV2\"\n"
+                        "\tpriority=%d\n"
+                        "\tid_str=\"id-%d\"\n"
+                        "}\n", i, i, i, i % NUM_PRIO, i);
+        }
+        fclose(f);
+
+        os_get_reltime(&t0);
+        config = wpa_config_read(PARSE_FILE);
+        os_get_reltime(&t1);
+        unlink(PARSE_FILE);
+        if (config == NULL) {
+                printf("Failed to parse the configuration file\n");
+                return -1;
+        }
+
+        for (ssid = config->ssid; ssid; ssid = ssid->next)
+                count++;
+        if (count != PARSE_NETWORKS || config->ap_scan != 2 ||
+            config->fast_reauth || config->scan_interval != 7 ||
+            config->roam_scan_interval != 30) {
+                printf("Configuration file not parsed correctly\n");
+                errors++;
+        }
+
+        ssid = wpa_config_get_network(config, 1234);
+        val = ssid ? wpa_config_get(ssid, "id_str") : NULL;
+        if (val == NULL || os_strcmp(val, "\"id-1234\"") != 0) {
+                printf("Unexpected id_str for network 1234\n");
+                errors++;
+        }
+        os_free(val);
+        val = ssid ? wpa_config_get_no_key(ssid, "password") : NULL;
+        if (val == NULL || os_strcmp(val, "*") != 0) {
+                printf("Key field exposed\n");
+                errors++;
+        }
+        os_free(val);
+        if (ssid == NULL || ssid->priority != 1234 % NUM_PRIO ||
+            wpa_config_set(ssid, "no_such_field", "1", 0) == 0 ||
+            wpa_config_set(ssid, "prio", "1", 0) == 0 ||
+            wpa_config_get(ssid, "priorityx") != NULL) {
+                printf("Field lookup failed\n");
+                errors++;
+        }
+
+        printf("config: parse %d networks: %.3f s\n", PARSE_NETWORKS,
+               time_diff(&t0, &t1));
+        wpa_config_free(config);
+        return 0;
+}
+
+
+/* Change the first PSK octet of the last entry in the PSK cache */
+static int psk_cache_tamper(void)
+{
+        char buf[1024], *pos;
+        size_t len;
+        FILE *f;
+
+        f = fopen(PSK_FILE ".psk", "r");
+        if (f == NULL)
+                return -1;
+        len = fread(buf, 1, sizeof(buf) - 1, f);
+        fclose(f);
+        buf[len] = '\0';
+        if (len < 2)
+                return -1;
+        buf[len - 1] = '\0';
+        pos = os_strrchr(buf, '\n');
+        /* <40 hex digits of id> <64 hex digits of PSK> <40 hex digits> */
+        if (pos == NULL || os_strlen(pos + 1) != 146)
+                return -1;
+        pos[42] = pos[42] == '0' ? '1' : '0';
+        buf[len - 1] = '\n';
+
+        f = fopen(PSK_FILE ".psk", "w");
+        if (f == NULL)
+                return -1;
+        fwrite(buf, 1, len, f);
+        fclose(f);
+        return 0;
+}
+
+
+static void test_psk_cache(void)
+{
+        struct wpa_config *config;
+        struct stat st;
+        u8 psk[32];
+        FILE *f;
+
+        f = fopen(PSK_FILE, "w");
+        if (f == NULL)
+                return;
+        fprintf(f, "psk_cache=1\nnetwork={\n\tssid=\"psk-test\"\n"
+                "\tpsk=\"passphrase\"\n}\n");
+        fclose(f);
+
+        /* A symlink left at the temporary path must not be followed */
+        unlink(PSK_FILE ".psk");
+        unlink(PSK_FILE ".target");
+        unlink(PSK_FILE ".psk.tmp");
+        if (symlink(PSK_FILE ".target", PSK_FILE ".psk.tmp") < 0) {
+                perror("symlink");
+                errors++;
+        }
+
+        config = wpa_config_read(PSK_FILE);
+        if (config == NULL || config->ssid == NULL ||
+            !config->ssid->psk_set) {
+                printf("PSK not derived\n");
+                errors++;
+        } else {
+                /* SET_NETWORK psk with lazy_psk=1 must not run PBKDF2 */
+                config->lazy_psk = 1;
+                wpa_config_psk_changed(config, config->ssid);
+                if (config->ssid->psk_set || !config->ssid->psk_pending) {
+                        printf("PSK change not deferred with lazy_psk\n");
+                        errors++;
+                }
+        }
+        if (config)
+                wpa_config_free(config);
+
+        if (lstat(PSK_FILE ".target", &st) == 0) {
+                printf("PSK cache written through a symlink\n");
+                errors++;
+        }
+        if (lstat(PSK_FILE ".psk.tmp", &st) == 0) {
+                printf("PSK cache temporary file left behind\n");
+                errors++;
+        }
+        if (stat(PSK_FILE ".psk", &st) < 0 || !S_ISREG(st.st_mode) ||
+            (st.st_mode & 0777) != 0600) {
+                printf("PSK cache file missing or not private\n");
+                errors++;
+        }
+
+        config = wpa_config_read(PSK_FILE);
+        if (config == NULL || config->ssid == NULL ||
+            config->psk_cache_hits != 1) {
+                printf("PSK not found in the cache\n");
+                errors++;
+        } else
+                os_memcpy(psk, config->ssid->psk, sizeof(psk));
+        if (config)
+                wpa_config_free(config);
+
+        /* A modified entry is not trusted; the PSK is derived again */
+        if (psk_cache_tamper() < 0) {
+                printf("Failed to modify the PSK cache\n");
+                errors++;
+        }
+        config = wpa_config_read(PSK_FILE);
+        if (config == NULL || config->ssid == NULL ||
+            config->psk_cache_hits != 0 || config->psk_cache_misses != 1 ||
+            !config->ssid->psk_set ||
+            os_memcmp(config->ssid->psk, psk, sizeof(psk)) != 0) {
+                printf("Modified PSK cache entry was used\n");
+                errors++;
+        }
+        if (config)
+                wpa_config_free(config);
+
+        /* ... and the cache is rewritten with the correct PSK */
+        config = wpa_config_read(PSK_FILE);
+        if (config == NULL || config->ssid == NULL ||
+            config->psk_cache_hits != 1 ||
+            os_memcmp(config->ssid->psk, psk, sizeof(psk)) != 0) {
+                printf("PSK cache not repaired\n");
+                errors++;
+        }
+        if (config)
+                wpa_config_free(config);
+
+        unlink(PSK_FILE);
+        unlink(PSK_FILE ".psk");
+        unlink(PSK_FILE ".target");
+        unlink(PSK_FILE ".psk.tmp");
+        printf("config: PSK cache test done\n");
+}
+
+
+int main(int argc, char *argv[])
+{
+        struct wpa_config *config;
+        struct wpa_ssid *ssid;
+        struct os_reltime t0, t1, t2, t3;
+        char buf[40];
+        int i, id, removed = 0;
+
+        config = wpa_config_alloc_empty(NULL, NULL);
+        if (config == NULL)
+                return -1;
+
+        /* Provisioning: ADD_NETWORK and SET_NETWORK for each network */
+        os_get_reltime(&t0);
+        for (i = 0; i < BENCH_NETWORKS; i++) {
+                ssid = wpa_config_add_network(config);
+                if (ssid == NULL || ssid->id != i) {
+                        printf("Failed to add network %d\n", i);
+                        return -1;
+                }
+                ssid = wpa_config_get_network(config, i);
+                os_snprintf(buf, sizeof(buf), "\"net-%d\"", i);
+                if (ssid == NULL || wpa_config_set(ssid, "ssid", buf, 0) < 0) {
+                        printf("Failed to configure network %d\n", i);
+                        return -1;
+                }
+                wpa_config_prio_changed(config, "ssid");
+                ssid = wpa_config_get_network(config, i);
+                os_snprintf(buf, sizeof(buf), "%d", i % NUM_PRIO);
+                if (ssid == NULL ||
+                    wpa_config_set(ssid, "priority", buf, 0) < 0) {
+                        printf("Failed to configure network %d\n", i);
+                        return -1;
+                }
+                wpa_config_prio_changed(config, "priority");
+        }
+        os_get_reltime(&t1);
+        check_lists(config);
+
+        /* Lookups: GET_NETWORK, ENABLE_NETWORK, SELECT_NETWORK */
+        for (i = 0; i < BENCH_NETWORKS * 10; i++) {
+                id = test_rand() % BENCH_NETWORKS;
+                ssid = wpa_config_get_network(config, id);
+                if (ssid == NULL || ssid->id != id) {
+                        printf("Lookup for network %d failed\n", id);
+                        errors++;
+                }
+        }
+        if (wpa_config_get_network(config, BENCH_NETWORKS) ||
+            wpa_config_get_network(config, -1)) {
+                printf("Lookup for an unknown network succeeded\n");
+                errors++;
+        }
+        os_get_reltime(&t2);
+
+        /* REMOVE_NETWORK for a random half of the networks */
+        for (i = 0; i < BENCH_NETWORKS; i++) {
+                id = test_rand() % BENCH_NETWORKS;
+                if (wpa_config_remove_network(config, id) == 0)
+                        removed++;
+                else if (wpa_config_get_network(config, id)) {
+                        printf("Failed to remove network %d\n", id);
+                        errors++;
+                }
+        }
+        os_get_reltime(&t3);
+        check_lists(config);
+
+        /* Ids continue from the largest remaining one */
+        id = -1;
+        for (ssid = config->ssid; ssid; ssid = ssid->next) {
+                if (ssid->id > id)
+                        id = ssid->id;
+        }
+        ssid = wpa_config_add_network(config);
+        if (ssid == NULL || ssid->id != id + 1) {
+                printf("Unexpected id for a new network\n");
+                errors++;
+        }
+        check_lists(config);
+
+        /* The lists are only rebuilt after an SSID or priority change */
+        ssid->priority = NUM_PRIO;
+        if (wpa_config_check_prio_index(config) != 0) {
+                printf("Priority lists rebuilt without a change\n");
+                errors++;
+        }
+        wpa_config_prio_changed(config, "psk");
+        if (wpa_config_check_prio_index(config) != 0) {
+                printf("Priority lists rebuilt after a PSK change\n");
+                errors++;
+        }
+        wpa_config_prio_changed(config, "priority");
+        if (wpa_config_check_prio_index(config) != 1 ||
+            config->prio_index[0].priority != NUM_PRIO ||
+            config->pssid[0] != ssid ||
+            wpa_config_check_prio_index(config) != 0) {
+                printf("Priority lists not rebuilt after a priority "
+                       "change\n");
+                errors++;
+        }
+        check_lists(config);
+
+        printf("config: add %d networks: %.3f s\n", BENCH_NETWORKS,
+               time_diff(&t0, &t1));
+        printf("config: %d network lookups: %.3f s\n", BENCH_NETWORKS * 10,
+               time_diff(&t1, &t2));
+        printf("config: remove %d networks: %.3f s\n", removed,
+               time_diff(&t2, &t3));
+
+        wpa_config_free(config);
+
+        if (bench_parse() < 0)
+                return -1;
+        test_psk_cache();
+
+        if (errors) {
+                printf("config test - FAILED (%d errors)\n", errors);
+                return -1;
+        }
+        printf("config test - OK\n");
+        return 0;
+}
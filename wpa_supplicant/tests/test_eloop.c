@@ -0,0 +1,367 @@
+/*
+ * Test program and microbenchmark for eloop timeouts
+ * Copyright (c) 2026, agent <agent@local>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * Alternatively, this software may be distributed under the terms of BSD
+ * license.
+ *
+ * See README and COPYING for more details.
+ */
+
+#include "includes.h"
+#include <fcntl.h>
+#include <sys/wait.h>
+
+#include "common.h"
+#include "eloop.h"
+
+#define NUM_TIMEOUTS 100000
+#define MAX_DELAY_USEC 200000
+#define NUM_WILDCARD 1000
+#define NUM_SOCKS 64
+#define NUM_HANDLES 1000
+
+
+struct test_timeout {
+        /* expiry is bracketed by clock reads around registration */
+        struct os_reltime expire_min, expire_max;
+        int cancelled;
+        int fired;
+};
+
+static struct test_timeout *timeouts;
+static struct os_reltime last_expire;
+static int fired, errors;
+
+
+static unsigned int test_rand(void)
+{
+        static unsigned int state = 0x12345678;
+        state = state * 1103515245 + 12345;
+        return state >> 8;
+}
+
+
+static void test_timeout_cb(void *eloop_ctx, void *timeout_ctx)
+{
+        struct test_timeout *t = timeout_ctx;
+        struct os_reltime now;
+
+        if (t->cancelled || t->fired) {
+                printf("Unexpected timeout %d (cancelled=%d fired=%d)\n",
+                       (int) (t - timeouts), t->cancelled, t->fired);
+                errors++;
+        }
+        os_get_reltime(&now);
+        if (os_reltime_before(&now, &t->expire_min)) {
+                printf("Timeout %d fired early\n", (int) (t - timeouts));
+                errors++;
+        }
+        if (os_reltime_before(&t->expire_max, &last_expire)) {
+                printf("Timeout %d fired out of order\n",
+                       (int) (t - timeouts));
+                errors++;
+        }
+        last_expire = t->expire_min;
+        t->fired = 1;
+        fired++;
+}
+
+
+static int socks[NUM_SOCKS][2];
+static int sock_reads;
+
+
+static void test_sock_cb(int sock, void *eloop_ctx, void *sock_ctx)
+{
+        int i = (int) (long) sock_ctx;
+        char buf[1];
+
+        if (i & 1) {
+                printf("Socket %d dispatched without data\n", i);
+                errors++;
+        }
+        if (recv(sock, buf, sizeof(buf), 0) != 1) {
+                printf("Socket %d not readable\n", i);
+                errors++;
+        }
+        eloop_unregister_read_sock(sock);
+        sock_reads++;
+}
+
+
+static void test_sock_done(void *eloop_ctx, void *timeout_ctx)
+{
+        int i;
+
+        for (i = 1; i < NUM_SOCKS; i += 2)
+                eloop_unregister_read_sock(socks[i][0]);
+}
+
+
+static int test_socks(void)
+{
+        int i;
+
+        for (i = 0; i < NUM_SOCKS; i++) {
+                if (socketpair(AF_UNIX, SOCK_DGRAM, 0, socks[i]) < 0) {
+                        perror("socketpair");
+                        return -1;
+                }
+                eloop_register_read_sock(socks[i][0], test_sock_cb, NULL,
+                                         (void *) (long) i);
+                if ((i & 1) == 0 && send(socks[i][1], "x", 1, 0) != 1)
+                        return -1;
+        }
+        eloop_register_timeout(0, 100000, test_sock_done, NULL, NULL);
+        eloop_run();
+
+        for (i = 0; i < NUM_SOCKS; i++) {
+                close(socks[i][0]);
+                close(socks[i][1]);
+        }
+
+        if (sock_reads != NUM_SOCKS / 2) {
+                printf("%d of %d sockets dispatched\n", sock_reads,
+                       NUM_SOCKS / 2);
+                errors++;
+        }
+        printf("eloop: socket dispatch test done\n");
+        return 0;
+}
+
+
+struct test_handle {
+        struct eloop_timeout *handle;
+        int fired;
+};
+
+static struct test_handle handles[NUM_HANDLES];
+static int handles_fired;
+
+
+static void test_handle_cb(void *eloop_ctx, void *timeout_ctx)
+{
+        struct test_handle *h = timeout_ctx;
+
+        if (h->handle != NULL) {
+                printf("Handle %d not cleared before the call\n",
+                       (int) (h - handles));
+                errors++;
+        }
+        if ((h - handles) % 2 == 0 && h != &handles[0]) {
+                printf("Cancelled handle %d fired\n", (int) (h - handles));
+                errors++;
+        }
+        h->fired++;
+        handles_fired++;
+}
+
+
+static void test_handles(void)
+{
+        int i;
+
+        for (i = 0; i < NUM_HANDLES; i++) {
+                if (eloop_register_timeout_handle(0, test_rand() % 50000,
+                                                  test_handle_cb, NULL,
+                                                  &handles[i],
+                                                  &handles[i].handle) ||
+                    handles[i].handle == NULL) {
+                        printf("Failed to register handle %d\n", i);
+                        errors++;
+                }
+        }
+
+        for (i = 0; i < NUM_HANDLES; i += 2) {
+                if (eloop_cancel_timeout_handle(&handles[i].handle) != 1 ||
+                    handles[i].handle != NULL ||
+                    eloop_cancel_timeout_handle(&handles[i].handle) != 0) {
+                        printf("Failed to cancel handle %d\n", i);
+                        errors++;
+                }
+        }
+
+        /* Re-arming replaces the previous timeout */
+        eloop_register_timeout_handle(0, 10000, test_handle_cb, NULL,
+                                      &handles[0], &handles[0].handle);
+        eloop_register_timeout_handle(0, 20000, test_handle_cb, NULL,
+                                      &handles[0], &handles[0].handle);
+
+        eloop_run();
+
+        for (i = 0; i < NUM_HANDLES; i++) {
+                if (handles[i].handle != NULL ||
+                    handles[i].fired != (i % 2 || i == 0)) {
+                        printf("Handle %d: fired %d times\n", i,
+                               handles[i].fired);
+                        errors++;
+                }
+        }
+        printf("eloop: handle test done (%d fired)\n", handles_fired);
+}
+
+
+static void test_fork_cb(void *eloop_ctx, void *timeout_ctx)
+{
+        _exit(2);
+}
+
+
+static void test_fork(void)
+{
+        int sv[2], status;
+        pid_t pid;
+
+        if (socketpair(AF_UNIX, SOCK_DGRAM, 0, sv) < 0) {
+                perror("socketpair");
+                errors++;
+                return;
+        }
+        eloop_register_read_sock(sv[0], test_sock_cb, NULL, NULL);
+        eloop_register_read_sock(sv[1], test_sock_cb, NULL, NULL);
+        eloop_register_timeout(0, 0, test_fork_cb, NULL, NULL);
+
+        pid = fork();
+        if (pid == 0) {
+                /* The child must not see the parent's sockets or timeouts */
+                if (eloop_fork_cleanup(sv[1]) < 0 ||
+                    fcntl(sv[0], F_GETFD) != -1 || fcntl(sv[1], F_GETFD) < 0)
+                        _exit(1);
+                eloop_init(NULL);
+                eloop_run();
+                eloop_destroy();
+                _exit(0);
+        }
+
+        eloop_cancel_timeout(test_fork_cb, NULL, NULL);
+        eloop_unregister_read_sock(sv[0]);
+        eloop_unregister_read_sock(sv[1]);
+        close(sv[0]);
+        close(sv[1]);
+        if (pid < 0 || waitpid(pid, &status, 0) != pid ||
+            !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+                printf("Event loop not released in the child process\n");
+                errors++;
+        }
+        printf("eloop: fork test done\n");
+}
+
+
+static void time_add_usec(struct os_reltime *t, unsigned int usec)
+{
+        t->usec += usec;
+        while (t->usec >= 1000000) {
+                t->sec++;
+                t->usec -= 1000000;
+        }
+}
+
+
+static double time_diff(struct os_reltime *start, struct os_reltime *end)
+{
+        struct os_reltime diff;
+        os_reltime_sub(end, start, &diff);
+        return diff.sec + diff.usec / 1000000.0;
+}
+
+
+int main(int argc, char *argv[])
+{
+        struct os_reltime t0, t1, t2, t3;
+        struct eloop_stats stats;
+        int i, cancelled = 0;
+
+        if (eloop_init(NULL)) {
+                printf("Failed to initialize event loop\n");
+                return -1;
+        }
+
+        if (test_socks() < 0)
+                return -1;
+        test_handles();
+        test_fork();
+
+        timeouts = os_zalloc(NUM_TIMEOUTS * sizeof(struct test_timeout));
+        if (timeouts == NULL)
+                return -1;
+
+        os_get_reltime(&t0);
+        for (i = 0; i < NUM_TIMEOUTS; i++) {
+                unsigned int usec = test_rand() % MAX_DELAY_USEC;
+                struct test_timeout *t = &timeouts[i];
+                int ret;
+                os_get_reltime(&t->expire_min);
+                ret = eloop_register_timeout(0, usec, test_timeout_cb, NULL,
+                                             t);
+                os_get_reltime(&t->expire_max);
+                time_add_usec(&t->expire_min, usec);
+                time_add_usec(&t->expire_max, usec);
+                if (ret) {
+                        printf("Failed to register timeout %d\n", i);
+                        return -1;
+                }
+        }
+        os_get_reltime(&t1);
+
+        for (i = 0; i < NUM_TIMEOUTS; i += 2) {
+                if (!eloop_is_timeout_registered(test_timeout_cb, NULL,
+                                                 &timeouts[i])) {
+                        printf("Timeout %d not registered\n", i);
+                        errors++;
+                }
+                if (eloop_cancel_timeout(test_timeout_cb, NULL,
+                                         &timeouts[i]) != 1) {
+                        printf("Failed to cancel timeout %d\n", i);
+                        errors++;
+                }
+                timeouts[i].cancelled = 1;
+                cancelled++;
+        }
+        os_get_reltime(&t2);
+
+        /* Wildcard cancellation cannot use the hash index */
+        for (i = 0; i < NUM_WILDCARD; i++)
+                eloop_register_timeout(1, i, test_timeout_cb, timeouts,
+                                       &timeouts[i]);
+        if (eloop_cancel_timeout(test_timeout_cb, timeouts, ELOOP_ALL_CTX) !=
+            NUM_WILDCARD) {
+                printf("Wildcard cancel failed\n");
+                errors++;
+        }
+
+        eloop_run();
+        os_get_reltime(&t3);
+
+        if (fired + cancelled != NUM_TIMEOUTS) {
+                printf("Only %d of %d timeouts fired\n", fired,
+                       NUM_TIMEOUTS - cancelled);
+                errors++;
+        }
+
+        printf("eloop: register %d timeouts: %.3f s\n", NUM_TIMEOUTS,
+               time_diff(&t0, &t1));
+        printf("eloop: cancel %d timeouts: %.3f s\n", cancelled,
+               time_diff(&t1, &t2));
+        printf("eloop: fire %d timeouts: %.3f s\n", fired,
+               time_diff(&t2, &t3));
+
+        eloop_get_stats(&stats);
+        printf("eloop: %u wakeups, %u timeouts fired in %u batches "
+               "(max %u per wakeup)\n", stats.wakeups, stats.timeouts_fired,
+               stats.timeout_batches, stats.max_batch);
+
+        eloop_destroy();
+        os_free(timeouts);
+
+        if (errors) {
+                printf("eloop timeout test - FAILED (%d errors)\n", errors);
+                return -1;
+        }
+        printf("eloop timeout test - OK\n");
+        return 0;
+}
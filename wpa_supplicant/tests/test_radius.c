@@ -0,0 +1,272 @@
+/*
+ * Test program and microbenchmark for RADIUS message parsing
+ * Copyright (c) 2026, agent <agent@local>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * Alternatively, this software may be distributed under the terms of BSD
+ * license.
+ *
+ * See README and COPYING for more details.
+ */
+
+#include "includes.h"
+
+#include "common.h"
+#include "radius/radius.h"
+
+#define NUM_PARSE 200000
+#define NUM_PADDING 20
+
+static const u8 secret[] = "secret";
+static int errors;
+
+
+static struct radius_msg * build_request(void)
+{
+        struct radius_msg *msg;
+        u8 eap[600], state[4] = { 0x12, 0x34, 0x56, 0x78 };
+        char buf[20];
+        int i;
+
+        msg = radius_msg_new(RADIUS_CODE_ACCESS_REQUEST, 17);
+        if (msg == NULL)
+                return NULL;
+        radius_msg_make_authenticator(msg, (u8 *) "test", 4);
+
+        /* Attributes that are not looked up by the server */
+        for (i = 0; i < NUM_PADDING; i++) {
+                os_snprintf(buf, sizeof(buf), "padding %d", i);
+                radius_msg_add_attr(msg, RADIUS_ATTR_PROXY_STATE, (u8 *) buf,
+                                    os_strlen(buf));
+        }
+        radius_msg_add_attr(msg, RADIUS_ATTR_USER_NAME, (u8 *) "user", 4);
+        radius_msg_add_attr(msg, RADIUS_ATTR_CALLING_STATION_ID,
+                            (u8 *) "02-00-00-00-00-01", 17);
+        radius_msg_add_attr_int32(msg, RADIUS_ATTR_FRAMED_MTU, 1400);
+        radius_msg_add_attr(msg, RADIUS_ATTR_STATE, state, sizeof(state));
+
+        /* EAP-Message is split into three attributes */
+        for (i = 0; i < (int) sizeof(eap); i++)
+                eap[i] = i;
+        WPA_PUT_BE16(eap + 2, sizeof(eap));
+        radius_msg_add_eap(msg, eap, sizeof(eap));
+
+        if (radius_msg_finish(msg, secret, sizeof(secret) - 1) < 0) {
+                radius_msg_free(msg);
+                os_free(msg);
+                return NULL;
+        }
+
+        return msg;
+}
+
+
+static void check_msg(const char *name, struct radius_msg *msg)
+{
+        u8 buf[32], *ptr, *eap;
+        const u8 *start = NULL;
+        size_t len, eap_len;
+        int count = 0;
+
+        if (radius_msg_get_attr(msg, RADIUS_ATTR_USER_NAME, buf,
+                                sizeof(buf)) != 4 ||
+            os_memcmp(buf, "user", 4) != 0) {
+                printf("%s: User-Name not found\n", name);
+                errors++;
+        }
+        if (radius_msg_get_attr(msg, RADIUS_ATTR_STATE, buf, sizeof(buf)) !=
+            4 || WPA_GET_BE32(buf) != 0x12345678) {
+                printf("%s: State not found\n", name);
+                errors++;
+        }
+        if (radius_msg_get_attr(msg, RADIUS_ATTR_CLASS, buf, sizeof(buf)) !=
+            -1) {
+                printf("%s: Unexpected Class attribute\n", name);
+                errors++;
+        }
+
+        while (radius_msg_get_attr_ptr(msg, RADIUS_ATTR_PROXY_STATE, &ptr,
+                                       &len, start) == 0) {
+                start = ptr;
+                count++;
+        }
+        if (count != NUM_PADDING ||
+            radius_msg_count_attr(msg, RADIUS_ATTR_PROXY_STATE, 0) !=
+            NUM_PADDING ||
+            radius_msg_count_attr(msg, RADIUS_ATTR_PROXY_STATE, 10) !=
+            NUM_PADDING - 10) {
+                printf("%s: Proxy-State attributes not found (%d)\n", name,
+                       count);
+                errors++;
+        }
+
+        eap = radius_msg_get_eap(msg, &eap_len);
+        if (eap == NULL || eap_len != 600 || eap[599] != (u8) 599) {
+                printf("%s: EAP-Message not reassembled\n", name);
+                errors++;
+        }
+        os_free(eap);
+
+        if (radius_msg_verify_msg_auth(msg, secret, sizeof(secret) - 1,
+                                       NULL)) {
+                printf("%s: Message-Authenticator not verified\n", name);
+                errors++;
+        }
+}
+
+
+static void test_parse(struct radius_msg *req)
+{
+        struct radius_msg *msg, *reply;
+        u8 *buf, mauth[16];
+
+        buf = os_malloc(req->buf_used);
+        if (buf == NULL)
+                return;
+        os_memcpy(buf, req->buf, req->buf_used);
+
+        msg = radius_msg_parse(buf, req->buf_used);
+        if (msg == NULL) {
+                printf("Failed to parse message\n");
+                errors++;
+        } else {
+                check_msg("copy", msg);
+                radius_msg_free(msg);
+                os_free(msg);
+        }
+
+        msg = radius_msg_parse_borrow(buf, req->buf_used);
+        if (msg == NULL || msg->buf != buf) {
+                printf("Failed to parse message without copying\n");
+                errors++;
+                os_free(buf);
+                return;
+        }
+        check_msg("borrow", msg);
+
+        /* Attributes copied from a borrowed message */
+        reply = radius_msg_new(RADIUS_CODE_ACCESS_ACCEPT, 17);
+        if (reply == NULL ||
+            radius_msg_copy_attr(reply, msg, RADIUS_ATTR_PROXY_STATE) !=
+            NUM_PADDING) {
+                printf("Failed to copy Proxy-State attributes\n");
+                errors++;
+        }
+        if (reply) {
+                radius_msg_free(reply);
+                os_free(reply);
+        }
+
+        /* A second Message-Authenticator must be rejected */
+        os_memset(mauth, 0, sizeof(mauth));
+        radius_msg_add_attr(msg, RADIUS_ATTR_MESSAGE_AUTHENTICATOR, mauth,
+                            sizeof(mauth));
+        if (msg->buf == buf || msg->buf_borrowed) {
+                printf("Borrowed buffer was not copied when extended\n");
+                errors++;
+        }
+        if (os_memcmp(buf, req->buf, req->buf_used) != 0) {
+                printf("Borrowed buffer was modified\n");
+                errors++;
+        }
+        if (!radius_msg_verify_msg_auth(msg, secret, sizeof(secret) - 1,
+                                        NULL)) {
+                printf("Duplicate Message-Authenticator accepted\n");
+                errors++;
+        }
+        radius_msg_free(msg);
+        os_free(msg);
+
+        msg = radius_msg_parse_borrow(buf, req->buf_used);
+        if (msg == NULL || radius_msg_own_buf(msg) < 0 || msg->buf == buf) {
+                printf("Failed to copy borrowed buffer\n");
+                errors++;
+        } else {
+                os_memset(buf, 0, req->buf_used);
+                check_msg("own", msg);
+        }
+        if (msg) {
+                radius_msg_free(msg);
+                os_free(msg);
+        }
+
+        /* Last attribute (Message-Authenticator) extends past the end */
+        os_memcpy(buf, req->buf, req->buf_used);
+        buf[req->buf_used - 18 + 1] = 19;
+        msg = radius_msg_parse_borrow(buf, req->buf_used);
+        if (msg) {
+                printf("Invalid message accepted\n");
+                errors++;
+                radius_msg_free(msg);
+                os_free(msg);
+        }
+
+        os_free(buf);
+}
+
+
+static double bench(struct radius_msg *req, int borrow)
+{
+        struct radius_msg *msg;
+        struct os_reltime t0, t1, diff;
+        u8 buf[64];
+        int i;
+
+        os_get_reltime(&t0);
+        for (i = 0; i < NUM_PARSE; i++) {
+                if (borrow)
+                        msg = radius_msg_parse_borrow(req->buf,
+                                                      req->buf_used);
+                else
+                        msg = radius_msg_parse(req->buf, req->buf_used);
+                if (msg == NULL) {
+                        errors++;
+                        break;
+                }
+                /* Lookups done by the RADIUS server for each request */
+                radius_msg_get_attr(msg, RADIUS_ATTR_STATE, buf, sizeof(buf));
+                radius_msg_get_attr(msg, RADIUS_ATTR_USER_NAME, buf,
+                                    sizeof(buf));
+                radius_msg_count_attr(msg, RADIUS_ATTR_MESSAGE_AUTHENTICATOR,
+                                      0);
+                os_free(radius_msg_get_eap(msg, NULL));
+                radius_msg_free(msg);
+                os_free(msg);
+        }
+        os_get_reltime(&t1);
+
+        os_reltime_sub(&t1, &t0, &diff);
+        return diff.sec + diff.usec / 1000000.0;
+}
+
+
+int main(int argc, char *argv[])
+{
+        struct radius_msg *req;
+
+        req = build_request();
+        if (req == NULL) {
+                printf("Failed to build RADIUS message\n");
+                return -1;
+        }
+
+        test_parse(req);
+
+        printf("radius: parse (copy) %d messages: %.3f s\n", NUM_PARSE,
+               bench(req, 0));
+        printf("radius: parse (borrow) %d messages: %.3f s\n", NUM_PARSE,
+               bench(req, 1));
+
+        radius_msg_free(req);
+        os_free(req);
+
+        if (errors) {
+                printf("radius parse test - FAILED (%d errors)\n", errors);
+                return -1;
+        }
+        printf("radius parse test - OK\n");
+        return 0;
+}
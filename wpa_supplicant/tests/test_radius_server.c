@@ -0,0 +1,971 @@
+/*
+ * Test program for the RADIUS server session and client tables
+ * Copyright (c) 2026, agent <agent@local>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * Alternatively, this software may be distributed under the terms of BSD
+ * license.
+ *
+ * See README and COPYING for more details.
+ */
+
+/* The tables are internal to the server, so it is included here */
+#ifndef RADIUS_SERVER
+#define RADIUS_SERVER
+#endif /* RADIUS_SERVER */
+#ifndef CONFIG_IPV6
+#define CONFIG_IPV6
+#endif /* CONFIG_IPV6 */
+#include "radius/radius_server.c"
+
+#define NUM_SESSIONS 3000
+
+static int errors;
+
+
+/*
+ * EAP server state machine replacement. A request is answered with an
+ * EAP-Request/Identity unless the state machine is told to wait for a
+ * pending method.
+ */
+struct eap_sm {
+        struct eap_eapol_interface eap_if;
+        int pending;
+};
+
+static int new_sm_pending;
+static int pending_cb_calls;
+static struct eap_sm *pending_cb_sm;
+
+
+struct eap_sm * eap_server_sm_init(void *eapol_ctx,
+                                   struct eapol_callbacks *eapol_cb,
+                                   struct eap_config *eap_conf)
+{
+        struct eap_sm *sm;
+
+        sm = os_zalloc(sizeof(*sm));
+        if (sm)
+                sm->pending = new_sm_pending;
+        return sm;
+}
+
+
+void eap_server_sm_deinit(struct eap_sm *sm)
+{
+        if (sm == NULL)
+                return;
+        wpabuf_free(sm->eap_if.eapRespData);
+        wpabuf_free(sm->eap_if.eapReqData);
+        os_free(sm);
+}
+
+
+int eap_server_sm_step(struct eap_sm *sm)
+{
+        if (sm->pending)
+                return 0;
+        wpabuf_free(sm->eap_if.eapReqData);
+        sm->eap_if.eapReqData = wpabuf_alloc(5);
+        if (sm->eap_if.eapReqData == NULL)
+                return 0;
+        wpabuf_put_u8(sm->eap_if.eapReqData, EAP_CODE_REQUEST);
+        wpabuf_put_u8(sm->eap_if.eapReqData, 1);
+        wpabuf_put_be16(sm->eap_if.eapReqData, 5);
+        wpabuf_put_u8(sm->eap_if.eapReqData, EAP_TYPE_IDENTITY);
+        sm->eap_if.eapReq = TRUE;
+        return 1;
+}
+
+
+int eap_sm_method_pending(struct eap_sm *sm)
+{
+        return sm->pending;
+}
+
+
+void eap_sm_pending_cb(struct eap_sm *sm)
+{
+        pending_cb_calls++;
+        pending_cb_sm = sm;
+}
+
+
+struct eap_eapol_interface * eap_get_interface(struct eap_sm *sm)
+{
+        return &sm->eap_if;
+}
+
+
+static int test_get_eap_user(void *ctx, const u8 *identity,
+                             size_t identity_len, int phase2,
+                             struct eap_user *user)
+{
+        return 0;
+}
+
+
+static struct radius_server_data * test_server(int max_sess)
+{
+        struct radius_server_data *data;
+
+        data = os_zalloc(sizeof(*data));
+        if (data == NULL)
+                return NULL;
+        data->auth_sock = -1;
+        data->worker = -1;
+        data->max_sess = max_sess;
+        data->get_eap_user = test_get_eap_user;
+        data->io = radius_server_io_init();
+        if (data->io == NULL) {
+                os_free(data);
+                return NULL;
+        }
+        return data;
+}
+
+
+static struct radius_client * test_client(const char *secret)
+{
+        struct radius_client *client;
+
+        client = os_zalloc(sizeof(*client));
+        if (client == NULL)
+                return NULL;
+        client->shared_secret = os_strdup(secret);
+        client->shared_secret_len = os_strlen(secret);
+        return client;
+}
+
+
+static void free_client(struct radius_client *client)
+{
+        if (client == NULL)
+                return;
+        os_free(client->shared_secret);
+        os_free(client);
+}
+
+
+/* Number of sessions in the session hash and the expiration queues */
+static int count_sessions(struct radius_server_data *data, int *pending,
+                          int *done)
+{
+        struct radius_session *sess;
+        unsigned int i;
+        int count = 0;
+
+        for (i = 0; i < data->sess_hash_size; i++) {
+                for (sess = data->sess_hash[i]; sess; sess = sess->hnext)
+                        count++;
+        }
+        *pending = *done = 0;
+        for (sess = data->pending.head; sess; sess = sess->exp_next)
+                (*pending)++;
+        for (sess = data->done.head; sess; sess = sess->exp_next)
+                (*done)++;
+        return count;
+}
+
+
+static void check_count(const char *name, struct radius_server_data *data,
+                        int pending, int done)
+{
+        int hash, p, d;
+
+        hash = count_sessions(data, &p, &d);
+        if (hash != pending + done || p != pending || d != done ||
+            data->num_sess != pending + done) {
+                printf("%s: %d sessions (%d hashed, %d pending, %d done), "
+                       "expected %d pending, %d done\n", name, data->num_sess,
+                       hash, p, d, pending, done);
+                errors++;
+        }
+}
+
+
+static void test_session_hash(void)
+{
+        struct radius_server_data *data;
+        struct radius_client *client, *other;
+        struct radius_session *sess;
+        unsigned int i, id;
+
+        data = test_server(NUM_SESSIONS);
+        client = test_client("secret");
+        other = test_client("other");
+        if (data == NULL || client == NULL || other == NULL) {
+                errors++;
+                goto fail;
+        }
+
+        for (i = 0; i < NUM_SESSIONS; i++) {
+                if (radius_server_new_session(data, client) == NULL) {
+                        printf("session hash: failed to add session %u\n", i);
+                        errors++;
+                        goto fail;
+                }
+        }
+
+        /* The table is doubled when it is full */
+        if (data->sess_hash_size != 4096) {
+                printf("session hash: size %u for %d sessions\n",
+                       data->sess_hash_size, data->num_sess);
+                errors++;
+        }
+        check_count("session hash", data, NUM_SESSIONS, 0);
+
+        for (id = 0; id < NUM_SESSIONS; id++) {
+                sess = radius_server_get_session(data, client, id);
+                if (sess == NULL || sess->sess_id != id) {
+                        printf("session hash: session 0x%x not found\n", id);
+                        errors++;
+                        break;
+                }
+                if (radius_server_get_session(data, other, id)) {
+                        printf("session hash: session 0x%x found for another "
+                               "client\n", id);
+                        errors++;
+                        break;
+                }
+        }
+        if (radius_server_get_session(data, client, NUM_SESSIONS)) {
+                printf("session hash: unknown session found\n");
+                errors++;
+        }
+
+        /* Removal in the middle of the queue and hash chains */
+        for (id = 0; id < NUM_SESSIONS; id += 3)
+                radius_server_session_remove(
+                        data, radius_server_get_session(data, client, id));
+        check_count("session remove", data, NUM_SESSIONS * 2 / 3, 0);
+        for (id = 0; id < NUM_SESSIONS; id++) {
+                sess = radius_server_get_session(data, client, id);
+                if ((sess == NULL) != (id % 3 == 0)) {
+                        printf("session remove: wrong lookup result for "
+                               "0x%x\n", id);
+                        errors++;
+                        break;
+                }
+        }
+
+fail:
+        if (data) {
+                radius_server_free_sessions(data);
+                os_free(data->io);
+                os_free(data);
+        }
+        free_client(client);
+        free_client(other);
+}
+
+
+static void test_session_expire(void)
+{
+        struct radius_server_data *data;
+        struct radius_client *client;
+        struct radius_session *sess;
+        struct os_reltime now;
+        int i;
+
+        data = test_server(100);
+        client = test_client("secret");
+        if (data == NULL || client == NULL) {
+                errors++;
+                goto fail;
+        }
+
+        for (i = 0; i < 10; i++)
+                radius_server_new_session(data, client);
+        if (data->timer_expire.sec == 0 ||
+            !eloop_is_timeout_registered(radius_server_session_expire, data,
+                                         NULL)) {
+                printf("session expire: timer not registered\n");
+                errors++;
+        }
+
+        /* Sessions 0..3 complete; they are kept for duplicates */
+        for (i = 0; i < 4; i++)
+                radius_server_session_done(
+                        data, radius_server_get_session(data, client, i));
+        check_count("session done", data, 6, 4);
+
+        /* The queues are in expiration order: the oldest three pending and
+         * the oldest two completed sessions are expired */
+        os_get_reltime(&now);
+        now.sec--;
+        for (sess = data->pending.head, i = 0; i < 3; i++) {
+                sess->expire = now;
+                sess = sess->exp_next;
+        }
+        for (sess = data->done.head, i = 0; i < 2; i++) {
+                sess->expire = now;
+                sess = sess->exp_next;
+        }
+        radius_server_session_expire(data, NULL);
+        check_count("session expire", data, 3, 2);
+        if (data->sess_timeouts != 3) {
+                printf("session expire: %u timeouts\n", data->sess_timeouts);
+                errors++;
+        }
+        for (i = 0; i < 10; i++) {
+                sess = radius_server_get_session(data, client, i);
+                if ((sess == NULL) != (i < 2 || (i >= 4 && i < 7))) {
+                        printf("session expire: wrong lookup result for "
+                               "0x%x\n", i);
+                        errors++;
+                        break;
+                }
+        }
+        if (data->pending.head == NULL || data->pending.head->sess_id != 7 ||
+            data->done.head == NULL || data->done.head->sess_id != 2) {
+                printf("session expire: wrong queue heads\n");
+                errors++;
+        }
+        if (data->timer_expire.sec == 0 ||
+            !eloop_is_timeout_registered(radius_server_session_expire, data,
+                                         NULL)) {
+                printf("session expire: timer not registered again\n");
+                errors++;
+        }
+
+        radius_server_free_sessions(data);
+        if (eloop_is_timeout_registered(radius_server_session_expire, data,
+                                        NULL)) {
+                printf("session expire: timer not cancelled\n");
+                errors++;
+        }
+
+fail:
+        if (data) {
+                radius_server_free_sessions(data);
+                os_free(data->io);
+                os_free(data);
+        }
+        free_client(client);
+}
+
+
+static void test_session_limit(void)
+{
+        struct radius_server_data *data;
+        struct radius_client *client;
+        struct radius_session *sess;
+        int i;
+
+        data = test_server(8);
+        client = test_client("secret");
+        if (data == NULL || client == NULL) {
+                errors++;
+                goto fail;
+        }
+
+        for (i = 0; i < 8; i++)
+                radius_server_new_session(data, client);
+        radius_server_session_done(data,
+                                   radius_server_get_session(data, client, 5));
+        radius_server_session_done(data,
+                                   radius_server_get_session(data, client, 2));
+
+        /* The completed sessions are evicted in completion order */
+        sess = radius_server_new_session(data, client);
+        if (sess == NULL || data->sess_evictions != 1 ||
+            radius_server_get_session(data, client, 5) ||
+            radius_server_get_session(data, client, 2) == NULL) {
+                printf("session limit: session 5 not evicted\n");
+                errors++;
+        }
+        sess = radius_server_new_session(data, client);
+        if (sess == NULL || data->sess_evictions != 2 ||
+            radius_server_get_session(data, client, 2)) {
+                printf("session limit: session 2 not evicted\n");
+                errors++;
+        }
+        check_count("session limit", data, 8, 0);
+
+        /* Authentications in progress are never evicted */
+        if (radius_server_new_session(data, client) ||
+            data->sess_limit_rejects != 1 || data->sess_evictions != 2) {
+                printf("session limit: pending session evicted\n");
+                errors++;
+        }
+        check_count("session limit reject", data, 8, 0);
+        if (data->peak_sess != 8) {
+                printf("session limit: peak %d\n", data->peak_sess);
+                errors++;
+        }
+
+fail:
+        if (data) {
+                radius_server_free_sessions(data);
+                os_free(data->io);
+                os_free(data);
+        }
+        free_client(client);
+}
+
+
+static struct radius_msg * build_request(u8 identifier)
+{
+        struct radius_msg *msg;
+        u8 eap[] = { EAP_CODE_RESPONSE, 1, 0, 9, EAP_TYPE_IDENTITY,
+                     'u', 's', 'e', 'r' };
+
+        msg = radius_msg_new(RADIUS_CODE_ACCESS_REQUEST, identifier);
+        if (msg == NULL)
+                return NULL;
+        radius_msg_make_authenticator(msg, &identifier, 1);
+        if (!radius_msg_add_attr(msg, RADIUS_ATTR_USER_NAME, (u8 *) "user",
+                                 4) ||
+            !radius_msg_add_eap(msg, eap, sizeof(eap)) ||
+            radius_msg_finish(msg, (u8 *) "secret", 6) < 0) {
+                radius_msg_free(msg);
+                os_free(msg);
+                return NULL;
+        }
+        return msg;
+}
+
+
+static void test_pending_cb(void)
+{
+        struct radius_server_data *data;
+        struct radius_client *client;
+        struct radius_session *sess;
+        struct radius_msg *msg, *reply;
+        struct sockaddr_in addr;
+        socklen_t addrlen;
+        struct eap_sm *sm;
+        int nas = -1, i, res, len;
+        u8 buf[RADIUS_MAX_MSG_LEN];
+
+        data = test_server(NUM_SESSIONS);
+        client = test_client("secret");
+        if (data == NULL || client == NULL) {
+                errors++;
+                goto fail;
+        }
+
+        /* The reply is sent from the server socket to the NAS socket */
+        os_memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        data->auth_sock = socket(PF_INET, SOCK_DGRAM, 0);
+        nas = socket(PF_INET, SOCK_DGRAM, 0);
+        addrlen = sizeof(addr);
+        if (data->auth_sock < 0 || nas < 0 ||
+            bind(nas, (struct sockaddr *) &addr, sizeof(addr)) < 0 ||
+            getsockname(nas, (struct sockaddr *) &addr, &addrlen) < 0) {
+                perror("socket");
+                errors++;
+                goto fail;
+        }
+
+        /* Enough sessions with EAP state machines to resize both hashes;
+         * the method of each one is pending */
+        new_sm_pending = 1;
+        for (i = 0; i < NUM_SESSIONS; i++) {
+                msg = build_request(i);
+                if (msg == NULL) {
+                        errors++;
+                        goto fail;
+                }
+                res = radius_server_request(data, msg,
+                                            (struct sockaddr *) &addr,
+                                            addrlen, client, "127.0.0.1",
+                                            ntohs(addr.sin_port), NULL);
+                if (res != -2) {
+                        printf("pending cb: request %d not stored\n", i);
+                        radius_msg_free(msg);
+                        os_free(msg);
+                        errors++;
+                        goto fail;
+                }
+        }
+        new_sm_pending = 0;
+
+        /* Complete the pending method of a session in the middle */
+        sess = radius_server_get_session(data, client, NUM_SESSIONS / 2);
+        if (sess == NULL || sess->last_msg == NULL) {
+                printf("pending cb: no pending request stored\n");
+                errors++;
+                goto fail;
+        }
+        sm = sess->eap;
+        sm->pending = 0;
+        radius_server_eap_pending_cb(data, sm);
+        if (pending_cb_calls != 1 || pending_cb_sm != sm ||
+            sess->last_msg != NULL) {
+                printf("pending cb: session not found by the state machine\n");
+                errors++;
+        }
+
+        len = recv(nas, buf, sizeof(buf), MSG_DONTWAIT);
+        reply = len > 0 ? radius_msg_parse(buf, len) : NULL;
+        if (reply == NULL ||
+            reply->hdr->code != RADIUS_CODE_ACCESS_CHALLENGE ||
+            reply->hdr->identifier != (u8) (NUM_SESSIONS / 2)) {
+                printf("pending cb: no Access-Challenge sent\n");
+                errors++;
+        }
+        if (reply) {
+                radius_msg_free(reply);
+                os_free(reply);
+        }
+
+        /* A callback for a state machine that no longer exists is ignored */
+        radius_server_session_remove(data, sess);
+        radius_server_eap_pending_cb(data, sm);
+        if (pending_cb_calls != 1) {
+                printf("pending cb: callback for a removed session\n");
+                errors++;
+        }
+
+fail:
+        if (nas >= 0)
+                close(nas);
+        if (data) {
+                if (data->auth_sock >= 0)
+                        close(data->auth_sock);
+                radius_server_free_sessions(data);
+                os_free(data->io);
+                os_free(data);
+        }
+        free_client(client);
+}
+
+
+static u32 test_rand_state = 12345;
+
+static u32 test_rand(void)
+{
+        test_rand_state = test_rand_state * 1103515245 + 12345;
+        return test_rand_state >> 8;
+}
+
+
+struct test_prefix {
+        u8 key[16];
+        int len;
+        struct radius_client *client;
+};
+
+
+/* Longest-prefix match by a linear search; the first duplicate is used */
+static struct radius_client *
+test_lookup(const struct test_prefix *prefixes, int num, const u8 *addr)
+{
+        struct radius_client *client = NULL;
+        int i, best = -1;
+
+        for (i = 0; i < num; i++) {
+                if (prefixes[i].len > best &&
+                    radius_client_key_common(addr, prefixes[i].key,
+                                             prefixes[i].len) ==
+                    prefixes[i].len) {
+                        best = prefixes[i].len;
+                        client = prefixes[i].client;
+                }
+        }
+        return client;
+}
+
+
+static struct radius_client *
+test_table_add(struct radius_client_table *table, const u8 *key, int len,
+               const char *secret)
+{
+        struct radius_client *client;
+
+        client = test_client(secret);
+        if (client == NULL)
+                return NULL;
+        client->next = table->clients;
+        table->clients = client;
+        table->num_clients++;
+        if (radius_client_trie_add(table, key, len, client) < 0)
+                return NULL;
+        return client;
+}
+
+
+static void check_client(const char *name, struct radius_client_table *table,
+                         const char *addr, const char *secret)
+{
+        struct radius_client *client;
+        struct in6_addr a6;
+        struct in_addr a;
+        int ipv6;
+
+        ipv6 = os_strchr(addr, ':') != NULL;
+        if (ipv6)
+                inet_pton(AF_INET6, addr, &a6);
+        else
+                inet_aton(addr, &a);
+        client = radius_server_get_client(table, ipv6 ? (struct in_addr *) &a6
+                                          : &a, ipv6);
+        if (secret == NULL ? client != NULL :
+            client == NULL || os_strcmp(client->shared_secret, secret) != 0) {
+                printf("%s: %s matched %s, expected %s\n", name, addr,
+                       client ? client->shared_secret : "no client",
+                       secret ? secret : "no client");
+                errors++;
+        }
+}
+
+
+static void test_client_prefixes(void)
+{
+        static const struct {
+                const char *addr;
+                int len;
+                const char *secret;
+        } entries[] = {
+                { "10.0.0.0", 8, "a" },
+                { "10.1.0.0", 16, "b" },
+                { "10.1.2.3", 32, "d" },
+                { "10.1.2.0", 24, "c" },
+                { "10.1.0.0", 16, "duplicate" },
+                { "10.128.0.0", 9, "f" },
+                { "192.168.1.0", 24, "g" },
+        };
+        struct radius_client_table *table;
+        struct in_addr addr;
+        unsigned int i;
+
+        table = os_zalloc(sizeof(*table));
+        if (table == NULL) {
+                errors++;
+                return;
+        }
+        for (i = 0; i < sizeof(entries) / sizeof(entries[0]); i++) {
+                inet_aton(entries[i].addr, &addr);
+                if (test_table_add(table, (u8 *) &addr, entries[i].len,
+                                   entries[i].secret) == NULL) {
+                        errors++;
+                        goto fail;
+                }
+        }
+
+        check_client("nested", table, "10.1.2.3", "d");
+        check_client("nested", table, "10.1.2.4", "c");
+        check_client("nested", table, "10.1.3.1", "b");
+        check_client("nested", table, "10.2.0.1", "a");
+        check_client("overlapping", table, "10.200.0.1", "f");
+        check_client("overlapping", table, "10.127.255.255", "a");
+        check_client("no match", table, "11.0.0.1", NULL);
+        check_client("separate", table, "192.168.1.77", "g");
+        check_client("no match", table, "192.168.2.1", NULL);
+
+        /* A default route matches everything else */
+        addr.s_addr = 0;
+        if (test_table_add(table, (u8 *) &addr, 0, "default") == NULL) {
+                errors++;
+                goto fail;
+        }
+        check_client("default", table, "11.0.0.1", "default");
+        check_client("default", table, "10.1.2.4", "c");
+
+fail:
+        radius_server_free_clients(table);
+}
+
+
+/* Random overlapping prefixes around a few base addresses compared with a
+ * linear search */
+static void test_client_random(int bits)
+{
+        struct test_prefix *prefixes;
+        struct radius_client_table *table;
+        u8 bases[8][16], addr[16];
+        int num = 500, i, j, bytes = bits / 8;
+
+        prefixes = os_zalloc(num * sizeof(*prefixes));
+        table = os_zalloc(sizeof(*table));
+        if (prefixes == NULL || table == NULL) {
+                errors++;
+                goto fail;
+        }
+
+        for (i = 0; i < 8; i++) {
+                for (j = 0; j < bytes; j++)
+                        bases[i][j] = test_rand();
+        }
+
+        for (i = 0; i < num; i++) {
+                if (i > 0 && test_rand() % 10 == 0) {
+                        /* Duplicate of an earlier prefix */
+                        prefixes[i] = prefixes[test_rand() % i];
+                } else {
+                        os_memcpy(prefixes[i].key, bases[test_rand() % 8],
+                                  bytes);
+                        prefixes[i].key[test_rand() % bytes] ^=
+                                1 << (test_rand() % 8);
+                        prefixes[i].len = test_rand() % (bits + 1);
+                }
+                prefixes[i].client = test_table_add(table, prefixes[i].key,
+                                                    prefixes[i].len, "random");
+                if (prefixes[i].client == NULL) {
+                        errors++;
+                        goto fail;
+                }
+        }
+
+        for (i = 0; i < 10000; i++) {
+                if (i < num) {
+                        os_memcpy(addr, prefixes[i].key, bytes);
+                } else {
+                        os_memcpy(addr, bases[test_rand() % 8], bytes);
+                        for (j = test_rand() % 3; j >= 0; j--)
+                                addr[test_rand() % bytes] ^=
+                                        1 << (test_rand() % 8);
+                }
+                if (radius_server_get_client(table, (struct in_addr *) addr,
+                                             bits == 128) !=
+                    test_lookup(prefixes, num, addr)) {
+                        printf("random prefixes: lookup %d (%d bits) does "
+                               "not match the linear search\n", i, bits);
+                        errors++;
+                        break;
+                }
+        }
+
+fail:
+        os_free(prefixes);
+        radius_server_free_clients(table);
+}
+
+
+static int write_file(const char *fname, const char *buf)
+{
+        FILE *f;
+
+        f = fopen(fname, "w");
+        if (f == NULL)
+                return -1;
+        fputs(buf, f);
+        fclose(f);
+        return 0;
+}
+
+
+static void test_client_mapped(const char *fname)
+{
+        struct radius_client_table *table;
+
+        /* IPv4 entries are IPv4-mapped IPv6 prefixes in IPv6 mode */
+        if (write_file(fname, "192.168.1.0/24 v4net\n"
+                       "10.0.0.1 v4host\n"
+                       "::ffff:192.168.1.128/121 mapped\n"
+                       "2001:db8::/32 v6net\n") < 0) {
+                errors++;
+                return;
+        }
+        table = radius_server_read_clients(fname, 1);
+        if (table == NULL || table->num_clients != 4) {
+                printf("mapped: client file not read\n");
+                errors++;
+                radius_server_free_clients(table);
+                return;
+        }
+        check_client("mapped", table, "::ffff:192.168.1.5", "v4net");
+        check_client("mapped", table, "::ffff:192.168.1.200", "mapped");
+        check_client("mapped", table, "::ffff:10.0.0.1", "v4host");
+        check_client("mapped", table, "::ffff:10.0.0.2", NULL);
+        check_client("mapped", table, "2001:db8::1", "v6net");
+        check_client("mapped", table, "2001:db9::1", NULL);
+        check_client("mapped", table, "::192.168.1.5", NULL);
+        radius_server_free_clients(table);
+
+        if (write_file(fname, "192.168.1.0/24 v4net\n"
+                       "::ffff:192.168.1.128/121 mapped\n") < 0) {
+                errors++;
+                return;
+        }
+        table = radius_server_read_clients(fname, 0);
+        if (table) {
+                printf("mapped: IPv6 entry accepted in IPv4 mode\n");
+                errors++;
+                radius_server_free_clients(table);
+        }
+}
+
+
+static struct radius_session *
+test_nas_session(struct radius_server_data *data, const char *nas)
+{
+        struct radius_session *sess;
+        struct radius_client *client;
+        struct sockaddr_in *sin;
+        struct sockaddr_in6 *sin6;
+        struct in6_addr a6;
+        struct in_addr a;
+
+        os_memset(&a6, 0, sizeof(a6));
+        if (data->ipv6) {
+                inet_pton(AF_INET6, nas, &a6);
+                client = radius_server_get_client(data->clients,
+                                                  (struct in_addr *) &a6, 1);
+        } else {
+                inet_aton(nas, &a);
+                client = radius_server_get_client(data->clients, &a, 0);
+        }
+        if (client == NULL)
+                return NULL;
+        sess = radius_server_new_session(data, client);
+        if (sess == NULL)
+                return NULL;
+
+        /* As stored by radius_server_request() */
+        if (data->ipv6) {
+                sin6 = (struct sockaddr_in6 *) &sess->last_from;
+                sin6->sin6_family = AF_INET6;
+                sin6->sin6_addr = a6;
+                sess->last_fromlen = sizeof(*sin6);
+        } else {
+                sin = (struct sockaddr_in *) &sess->last_from;
+                sin->sin_family = AF_INET;
+                sin->sin_addr = a;
+                sess->last_fromlen = sizeof(*sin);
+        }
+        return sess;
+}
+
+
+static void check_session(const char *name, struct radius_server_data *data,
+                          unsigned int sess_id, const char *secret)
+{
+        struct radius_session *sess = NULL;
+        unsigned int i;
+
+        for (i = 0; i < data->sess_hash_size && sess == NULL; i++) {
+                for (sess = data->sess_hash[i]; sess; sess = sess->hnext) {
+                        if (sess->sess_id == sess_id)
+                                break;
+                }
+        }
+        if (secret == NULL ? sess != NULL :
+            sess == NULL ||
+            os_strcmp(sess->client->shared_secret, secret) != 0 ||
+            radius_server_get_session(data, sess->client, sess_id) != sess) {
+                printf("%s: session 0x%x has %s, expected %s\n", name,
+                       sess_id, sess ? sess->client->shared_secret :
+                       "been removed", secret ? secret : "removal");
+                errors++;
+        }
+}
+
+
+static void test_reload(const char *fname, int ipv6)
+{
+        static const char *nas4[] = {
+                "127.0.0.1", "10.0.0.1", "127.0.0.2", "10.0.0.2"
+        };
+        static const char *nas6[] = {
+                "::ffff:127.0.0.1", "2001:db8::1", "::ffff:127.0.0.2",
+                "2001:db8::2"
+        };
+        const char **nas = ipv6 ? nas6 : nas4;
+        struct radius_server_data *data;
+        struct radius_client_table *old;
+        int i;
+
+        data = test_server(100);
+        if (data == NULL ||
+            write_file(fname, ipv6 ? "127.0.0.0/8 first\n2001:db8::/32 other\n"
+                       : "127.0.0.0/8 first\n10.0.0.0/8 other\n") < 0) {
+                errors++;
+                goto fail;
+        }
+        data->ipv6 = ipv6;
+        data->clients = radius_server_read_clients(fname, ipv6);
+        if (data->clients == NULL) {
+                errors++;
+                goto fail;
+        }
+        for (i = 0; i < 4; i++) {
+                if (test_nas_session(data, nas[i]) == NULL) {
+                        printf("reload: no session for %s\n", nas[i]);
+                        errors++;
+                        goto fail;
+                }
+        }
+        /* Completed sessions are moved, too */
+        radius_server_session_done(data, data->pending.head);
+
+        /* A file that cannot be read keeps the current clients */
+        old = data->clients;
+        if (radius_server_reload_clients(data, "/nonexistent") == 0 ||
+            data->clients != old || data->num_sess != 4) {
+                printf("reload: failed reload changed the clients\n");
+                errors++;
+        }
+
+        /* Sessions move to the most specific new entry of their NAS; the
+         * sessions of the removed NAS are removed */
+        if (write_file(fname, "127.0.0.1 second\n127.0.0.0/8 third\n") < 0 ||
+            radius_server_reload_clients(data, fname) < 0) {
+                errors++;
+                goto fail;
+        }
+        check_session("reload", data, 0, "second");
+        check_session("reload", data, 1, NULL);
+        check_session("reload", data, 2, "third");
+        check_session("reload", data, 3, NULL);
+        check_count("reload", data, 1, 1);
+        if (data->done.head == NULL || data->done.head->sess_id != 0) {
+                printf("reload: completed session not kept\n");
+                errors++;
+        }
+        check_client("reload", data->clients, nas[1], NULL);
+
+fail:
+        if (data) {
+                radius_server_free_sessions(data);
+                radius_server_free_clients(data->clients);
+                os_free(data->io);
+                os_free(data);
+        }
+}
+
+
+int main(int argc, char *argv[])
+{
+        char fname[] = "/tmp/test_radius_server.XXXXXX";
+        int fd;
+
+        if (eloop_init(NULL) < 0)
+                return -1;
+
+        test_session_hash();
+        test_session_expire();
+        test_session_limit();
+        test_pending_cb();
+
+        test_client_prefixes();
+        test_client_random(32);
+        test_client_random(128);
+        fd = mkstemp(fname);
+        if (fd < 0) {
+                perror("mkstemp");
+                errors++;
+        } else {
+                close(fd);
+                test_client_mapped(fname);
+                test_reload(fname, 0);
+                test_reload(fname, 1);
+                unlink(fname);
+        }
+
+        eloop_destroy();
+
+        if (errors) {
+                printf("radius server test - FAILED (%d errors)\n", errors);
+                return -1;
+        }
+        printf("radius server test - OK\n");
+        return 0;
+}
@@ -0,0 +1,393 @@
+/*
+ * Test program for the scan scheduler
+ * Copyright (c) 2026, agent <agent@local>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * Alternatively, this software may be distributed under the terms of BSD
+ * license.
+ *
+ * See README and COPYING for more details.
+ */
+
+/* The scheduler is internal to the scan code, so it is included here */
+#include "../scan.c"
+
+static int errors;
+
+static int drv_scans;
+static int drv_ret;
+static int drv_freqs[10];
+
+
+static int test_driver_scan2(void *priv, struct wpa_driver_scan_params *params)
+{
+        size_t i = 0;
+
+        drv_scans++;
+        if (params->freqs) {
+                for (; i < 9 && params->freqs[i]; i++)
+                        drv_freqs[i] = params->freqs[i];
+        }
+        drv_freqs[i] = 0;
+        return drv_ret;
+}
+
+
+void wpa_supplicant_set_state(struct wpa_supplicant *wpa_s, wpa_states state)
+{
+        wpa_s->wpa_state = state;
+}
+
+
+struct wpa_ssid * wpa_supplicant_get_ssid(struct wpa_supplicant *wpa_s)
+{
+        return NULL;
+}
+
+
+void wpa_supplicant_initiate_eapol(struct wpa_supplicant *wpa_s)
+{
+}
+
+
+void wpa_supplicant_associate(struct wpa_supplicant *wpa_s,
+                              struct wpa_scan_res *bss, struct wpa_ssid *ssid)
+{
+}
+
+
+void wpa_supplicant_event(void *ctx, wpa_event_type event,
+                          union wpa_event_data *data)
+{
+}
+
+
+/* The ESS has been seen on 2412 MHz and the current AP is on 2437 MHz */
+static struct wpa_bss test_bss;
+
+
+struct wpa_bss * wpa_bss_get_bssid(struct wpa_supplicant *wpa_s,
+                                   const u8 *bssid)
+{
+        return &test_bss;
+}
+
+
+int * wpa_bss_ess_freqs(struct wpa_supplicant *wpa_s, const u8 *ssid,
+                        size_t ssid_len)
+{
+        int *freqs;
+
+        freqs = os_zalloc(2 * sizeof(int));
+        if (freqs)
+                freqs[0] = 2412;
+        return freqs;
+}
+
+
+#ifdef CONFIG_WPS
+enum wps_request_type wpas_wps_get_req_type(struct wpa_ssid *ssid)
+{
+        return WPS_REQ_ENROLLEE;
+}
+
+
+struct wpabuf * wps_build_probe_req_ie(int pbc, struct wps_device_data *dev,
+                                       const u8 *uuid,
+                                       enum wps_request_type req_type)
+{
+        return NULL;
+}
+#endif /* CONFIG_WPS */
+
+
+#ifdef CONFIG_CLIENT_MLME
+int ieee80211_sta_req_scan(struct wpa_supplicant *wpa_s, const u8 *ssid,
+                           size_t ssid_len)
+{
+        return -1;
+}
+
+
+int ieee80211_sta_set_probe_req_ie(struct wpa_supplicant *wpa_s, const u8 *ies,
+                                   size_t ies_len)
+{
+        return -1;
+}
+#endif /* CONFIG_CLIENT_MLME */
+
+
+#ifdef CONFIG_CTRL_IFACE_DBUS
+void wpa_supplicant_dbus_notify_scanning(struct wpa_supplicant *wpa_s)
+{
+}
+#endif /* CONFIG_CTRL_IFACE_DBUS */
+
+
+static int scan_pending(struct wpa_supplicant *wpa_s)
+{
+        return eloop_is_timeout_registered(wpa_supplicant_scan, wpa_s, NULL);
+}
+
+
+/* Run the scheduled scan now instead of waiting for the timeout */
+static void run_scan(struct wpa_supplicant *wpa_s)
+{
+        eloop_cancel_timeout(wpa_supplicant_scan, wpa_s, NULL);
+        wpa_supplicant_scan(wpa_s, NULL);
+}
+
+
+/* Run the roaming scan timeout now; it registers itself again */
+static void roam_scan(struct wpa_supplicant *wpa_s)
+{
+        eloop_cancel_timeout(wpa_supplicant_roam_scan, wpa_s, NULL);
+        wpa_supplicant_roam_scan(wpa_s, NULL);
+}
+
+
+/* Deliver the results of the scan that is in flight */
+static void scan_done(struct wpa_supplicant *wpa_s)
+{
+        wpa_supplicant_notify_scanning(wpa_s, 0);
+}
+
+
+static void test_backoff(struct wpa_supplicant *wpa_s)
+{
+        static const int expected[] = { 10, 20, 40, 60, 60 };
+        unsigned int periodic, failed;
+        size_t i;
+
+        /* The interval doubles up to scan_interval_max */
+        for (i = 0; i < sizeof(expected) / sizeof(expected[0]); i++) {
+                wpa_supplicant_cancel_scan(wpa_s);
+                wpa_supplicant_req_periodic_scan(wpa_s);
+                if (!scan_pending(wpa_s) ||
+                    wpa_s->scan_interval != expected[i]) {
+                        printf("Periodic scan %lu: interval %d (expected "
+                               "%d)\n", (unsigned long) i,
+                               wpa_s->scan_interval, expected[i]);
+                        errors++;
+                }
+        }
+        if (wpa_s->scan_periodic != i) {
+                printf("%u periodic scans (expected %lu)\n",
+                       wpa_s->scan_periodic, (unsigned long) i);
+                errors++;
+        }
+
+        /* A pending scan is not delayed */
+        periodic = wpa_s->scan_periodic;
+        wpa_supplicant_req_periodic_scan(wpa_s);
+        if (wpa_s->scan_periodic != periodic) {
+                printf("Periodic scan rescheduled a pending scan\n");
+                errors++;
+        }
+
+        /* An explicit request restarts from scan_interval */
+        wpa_supplicant_req_scan(wpa_s, 0, 0);
+        if (wpa_s->scan_interval != 0 || wpa_s->scan_requests != 1 ||
+            wpa_s->scan_backoff_resets != 1 || !scan_pending(wpa_s)) {
+                printf("Scan request did not reset the backoff\n");
+                errors++;
+        }
+        wpa_supplicant_cancel_scan(wpa_s);
+        wpa_supplicant_req_periodic_scan(wpa_s);
+        if (wpa_s->scan_interval != 10) {
+                printf("Backoff did not restart: interval %d\n",
+                       wpa_s->scan_interval);
+                errors++;
+        }
+
+        /* A driver failure is retried with the same backoff */
+        failed = wpa_s->scans_failed;
+        periodic = wpa_s->scan_periodic;
+        drv_ret = -1;
+        run_scan(wpa_s);
+        drv_ret = 0;
+        if (wpa_s->scans_failed != failed + 1 ||
+            wpa_s->scan_periodic != periodic + 1 ||
+            wpa_s->scan_interval != 20 || wpa_s->scanning ||
+            !scan_pending(wpa_s)) {
+                printf("Failed scan not retried with backoff\n");
+                errors++;
+        }
+
+        wpa_supplicant_cancel_scan(wpa_s);
+        wpa_supplicant_reset_scan_backoff(wpa_s);
+}
+
+
+static void test_in_flight(struct wpa_supplicant *wpa_s)
+{
+        int scans = drv_scans;
+
+        run_scan(wpa_s);
+        if (drv_scans != scans + 1 || !wpa_s->scanning) {
+                printf("Scan was not started\n");
+                errors++;
+        }
+
+        /* A timer-driven scan is dropped while the results are pending */
+        wpa_s->scan_req = 0;
+        run_scan(wpa_s);
+        if (drv_scans != scans + 1 || wpa_s->scans_skipped != 1 ||
+            scan_pending(wpa_s)) {
+                printf("Periodic scan not skipped while in flight\n");
+                errors++;
+        }
+
+        /* A manual request is kept and retried */
+        wpa_s->scan_req = 2;
+        run_scan(wpa_s);
+        if (drv_scans != scans + 1 || wpa_s->scans_skipped != 2 ||
+            !scan_pending(wpa_s) || wpa_s->scan_req != 2) {
+                printf("Manual scan not retried after in-flight scan\n");
+                errors++;
+        }
+        scan_done(wpa_s);
+        run_scan(wpa_s);
+        if (drv_scans != scans + 2 || wpa_s->scan_req != 0) {
+                printf("Manual scan not run after in-flight scan\n");
+                errors++;
+        }
+
+        /* A scan that never completed is considered lost */
+        wpa_s->scan_start.sec -= WPA_SCAN_IN_FLIGHT_TIMEOUT;
+        run_scan(wpa_s);
+        if (drv_scans != scans + 3 || wpa_s->scans_skipped != 2) {
+                printf("Lost scan blocked new scans\n");
+                errors++;
+        }
+        scan_done(wpa_s);
+        wpa_supplicant_cancel_scan(wpa_s);
+}
+
+
+static void test_roam_scan(struct wpa_supplicant *wpa_s)
+{
+        unsigned int requests = wpa_s->scan_requests;
+        unsigned int resets = wpa_s->scan_backoff_resets;
+        int scans = drv_scans;
+
+        wpa_s->wpa_state = WPA_COMPLETED;
+        wpa_s->conf->roam_scan_interval = 10;
+        wpa_s->conf->roam_full_scan_interval = 300;
+        wpa_s->scan_interval = 40;
+
+        /* The first roaming scan covers all channels */
+        os_memset(&wpa_s->last_full_scan, 0, sizeof(wpa_s->last_full_scan));
+        roam_scan(wpa_s);
+        if (wpa_s->scan_roaming != 1 || !scan_pending(wpa_s) ||
+            wpa_s->next_scan_freqs ||
+            !eloop_is_timeout_registered(wpa_supplicant_roam_scan, wpa_s,
+                                         NULL)) {
+                printf("Roaming scan was not scheduled\n");
+                errors++;
+        }
+        if (wpa_s->scan_requests != requests ||
+            wpa_s->scan_backoff_resets != resets ||
+            wpa_s->scan_interval != 40) {
+                printf("Roaming scan counted as an explicit request\n");
+                errors++;
+        }
+        run_scan(wpa_s);
+        if (drv_scans != scans + 1 || drv_freqs[0] != 0 ||
+            wpa_s->last_full_scan.sec == 0) {
+                printf("Roaming scan was not a full scan\n");
+                errors++;
+        }
+
+        /* A roaming scan is not run while another one is pending */
+        wpa_supplicant_req_periodic_scan(wpa_s);
+        roam_scan(wpa_s);
+        if (wpa_s->scan_roaming != 1) {
+                printf("Roaming scan replaced a pending scan\n");
+                errors++;
+        }
+        eloop_cancel_timeout(wpa_supplicant_scan, wpa_s, NULL);
+
+        /* Later ones are limited to the known channels of the ESS */
+        roam_scan(wpa_s);
+        if (wpa_s->scan_roaming != 2 || wpa_s->next_scan_freqs == NULL) {
+                printf("Roaming scan not limited to the ESS channels\n");
+                errors++;
+        }
+
+        /* They are dropped with the channel list if a scan is in flight */
+        run_scan(wpa_s);
+        if (drv_scans != scans + 1 || wpa_s->next_scan_freqs) {
+                printf("Roaming scan channels left after in-flight skip\n");
+                errors++;
+        }
+        scan_done(wpa_s);
+
+        roam_scan(wpa_s);
+        run_scan(wpa_s);
+        if (drv_scans != scans + 2 || drv_freqs[0] != 2412 ||
+            drv_freqs[1] != 2437 || drv_freqs[2] != 0 ||
+            wpa_s->scan_roaming != 3) {
+                printf("Roaming scan channels %d %d %d\n",
+                       drv_freqs[0], drv_freqs[1], drv_freqs[2]);
+                errors++;
+        }
+        scan_done(wpa_s);
+
+        wpa_supplicant_roam_scan_stop(wpa_s);
+        wpa_supplicant_cancel_scan(wpa_s);
+}
+
+
+int main(int argc, char *argv[])
+{
+        struct wpa_supplicant *wpa_s;
+        struct wpa_driver_ops driver;
+        struct wpa_config *conf;
+        struct wpa_ssid *ssid;
+
+        if (eloop_init(NULL) < 0)
+                return -1;
+
+        wpa_s = os_zalloc(sizeof(*wpa_s));
+        conf = os_zalloc(sizeof(*conf));
+        ssid = os_zalloc(sizeof(*ssid));
+        if (wpa_s == NULL || conf == NULL || ssid == NULL)
+                return -1;
+
+        os_memset(&driver, 0, sizeof(driver));
+        driver.name = "test";
+        driver.scan2 = test_driver_scan2;
+        wpa_s->driver = &driver;
+
+        ssid->ssid = (u8 *) "test";
+        ssid->ssid_len = 4;
+        conf->ssid = ssid;
+        conf->ap_scan = 1;
+        conf->scan_interval = 5;
+        conf->scan_interval_max = 60;
+        wpa_s->conf = conf;
+        wpa_s->current_ssid = ssid;
+        wpa_s->scan_res_tried = 1;
+        test_bss.freq = 2437;
+
+        test_backoff(wpa_s);
+        test_in_flight(wpa_s);
+        test_roam_scan(wpa_s);
+
+        os_free(wpa_s->last_scan_freqs);
+        os_free(wpa_s);
+        os_free(conf);
+        os_free(ssid);
+        eloop_destroy();
+
+        if (errors) {
+                printf("Scan scheduler test - FAILED (%d errors)\n", errors);
+                return -1;
+        }
+        printf("Scan scheduler test - OK\n");
+        return 0;
+}
@@ -0,0 +1,447 @@
+/*
+ * Test program and benchmark for scan result helpers
+ * Copyright (c) 2026, agent <agent@local>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * Alternatively, this software may be distributed under the terms of BSD
+ * license.
+ *
+ * See README and COPYING for more details.
+ */
+
+#include "includes.h"
+
+#include "common.h"
+#include "drivers/driver.h"
+#include "ieee802_11_defs.h"
+
+#define BENCH_ENTRIES 50000
+
+
+static unsigned int test_rand(void)
+{
+        static unsigned int state = 0x12345678;
+        state = state * 1103515245 + 12345;
+        return state >> 8;
+}
+
+
+static double time_diff(struct os_reltime *start, struct os_reltime *end)
+{
+        struct os_reltime diff;
+        os_reltime_sub(end, start, &diff);
+        return diff.sec + diff.usec / 1000000.0;
+}
+
+
+/* Comparison that parses the IEs on each call as a reference for ordering */
+static int ref_compar(const void *a, const void *b)
+{
+        struct wpa_scan_res **_wa = (void *) a;
+        struct wpa_scan_res **_wb = (void *) b;
+        struct wpa_scan_res *wa = *_wa;
+        struct wpa_scan_res *wb = *_wb;
+        int wpa_a, wpa_b, maxrate_a, maxrate_b;
+
+        wpa_a = wpa_scan_get_vendor_ie(wa, WPA_IE_VENDOR_TYPE) != NULL ||
+                wpa_scan_get_ie(wa, WLAN_EID_RSN) != NULL;
+        wpa_b = wpa_scan_get_vendor_ie(wb, WPA_IE_VENDOR_TYPE) != NULL ||
+                wpa_scan_get_ie(wb, WLAN_EID_RSN) != NULL;
+
+        if (wpa_b && !wpa_a)
+                return 1;
+        if (!wpa_b && wpa_a)
+                return -1;
+
+        if ((wa->caps & IEEE80211_CAP_PRIVACY) == 0 &&
+            (wb->caps & IEEE80211_CAP_PRIVACY))
+                return 1;
+        if ((wa->caps & IEEE80211_CAP_PRIVACY) &&
+            (wb->caps & IEEE80211_CAP_PRIVACY) == 0)
+                return -1;
+
+        if ((wa->level && wb->level && abs(wb->level - wa->level) < 5) ||
+            (wa->qual && wb->qual && abs(wb->qual - wa->qual) < 10)) {
+                maxrate_a = wpa_scan_get_max_rate(wa);
+                maxrate_b = wpa_scan_get_max_rate(wb);
+                if (maxrate_a != maxrate_b)
+                        return maxrate_b - maxrate_a;
+        }
+
+        if (wb->level == wa->level)
+                return wb->qual - wa->qual;
+        return -(wb->level - wa->level);
+}
+
+
+static u8 * add_ie(u8 *pos, u8 id, const u8 *data, size_t len)
+{
+        *pos++ = id;
+        *pos++ = len;
+        os_memcpy(pos, data, len);
+        return pos + len;
+}
+
+
+/* Build a scan result with IEs similar to what APs advertise */
+static struct wpa_scan_res * gen_res(int i)
+{
+        static const u8 rates[] = { 0x82, 0x84, 0x8b, 0x96, 0x0c, 0x12, 0x18,
+                                    0x24 };
+        static const u8 ext_rates[] = { 0x30, 0x48, 0x60, 0x6c };
+        static const u8 rsn[] = { 0x01, 0x00, 0x00, 0x0f, 0xac, 0x04, 0x01,
+                                  0x00, 0x00, 0x0f, 0xac, 0x04, 0x01, 0x00,
+                                  0x00, 0x0f, 0xac, 0x02, 0x00, 0x00 };
+        static const u8 wpa[] = { 0x00, 0x50, 0xf2, 0x01, 0x01, 0x00, 0x00,
+                                  0x50, 0xf2, 0x02, 0x01, 0x00, 0x00, 0x50,
+                                  0xf2, 0x02, 0x01, 0x00, 0x00, 0x50, 0xf2,
+                                  0x02 };
+        u8 buf[512], vendor[40], *pos = buf;
+        struct wpa_scan_res *r;
+        unsigned int rnd = test_rand();
+        char ssid[32];
+        int len;
+
+        len = os_snprintf(ssid, sizeof(ssid), "network-%d", i % 97);
+        pos = add_ie(pos, WLAN_EID_SSID, (u8 *) ssid, len);
+        pos = add_ie(pos, WLAN_EID_SUPP_RATES, rates,
+                     4 + (rnd & 3));
+        pos = add_ie(pos, WLAN_EID_DS_PARAMS, (u8 *) "\x06", 1);
+        if (rnd & 4)
+                pos = add_ie(pos, WLAN_EID_EXT_SUPP_RATES, ext_rates,
+                             sizeof(ext_rates));
+        if ((rnd & 0x18) == 0x08)
+                pos = add_ie(pos, WLAN_EID_RSN, rsn, sizeof(rsn));
+        /* Vendor IEs before the WPA IE to make the lookup realistic */
+        os_memset(vendor, 0xdd, sizeof(vendor));
+        vendor[0] = 0x00;
+        vendor[1] = 0x10;
+        vendor[2] = 0x18;
+        pos = add_ie(pos, WLAN_EID_VENDOR_SPECIFIC, vendor, sizeof(vendor));
+        pos = add_ie(pos, WLAN_EID_VENDOR_SPECIFIC, vendor, sizeof(vendor));
+        if ((rnd & 0x18) == 0x10)
+                pos = add_ie(pos, WLAN_EID_VENDOR_SPECIFIC, wpa, sizeof(wpa));
+
+        r = os_zalloc(sizeof(*r) + (pos - buf));
+        if (r == NULL)
+                return NULL;
+        r->bssid[0] = 0x02;
+        WPA_PUT_BE32(&r->bssid[2], i);
+        r->freq = 2437;
+        r->caps = IEEE80211_CAP_ESS;
+        if ((rnd & 0x18) || (rnd & 0x20))
+                r->caps |= IEEE80211_CAP_PRIVACY;
+        r->level = (rnd >> 6) % 8 ? -30 - (int) ((rnd >> 9) % 60) : 0;
+        r->qual = (rnd >> 15) % 70;
+        r->ie_len = pos - buf;
+        os_memcpy(r + 1, buf, r->ie_len);
+        return r;
+}
+
+
+static int test_sort(size_t num)
+{
+        struct wpa_scan_results res;
+        struct wpa_scan_res **orig, **ref;
+        struct os_reltime t0, t1, t2;
+        size_t i, rounds;
+        int r, errors = 0;
+
+        res.num = num;
+        res.res = os_malloc(num * sizeof(struct wpa_scan_res *));
+        orig = os_malloc(num * sizeof(struct wpa_scan_res *));
+        ref = os_malloc(num * sizeof(struct wpa_scan_res *));
+        if (res.res == NULL || orig == NULL || ref == NULL)
+                return -1;
+        for (i = 0; i < num; i++) {
+                orig[i] = gen_res(i);
+                if (orig[i] == NULL)
+                        return -1;
+        }
+
+        rounds = BENCH_ENTRIES / num;
+        os_get_reltime(&t0);
+        for (r = 0; r < (int) rounds; r++) {
+                os_memcpy(ref, orig, num * sizeof(struct wpa_scan_res *));
+                qsort(ref, num, sizeof(struct wpa_scan_res *), ref_compar);
+        }
+        os_get_reltime(&t1);
+        for (r = 0; r < (int) rounds; r++) {
+                os_memcpy(res.res, orig, num * sizeof(struct wpa_scan_res *));
+                wpa_scan_sort_results(&res);
+        }
+        os_get_reltime(&t2);
+
+        for (i = 0; i < num; i++) {
+                if (res.res[i] != ref[i]) {
+                        printf("Sort order differs at %d/%d\n",
+                               (int) i, (int) num);
+                        errors++;
+                        break;
+                }
+        }
+
+        printf("scan sort %5d entries x %4d: parse per compare %.3f s, "
+               "sort keys %.3f s\n", (int) num, (int) rounds,
+               time_diff(&t0, &t1), time_diff(&t1, &t2));
+
+        for (i = 0; i < num; i++)
+                os_free(orig[i]);
+        os_free(orig);
+        os_free(ref);
+        os_free(res.res);
+
+        return errors;
+}
+
+
+static struct wpa_scan_res * copy_res(const struct wpa_scan_res *r)
+{
+        struct wpa_scan_res *c;
+
+        c = os_malloc(sizeof(*r) + r->ie_len);
+        if (c)
+                os_memcpy(c, r, sizeof(*r) + r->ie_len);
+        return c;
+}
+
+
+static int check_index(const struct wpa_scan_res *plain,
+                       const struct wpa_scan_res *indexed)
+{
+        static const u32 types[] = {
+                WPA_IE_VENDOR_TYPE, WPS_IE_VENDOR_TYPE, 0x001018dd,
+                0x0050f202, 0x00112233
+        };
+        const u8 *a, *b;
+        size_t i;
+
+        if (!(indexed->flags & WPA_SCAN_IE_INDEXED))
+                return 1;
+        for (i = 0; i < 256; i++) {
+                a = wpa_scan_get_ie(plain, i);
+                b = wpa_scan_get_ie(indexed, i);
+                if ((a == NULL) != (b == NULL) ||
+                    (a && a - (const u8 *) plain != b - (const u8 *) indexed))
+                        return 1;
+        }
+        for (i = 0; i < sizeof(types) / sizeof(types[0]); i++) {
+                a = wpa_scan_get_vendor_ie(plain, types[i]);
+                b = wpa_scan_get_vendor_ie(indexed, types[i]);
+                if ((a == NULL) != (b == NULL) ||
+                    (a && a - (const u8 *) plain != b - (const u8 *) indexed))
+                        return 1;
+        }
+        return 0;
+}
+
+
+static int test_index(size_t num)
+{
+        struct wpa_scan_results res;
+        struct wpa_scan_res **orig, *r;
+        struct os_reltime t0, t1, t2;
+        u8 buf[200], *pos;
+        size_t i, rounds, r_i, found = 0;
+        int errors = 0;
+
+        os_memset(&res, 0, sizeof(res));
+        res.num = num + 1;
+        res.res = os_malloc(res.num * sizeof(struct wpa_scan_res *));
+        orig = os_malloc(res.num * sizeof(struct wpa_scan_res *));
+        if (res.res == NULL || orig == NULL)
+                return -1;
+        for (i = 0; i < num; i++)
+                orig[i] = gen_res(i);
+
+        /* More vendor IE types than fit into the index */
+        pos = buf;
+        for (i = 0; i < 12; i++) {
+                u8 v[4] = { 0x00, 0x11, 0x22, 0x20 + i };
+                pos = add_ie(pos, WLAN_EID_VENDOR_SPECIFIC, v, sizeof(v));
+        }
+        pos = add_ie(pos, WLAN_EID_VENDOR_SPECIFIC,
+                     (u8 *) "\x00\x11\x22\x33", 4);
+        r = os_zalloc(sizeof(*r) + (pos - buf));
+        if (r == NULL)
+                return -1;
+        r->ie_len = pos - buf;
+        os_memcpy(r + 1, buf, r->ie_len);
+        orig[num] = r;
+
+        for (i = 0; i < res.num; i++) {
+                res.res[i] = copy_res(orig[i]);
+                if (res.res[i] == NULL)
+                        return -1;
+        }
+        wpa_scan_results_index(&res);
+
+        for (i = 0; i < res.num; i++) {
+                if (check_index(orig[i], res.res[i])) {
+                        printf("IE index mismatch for entry %d\n", (int) i);
+                        errors++;
+                }
+        }
+        if (wpa_scan_res_size(res.res[0]) <= sizeof(*r) + res.res[0]->ie_len) {
+                printf("IE index not included in the size\n");
+                errors++;
+        }
+
+        /* Lookups done for each BSS during scan processing */
+        rounds = BENCH_ENTRIES * 10 / num;
+        os_get_reltime(&t0);
+        for (r_i = 0; r_i < rounds; r_i++) {
+                for (i = 0; i < num; i++) {
+                        r = orig[i];
+                        found += wpa_scan_get_ie(r, WLAN_EID_SSID) != NULL;
+                        found += wpa_scan_get_ie(r, WLAN_EID_RSN) != NULL;
+                        found += wpa_scan_get_vendor_ie(
+                                r, WPA_IE_VENDOR_TYPE) != NULL;
+                        found += wpa_scan_get_max_rate(r);
+                }
+        }
+        os_get_reltime(&t1);
+        for (r_i = 0; r_i < rounds; r_i++) {
+                for (i = 0; i < num; i++) {
+                        r = res.res[i];
+                        found -= wpa_scan_get_ie(r, WLAN_EID_SSID) != NULL;
+                        found -= wpa_scan_get_ie(r, WLAN_EID_RSN) != NULL;
+                        found -= wpa_scan_get_vendor_ie(
+                                r, WPA_IE_VENDOR_TYPE) != NULL;
+                        found -= wpa_scan_get_max_rate(r);
+                }
+        }
+        os_get_reltime(&t2);
+        if (found != 0) {
+                printf("IE lookup results differ\n");
+                errors++;
+        }
+
+        printf("IE lookup %5d entries x %4d: linear %.3f s, indexed %.3f s\n",
+               (int) num, (int) rounds, time_diff(&t0, &t1),
+               time_diff(&t1, &t2));
+
+        for (i = 0; i < res.num; i++) {
+                os_free(orig[i]);
+                os_free(res.res[i]);
+        }
+        os_free(orig);
+        os_free(res.res);
+
+        return errors;
+}
+
+
+static int test_arena(size_t num)
+{
+        struct wpa_scan_results *res, *old;
+        struct wpa_scan_res **orig, **tmp, *r;
+        struct os_reltime t0, t1, t2;
+        size_t i, j, rounds;
+        int errors = 0;
+
+        orig = os_malloc(num * sizeof(struct wpa_scan_res *));
+        if (orig == NULL)
+                return -1;
+        for (i = 0; i < num; i++) {
+                orig[i] = gen_res(i);
+                if (orig[i] == NULL)
+                        return -1;
+        }
+
+        /* Build and free scan result tables as the driver wrappers do */
+        rounds = BENCH_ENTRIES / num;
+        os_get_reltime(&t0);
+        for (j = 0; j < rounds; j++) {
+                old = os_zalloc(sizeof(*old));
+                if (old == NULL)
+                        return -1;
+                for (i = 0; i < num; i++) {
+                        r = os_malloc(sizeof(*r) + orig[i]->ie_len);
+                        if (r == NULL)
+                                return -1;
+                        os_memcpy(r, orig[i], sizeof(*r) + orig[i]->ie_len);
+                        /* Stray driver flags must not affect ownership */
+                        r->flags = ~0U;
+                        tmp = os_realloc(old->res, (old->num + 1) *
+                                         sizeof(struct wpa_scan_res *));
+                        if (tmp == NULL)
+                                return -1;
+                        tmp[old->num++] = r;
+                        old->res = tmp;
+                }
+                wpa_scan_results_index(old);
+                wpa_scan_results_free(old);
+        }
+        os_get_reltime(&t1);
+        for (j = 0; j < rounds; j++) {
+                res = os_zalloc(sizeof(*res));
+                if (res == NULL)
+                        return -1;
+                for (i = 0; i < num; i++) {
+                        r = wpa_scan_results_add(res, orig[i]->ie_len);
+                        if (r == NULL)
+                                return -1;
+                        os_memcpy(r, orig[i], sizeof(*r) + orig[i]->ie_len);
+                        r->flags = 0;
+                }
+                wpa_scan_results_index(res);
+                if (j + 1 < rounds)
+                        wpa_scan_results_free(res);
+        }
+        os_get_reltime(&t2);
+
+        if (res->num != num) {
+                printf("Arena has %d of %d entries\n", (int) res->num,
+                       (int) num);
+                errors++;
+        }
+        for (i = 0; i < res->num; i++) {
+                r = res->res[i];
+                if ((unsigned long) r % sizeof(u64)) {
+                        printf("Arena entry %d is not aligned\n", (int) i);
+                        errors++;
+                }
+                if (r->ie_len != orig[i]->ie_len ||
+                    os_memcmp(r->bssid, orig[i]->bssid, ETH_ALEN) != 0 ||
+                    os_memcmp(r + 1, orig[i] + 1, r->ie_len) != 0 ||
+                    check_index(orig[i], r)) {
+                        printf("Arena entry %d mismatch\n", (int) i);
+                        errors++;
+                }
+        }
+        wpa_scan_results_free(res);
+
+        printf("Scan table %5d entries x %4d: malloc %.3f s, arena %.3f s\n",
+               (int) num, (int) rounds, time_diff(&t0, &t1),
+               time_diff(&t1, &t2));
+
+        for (i = 0; i < num; i++)
+                os_free(orig[i]);
+        os_free(orig);
+
+        return errors;
+}
+
+
+int main(int argc, char *argv[])
+{
+        int errors = 0;
+
+        errors += test_sort(50);
+        errors += test_sort(500);
+        errors += test_sort(5000);
+        errors += test_index(500);
+        errors += test_arena(200);
+        errors += test_arena(5000);
+
+        if (errors) {
+                printf("scan helpers test - FAILED (%d errors)\n", errors);
+                return -1;
+        }
+        printf("scan helpers test - OK\n");
+        return 0;
+}
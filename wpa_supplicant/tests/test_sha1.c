@@ -291,6 +291,162 @@ static struct passphrase_test passphrase_tests[] =
 (sizeof(passphrase_tests) / sizeof(passphrase_tests[0]))
 
 
+/* Reference PBKDF2-SHA1 with a full HMAC-SHA1 operation per iteration */
+static void pbkdf2_sha1_ref(const char *passphrase, const char *ssid,
+                            size_t ssid_len, int iterations, u8 *buf,
+                            size_t buflen)
+{
+        u8 count_buf[4], tmp[SHA1_MAC_LEN], digest[SHA1_MAC_LEN];
+        const u8 *addr[2];
+        size_t len[2], plen;
+        size_t passphrase_len = os_strlen(passphrase);
+        unsigned int count = 0;
+        int i, j;
+
+        addr[0] = (const u8 *) ssid;
+        len[0] = ssid_len;
+        addr[1] = count_buf;
+        len[1] = 4;
+
+        while (buflen > 0) {
+                count++;
+                WPA_PUT_BE32(count_buf, count);
+                hmac_sha1_vector((const u8 *) passphrase, passphrase_len, 2,
+                                 addr, len, tmp);
+                os_memcpy(digest, tmp, SHA1_MAC_LEN);
+                for (i = 1; i < iterations; i++) {
+                        hmac_sha1((const u8 *) passphrase, passphrase_len, tmp,
+                                  SHA1_MAC_LEN, tmp);
+                        for (j = 0; j < SHA1_MAC_LEN; j++)
+                                digest[j] ^= tmp[j];
+                }
+                plen = buflen > SHA1_MAC_LEN ? SHA1_MAC_LEN : buflen;
+                os_memcpy(buf, digest, plen);
+                buf += plen;
+                buflen -= plen;
+        }
+}
+
+
+static double time_diff(struct os_reltime *start, struct os_reltime *end)
+{
+        struct os_reltime diff;
+        os_reltime_sub(end, start, &diff);
+        return diff.sec + diff.usec / 1000000.0;
+}
+
+
+#define PBKDF2_BENCH_ROUNDS 20
+
+static int test_pbkdf2_benchmark(void)
+{
+        const char *long_passphrase =
+                "This passphrase is longer than the 64 octet HMAC-SHA1 block "
+                "size and is hashed first";
+        u8 psk[32], ref[32];
+        struct os_reltime t0, t1, t2;
+        double fast, slow;
+        int i, errors = 0;
+
+        pbkdf2_sha1(long_passphrase, "ssid", 4, 4096, psk, 32);
+        pbkdf2_sha1_ref(long_passphrase, "ssid", 4, 4096, ref, 32);
+        if (os_memcmp(psk, ref, 32) != 0) {
+                printf("PBKDF2-SHA1 long passphrase test - FAILED!\n");
+                errors++;
+        }
+
+        os_get_reltime(&t0);
+        for (i = 0; i < PBKDF2_BENCH_ROUNDS; i++)
+                pbkdf2_sha1("benchmark passphrase", "benchmark", 9, 4096,
+                            psk, 32);
+        os_get_reltime(&t1);
+        for (i = 0; i < PBKDF2_BENCH_ROUNDS; i++)
+                pbkdf2_sha1_ref("benchmark passphrase", "benchmark", 9, 4096,
+                                ref, 32);
+        os_get_reltime(&t2);
+
+        if (os_memcmp(psk, ref, 32) != 0) {
+                printf("PBKDF2-SHA1 benchmark result mismatch - FAILED!\n");
+                errors++;
+        }
+
+        fast = time_diff(&t0, &t1);
+        slow = time_diff(&t1, &t2);
+        printf("PBKDF2-SHA1 benchmark: %d PSKs: %.3f s (HMAC per iteration: "
+               "%.3f s, speedup %.2fx)\n", PBKDF2_BENCH_ROUNDS, fast, slow,
+               fast > 0 ? slow / fast : 0.0);
+
+        return errors;
+}
+
+
+#define PBKDF2_BATCH_SIZE 32
+
+static int test_pbkdf2_batch(void)
+{
+        const char *passphrase[PBKDF2_BATCH_SIZE], *ssid[PBKDF2_BATCH_SIZE];
+        size_t ssid_len[PBKDF2_BATCH_SIZE];
+        u8 psk[PBKDF2_BATCH_SIZE][32], ref[32], *buf[PBKDF2_BATCH_SIZE];
+        char names[PBKDF2_BATCH_SIZE][16];
+        struct os_reltime t0, t1, t2;
+        double batch, serial;
+        unsigned int i;
+        int errors = 0;
+
+        printf("PBKDF2-SHA1 batch test cases:\n");
+        for (i = 0; i < PBKDF2_BATCH_SIZE; i++) {
+                struct passphrase_test *test =
+                        &passphrase_tests[i % NUM_PASSPHRASE_TESTS];
+                passphrase[i] = test->passphrase;
+                ssid[i] = test->ssid;
+                ssid_len[i] = strlen(test->ssid);
+                buf[i] = psk[i];
+        }
+        /* Odd count leaves some SIMD lanes unused */
+        pbkdf2_sha1_batch(passphrase, ssid, ssid_len, NUM_PASSPHRASE_TESTS + 2,
+                          4096, buf, 32);
+        for (i = 0; i < NUM_PASSPHRASE_TESTS + 2; i++) {
+                struct passphrase_test *test =
+                        &passphrase_tests[i % NUM_PASSPHRASE_TESTS];
+                if (memcmp(psk[i], test->psk, 32) == 0)
+                        printf("Test case %d - OK\n", i);
+                else {
+                        printf("Test case %d - FAILED!\n", i);
+                        errors++;
+                }
+        }
+
+        for (i = 0; i < PBKDF2_BATCH_SIZE; i++) {
+                os_snprintf(names[i], sizeof(names[i]), "network-%u", i);
+                ssid[i] = names[i];
+                ssid_len[i] = strlen(names[i]);
+        }
+
+        os_get_reltime(&t0);
+        pbkdf2_sha1_batch(passphrase, ssid, ssid_len, PBKDF2_BATCH_SIZE,
+                          4096, buf, 32);
+        os_get_reltime(&t1);
+        for (i = 0; i < PBKDF2_BATCH_SIZE; i++) {
+                pbkdf2_sha1(passphrase[i], ssid[i], ssid_len[i], 4096, ref,
+                            32);
+                if (memcmp(psk[i], ref, 32) != 0) {
+                        printf("PBKDF2-SHA1 batch entry %u mismatch - "
+                               "FAILED!\n", i);
+                        errors++;
+                }
+        }
+        os_get_reltime(&t2);
+
+        batch = time_diff(&t0, &t1);
+        serial = time_diff(&t1, &t2);
+        printf("PBKDF2-SHA1 batch benchmark: %d PSKs: %.3f s (serial: "
+               "%.3f s, speedup %.2fx)\n", PBKDF2_BATCH_SIZE, batch, serial,
+               batch > 0 ? serial / batch : 0.0);
+
+        return errors;
+}
+
+
 int main(int argc, char *argv[])
 {
         u8 res[512];
@@ -343,5 +499,27 @@ int main(int argc, char *argv[])
                 }
         }
 
+        printf("PBKDF2-SHA1 incremental test cases:\n");
+        for (i = 0; i < NUM_PASSPHRASE_TESTS; i++) {
+                u8 psk[32];
+                struct passphrase_test *test = &passphrase_tests[i];
+                struct pbkdf2_sha1_ctx *ctx;
+                int steps = 0;
+                ctx = pbkdf2_sha1_init(test->passphrase, test->ssid,
+                                       strlen(test->ssid), 4096, 32);
+                while (ctx && !pbkdf2_sha1_update(ctx, 100))
+                        steps++;
+                if (ctx && pbkdf2_sha1_deinit(ctx, psk) == 0 &&
+                    memcmp(psk, test->psk, 32) == 0)
+                        printf("Test case %d - OK (%d steps)\n", i, steps);
+                else {
+                        printf("Test case %d - FAILED!\n", i);
+                        ret++;
+                }
+        }
+
+        ret += test_pbkdf2_benchmark();
+        ret += test_pbkdf2_batch();
+
         return ret;
 }
@@ -18,19 +18,93 @@
 #include "sha1.h"
 
 
+static int check_passphrase(const char *passphrase)
+{
+        if (os_strlen(passphrase) < 8 || os_strlen(passphrase) > 63) {
+                printf("Passphrase must be 8..63 characters\n");
+                return -1;
+        }
+        return 0;
+}
+
+
+static void print_network(const char *ssid, const char *passphrase,
+                          const u8 *psk)
+{
+        int i;
+
+        printf("network={\n");
+        printf("\tssid=\"%s\"\n", ssid);
+        printf("\t#psk=\"%s\"\n", passphrase);
+        printf("\tpsk=");
+        for (i = 0; i < 32; i++)
+                printf("%02x", psk[i]);
+        printf("\n");
+        printf("}\n");
+}
+
+
 int main(int argc, char *argv[])
 {
         unsigned char psk[32];
-        int i;
         char *ssid, *passphrase, buf[64], *pos;
+        const char **passphrases, **ssids;
+        size_t *ssid_lens;
+        u8 **psks;
+        int i, num;
 
         if (argc < 2) {
-                printf("usage: wpa_passphrase <ssid> [passphrase]\n"
-                        "\nIf passphrase is left out, it will be read from "
-                        "stdin\n");
+                printf("usage: wpa_passphrase <ssid> [passphrase] "
+                       "[<ssid> <passphrase> ...]\n"
+                       "\nIf passphrase is left out, it will be read from "
+                       "stdin\n");
                 return 1;
         }
 
+        if (argc > 3) {
+                /* Multiple networks; derive the PSKs as a single batch */
+                if (argc % 2 == 0) {
+                        printf("Missing passphrase for SSID '%s'\n",
+                               argv[argc - 1]);
+                        return 1;
+                }
+                num = (argc - 1) / 2;
+                passphrases = os_malloc(num * sizeof(char *));
+                ssids = os_malloc(num * sizeof(char *));
+                ssid_lens = os_malloc(num * sizeof(size_t));
+                psks = os_malloc(num * sizeof(u8 *));
+                if (passphrases == NULL || ssids == NULL ||
+                    ssid_lens == NULL || psks == NULL) {
+                        printf("Failed to allocate memory\n");
+                        return 1;
+                }
+                for (i = 0; i < num; i++) {
+                        ssids[i] = argv[1 + 2 * i];
+                        ssid_lens[i] = os_strlen(ssids[i]);
+                        passphrases[i] = argv[2 + 2 * i];
+                        if (check_passphrase(passphrases[i]) < 0)
+                                return 1;
+                        psks[i] = os_malloc(32);
+                        if (psks[i] == NULL) {
+                                printf("Failed to allocate memory\n");
+                                return 1;
+                        }
+                }
+
+                pbkdf2_sha1_batch(passphrases, ssids, ssid_lens, num, 4096,
+                                  psks, 32);
+
+                for (i = 0; i < num; i++) {
+                        print_network(ssids[i], passphrases[i], psks[i]);
+                        os_free(psks[i]);
+                }
+                os_free(passphrases);
+                os_free(ssids);
+                os_free(ssid_lens);
+                os_free(psks);
+                return 0;
+        }
+
         ssid = argv[1];
 
         if (argc > 2) {
@@ -53,21 +127,11 @@ int main(int argc, char *argv[])
                 passphrase = buf;
         }
 
-        if (os_strlen(passphrase) < 8 || os_strlen(passphrase) > 63) {
-                printf("Passphrase must be 8..63 characters\n");
+        if (check_passphrase(passphrase) < 0)
                 return 1;
-        }
 
         pbkdf2_sha1(passphrase, ssid, os_strlen(ssid), 4096, psk, 32);
-
-        printf("network={\n");
-        printf("\tssid=\"%s\"\n", ssid);
-        printf("\t#psk=\"%s\"\n", passphrase);
-        printf("\tpsk=");
-        for (i = 0; i < 32; i++)
-                printf("%02x", psk[i]);
-        printf("\n");
-        printf("}\n");
+        print_network(ssid, passphrase, psk);
 
         return 0;
 }
@@ -37,10 +37,12 @@
 #include "mlme.h"
 #include "ieee802_11_defs.h"
 #include "blacklist.h"
+#include "bss.h"
 #include "wpas_glue.h"
 #include "wps_supplicant.h"
 #include "wpa_i.h"
 #include "wpa_common.h"
+#include "sha1.h"
 
 const char *wpa_supplicant_version =
 "wpa_supplicant v" VERSION_STR "\n"
@@ -380,8 +382,10 @@ static void wpa_supplicant_cleanup(struct wpa_supplicant *wpa_s)
 
         wpa_scan_results_free(wpa_s->scan_res);
         wpa_s->scan_res = NULL;
+        wpa_bss_deinit(wpa_s);
 
         wpa_supplicant_cancel_scan(wpa_s);
+        wpa_supplicant_roam_scan_stop(wpa_s);
         wpa_supplicant_cancel_auth_timeout(wpa_s);
 
         ieee80211_sta_deinit(wpa_s);
@@ -390,6 +394,8 @@ static void wpa_supplicant_cleanup(struct wpa_supplicant *wpa_s)
 
         wpabuf_free(wpa_s->pending_eapol_rx);
         wpa_s->pending_eapol_rx = NULL;
+
+        wpa_supplicant_psk_derive_cancel(wpa_s);
 }
 
 
@@ -508,6 +514,11 @@ void wpa_supplicant_set_state(struct wpa_supplicant *wpa_s, wpa_states state)
                 wpa_s->new_connection = 1;
                 wpa_drv_set_operstate(wpa_s, 0);
         }
+        if (state == WPA_COMPLETED) {
+                wpa_supplicant_reset_scan_backoff(wpa_s);
+                wpa_supplicant_roam_scan_start(wpa_s);
+        } else if (state < WPA_ASSOCIATED)
+                wpa_supplicant_roam_scan_stop(wpa_s);
         wpa_s->wpa_state = state;
 }
 
@@ -902,15 +913,162 @@ int wpa_supplicant_set_suites(struct wpa_supplicant *wpa_s,
         }
 
         if (ssid->key_mgmt &
-            (WPA_KEY_MGMT_PSK | WPA_KEY_MGMT_FT_PSK | WPA_KEY_MGMT_PSK_SHA256))
+            (WPA_KEY_MGMT_PSK | WPA_KEY_MGMT_FT_PSK |
+             WPA_KEY_MGMT_PSK_SHA256)) {
+                if (ssid->psk_pending) {
+                        /* Not selected through wpa_supplicant_associate(), so
+                         * the PSK is needed right away */
+                        wpa_config_update_psk(ssid);
+                }
                 wpa_sm_set_pmk(wpa_s->wpa, ssid->psk, PMK_LEN);
-        else
+        } else
                 wpa_sm_set_pmk_from_pmksa(wpa_s->wpa);
 
         return 0;
 }
 
 
+#ifndef CONFIG_NO_PBKDF2
+
+/* Number of PBKDF2 iterations to run per eloop callback */
+#define PSK_DERIVE_STEP_ITERATIONS 256
+
+static void wpa_supplicant_psk_derive_step(void *eloop_ctx, void *timeout_ctx);
+
+
+static int wpa_supplicant_psk_derive_match(struct wpa_supplicant *wpa_s,
+                                           struct wpa_ssid *ssid)
+{
+        return wpa_s->psk_derive && ssid->id == wpa_s->psk_derive_id &&
+                ssid->passphrase &&
+                os_strcmp(ssid->passphrase,
+                          wpa_s->psk_derive_passphrase) == 0 &&
+                ssid->ssid_len == wpa_s->psk_derive_ssid_len &&
+                os_memcmp(ssid->ssid, wpa_s->psk_derive_ssid,
+                          ssid->ssid_len) == 0;
+}
+
+
+/*
+ * Start deriving the PSK for a network that has psk_pending set. The work is
+ * split into eloop callbacks and wpa_supplicant_associate() is called again
+ * once the PSK is available.
+ */
+static void wpa_supplicant_psk_derive_start(struct wpa_supplicant *wpa_s,
+                                            struct wpa_scan_res *bss,
+                                            struct wpa_ssid *ssid)
+{
+        if (!wpa_supplicant_psk_derive_match(wpa_s, ssid)) {
+                wpa_supplicant_psk_derive_cancel(wpa_s);
+                if (ssid->ssid_len > sizeof(wpa_s->psk_derive_ssid))
+                        goto blocking;
+                wpa_s->psk_derive = pbkdf2_sha1_init(ssid->passphrase,
+                                                     (char *) ssid->ssid,
+                                                     ssid->ssid_len, 4096,
+                                                     PMK_LEN);
+                wpa_s->psk_derive_passphrase = os_strdup(ssid->passphrase);
+                if (wpa_s->psk_derive == NULL ||
+                    wpa_s->psk_derive_passphrase == NULL) {
+                        wpa_supplicant_psk_derive_cancel(wpa_s);
+                        goto blocking;
+                }
+                wpa_s->psk_derive_id = ssid->id;
+                os_memcpy(wpa_s->psk_derive_ssid, ssid->ssid, ssid->ssid_len);
+                wpa_s->psk_derive_ssid_len = ssid->ssid_len;
+                wpa_printf(MSG_DEBUG, "Deriving PSK for network id=%d before "
+                           "association", ssid->id);
+                eloop_register_timeout(0, 0, wpa_supplicant_psk_derive_step,
+                                       wpa_s, NULL);
+        }
+
+        if (bss)
+                os_memcpy(wpa_s->psk_derive_bssid, bss->bssid, ETH_ALEN);
+        else
+                os_memset(wpa_s->psk_derive_bssid, 0, ETH_ALEN);
+        wpa_supplicant_cancel_scan(wpa_s);
+        return;
+
+blocking:
+        wpa_config_update_psk(ssid);
+        wpa_supplicant_associate(wpa_s, bss, ssid);
+}
+
+
+static void wpa_supplicant_psk_derive_step(void *eloop_ctx, void *timeout_ctx)
+{
+        struct wpa_supplicant *wpa_s = eloop_ctx;
+        struct wpa_ssid *ssid;
+        struct wpa_bss *bss;
+
+        if (!pbkdf2_sha1_update(wpa_s->psk_derive,
+                                PSK_DERIVE_STEP_ITERATIONS)) {
+                eloop_register_timeout(0, 0, wpa_supplicant_psk_derive_step,
+                                       wpa_s, NULL);
+                return;
+        }
+
+        /* The network may have been removed or changed in the meantime */
+        ssid = wpa_config_get_network(wpa_s->conf, wpa_s->psk_derive_id);
+        if (ssid == NULL || !ssid->psk_pending ||
+            !wpa_supplicant_psk_derive_match(wpa_s, ssid)) {
+                wpa_printf(MSG_DEBUG, "Network changed during PSK "
+                           "derivation - drop result");
+                wpa_supplicant_psk_derive_cancel(wpa_s);
+                return;
+        }
+
+        pbkdf2_sha1_deinit(wpa_s->psk_derive, ssid->psk);
+        wpa_s->psk_derive = NULL;
+        wpa_supplicant_psk_derive_cancel(wpa_s);
+        wpa_hexdump_key(MSG_MSGDUMP, "PSK (from passphrase)",
+                        ssid->psk, PMK_LEN);
+        ssid->psk_set = 1;
+        ssid->psk_pending = 0;
+
+        if (wpa_s->disconnected || ssid->disabled)
+                return;
+
+        if (is_zero_ether_addr(wpa_s->psk_derive_bssid)) {
+                wpa_supplicant_associate(wpa_s, NULL, ssid);
+                return;
+        }
+
+        bss = wpa_bss_get_bssid(wpa_s, wpa_s->psk_derive_bssid);
+        if (bss)
+                wpa_supplicant_associate(wpa_s, bss->res, ssid);
+        else {
+                /* BSS has expired; select the network again */
+                wpa_s->reassociate = 1;
+                wpa_supplicant_req_scan(wpa_s, 0, 0);
+        }
+}
+
+#endif /* CONFIG_NO_PBKDF2 */
+
+
+/**
+ * wpa_supplicant_psk_derive_cancel - Stop pending PSK derivation
+ * @wpa_s: Pointer to wpa_supplicant data
+ *
+ * The network for which the PSK was being derived keeps psk_pending set and
+ * the derivation is started again the next time the network is selected.
+ */
+void wpa_supplicant_psk_derive_cancel(struct wpa_supplicant *wpa_s)
+{
+#ifndef CONFIG_NO_PBKDF2
+        eloop_cancel_timeout(wpa_supplicant_psk_derive_step, wpa_s, NULL);
+        pbkdf2_sha1_deinit(wpa_s->psk_derive, NULL);
+        wpa_s->psk_derive = NULL;
+        if (wpa_s->psk_derive_passphrase) {
+                os_memset(wpa_s->psk_derive_passphrase, 0,
+                          os_strlen(wpa_s->psk_derive_passphrase));
+                os_free(wpa_s->psk_derive_passphrase);
+                wpa_s->psk_derive_passphrase = NULL;
+        }
+#endif /* CONFIG_NO_PBKDF2 */
+}
+
+
 /**
  * wpa_supplicant_associate - Request association
  * @wpa_s: Pointer to wpa_supplicant data
@@ -936,6 +1094,14 @@ void wpa_supplicant_associate(struct wpa_supplicant *wpa_s,
         int rekey_number = 0;
 #endif
 
+#ifndef CONFIG_NO_PBKDF2
+        if (ssid->psk_pending) {
+                /* lazy_psk=1: derive PSK first without blocking eloop */
+                wpa_supplicant_psk_derive_start(wpa_s, bss, ssid);
+                return;
+        }
+#endif /* CONFIG_NO_PBKDF2 */
+
         wpa_s->reassociate = 0;
         if (bss) {
 #ifdef CONFIG_IEEE80211R
@@ -1394,7 +1560,9 @@ static int wpa_supplicant_get_scan_results_old(struct wpa_supplicant *wpa_s)
  * Returns: 0 on success, -1 on failure
  *
  * This function is request the current scan results from the driver and stores
- * a local copy of the results in wpa_s->scan_res.
+ * a local copy of the results in wpa_s->scan_res. The BSS table is updated
+ * based on the results and wpa_s->last_scan_res will point to the BSS entries
+ * included in the results.
  */
 int wpa_supplicant_get_scan_results(struct wpa_supplicant *wpa_s)
 {
@@ -1420,8 +1588,15 @@ int wpa_supplicant_get_scan_results(struct wpa_supplicant *wpa_s)
                         ret = 0;
         }
 
-        if (wpa_s->scan_res)
+        if (wpa_s->scan_res) {
+                wpa_scan_results_index(wpa_s->scan_res);
                 wpa_scan_sort_results(wpa_s->scan_res);
+                if (wpa_bss_update_scan_res(wpa_s, wpa_s->scan_res) < 0) {
+                        wpa_printf(MSG_WARNING, "Failed to update BSS "
+                                   "table");
+                        ret = -1;
+                }
+        }
 
         return ret;
 }
@@ -1917,7 +2092,13 @@ static int wpa_supplicant_init_iface2(struct wpa_supplicant *wpa_s)
                 return -1;
         }
 
+        wpa_s->max_scan_ssids = 1;
+        os_memset(&capa, 0, sizeof(capa));
         if (wpa_drv_get_capa(wpa_s, &capa) == 0) {
+                if (capa.max_scan_ssids > 1)
+                        wpa_s->max_scan_ssids = capa.max_scan_ssids;
+                if (wpa_s->max_scan_ssids > WPAS_MAX_SCAN_SSIDS)
+                        wpa_s->max_scan_ssids = WPAS_MAX_SCAN_SSIDS;
                 if (capa.flags & WPA_DRIVER_FLAGS_USER_SPACE_MLME) {
                         wpa_s->use_client_mlme = 1;
                         if (ieee80211_sta_init(wpa_s))
@@ -32,6 +32,8 @@ extern struct wpa_driver_ops *wpa_supplicant_drivers[];
 
 struct wpa_scan_result;
 struct wpa_sm;
+struct wpa_bss;
+struct wpa_ess_chans;
 struct wpa_supplicant;
 
 /*
@@ -322,6 +324,18 @@ struct wpa_supplicant {
 
   struct wpa_scan_results *scan_res;
 
+#define WPA_BSS_HASH_SIZE 64
+  struct wpa_bss *bss; /* BSS table, least recently updated first */
+  struct wpa_bss *bss_tail;
+  struct wpa_bss *bss_hash[WPA_BSS_HASH_SIZE];
+  size_t num_bss;
+  unsigned int bss_next_id;
+  unsigned int bss_update_idx;
+  /* BSS entries from the latest scan in the order of preference */
+  struct wpa_bss **last_scan_res;
+  size_t last_scan_res_used;
+  size_t last_scan_res_size;
+
   struct wpa_driver_ops *driver;
   int interface_removed; /* whether the network interface has been
         * removed */
@@ -353,6 +367,20 @@ struct wpa_supplicant {
            * to speed up the first association if the driver
            * has already available scan results. */
   int scan_runs; /* number of scan runs since WPS was started */
+  int max_scan_ssids; /* maximum number of SSIDs in a scan request */
+  int *next_scan_freqs; /* channels for the next scan or NULL for all */
+  int *last_scan_freqs; /* channels of the last started scan or NULL */
+  struct os_reltime last_full_scan; /* last scan that covered all channels */
+  struct wpa_ess_chans *ess_chans; /* channel history, see bss.h */
+  int scan_interval; /* current periodic scan interval; 0 = not backing off */
+  struct os_reltime scan_start; /* time the latest driver scan was started */
+  unsigned int scan_requests; /* explicit scan requests */
+  unsigned int scan_periodic; /* scans scheduled by periodic backoff */
+  unsigned int scans_started; /* scans accepted by the driver */
+  unsigned int scans_failed; /* scans rejected by the driver */
+  unsigned int scans_skipped; /* scans skipped while one was in flight */
+  unsigned int scan_backoff_resets;
+  unsigned int scan_roaming; /* background roaming scans */
 
   struct wpa_client_mlme mlme;
   int use_client_mlme;
@@ -369,6 +397,14 @@ struct wpa_supplicant {
   struct wpabuf *pending_eapol_rx;
   struct os_time pending_eapol_rx_time;
   u8 pending_eapol_rx_src[ETH_ALEN];
+
+  /* PSK derivation in progress for a network with psk_pending set */
+  struct pbkdf2_sha1_ctx *psk_derive;
+  int psk_derive_id; /* network id */
+  char *psk_derive_passphrase;
+  u8 psk_derive_ssid[32];
+  size_t psk_derive_ssid_len;
+  u8 psk_derive_bssid[ETH_ALEN]; /* BSS to associate with; zero = none */
 };
 
 
@@ -377,6 +413,7 @@ int wpa_supplicant_reload_configuration(struct wpa_supplicant *wpa_s);
 
 const char * wpa_supplicant_state_txt(int state);
 int wpa_supplicant_driver_init(struct wpa_supplicant *wpa_s);
+void wpa_supplicant_psk_derive_cancel(struct wpa_supplicant *wpa_s);
 int wpa_supplicant_set_suites(struct wpa_supplicant *wpa_s,
             struct wpa_scan_res *bss,
             struct wpa_ssid *ssid,
@@ -417,7 +454,13 @@ int wpa_supplicant_scard_init(struct wpa_supplicant *wpa_s,
 /* scan.c */
 int wpa_supplicant_enabled_networks(struct wpa_config *conf);
 void wpa_supplicant_req_scan(struct wpa_supplicant *wpa_s, int sec, int usec);
+void wpa_supplicant_req_periodic_scan(struct wpa_supplicant *wpa_s);
+void wpa_supplicant_reset_scan_backoff(struct wpa_supplicant *wpa_s);
+int wpa_supplicant_scan_get_mib(struct wpa_supplicant *wpa_s, char *buf,
+                                size_t buflen);
 void wpa_supplicant_cancel_scan(struct wpa_supplicant *wpa_s);
+void wpa_supplicant_roam_scan_start(struct wpa_supplicant *wpa_s);
+void wpa_supplicant_roam_scan_stop(struct wpa_supplicant *wpa_s);
 void wpa_supplicant_notify_scanning(struct wpa_supplicant *wpa_s,
             int scanning);
 
@@ -515,6 +558,22 @@ static inline int wpa_drv_scan(struct wpa_supplicant *wpa_s, const u8 *ssid,
   return -1;
 }
 
+static inline int wpa_drv_scan2(struct wpa_supplicant *wpa_s,
+        struct wpa_driver_scan_params *params)
+{
+  if (wpa_s->driver->scan2)
+    return wpa_s->driver->scan2(wpa_s->drv_priv, params);
+  if (wpa_s->driver->scan) {
+    /* Fall back to the first SSID on all channels */
+    return wpa_s->driver->scan(wpa_s->drv_priv,
+             params->num_ssids ?
+             params->ssids[0].ssid : NULL,
+             params->num_ssids ?
+             params->ssids[0].ssid_len : 0);
+  }
+  return -1;
+}
+
 static inline int wpa_drv_get_scan_results(struct wpa_supplicant *wpa_s,
              struct wpa_scan_result *results,
              size_t max_size)
@@ -263,6 +263,7 @@ static int wpa_supplicant_wps_cred(void *ctx,
                 os_memcpy(ssid->ssid, cred->ssid, cred->ssid_len);
                 ssid->ssid_len = cred->ssid_len;
         }
+        wpa_config_prio_changed(wpa_s->conf, NULL);
 
         switch (cred->encr_type) {
         case WPS_ENCR_NONE:
@@ -529,6 +530,7 @@ static struct wpa_ssid * wpas_wps_add_network(struct wpa_supplicant *wpa_s,
                         ssid->ssid = NULL;
                         ssid->ssid_len = 0;
                 }
+                wpa_config_prio_changed(wpa_s->conf, NULL);
         }
 
         return ssid;
@@ -862,7 +864,7 @@ int wpas_wps_scan_pbc_overlap(struct wpa_supplicant *wpa_s,
         for (i = 0; i < wpa_s->scan_res->num; i++) {
                 struct wpa_scan_res *bss = wpa_s->scan_res->res[i];
                 struct wpabuf *ie;
-                if (bss == selected)
+                if (os_memcmp(bss->bssid, selected->bssid, ETH_ALEN) == 0)
                         continue;
                 ie = wpa_scan_get_vendor_ie_multi(bss, WPS_IE_VENDOR_TYPE);
                 if (!ie)